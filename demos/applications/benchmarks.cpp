@@ -0,0 +1,385 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+
+#include <libhal-stm32f4/boot.hpp>
+#include <libhal-stm32f4/constants.hpp>
+#include <libhal-stm32f4/dsp.hpp>
+#include <libhal-stm32f4/interrupt.hpp>
+#include <libhal-stm32f4/output_pin.hpp>
+#include <libhal-stm32f4/pin.hpp>
+#include <libhal-stm32f4/port_configuration.hpp>
+#include <libhal-stm32f4/profile.hpp>
+#include <libhal-stm32f4/ramfunc.hpp>
+#include <libhal-stm32f4/spi.hpp>
+#include <libhal-stm32f4/spsc_ring.hpp>
+#include <libhal/units.hpp>
+
+// Results are reported as one JSON object per line on ITM stimulus port 0,
+// which most debug probes can capture over SWO, for example:
+//
+//    pyocd gdbserver --swv --swv-system-clock 16000000 --swv-clock 2000000
+//
+// Every line has the form:
+//
+//    {"bench":"<name>","variant":<n>,"param":<n>,"iterations":<n>,"cycles":<n>}
+//
+// where "cycles" is the total DWT cycle count for all iterations. "variant"
+// and "param" are benchmark specific, for example spi_transfer uses the bus
+// clock rate in kHz and the transfer size in bytes.
+
+namespace {
+/// Instrumentation trace macrocell registers
+struct itm_reg_t
+{
+  /// Offset: 0x000 Stimulus ports
+  std::array<std::uint32_t volatile, 32> port;
+  std::array<std::uint32_t volatile, 864> reserved0;
+  /// Offset: 0xE00 Trace Enable Register
+  std::uint32_t volatile ter;
+  std::array<std::uint32_t volatile, 15> reserved1;
+  /// Offset: 0xE40 Trace Privilege Register
+  std::uint32_t volatile tpr;
+  std::array<std::uint32_t volatile, 15> reserved2;
+  /// Offset: 0xE80 Trace Control Register
+  std::uint32_t volatile tcr;
+};
+
+auto* const itm = reinterpret_cast<itm_reg_t*>(0xE000'0000);
+
+void itm_write(std::string_view p_text)
+{
+  // The debugger enables the ITM and port 0 when it starts capturing SWO.
+  // Until then, the port would read as full forever.
+  if ((itm->tcr & 1U) == 0 || (itm->ter & 1U) == 0) {
+    return;
+  }
+
+  for (char const character : p_text) {
+    // Port reads as 0 while its FIFO is full
+    while (itm->port[0] == 0) {
+      continue;
+    }
+    *reinterpret_cast<std::uint8_t volatile*>(&itm->port[0]) =
+      static_cast<std::uint8_t>(character);
+  }
+}
+
+void itm_write(std::uint32_t p_number)
+{
+  std::array<char, 10> digits{};
+  auto const result =
+    std::to_chars(digits.data(), digits.data() + digits.size(), p_number);
+  itm_write(std::string_view(digits.data(), result.ptr));
+}
+
+void report(std::string_view p_name,
+            std::uint32_t p_variant,
+            std::uint32_t p_param,
+            std::uint32_t p_iterations,
+            std::uint32_t p_cycles)
+{
+  itm_write("{\"bench\":\"");
+  itm_write(p_name);
+  itm_write("\",\"variant\":");
+  itm_write(p_variant);
+  itm_write(",\"param\":");
+  itm_write(p_param);
+  itm_write(",\"iterations\":");
+  itm_write(p_iterations);
+  itm_write(",\"cycles\":");
+  itm_write(p_cycles);
+  itm_write("}\n");
+}
+
+template<typename Operation>
+std::uint32_t measure(std::uint32_t p_iterations, Operation&& p_operation)
+{
+  auto const start = hal::stm32f4::cycle_count();
+  for (std::uint32_t i = 0; i < p_iterations; i++) {
+    p_operation();
+  }
+  return hal::stm32f4::cycle_count() - start;
+}
+
+void benchmark_gpio()
+{
+  constexpr std::uint32_t iterations = 10'000;
+  hal::stm32f4::output_pin pin(hal::stm32f4::peripheral::gpio_a, 5);
+
+  // One iteration is a full period: a rising and a falling edge
+  auto const cycles = measure(iterations, [&pin]() {
+    pin.level(true);
+    pin.level(false);
+  });
+  report("gpio_toggle.output_pin", 0, 0, iterations, cycles);
+}
+
+void benchmark_power()
+{
+  constexpr std::uint32_t iterations = 1'000;
+  // Constructing a pin powers on its port through RCC
+  auto const cycles = measure(iterations, []() {
+    hal::stm32f4::pin pin(hal::stm32f4::peripheral::gpio_c, 0);
+  });
+  report("rcc_power_on.gpio", 0, 0, iterations, cycles);
+}
+
+void benchmark_port_configuration()
+{
+  using hal::stm32f4::pin;
+  constexpr std::uint32_t iterations = 1'000;
+  constexpr std::uint8_t pin_count = 4;
+
+  // Unused pins PC0 to PC3 as fast outputs with a pull down, first with one
+  // read-modify-write per setting per pin, then batched per register
+  auto const separate = measure(iterations, []() {
+    for (std::uint8_t i = 0; i < pin_count; i++) {
+      pin(hal::stm32f4::peripheral::gpio_c, i)
+        .function(pin::pin_function::output)
+        .resistor(hal::pin_resistor::pull_down)
+        .speed(hal::stm32f4::pin_speed::fast);
+    }
+  });
+  report("pin_configure.pin", 0, pin_count, iterations, separate);
+
+  auto const batched = measure(iterations, []() {
+    hal::stm32f4::port_configuration port(hal::stm32f4::peripheral::gpio_c);
+    for (std::uint8_t i = 0; i < pin_count; i++) {
+      port.function(i, pin::pin_function::output)
+        .resistor(i, hal::pin_resistor::pull_down)
+        .speed(i, hal::stm32f4::pin_speed::fast);
+    }
+    port.commit();
+  });
+  report(
+    "pin_configure.port_configuration", 0, pin_count, iterations, batched);
+}
+
+void benchmark_spi()
+{
+  constexpr std::uint32_t iterations = 100;
+  constexpr std::array<std::uint32_t, 3> clock_rates_khz{ 1'000,
+                                                          4'000,
+                                                          8'000 };
+  constexpr std::array<std::uint32_t, 5> transfer_sizes{ 1, 4, 16, 64, 256 };
+  std::array<hal::byte, 256> buffer{};
+
+  for (auto const clock_rate : clock_rates_khz) {
+    hal::stm32f4::spi bus(
+      hal::runtime{},
+      2,
+      { .clock_rate = static_cast<hal::hertz>(clock_rate * 1'000) });
+
+    for (auto const size : transfer_sizes) {
+      auto const data = std::span(buffer).first(size);
+      auto const cycles =
+        measure(iterations, [&bus, data]() { bus.transfer(data, data); });
+      report("spi_transfer", clock_rate, size, iterations, cycles);
+    }
+  }
+}
+
+void benchmark_spsc_ring()
+{
+  constexpr std::uint32_t iterations = 1'000;
+  static hal::stm32f4::spsc_ring<hal::byte, 256> ring;
+
+  // One iteration hands a single byte through the ring
+  auto const single_cycles = measure(iterations, []() {
+    ring.push(0xA5);
+    static_cast<void>(ring.pop());
+  });
+  report("spsc_ring.push_pop", 0, 1, iterations, single_cycles);
+
+  // One iteration hands a block through the ring with bulk copies
+  std::array<hal::byte, 64> block{};
+  auto const block_cycles = measure(iterations, [&block]() {
+    ring.write(block);
+    ring.read(block);
+  });
+  report("spsc_ring.write_read",
+         0,
+         static_cast<std::uint32_t>(block.size()),
+         iterations,
+         block_cycles);
+}
+
+void benchmark_dsp()
+{
+  constexpr std::uint32_t iterations = 100;
+  constexpr std::size_t block = 256;
+  static std::array<hal::stm32f4::q15, block> samples{};
+  static std::array<hal::stm32f4::q15, block> output{};
+  std::span<hal::stm32f4::q15 const> const input(samples);
+  for (std::size_t i = 0; i < samples.size(); i++) {
+    samples[i] = static_cast<hal::stm32f4::q15>(i * 397U);
+  }
+
+  // Variant 0 is the SIMD kernel, variant 1 the scalar reference
+  std::int64_t volatile sink = 0;
+  report("dsp.dot_product_q15",
+         0,
+         block,
+         iterations,
+         measure(iterations, [&]() {
+           sink = hal::stm32f4::dot_product(input, input);
+         }));
+  report("dsp.dot_product_q15",
+         1,
+         block,
+         iterations,
+         measure(iterations, [&]() {
+           sink = hal::stm32f4::reference::dot_product(input, input);
+         }));
+
+  report("dsp.statistics_q15",
+         0,
+         block,
+         iterations,
+         measure(iterations, [&]() {
+           sink = hal::stm32f4::statistics(input).mean;
+         }));
+  report("dsp.statistics_q15",
+         1,
+         block,
+         iterations,
+         measure(iterations, [&]() {
+           sink = hal::stm32f4::reference::statistics(input).mean;
+         }));
+
+  // "param" is the number of taps, the block is filtered without decimation
+  constexpr std::size_t taps = 32;
+  static std::array<hal::stm32f4::q15, taps - 1 + block> history{};
+  auto const coefficients = input.first(taps);
+  hal::stm32f4::fir_q15 filter(coefficients, history);
+  report("dsp.fir_q15",
+         0,
+         taps,
+         iterations,
+         measure(iterations, [&]() { filter.process(input, output); }));
+  report("dsp.fir_q15",
+         1,
+         taps,
+         iterations,
+         measure(iterations, [&]() {
+           hal::stm32f4::reference::fir(coefficients, input, output);
+         }));
+}
+
+/// Software Trigger Interrupt Register, pends the interrupt written to it
+auto* const nvic_stir = reinterpret_cast<std::uint32_t volatile*>(0xE000'EF00);
+std::uint32_t volatile interrupt_entry_cycle = 0;
+
+HAL_STM32F4_RAMFUNC void benchmark_interrupt_handler()
+{
+  interrupt_entry_cycle = hal::stm32f4::cycle_count();
+}
+
+void benchmark_interrupt()
+{
+  constexpr std::uint32_t iterations = 1'000;
+  // SDIO is not used by any of the benchmarks, so it is free to be pended by
+  // software
+  constexpr auto bench_irq = hal::stm32f4::irq::sdio;
+  hal::stm32f4::set_interrupt_priority(bench_irq, 0);
+  hal::stm32f4::enable_interrupt(bench_irq, benchmark_interrupt_handler);
+
+  // "cycles" is the total time from pending the interrupt to the first
+  // instruction of the handler reading the cycle counter
+  std::uint32_t total = 0;
+  for (std::uint32_t i = 0; i < iterations; i++) {
+    interrupt_entry_cycle = 0;
+    auto const start = hal::stm32f4::cycle_count();
+    *nvic_stir = static_cast<std::uint32_t>(bench_irq);
+    while (interrupt_entry_cycle == 0) {
+      continue;
+    }
+    total += interrupt_entry_cycle - start;
+  }
+
+  hal::stm32f4::disable_interrupt(bench_irq);
+  report("interrupt_entry.ram_vector", 0, 0, iterations, total);
+}
+
+void report_profiles()
+{
+  // Only populated if the library was built with LIBHAL_STM32F4_PROFILE.
+  // "iterations" is the number of samples and "cycles" is the p99 latency.
+  constexpr std::array<std::string_view,
+                       static_cast<std::size_t>(
+                         hal::stm32f4::profile_point::max)>
+    names{ "profile.spi_transfer.p99",
+           "profile.spi_configure.p99",
+           "profile.pin_configure.p99",
+           "profile.power_on.p99",
+           "profile.power_off.p99",
+           "profile.stop_wake.p99",
+           "profile.dma_complete.p99" };
+
+  for (std::size_t i = 0; i < names.size(); i++) {
+    auto const& histogram =
+      hal::stm32f4::profile(static_cast<hal::stm32f4::profile_point>(i));
+    report(
+      names[i], 0, 0, histogram.count(), histogram.percentile(0.99f));
+  }
+}
+
+void report_boot_phases()
+{
+  // "cycles" is the cycle count at the end of the phase, phases that were not
+  // marked are skipped. Only profiling builds start the cycle counter at
+  // boot, so only their counts are meaningful.
+  constexpr std::array<std::string_view,
+                       static_cast<std::size_t>(hal::stm32f4::boot_phase::max)>
+    names{ "boot.data_initialized",
+           "boot.constructors_done",
+           "boot.clocks_configured",
+           "boot.drivers_initialized",
+           "boot.application_started" };
+
+  for (std::size_t i = 0; i < names.size(); i++) {
+    auto const cycles = hal::stm32f4::boot_phase_cycles(
+      static_cast<hal::stm32f4::boot_phase>(i));
+    if (cycles) {
+      report(names[i], 0, 0, 1, *cycles);
+    }
+  }
+}
+}  // namespace
+
+void application()
+{
+  hal::stm32f4::enable_cycle_counter();
+  hal::stm32f4::reset_profiles();
+
+  report_boot_phases();
+  benchmark_gpio();
+  benchmark_power();
+  benchmark_port_configuration();
+  benchmark_spi();
+  benchmark_spsc_ring();
+  benchmark_dsp();
+  benchmark_interrupt();
+  report_profiles();
+  itm_write("{\"bench\":\"done\"}\n");
+
+  while (true) {
+    continue;
+  }
+}
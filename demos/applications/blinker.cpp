@@ -12,29 +12,21 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include <libhal-armcortex/dwt_counter.hpp>
 #include <libhal-stm32f4/output_pin.hpp>
-#include <libhal-util/serial.hpp>
-#include <libhal-util/steady_clock.hpp>
+#include <libhal-stm32f4/scheduler.hpp>
 
-// TODO(#15): Replace with `hal::cortex_m::dwt_counter`
-
-void delay_by_cycles(int p_cycles)
-{
-  int volatile i = 0;
-  while (i < p_cycles) {
-    i = i + 1;
-  }
-}
+using namespace std::chrono_literals;
 
 void application()
 {
   hal::stm32f4::output_pin led(hal::stm32f4::peripheral::gpio_b, 15);
+  hal::stm32f4::scheduler scheduler(hal::runtime{});
+  bool level = false;
 
-  while (true) {
-    led.level(false);
-    delay_by_cycles(1000000);
-    led.level(true);
-    delay_by_cycles(1000000);
-  }
+  // The core sleeps between toggles instead of spinning
+  scheduler.post_every(500ms, [&led, &level]() {
+    level = !level;
+    led.level(level);
+  });
+  scheduler.run();
 }
@@ -12,22 +12,12 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include <libhal-armcortex/dwt_counter.hpp>
-
 #include <libhal-stm32f4/input_pin.hpp>
 #include <libhal-stm32f4/output_pin.hpp>
-#include <libhal-util/steady_clock.hpp>
+#include <libhal-stm32f4/scheduler.hpp>
 #include <libhal/units.hpp>
 
-// TODO(#15): Replace with `hal::cortex_m::dwt_counter`
-
-void delay_by_cycles(int p_cycles)
-{
-  int volatile i = 0;
-  while (i < p_cycles) {
-    i = i + 1;
-  }
-}
+using namespace std::chrono_literals;
 
 void application()
 {
@@ -35,12 +25,14 @@ void application()
                                  13,
                                  { .resistor = hal::pin_resistor::pull_up });
   hal::stm32f4::output_pin led(hal::stm32f4::peripheral::gpio_a, 5);
+  hal::stm32f4::scheduler scheduler(hal::runtime{});
   bool led_val = false;
-  while (true) {
+
+  scheduler.post_every(50ms, [&]() {
     if (!button.level()) {
       led_val = !led_val;
     }
     led.level(led_val);
-    delay_by_cycles(200000);
-  }
+  });
+  scheduler.run();
 }
@@ -0,0 +1,46 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+
+#include <libhal-stm32f4/input_pin.hpp>
+#include <libhal-stm32f4/low_power.hpp>
+#include <libhal-stm32f4/output_pin.hpp>
+#include <libhal-stm32f4/profile.hpp>
+
+// Toggles an LED every 500ms while spending the time in between in stop mode.
+// Pressing the button on PC13 wakes the device early and lights the LED
+// until the next RTC wake-up.
+void application()
+{
+  using namespace std::chrono_literals;
+
+  hal::stm32f4::output_pin led(hal::stm32f4::peripheral::gpio_a, 5);
+  hal::stm32f4::input_pin button(hal::stm32f4::peripheral::gpio_c,
+                                 13,
+                                 { .resistor = hal::pin_resistor::pull_up });
+
+  hal::stm32f4::enable_cycle_counter();
+  hal::stm32f4::enable_rtc_wake(500ms);
+  hal::stm32f4::enable_pin_wake(
+    hal::stm32f4::peripheral::gpio_c, 13, hal::stm32f4::wake_edge::falling);
+
+  bool level = false;
+  while (true) {
+    level = !level;
+    led.level(level || !button.level());
+    // Cycles spent restoring the clocks, inspect with a debugger
+    [[maybe_unused]] auto volatile restore_cycles = hal::stm32f4::stop();
+  }
+}
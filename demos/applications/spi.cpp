@@ -55,5 +55,13 @@ void application()
     hal::write_then_read(spi2, payload, buffer);
     chip_select.level(true);
     delay_by_cycles(1000000);
+
+    // Same as above, without the bus going idle between write and read
+    std::array const segments{
+      hal::stm32f4::spi_segment{ .data_out = payload },
+      hal::stm32f4::spi_segment{ .data_in = buffer },
+    };
+    spi2.transaction(chip_select, segments);
+    delay_by_cycles(1000000);
   }
 }
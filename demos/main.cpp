@@ -13,14 +13,40 @@
 // limitations under the License.
 
 #include <libhal-armcortex/system_control.hpp>
+#include <libhal-stm32f4/boot.hpp>
 
 // Application function must be implemented by one of the compilation units
 // (.cpp) files.
 extern void application();
 
+namespace {
+void initialize_board()
+{
+  using namespace hal::stm32f4;
+
+  // The demos run from the HSI, which the SWV output of the benchmarks
+  // expects, and share the Nucleo's user LED and button
+  board_configuration clocks;
+  clocks.clocks(hsi_16mhz_profile).commit();
+  mark_boot_phase(boot_phase::clocks_configured);
+
+  board_configuration board;
+  board.port(peripheral::gpio_a).function(5, pin::pin_function::output);
+  board.port(peripheral::gpio_c)
+    .function(13, pin::pin_function::input)
+    .resistor(13, hal::pin_resistor::pull_up);
+  board.commit();
+  mark_boot_phase(boot_phase::drivers_initialized);
+}
+}  // namespace
+
 int main()
 {
+  hal::stm32f4::mark_boot_phase(hal::stm32f4::boot_phase::constructors_done);
   try {
+    initialize_board();
+    hal::stm32f4::mark_boot_phase(
+      hal::stm32f4::boot_phase::application_started);
     application();
   } catch (...) {
     hal::cortex_m::reset();
@@ -0,0 +1,161 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "interrupt.hpp"
+
+namespace hal::stm32f4 {
+/**
+ * @brief Memory region whose bits are individually addressable
+ *
+ * Every bit of the first megabyte of SRAM and of the peripheral space is
+ * mirrored as a 32-bit word in an alias region. Storing 0 or 1 into the alias
+ * word clears or sets the bit with a read-modify-write performed by the bus,
+ * which can not be interrupted. Loading it reads the bit as 0 or 1.
+ */
+struct bit_band_region
+{
+  /// Address of the first bit-addressable byte
+  std::uintptr_t base;
+  /// Number of bit-addressable bytes
+  std::uintptr_t size;
+  /// Address of the alias word of bit 0 of the first byte
+  std::uintptr_t alias;
+
+  [[nodiscard]] constexpr bool contains(std::uintptr_t p_address) const
+  {
+    return base <= p_address && p_address - base < size;
+  }
+};
+
+/// SRAM1 and SRAM2, the CCM data RAM is not bit-addressable
+inline constexpr bit_band_region sram_bit_band{
+  .base = 0x2000'0000, .size = 0x10'0000, .alias = 0x2200'0000
+};
+/// APB1, APB2 and AHB1 peripherals, AHB2 and the core peripherals are not
+inline constexpr bit_band_region peripheral_bit_band{
+  .base = 0x4000'0000, .size = 0x10'0000, .alias = 0x4200'0000
+};
+
+/**
+ * @brief Address of the alias word of a bit
+ *
+ * @param p_address - address of a 32-bit word in a bit-band region
+ * @param p_bit - bit 0 to 31 of the word
+ * @return std::uintptr_t - address of the alias word, 0 if p_address is not in
+ * a bit-band region
+ */
+[[nodiscard]] constexpr std::uintptr_t bit_band_alias(std::uintptr_t p_address,
+                                                      std::uint32_t p_bit)
+{
+  for (auto const& region :
+       std::array{ sram_bit_band, peripheral_bit_band }) {
+    if (region.contains(p_address)) {
+      return region.alias + ((p_address - region.base) * 32U) + (p_bit * 4U);
+    }
+  }
+  return 0;
+}
+
+namespace internal {
+/**
+ * @return std::uint32_t volatile* - alias word of bit p_bit of p_word, nullptr
+ * on non-ARM builds, where memory is not bit-banded, or if p_word is not in a
+ * bit-band region.
+ */
+inline std::uint32_t volatile* bit_band_word(
+  [[maybe_unused]] std::uint32_t const volatile& p_word,
+  [[maybe_unused]] std::uint32_t p_bit)
+{
+#if defined(__arm__)
+  auto const alias =
+    bit_band_alias(reinterpret_cast<std::uintptr_t>(&p_word), p_bit);
+  return reinterpret_cast<std::uint32_t volatile*>(alias);
+#else
+  return nullptr;
+#endif
+}
+}  // namespace internal
+
+/**
+ * @brief Set or clear a bit of a variable in SRAM with a single store
+ *
+ * Intended for flags shared between interrupt handlers and the main loop
+ * where each context owns different bits of the same word. Words outside of
+ * the SRAM bit-band region, such as those in CCM RAM, and every word on
+ * non-ARM builds are updated with a read-modify-write inside a critical
+ * section instead.
+ *
+ * @param p_word - word holding the bit
+ * @param p_bit - bit 0 to 31 of the word
+ * @param p_value - new value of the bit
+ */
+inline void bit_band_write(std::uint32_t volatile& p_word,
+                           std::uint32_t p_bit,
+                           bool p_value)
+{
+  if (auto* alias = internal::bit_band_word(p_word, p_bit)) {
+    *alias = static_cast<std::uint32_t>(p_value);
+    return;
+  }
+
+  critical_section section;
+  auto const mask = std::uint32_t{ 1 } << p_bit;
+  std::uint32_t const current = p_word;
+  p_word = p_value ? (current | mask) : (current & ~mask);
+}
+
+/**
+ * @brief Set a bit of a variable in SRAM with a single store
+ *
+ * @param p_word - word holding the bit
+ * @param p_bit - bit 0 to 31 of the word
+ */
+inline void bit_band_set(std::uint32_t volatile& p_word, std::uint32_t p_bit)
+{
+  bit_band_write(p_word, p_bit, true);
+}
+
+/**
+ * @brief Clear a bit of a variable in SRAM with a single store
+ *
+ * @param p_word - word holding the bit
+ * @param p_bit - bit 0 to 31 of the word
+ */
+inline void bit_band_clear(std::uint32_t volatile& p_word, std::uint32_t p_bit)
+{
+  bit_band_write(p_word, p_bit, false);
+}
+
+/**
+ * @brief Read a bit of a variable in SRAM with a single load
+ *
+ * @param p_word - word holding the bit
+ * @param p_bit - bit 0 to 31 of the word
+ * @return true - the bit is set
+ * @return false - the bit is clear
+ */
+[[nodiscard]] inline bool bit_band_test(std::uint32_t const volatile& p_word,
+                                        std::uint32_t p_bit)
+{
+  if (auto const* alias = internal::bit_band_word(p_word, p_bit)) {
+    return *alias != 0;
+  }
+  return ((p_word >> p_bit) & 1U) != 0;
+}
+}  // namespace hal::stm32f4
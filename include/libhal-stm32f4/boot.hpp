@@ -0,0 +1,158 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+#include <libhal/units.hpp>
+
+#include "clock.hpp"
+#include "constants.hpp"
+#include "pin.hpp"
+#include "port_configuration.hpp"
+
+namespace hal::stm32f4 {
+/// Milestones between reset and the application, in the order they occur
+enum class boot_phase : std::uint8_t
+{
+  /// Data and bss sections initialized, static constructors about to run.
+  /// Marked automatically when built with LIBHAL_STM32F4_PROFILE.
+  data_initialized,
+  /// Static constructors done, main() entered
+  constructors_done,
+  /// Clock tree switched to its run profile
+  clocks_configured,
+  /// Board pins and peripherals configured
+  drivers_initialized,
+  /// application() entered
+  application_started,
+  max,
+};
+
+/**
+ * @brief Record the cycle count at which a boot phase completed
+ *
+ * Call from the startup code, main() or the application as each phase ends.
+ * Marking a phase again overwrites its previous cycle count.
+ *
+ * When the library is built with LIBHAL_STM32F4_PROFILE, the cycle counter is
+ * started and zeroed from `.preinit_array`, right after the data and bss
+ * sections are initialized, which also marks `boot_phase::data_initialized`.
+ * Otherwise the counter must be started with `enable_cycle_counter()` before
+ * marking. The time from reset to the data initialization can not be
+ * measured, as the counter is stopped at reset.
+ *
+ * @param p_phase - phase that just completed
+ */
+void mark_boot_phase(boot_phase p_phase);
+
+/**
+ * @brief Cycle count at which a boot phase was marked
+ *
+ * Counts are core clock cycles, so compare phases running at the same clock
+ * profile, or convert each with the clock rate it ran at.
+ *
+ * @param p_phase - phase to look up
+ * @return std::optional<std::uint32_t> - cycle count, std::nullopt if the
+ * phase was not marked
+ */
+[[nodiscard]] std::optional<std::uint32_t> boot_phase_cycles(
+  boot_phase p_phase);
+
+/**
+ * @brief Forget every boot phase marked so far
+ *
+ */
+void reset_boot_phases();
+
+/**
+ * @brief Accumulates a whole board's clock, power and pin configuration and
+ * commits it in one batched register sequence
+ *
+ * Constructing drivers one at a time powers each gpio port and peripheral
+ * with its own read-modify-write, and configures each pin separately. For
+ * cold start time critical boards, describe the board once and commit it
+ * before constructing the drivers, which then find their ports powered and
+ * pins configured:
+ *
+ *     board_configuration board;
+ *     board.clocks(hsi_pll_100mhz_profile)
+ *       .power(peripheral::spi1)
+ *       .power(peripheral::dma2);
+ *     board.port(peripheral::gpio_a)
+ *       .function(5, pin::pin_function::alternate5)
+ *       .function(6, pin::pin_function::alternate5)
+ *       .function(7, pin::pin_function::alternate5)
+ *       .function(8, pin::pin_function::output)
+ *       .level(8, true);
+ *     board.commit();
+ *
+ * Commit switches the clock profile first, so everything after runs at full
+ * speed, then writes each bus's clock enable register once, then each port
+ * with one access per register (see `port_configuration`).
+ */
+class board_configuration
+{
+public:
+  /// Number of gpio port slots, ports A to H
+  static constexpr std::size_t port_count = 8;
+
+  board_configuration();
+
+  /**
+   * @brief Switch to a clock profile when committing
+   *
+   * @param p_profile - profile to switch to, see `set_clock_profile()`
+   * @return board_configuration& - reference to this for chaining
+   */
+  board_configuration& clocks(clock_profile const& p_profile);
+
+  /**
+   * @brief Enable a peripheral's clock when committing
+   *
+   * Gpio ports are powered automatically when configured with `port()`.
+   *
+   * @param p_peripheral - peripheral to power
+   * @return board_configuration& - reference to this for chaining
+   * @throws hal::argument_out_of_domain - if the peripheral has no clock
+   * enable bit
+   */
+  board_configuration& power(peripheral p_peripheral);
+
+  /**
+   * @brief Configuration of a gpio port, powered and committed with the board
+   *
+   * @param p_port - gpio port
+   * @return port_configuration& - the port's configuration, to chain settings
+   * @throws hal::argument_out_of_domain - if the peripheral is not a gpio port
+   */
+  port_configuration& port(peripheral p_port);
+
+  /**
+   * @brief Apply the clock profile, peripheral clocks and port settings
+   *
+   * The accumulated settings are kept, so committing again re-applies them.
+   */
+  void commit() const;
+
+private:
+  std::optional<clock_profile> m_clocks;
+  /// Clock enable bits per bus: AHB1, AHB2, APB1, APB2
+  std::array<std::uint32_t, 4> m_enable{};
+  std::array<port_configuration, port_count> m_ports;
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,327 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+#include <libhal-util/enum.hpp>
+#include <libhal/error.hpp>
+#include <libhal/functional.hpp>
+#include <libhal/units.hpp>
+
+#include "constants.hpp"
+
+namespace hal::stm32f4 {
+/// Frequency of the internal high speed oscillator
+inline constexpr hal::hertz hsi_frequency = 16'000'000.0f;
+/// Highest system, AHB and APB2 clock rate
+inline constexpr hal::hertz max_system_clock = 100'000'000.0f;
+/// Highest APB1 clock rate
+inline constexpr hal::hertz max_apb1_clock = 50'000'000.0f;
+
+/// Oscillator or PLL driving the system clock
+enum class system_clock_source : std::uint8_t
+{
+  hsi,
+  hse,
+  pll,
+};
+
+/// Main PLL: system clock = input / m * n / p
+struct pll_settings
+{
+  /// Clock the HSE instead of the HSI into the PLL
+  bool use_hse = false;
+  /// Input divider, 2 to 63, the result must be within 1MHz and 2MHz
+  std::uint8_t m = 16;
+  /// VCO multiplier, 50 to 432, the VCO must run within 100MHz and 432MHz
+  std::uint16_t n = 192;
+  /// System clock divider: 2, 4, 6 or 8
+  std::uint8_t p = 2;
+  /// USB OTG FS and SDIO clock divider, 2 to 15
+  std::uint8_t q = 4;
+};
+
+/// Clock tree configuration switched to with `set_clock_profile()`
+struct clock_profile
+{
+  system_clock_source source = system_clock_source::hsi;
+  /// Frequency of the crystal or clock connected to OSC_IN, 0 if there is
+  /// none. 4MHz to 26MHz, or up to 50MHz when bypassed.
+  hal::hertz hse_frequency = 0.0f;
+  /// OSC_IN is driven by an external clock instead of a crystal
+  bool hse_bypass = false;
+  /// Used if the source is the PLL
+  pll_settings pll{};
+  /// System clock to AHB divider: 1, 2, 4, 8, 16, 64, 128, 256 or 512
+  std::uint16_t ahb_divider = 1;
+  /// AHB to APB1 divider: 1, 2, 4, 8 or 16
+  std::uint8_t apb1_divider = 1;
+  /// AHB to APB2 divider: 1, 2, 4, 8 or 16
+  std::uint8_t apb2_divider = 1;
+};
+
+/// Rates of the clock tree's main clocks
+struct clock_rates
+{
+  /// SYSCLK
+  hal::hertz system;
+  /// HCLK, clock of the core, memories, dma and gpio ports
+  hal::hertz ahb;
+  /// PCLK1
+  hal::hertz apb1;
+  /// PCLK2
+  hal::hertz apb2;
+  /// Clock counted by the APB1 timers (TIM2 to TIM5)
+  hal::hertz apb1_timer;
+  /// Clock counted by the APB2 timers (TIM1, TIM9 to TIM11)
+  hal::hertz apb2_timer;
+};
+
+/**
+ * @brief Calculate the clock rates a profile results in
+ *
+ * Can be evaluated at compile time to reject invalid profiles while building.
+ *
+ * @param p_profile - profile to check
+ * @return clock_rates - rates of the clocks once switched to the profile
+ * @throws hal::argument_out_of_domain - if a divider or multiplier is invalid,
+ * a clock is out of its range or the HSE frequency is missing
+ */
+constexpr clock_rates calculate_clock_rates(clock_profile const& p_profile)
+{
+  auto const fail = []() {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  };
+  auto const uses_hse = p_profile.source == system_clock_source::hse ||
+                        (p_profile.source == system_clock_source::pll &&
+                         p_profile.pll.use_hse);
+  auto const max_hse = p_profile.hse_bypass ? 50e6f : 26e6f;
+  auto const min_hse = p_profile.hse_bypass ? 1e6f : 4e6f;
+  if (uses_hse && (p_profile.hse_frequency < min_hse ||
+                   p_profile.hse_frequency > max_hse)) {
+    fail();
+  }
+
+  hal::hertz system = hsi_frequency;
+  if (p_profile.source == system_clock_source::hse) {
+    system = p_profile.hse_frequency;
+  } else if (p_profile.source == system_clock_source::pll) {
+    auto const& pll = p_profile.pll;
+    auto const input = pll.use_hse ? p_profile.hse_frequency : hsi_frequency;
+    if (pll.m < 2 || pll.m > 63 || pll.n < 50 || pll.n > 432 || pll.p < 2 ||
+        pll.p > 8 || pll.p % 2 != 0 || pll.q < 2 || pll.q > 15) {
+      fail();
+    }
+    auto const vco_input = input / static_cast<float>(pll.m);
+    auto const vco = vco_input * static_cast<float>(pll.n);
+    if (vco_input < 1e6f || vco_input > 2e6f || vco < 100e6f ||
+        vco > 432e6f) {
+      fail();
+    }
+    system = vco / static_cast<float>(pll.p);
+  }
+
+  auto const valid_apb = [](std::uint8_t p_divider) {
+    return std::has_single_bit(p_divider) && p_divider <= 16;
+  };
+  if (!std::has_single_bit(p_profile.ahb_divider) ||
+      p_profile.ahb_divider > 512 || p_profile.ahb_divider == 32 ||
+      !valid_apb(p_profile.apb1_divider) ||
+      !valid_apb(p_profile.apb2_divider)) {
+    fail();
+  }
+
+  auto const ahb = system / static_cast<float>(p_profile.ahb_divider);
+  auto const apb1 = ahb / static_cast<float>(p_profile.apb1_divider);
+  auto const apb2 = ahb / static_cast<float>(p_profile.apb2_divider);
+  if (system > max_system_clock || apb1 > max_apb1_clock) {
+    fail();
+  }
+  // Timers count twice as fast as their bus whenever the bus is divided
+  return {
+    .system = system,
+    .ahb = ahb,
+    .apb1 = apb1,
+    .apb2 = apb2,
+    .apb1_timer = p_profile.apb1_divider == 1 ? apb1 : 2.0f * apb1,
+    .apb2_timer = p_profile.apb2_divider == 1 ? apb2 : 2.0f * apb2,
+  };
+}
+
+/// Reset clock tree: HSI, undivided
+inline constexpr clock_profile hsi_16mhz_profile{};
+
+/// Lowest power while running without an external clock: HSI / 8
+inline constexpr clock_profile hsi_2mhz_profile{ .ahb_divider = 8 };
+
+/// Full speed without an external clock: HSI / 8 * 100 / 2
+inline constexpr clock_profile hsi_pll_100mhz_profile{
+  .source = system_clock_source::pll,
+  .pll = { .use_hse = false, .m = 8, .n = 100, .p = 2, .q = 4 },
+  .apb1_divider = 2,
+};
+
+/**
+ * @brief Full speed from a crystal: HSE / (HSE in MHz) * 200 / 2
+ *
+ * @param p_hse_frequency - whole number of MHz, from 4MHz to 26MHz
+ * @return clock_profile - 100MHz system clock, 50MHz APB1, 100MHz APB2
+ */
+constexpr clock_profile hse_pll_100mhz_profile(hal::hertz p_hse_frequency)
+{
+  return {
+    .source = system_clock_source::pll,
+    .hse_frequency = p_hse_frequency,
+    .pll = { .use_hse = true,
+             .m = static_cast<std::uint8_t>(p_hse_frequency / 1e6f),
+             .n = 200,
+             .p = 2,
+             .q = 4 },
+    .apb1_divider = 2,
+  };
+}
+
+/**
+ * @brief Switch the clock tree to a profile without resetting the drivers
+ *
+ * Starts the oscillators and PLL the profile needs, then switches the system
+ * clock in the order that keeps every clock within its limits: flash wait
+ * states are raised before and lowered after the system clock changes, bus
+ * dividers are applied before speeding up and after slowing down. Oscillators
+ * and the PLL left unused are stopped to save power, except for the HSI. The
+ * regulator voltage scale is lowered as far as the PLL output allows.
+ *
+ * Once switched, the handlers of every `clock_change_listener` are called, so
+ * drivers re-time themselves:
+ *
+ * - `spi`, `spi_bus` devices, `spi_capture` and `spi_engine` recompute their
+ *   baud rate prescalers, keeping the closest rate not above the configured
+ *   one, or the slowest rate if it is out of reach.
+ * - `scheduler` recomputes the TIM5 prescaler and keeps counting from where
+ *   it was, so `uptime()` stays continuous.
+ * - `gpio_capture` and `gpio_waveform` recompute the TIM1 period and report
+ *   the rate achieved by `sample_rate()` and `word_rate()`.
+ *
+ * Call between transfers: a transfer running during the switch continues at
+ * the rate the new clock gives its old settings. `spi_engine` waits for its
+ * running transfers before re-timing, a running `spi_capture` keeps its
+ * prescaler until it is restarted, and a streaming `spi` keeps its prescaler
+ * until `stop_stream()`.
+ *
+ * Flash wait states assume a 2.7V to 3.6V supply.
+ *
+ * @param p_profile - clock tree to switch to
+ * @throws hal::argument_out_of_domain - if the profile is invalid, see
+ * `calculate_clock_rates()`
+ */
+void set_clock_profile(clock_profile const& p_profile);
+
+/**
+ * @brief Read the current clock rates from the clock tree
+ *
+ * The HSE frequency is the one given to the last `set_clock_profile()` that
+ * used the HSE.
+ *
+ * @return clock_rates - current rates
+ */
+[[nodiscard]] clock_rates current_clock_rates();
+
+/**
+ * @brief Rate of the clock feeding a peripheral for a given set of rates
+ *
+ * Usable at compile time with the rates of a profile, see
+ * `calculate_clock_rates()`.
+ *
+ * @param p_peripheral - peripheral to look up
+ * @param p_rates - rates of the clock tree
+ * @return hal::hertz - the timer clock for timers, the bus clock for other
+ * peripherals, the AHB clock for the cpu and system timer
+ */
+[[nodiscard]] constexpr hal::hertz clock_rate(peripheral p_peripheral,
+                                              clock_rates const& p_rates)
+{
+  switch (p_peripheral) {
+    case peripheral::timer2:
+    case peripheral::timer3:
+    case peripheral::timer4:
+    case peripheral::timer5:
+      return p_rates.apb1_timer;
+    case peripheral::timer1:
+    case peripheral::timer9:
+    case peripheral::timer10:
+    case peripheral::timer11:
+      return p_rates.apb2_timer;
+    default:
+      break;
+  }
+  switch (hal::value(p_peripheral) / bus_id_offset) {
+    case apb1_bus / bus_id_offset:
+      return p_rates.apb1;
+    case apb2_bus / bus_id_offset:
+      return p_rates.apb2;
+    default:
+      return p_rates.ahb;
+  }
+}
+
+/**
+ * @brief Current rate of the clock feeding a peripheral
+ *
+ * @param p_peripheral - peripheral to look up
+ * @return hal::hertz - the timer clock for timers, the bus clock for other
+ * peripherals, the AHB clock for the cpu and system timer
+ */
+[[nodiscard]] hal::hertz clock_rate(peripheral p_peripheral);
+
+/**
+ * @brief Calls a handler after every `set_clock_profile()`
+ *
+ * Drivers deriving rates from a peripheral clock hold one to re-time
+ * themselves when the clock changes. Handlers run in the context calling
+ * `set_clock_profile()`, in the order the listeners were created.
+ */
+class clock_change_listener
+{
+public:
+  /// Called once the clock tree has switched
+  using handler = hal::callback<void()>;
+
+  /**
+   * @brief Start listening for clock changes
+   *
+   * @param p_handler - called after each switch
+   */
+  explicit clock_change_listener(handler p_handler);
+
+  clock_change_listener(clock_change_listener& p_other) = delete;
+  clock_change_listener& operator=(clock_change_listener& p_other) = delete;
+  clock_change_listener(clock_change_listener&& p_other) noexcept = delete;
+  clock_change_listener& operator=(clock_change_listener&& p_other) noexcept =
+    delete;
+
+  /**
+   * @brief Stop listening
+   */
+  ~clock_change_listener();
+
+private:
+  friend void set_clock_profile(clock_profile const& p_profile);
+
+  handler m_handler;
+  clock_change_listener* m_next = nullptr;
+};
+}  // namespace hal::stm32f4
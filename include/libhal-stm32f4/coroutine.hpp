@@ -0,0 +1,497 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <utility>
+
+#include <span>
+
+#include <libhal/steady_clock.hpp>
+#include <libhal/units.hpp>
+
+#include "constants.hpp"
+#include "low_power.hpp"
+#include "scheduler.hpp"
+#include "spi_engine.hpp"
+
+/// Size in bytes of each coroutine frame in the frame pool. Coroutines whose
+/// frame is larger cannot be started.
+#if !defined(LIBHAL_STM32F4_COROUTINE_FRAME_SIZE)
+#define LIBHAL_STM32F4_COROUTINE_FRAME_SIZE 512
+#endif
+
+/// Number of coroutine frames in the frame pool, which is the maximum number
+/// of coroutines alive at any time
+#if !defined(LIBHAL_STM32F4_COROUTINE_FRAME_COUNT)
+#define LIBHAL_STM32F4_COROUTINE_FRAME_COUNT 8
+#endif
+
+namespace hal::stm32f4 {
+/**
+ * @brief Statically allocated storage for coroutine frames
+ *
+ * Every `task` frame comes from this pool rather than the heap. The pool is
+ * sized at compile time with LIBHAL_STM32F4_COROUTINE_FRAME_SIZE and
+ * LIBHAL_STM32F4_COROUTINE_FRAME_COUNT.
+ */
+class frame_pool
+{
+public:
+  static constexpr std::size_t frame_size = LIBHAL_STM32F4_COROUTINE_FRAME_SIZE;
+  static constexpr std::size_t frame_count =
+    LIBHAL_STM32F4_COROUTINE_FRAME_COUNT;
+
+  /**
+   * @brief Take a frame from the pool
+   *
+   * @param p_size - size of the coroutine frame
+   * @return void* - storage for the frame
+   * @throws hal::argument_out_of_domain - if p_size is above `frame_size`
+   * @throws hal::resource_unavailable_try_again - if every frame is in use
+   */
+  static void* allocate(std::size_t p_size);
+
+  /**
+   * @brief Return a frame to the pool
+   *
+   * @param p_frame - frame returned by `allocate()`
+   */
+  static void release(void* p_frame) noexcept;
+
+  /**
+   * @return std::size_t - number of frames not in use
+   */
+  [[nodiscard]] static std::size_t available();
+};
+
+/**
+ * @brief Coroutine returning nothing, allocated from the `frame_pool`
+ *
+ * Tasks start suspended. They are either handed to `executor::spawn()` or
+ * awaited by another task with `co_await`, which runs them until they
+ * finish. Exceptions escaping a task are rethrown to the awaiting task, or
+ * from `executor::run_ready()` for spawned tasks.
+ */
+class task
+{
+public:
+  struct promise_type
+  {
+    static void* operator new(std::size_t p_size)
+    {
+      return frame_pool::allocate(p_size);
+    }
+    static void operator delete(void* p_frame) noexcept
+    {
+      frame_pool::release(p_frame);
+    }
+
+    task get_return_object() noexcept
+    {
+      return task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept
+    {
+      return {};
+    }
+
+    /// Resumes the awaiting task, if any, once this task finishes
+    struct final_awaiter
+    {
+      bool await_ready() noexcept
+      {
+        return false;
+      }
+      std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<promise_type> p_self) noexcept
+      {
+        if (auto continuation = p_self.promise().continuation) {
+          return continuation;
+        }
+        return std::noop_coroutine();
+      }
+      void await_resume() noexcept
+      {
+      }
+    };
+
+    final_awaiter final_suspend() noexcept
+    {
+      return {};
+    }
+    void return_void() noexcept
+    {
+    }
+    void unhandled_exception() noexcept
+    {
+      exception = std::current_exception();
+    }
+
+    std::coroutine_handle<> continuation{};
+    std::exception_ptr exception{};
+  };
+
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  task(task const&) = delete;
+  task& operator=(task const&) = delete;
+  task(task&& p_other) noexcept
+    : m_handle(std::exchange(p_other.m_handle, nullptr))
+  {
+  }
+  task& operator=(task&& p_other) noexcept
+  {
+    if (this != &p_other) {
+      destroy();
+      m_handle = std::exchange(p_other.m_handle, nullptr);
+    }
+    return *this;
+  }
+  ~task()
+  {
+    destroy();
+  }
+
+  /**
+   * @return true - the task has run to completion
+   */
+  [[nodiscard]] bool done() const
+  {
+    return !m_handle || m_handle.done();
+  }
+
+  /// Awaiting a task runs it and resumes the awaiter once it finishes
+  auto operator co_await() && noexcept
+  {
+    struct awaiter
+    {
+      handle_type handle;
+
+      bool await_ready() noexcept
+      {
+        return !handle || handle.done();
+      }
+      std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<> p_awaiter) noexcept
+      {
+        handle.promise().continuation = p_awaiter;
+        return handle;
+      }
+      void await_resume()
+      {
+        if (handle && handle.promise().exception) {
+          std::rethrow_exception(handle.promise().exception);
+        }
+      }
+    };
+    return awaiter{ m_handle };
+  }
+
+private:
+  friend class executor;
+
+  explicit task(handle_type p_handle) noexcept
+    : m_handle(p_handle)
+  {
+  }
+
+  void destroy() noexcept
+  {
+    if (m_handle) {
+      m_handle.destroy();
+      m_handle = nullptr;
+    }
+  }
+
+  handle_type m_handle;
+};
+
+/**
+ * @brief Single core run-to-completion executor for tasks
+ *
+ * Suspended tasks are resumed in the order they became ready, one at a time,
+ * from `run_ready()` or `run()`. Interrupt handlers make tasks ready with
+ * `schedule()`, typically through a `completion`.
+ */
+class executor
+{
+public:
+  /// Maximum number of spawned tasks
+  static constexpr std::size_t task_capacity = frame_pool::frame_count;
+  /// Maximum number of coroutines waiting to be resumed
+  static constexpr std::size_t ready_capacity = 2 * frame_pool::frame_count;
+
+  /**
+   * @brief Construct an executor
+   *
+   * While delays are pending, `run()` polls the clock instead of sleeping,
+   * as a generic clock cannot wake the core. Use the `scheduler` constructor
+   * to sleep through delays.
+   *
+   * @param p_clock - time source for `delay()`
+   */
+  explicit executor(hal::steady_clock& p_clock);
+
+  /**
+   * @brief Construct an executor timing its delays with a scheduler
+   *
+   * `run()` programs the scheduler's TIM5 compare for the earliest delay and
+   * sleeps with WFI until then, instead of polling.
+   *
+   * @param p_scheduler - time source for `delay()` and wake up timer
+   */
+  explicit executor(scheduler& p_scheduler);
+
+  executor(executor const&) = delete;
+  executor& operator=(executor const&) = delete;
+
+  /**
+   * @brief Destroy the spawned tasks that have not finished
+   *
+   * Nothing may resume those tasks afterwards, so any transfer or edge they
+   * are waiting on must be over or cancelled.
+   */
+  ~executor();
+
+  /**
+   * @brief Take ownership of a task and make it ready to run
+   *
+   * @param p_task - task to run, destroyed once it finishes
+   * @throws hal::resource_unavailable_try_again - if `task_capacity` tasks are
+   * already running
+   */
+  void spawn(task&& p_task);
+
+  /**
+   * @brief Make a suspended coroutine ready to be resumed
+   *
+   * Safe to call from interrupts.
+   *
+   * @param p_coroutine - coroutine to resume
+   */
+  void schedule(std::coroutine_handle<> p_coroutine);
+
+  /**
+   * @brief Resume every ready coroutine, including those made ready while
+   * doing so, and every task whose delay has expired
+   *
+   * @return true - spawned tasks are still running
+   */
+  bool run_ready();
+
+  /**
+   * @brief Run until every spawned task has finished
+   *
+   * Sleeps with WFI while waiting on interrupts. While delays are pending,
+   * it sleeps until the earliest one if the executor was constructed with a
+   * `scheduler`, otherwise the clock is polled at full speed.
+   */
+  void run();
+
+  /**
+   * @return std::size_t - number of spawned tasks that have not finished
+   */
+  [[nodiscard]] std::size_t running() const;
+
+  /// Awaitable suspending a task for a duration
+  class delay_awaiter
+  {
+  public:
+    bool await_ready() const noexcept
+    {
+      return m_ticks == 0;
+    }
+    void await_suspend(std::coroutine_handle<> p_coroutine);
+    void await_resume() const noexcept
+    {
+    }
+
+  private:
+    friend class executor;
+    delay_awaiter(executor& p_executor, std::uint64_t p_ticks)
+      : m_executor(&p_executor)
+      , m_ticks(p_ticks)
+    {
+    }
+
+    executor* m_executor;
+    std::uint64_t m_ticks;
+  };
+
+  /**
+   * @brief Suspend the awaiting task for at least a duration
+   *
+   * Unless the executor was constructed with a `scheduler`, `run()` polls
+   * the clock while delays are pending rather than sleeping.
+   *
+   * @param p_duration - time to wait, rounded up to the clock's resolution
+   * @return delay_awaiter - to be awaited with co_await
+   */
+  [[nodiscard]] delay_awaiter delay(hal::time_duration p_duration);
+
+private:
+  struct timer
+  {
+    std::uint64_t deadline = 0;
+    std::coroutine_handle<> coroutine{};
+  };
+
+  std::coroutine_handle<> take_ready();
+  void add_timer(std::uint64_t p_ticks, std::coroutine_handle<> p_coroutine);
+  bool resume_due_timers();
+
+  hal::steady_clock* m_clock;
+  /// Wakes the core for delays, nullptr if the clock cannot
+  scheduler* m_wake_timer = nullptr;
+  std::array<task::handle_type, task_capacity> m_tasks{};
+  std::array<std::coroutine_handle<>, ready_capacity> m_ready{};
+  std::size_t m_ready_head = 0;
+  std::size_t volatile m_ready_size = 0;
+  /// Pending delays, ordered by deadline
+  std::array<timer, task_capacity> m_timers{};
+  std::size_t m_timer_count = 0;
+};
+
+/**
+ * @brief One-shot event completed from an interrupt and awaited by a task
+ *
+ * If the event completes before it is awaited, awaiting it does not suspend.
+ * Only one task may await the event at a time.
+ */
+class completion
+{
+public:
+  /**
+   * @param p_executor - executor resuming the awaiting task
+   */
+  explicit completion(executor& p_executor);
+
+  completion(completion const&) = delete;
+  completion& operator=(completion const&) = delete;
+
+  /**
+   * @brief Complete the event, scheduling the awaiting task
+   *
+   * Safe to call from interrupts.
+   */
+  void complete();
+
+  /**
+   * @brief Allow the event to be awaited again
+   */
+  void reset();
+
+  /**
+   * @return true - the event has completed
+   */
+  [[nodiscard]] bool done() const;
+
+  bool await_ready() const noexcept
+  {
+    return m_done;
+  }
+  bool await_suspend(std::coroutine_handle<> p_coroutine);
+  void await_resume() const noexcept
+  {
+  }
+
+private:
+  executor* m_executor;
+  std::coroutine_handle<> m_waiter{};
+  bool volatile m_done = false;
+};
+
+/**
+ * @brief Awaitable dma transfer on a bus run by a `spi_engine`
+ *
+ * The transfer starts when awaited. Other tasks run while it is in progress.
+ * Replaces the engine's `on_finished()` handler of the bus.
+ */
+class spi_transfer_awaiter
+{
+public:
+  /**
+   * @param p_executor - executor resuming the awaiting task
+   * @param p_engine - engine running the bus
+   * @param p_bus - spi bus number 1-5
+   * @param p_data_out - bytes to send, followed by p_filler
+   * @param p_data_in - received bytes, extra bytes are dropped
+   * @param p_filler - byte sent once p_data_out is exhausted
+   */
+  spi_transfer_awaiter(executor& p_executor,
+                       spi_engine& p_engine,
+                       std::uint8_t p_bus,
+                       std::span<hal::byte const> p_data_out,
+                       std::span<hal::byte> p_data_in,
+                       hal::byte p_filler = hal::spi::default_filler);
+
+  bool await_ready() const noexcept
+  {
+    return false;
+  }
+  bool await_suspend(std::coroutine_handle<> p_coroutine);
+  void await_resume();
+
+private:
+  completion m_completion;
+  spi_engine* m_engine;
+  std::span<hal::byte const> m_data_out;
+  std::span<hal::byte> m_data_in;
+  std::uint8_t m_bus;
+  hal::byte m_filler;
+};
+
+/**
+ * @brief Awaitable edge on a gpio pin, using its EXTI line interrupt
+ *
+ * The EXTI line is armed when awaited and disarmed once the edge occurs. Only
+ * one pin per pin number (EXTI line) can be awaited at a time.
+ */
+class pin_edge_awaiter
+{
+public:
+  /**
+   * @param p_executor - executor resuming the awaiting task
+   * @param p_port - gpio port of the pin
+   * @param p_pin - pin number 0-15
+   * @param p_edge - edge(s) to wait for
+   * @throws hal::argument_out_of_domain - if the port or pin is invalid
+   */
+  pin_edge_awaiter(executor& p_executor,
+                   peripheral p_port,
+                   std::uint8_t p_pin,
+                   wake_edge p_edge);
+
+  bool await_ready() const noexcept
+  {
+    return false;
+  }
+  bool await_suspend(std::coroutine_handle<> p_coroutine);
+  void await_resume() const noexcept
+  {
+  }
+
+private:
+  completion m_completion;
+  peripheral m_port;
+  std::uint8_t m_pin;
+  wake_edge m_edge;
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,264 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <span>
+
+namespace hal::stm32f4 {
+/// Signed fixed point sample in [-1, 1) with 15 fractional bits
+using q15 = std::int16_t;
+/// Signed fixed point sample in [-1, 1) with 31 fractional bits
+using q31 = std::int32_t;
+
+/**
+ * @brief Smallest, largest and mean sample of a block
+ *
+ * @tparam T - sample type
+ */
+template<typename T>
+struct sample_statistics
+{
+  T min;
+  T max;
+  /// Sum of the samples divided by their number, rounded towards zero
+  T mean;
+
+  constexpr bool operator==(sample_statistics const&) const = default;
+};
+
+/**
+ * @brief Sum of the products of two q15 vectors
+ *
+ * Computed two samples at a time with SMLALD on Cortex-M4. Exact for any
+ * length, the products are accumulated in 64 bits.
+ *
+ * @param p_a - first vector
+ * @param p_b - second vector, same length as p_a
+ * @return std::int64_t - sum of products with 30 fractional bits
+ * @throws hal::argument_out_of_domain - if the lengths differ
+ */
+[[nodiscard]] std::int64_t dot_product(std::span<q15 const> p_a,
+                                       std::span<q15 const> p_b);
+
+/**
+ * @brief Sum of the products of two q31 vectors
+ *
+ * Each 62 fractional bit product is shifted right by 14 bits before being
+ * accumulated, which leaves room to sum 2^16 full scale products.
+ *
+ * @param p_a - first vector
+ * @param p_b - second vector, same length as p_a
+ * @return std::int64_t - sum of products with 48 fractional bits
+ * @throws hal::argument_out_of_domain - if the lengths differ
+ */
+[[nodiscard]] std::int64_t dot_product(std::span<q31 const> p_a,
+                                       std::span<q31 const> p_b);
+
+/**
+ * @brief Smallest, largest and mean sample of a q15 block
+ *
+ * Two samples are compared and summed per instruction on Cortex-M4
+ * (SSUB16/SEL and SMLALD).
+ *
+ * @param p_samples - block of samples
+ * @return sample_statistics<q15> - statistics of the block
+ * @throws hal::argument_out_of_domain - if the block is empty
+ */
+[[nodiscard]] sample_statistics<q15> statistics(
+  std::span<q15 const> p_samples);
+
+/**
+ * @brief Smallest, largest and mean sample of a q31 block
+ *
+ * @param p_samples - block of samples
+ * @return sample_statistics<q31> - statistics of the block
+ * @throws hal::argument_out_of_domain - if the block is empty
+ */
+[[nodiscard]] sample_statistics<q31> statistics(
+  std::span<q31 const> p_samples);
+
+/**
+ * @brief Finite impulse response filter for q15 samples with decimation
+ *
+ * Output sample n is the sum of coefficient k times input sample n - k,
+ * accumulated in 64 bits, shifted right by 15 bits and saturated to q15.
+ * Coefficient pairs are applied to sample pairs with SMLALDX on Cortex-M4.
+ *
+ * With a decimation factor of M, only every Mth output sample is computed and
+ * returned, the last of each group of M input samples.
+ *
+ * The filter does not allocate. The caller provides the working buffer, which
+ * holds the previous input samples followed by the current block. A block can
+ * therefore hold at most `buffer size - (number of coefficients - 1)` samples.
+ */
+class fir_q15
+{
+public:
+  /**
+   * @brief Create a filter with an all zero history
+   *
+   * @param p_coefficients - coefficient 0 applies to the newest sample. Must
+   * outlive the filter.
+   * @param p_buffer - working buffer, must outlive the filter
+   * @param p_decimation - keep every Nth output sample, 1 to keep all
+   * @throws hal::argument_out_of_domain - if there are no coefficients, the
+   * decimation factor is 0, or the buffer can not hold one block of
+   * p_decimation samples
+   */
+  fir_q15(std::span<q15 const> p_coefficients,
+          std::span<q15> p_buffer,
+          std::uint32_t p_decimation = 1);
+
+  /**
+   * @brief Filter a block of samples
+   *
+   * @param p_input - samples following the previous block. Its length must be
+   * a multiple of the decimation factor and at most `max_block()`.
+   * @param p_output - receives `p_input.size() / decimation` samples
+   * @return std::span<q15> - the output samples written
+   * @throws hal::argument_out_of_domain - if the block sizes are invalid
+   */
+  std::span<q15> process(std::span<q15 const> p_input,
+                         std::span<q15> p_output);
+
+  /**
+   * @brief Forget the previous input samples
+   *
+   */
+  void reset();
+
+  /**
+   * @return std::size_t - largest number of input samples per block
+   */
+  [[nodiscard]] std::size_t max_block() const;
+
+private:
+  std::span<q15 const> m_coefficients;
+  std::span<q15> m_buffer;
+  std::uint32_t m_decimation;
+};
+
+/// Coefficients of one second order section, with a0 normalized to 1
+struct biquad_coefficients
+{
+  float b0;
+  float b1;
+  float b2;
+  float a1;
+  float a2;
+};
+
+/// Delay line of one second order section
+using biquad_state = std::array<float, 2>;
+
+/**
+ * @brief Cascade of second order IIR sections on floating point samples
+ *
+ * Each section is computed in transposed direct form II on the FPU:
+ *
+ *    y = b0 * x + d0
+ *    d0 = b1 * x - a1 * y + d1
+ *    d1 = b2 * x - a2 * y
+ *
+ * A block is run through one section at a time, keeping the section's
+ * coefficients and delay line in registers.
+ */
+class biquad_cascade
+{
+public:
+  /**
+   * @brief Create a cascade with zeroed delay lines
+   *
+   * @param p_sections - sections in the order samples pass through them. Must
+   * outlive the cascade.
+   * @param p_state - one delay line per section, must outlive the cascade
+   * @throws hal::argument_out_of_domain - if there is not one delay line per
+   * section
+   */
+  biquad_cascade(std::span<biquad_coefficients const> p_sections,
+                 std::span<biquad_state> p_state);
+
+  /**
+   * @brief Filter a block of samples
+   *
+   * @param p_input - samples following the previous block
+   * @param p_output - receives as many samples as the input, may be the same
+   * memory as p_input
+   * @return std::span<float> - the output samples written
+   * @throws hal::argument_out_of_domain - if the output is too small
+   */
+  std::span<float> process(std::span<float const> p_input,
+                           std::span<float> p_output);
+
+  /**
+   * @brief Clear the delay lines
+   *
+   */
+  void reset();
+
+private:
+  std::span<biquad_coefficients const> m_sections;
+  std::span<biquad_state> m_state;
+};
+
+/**
+ * @brief Portable scalar implementations of the kernels above
+ *
+ * Straightforward loops that define the exact results the optimized kernels
+ * must produce. Used to test the kernels and as a baseline when measuring
+ * them.
+ */
+namespace reference {
+/// @see hal::stm32f4::dot_product()
+[[nodiscard]] std::int64_t dot_product(std::span<q15 const> p_a,
+                                       std::span<q15 const> p_b);
+
+/// @see hal::stm32f4::statistics()
+[[nodiscard]] sample_statistics<q15> statistics(
+  std::span<q15 const> p_samples);
+
+/**
+ * @brief Filter a whole signal with a zero initial history
+ *
+ * @see hal::stm32f4::fir_q15
+ *
+ * @param p_coefficients - coefficient 0 applies to the newest sample
+ * @param p_input - the signal
+ * @param p_output - receives `p_input.size() / p_decimation` samples
+ * @param p_decimation - keep every Nth output sample
+ */
+void fir(std::span<q15 const> p_coefficients,
+         std::span<q15 const> p_input,
+         std::span<q15> p_output,
+         std::uint32_t p_decimation = 1);
+
+/**
+ * @brief Filter a whole signal with zeroed delay lines
+ *
+ * @see hal::stm32f4::biquad_cascade
+ *
+ * @param p_sections - second order sections
+ * @param p_input - the signal
+ * @param p_output - receives as many samples as the input
+ */
+void biquad(std::span<biquad_coefficients const> p_sections,
+            std::span<float const> p_input,
+            std::span<float> p_output);
+}  // namespace reference
+}  // namespace hal::stm32f4
@@ -0,0 +1,190 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <span>
+
+#include <libhal/functional.hpp>
+#include <libhal/units.hpp>
+
+#include "clock.hpp"
+#include "constants.hpp"
+#include "resources.hpp"
+
+namespace hal::stm32f4 {
+/// Settings of a `gpio_capture`
+struct gpio_capture_settings
+{
+  /// Samples taken per second, rounded to a divider of the timer clock
+  hal::hertz sample_rate = 1'000'000.0f;
+};
+
+/// Sample pattern starting the delivery of samples of a `gpio_capture`
+struct gpio_capture_trigger
+{
+  /// Pins the pattern applies to, 0 matches the first sample
+  std::uint16_t mask = 0;
+  /// Levels of the masked pins
+  std::uint16_t levels = 0;
+
+  [[nodiscard]] constexpr bool matches(std::uint16_t p_sample) const
+  {
+    return (p_sample & mask) == (levels & mask);
+  }
+};
+
+/**
+ * @return resource_list - resources used by a `gpio_capture`
+ */
+constexpr resource_list gpio_capture_resources()
+{
+  resource_list resources;
+  resources.add(peripheral_resource(peripheral::timer1))
+    .add(dma_stream_resource(2, 5));
+  return resources;
+}
+
+/**
+ * @brief Samples all 16 pins of a gpio port at a fixed rate (logic analyzer)
+ *
+ * Every TIM1 update event requests a DMA2 transfer of the port's input data
+ * register into a buffer, so samples are taken at exact intervals at rates of
+ * several MHz, unaffected by interrupts and without the CPU. Only DMA2 can
+ * reach the gpio ports and only TIM1's update request is routed to it, hence
+ * the fixed TIM1 and DMA2 stream 5 (see `gpio_capture_resources()`).
+ *
+ * Samples are handed to a handler, from the dma interrupt, in order and
+ * without gaps:
+ *
+ * - one shot: the buffer is filled once. Without a trigger, the handler is
+ *   called once with the whole buffer, otherwise with the samples from the
+ *   trigger on, split in pieces, until as many samples as the buffer holds
+ *   were delivered. The capture then stops by itself.
+ * - circular: the buffer is filled over and over. The handler is called with
+ *   each half of the buffer once filled, starting from the trigger, until
+ *   `stop()`. Each half must be consumed before the dma wraps around to it.
+ *
+ * A trigger holds the handler back until a sample matches a pattern. While
+ * waiting, the port is sampled continuously and each filled half of the
+ * buffer is searched, so the trigger sample is found at its exact position
+ * and no sample after it is lost.
+ *
+ * Pins are sampled in whatever mode they are in. Configure them, for example
+ * with `input_pin`, before starting.
+ *
+ * The timer is re-timed after every `set_clock_profile()` to keep the sample
+ * rate, or the closest rate TIM1 can give from the new clock, and
+ * `sample_rate()` reports the new rate.
+ */
+class gpio_capture
+{
+public:
+  /// Called with consecutive runs of samples, bit N of a sample is pin N
+  using handler = hal::callback<void(std::span<std::uint16_t const>)>;
+
+  /// How often the buffer is filled
+  enum class mode : std::uint8_t
+  {
+    one_shot,
+    circular,
+  };
+
+  using trigger = gpio_capture_trigger;
+
+  /**
+   * @brief Prepare sampling a port
+   *
+   * @param p_port - gpio port to sample
+   * @param p_buffer - sample buffer, its size must be even, from 2 to 65534
+   * @param p_on_samples - called from the dma interrupt with samples
+   * @param p_settings - sampling settings
+   * @throws hal::operation_not_supported - if the sample rate can not be
+   * generated
+   * @throws hal::argument_out_of_domain - if the port or buffer size is
+   * invalid
+   * @throws hal::device_or_resource_busy - if TIM1 or DMA2 stream 5 is used
+   * by another driver
+   */
+  gpio_capture(peripheral p_port,
+               std::span<std::uint16_t> p_buffer,
+               handler p_on_samples,
+               gpio_capture_settings const& p_settings = {});
+
+  gpio_capture(gpio_capture& p_other) = delete;
+  gpio_capture& operator=(gpio_capture& p_other) = delete;
+  gpio_capture(gpio_capture&& p_other) noexcept = delete;
+  gpio_capture& operator=(gpio_capture&& p_other) noexcept = delete;
+
+  /**
+   * @brief Stop sampling and release TIM1 and the dma stream
+   */
+  ~gpio_capture();
+
+  /**
+   * @brief Start sampling into the buffer from its beginning
+   *
+   * Restarts the capture if it is running.
+   *
+   * @param p_mode - fill the buffer once or continuously
+   * @param p_trigger - pattern to wait for before delivering samples
+   */
+  void start(mode p_mode, trigger p_trigger = {});
+
+  /**
+   * @brief Stop sampling
+   *
+   * No more samples are delivered. Does nothing if the capture is not running.
+   */
+  void stop();
+
+  /**
+   * @return true - the port is being sampled
+   */
+  [[nodiscard]] bool running() const;
+
+  /**
+   * @return true - the trigger matched, samples are being delivered
+   */
+  [[nodiscard]] bool triggered() const;
+
+  /**
+   * @return hal::hertz - samples taken per second
+   */
+  [[nodiscard]] hal::hertz sample_rate() const;
+
+private:
+  void handle_interrupt();
+  void deliver(std::span<std::uint16_t const> p_samples);
+  void retime();
+
+  resource_claim m_resources;
+  std::span<std::uint16_t> m_buffer;
+  handler m_on_samples;
+  peripheral m_port;
+  hal::hertz m_sample_rate = 0.0f;
+  /// Sample rate asked for, kept to re-time after clock changes
+  hal::hertz m_requested_rate = 0.0f;
+  /// Samples still to deliver in one shot mode after the trigger
+  std::size_t m_remaining = 0;
+  trigger m_trigger{};
+  mode m_mode = mode::one_shot;
+  bool m_running = false;
+  bool m_triggered = false;
+  clock_change_listener m_clock_listener{ [this]() { retime(); } };
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,273 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <span>
+
+#include <libhal/error.hpp>
+#include <libhal/functional.hpp>
+#include <libhal/units.hpp>
+
+#include "clock.hpp"
+#include "constants.hpp"
+#include "resources.hpp"
+
+namespace hal::stm32f4 {
+/**
+ * @brief Set/reset register (BSRR) word driving pins to levels
+ *
+ * Pins outside of the mask are left untouched by the word.
+ *
+ * @param p_mask - bit N selects pin N
+ * @param p_levels - bit N is the level of pin N
+ * @return std::uint32_t - set bits in the lower half, reset bits in the upper
+ */
+constexpr std::uint32_t bsrr_word(std::uint16_t p_mask, std::uint16_t p_levels)
+{
+  auto const set = static_cast<std::uint32_t>(p_levels & p_mask);
+  auto const reset = static_cast<std::uint32_t>(~p_levels & p_mask);
+  return set | (reset << 16);
+}
+
+/**
+ * @brief Encode a sequence of port levels, one word per level
+ *
+ * Suited to parallel bus writes and multi-pin patterns such as stepper pulse
+ * trains.
+ *
+ * @param p_mask - pins driven by the waveform
+ * @param p_levels - levels of the port, in order
+ * @param p_words - receives one word per level
+ * @return std::span<std::uint32_t> - the words written
+ * @throws hal::argument_out_of_domain - if p_words is too small
+ */
+constexpr std::span<std::uint32_t> encode_levels(
+  std::uint16_t p_mask,
+  std::span<std::uint16_t const> p_levels,
+  std::span<std::uint32_t> p_words)
+{
+  if (p_words.size() < p_levels.size()) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+  for (std::size_t i = 0; i < p_levels.size(); i++) {
+    p_words[i] = bsrr_word(p_mask, p_levels[i]);
+  }
+  return p_words.first(p_levels.size());
+}
+
+/// Order bits are taken from each byte of a bitstream
+enum class bit_order : std::uint8_t
+{
+  msb_first,
+  lsb_first,
+};
+
+/**
+ * @brief Encode a bitstream on one pin, one word per bit
+ *
+ * @param p_pin - pin 0 to 15 carrying the data
+ * @param p_bytes - bitstream, 8 bits per byte
+ * @param p_words - receives 8 words per byte
+ * @param p_order - order of the bits within each byte
+ * @return std::span<std::uint32_t> - the words written
+ * @throws hal::argument_out_of_domain - if the pin is above 15 or p_words is
+ * too small
+ */
+constexpr std::span<std::uint32_t> encode_bitstream(
+  std::uint8_t p_pin,
+  std::span<hal::byte const> p_bytes,
+  std::span<std::uint32_t> p_words,
+  bit_order p_order = bit_order::msb_first)
+{
+  auto const count = p_bytes.size() * 8;
+  if (p_pin > 15 || p_words.size() < count) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+  auto const mask = static_cast<std::uint16_t>(1U << p_pin);
+  for (std::size_t i = 0; i < count; i++) {
+    auto const bit = p_order == bit_order::msb_first ? 7 - (i % 8) : i % 8;
+    auto const high = ((p_bytes[i / 8] >> bit) & 1U) != 0;
+    p_words[i] = bsrr_word(mask, high ? mask : 0);
+  }
+  return p_words.first(count);
+}
+
+/**
+ * @brief Encode a bitstream with a clock, two words per bit
+ *
+ * Each bit drives the data pin with the clock low, then raises the clock, so
+ * receivers sample data on rising edges (like spi mode 0). The clock is
+ * lowered again with the next bit, run the waveform with a final
+ * `bsrr_word()` to return it to idle.
+ *
+ * @param p_data_pin - pin 0 to 15 carrying the data
+ * @param p_clock_pin - pin 0 to 15 carrying the clock
+ * @param p_bytes - bitstream, 8 bits per byte
+ * @param p_words - receives 16 words per byte
+ * @param p_order - order of the bits within each byte
+ * @return std::span<std::uint32_t> - the words written
+ * @throws hal::argument_out_of_domain - if a pin is above 15, both pins are
+ * the same or p_words is too small
+ */
+constexpr std::span<std::uint32_t> encode_clocked_bitstream(
+  std::uint8_t p_data_pin,
+  std::uint8_t p_clock_pin,
+  std::span<hal::byte const> p_bytes,
+  std::span<std::uint32_t> p_words,
+  bit_order p_order = bit_order::msb_first)
+{
+  auto const count = p_bytes.size() * 16;
+  if (p_data_pin > 15 || p_clock_pin > 15 || p_data_pin == p_clock_pin ||
+      p_words.size() < count) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+  auto const data = static_cast<std::uint16_t>(1U << p_data_pin);
+  auto const clock = static_cast<std::uint16_t>(1U << p_clock_pin);
+  auto const mask = static_cast<std::uint16_t>(data | clock);
+  auto const bits = encode_bitstream(p_data_pin, p_bytes, p_words, p_order);
+  // Spread the data words out back to front, so none is overwritten before
+  // it is read
+  for (std::size_t i = bits.size(); i-- > 0;) {
+    auto const level = (bits[i] & data) != 0 ? data : std::uint16_t{ 0 };
+    p_words[(2 * i) + 1] = bsrr_word(mask, level | clock);
+    p_words[2 * i] = bsrr_word(mask, level);
+  }
+  return p_words.first(count);
+}
+
+/// Settings of a `gpio_waveform`
+struct gpio_waveform_settings
+{
+  /// Words written per second, rounded to a divider of the timer clock
+  hal::hertz word_rate = 1'000'000.0f;
+};
+
+/**
+ * @return resource_list - resources used by a `gpio_waveform`
+ */
+constexpr resource_list gpio_waveform_resources()
+{
+  resource_list resources;
+  resources.add(peripheral_resource(peripheral::timer1))
+    .add(dma_stream_resource(2, 5));
+  return resources;
+}
+
+/**
+ * @brief Plays precomputed set/reset words on a gpio port at a fixed rate
+ *
+ * Every TIM1 update event requests a DMA2 transfer of the next word into the
+ * port's set/reset register (BSRR). Each word sets and resets any subset of
+ * the port's pins at once, so multi-pin waveforms come out with the timing
+ * of the timer, unaffected by interrupts and without the CPU. Words are
+ * prepared with `bsrr_word()` and the `encode_*()` functions.
+ *
+ * Uses TIM1 and DMA2 stream 5 (see `gpio_waveform_resources()`), like
+ * `gpio_capture`, as TIM1 is the only timer whose update requests DMA2, the
+ * only controller that can reach the gpio ports.
+ *
+ * The pins must be configured as outputs, for example with `output_pin`.
+ * They hold the levels of the last word once the waveform ends.
+ *
+ * The timer is re-timed after every `set_clock_profile()` to keep the word
+ * rate, or the closest rate TIM1 can give from the new clock, and
+ * `word_rate()` reports the new rate.
+ */
+class gpio_waveform
+{
+public:
+  /// Called from the dma interrupt once a waveform played to its end
+  using handler = hal::callback<void()>;
+
+  /// Whether the waveform ends or starts over after its last word
+  enum class mode : std::uint8_t
+  {
+    once,
+    repeat,
+  };
+
+  /**
+   * @brief Prepare playing waveforms on a port
+   *
+   * @param p_port - gpio port to drive
+   * @param p_on_finished - called when a waveform played in `mode::once` ends
+   * @param p_settings - timing settings
+   * @throws hal::operation_not_supported - if the word rate can not be
+   * generated
+   * @throws hal::argument_out_of_domain - if the port is invalid
+   * @throws hal::device_or_resource_busy - if TIM1 or DMA2 stream 5 is used
+   * by another driver
+   */
+  gpio_waveform(peripheral p_port,
+                handler p_on_finished = [] {},
+                gpio_waveform_settings const& p_settings = {});
+
+  gpio_waveform(gpio_waveform& p_other) = delete;
+  gpio_waveform& operator=(gpio_waveform& p_other) = delete;
+  gpio_waveform(gpio_waveform&& p_other) noexcept = delete;
+  gpio_waveform& operator=(gpio_waveform&& p_other) noexcept = delete;
+
+  /**
+   * @brief Stop playing and release TIM1 and the dma stream
+   */
+  ~gpio_waveform();
+
+  /**
+   * @brief Start playing a waveform
+   *
+   * The first word is written one word period after the call. Stops the
+   * waveform currently playing, if any.
+   *
+   * @param p_words - set/reset words, must stay valid while playing, 1 to
+   * 65535 words
+   * @param p_mode - play once or repeat until `stop()`
+   * @throws hal::argument_out_of_domain - if the number of words is invalid
+   */
+  void play(std::span<std::uint32_t const> p_words, mode p_mode = mode::once);
+
+  /**
+   * @brief Stop playing, the pins keep the levels of the last word written
+   *
+   * Does nothing if no waveform is playing.
+   */
+  void stop();
+
+  /**
+   * @return true - a waveform is playing
+   */
+  [[nodiscard]] bool playing() const;
+
+  /**
+   * @return hal::hertz - words written per second
+   */
+  [[nodiscard]] hal::hertz word_rate() const;
+
+private:
+  void handle_interrupt();
+  void retime();
+
+  resource_claim m_resources;
+  handler m_on_finished;
+  peripheral m_port;
+  hal::hertz m_word_rate = 0.0f;
+  /// Word rate asked for, kept to re-time after clock changes
+  hal::hertz m_requested_rate = 0.0f;
+  bool m_playing = false;
+  clock_change_listener m_clock_listener{ [this]() { retime(); } };
+};
+}  // namespace hal::stm32f4
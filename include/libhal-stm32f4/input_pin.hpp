@@ -17,6 +17,7 @@
 #include <libhal/input_pin.hpp>
 
 #include "pin.hpp"
+#include "ramfunc.hpp"
 
 namespace hal::stm32f4 {
 /**
@@ -45,7 +46,7 @@ public:
 
 private:
   void driver_configure(settings const& p_settings) override;
-  bool driver_level() override;
+  HAL_STM32F4_RAMFUNC bool driver_level() override;
 
   hal::stm32f4::peripheral m_port{};
   uint8_t m_pin{};
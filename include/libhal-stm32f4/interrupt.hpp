@@ -0,0 +1,139 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+
+#include "constants.hpp"
+
+namespace hal::stm32f4 {
+/// Interrupt service routine placed directly in the vector table
+using interrupt_handler = void (*)();
+
+/// Lowest (least urgent) interrupt priority. 0 is the highest priority.
+inline constexpr std::uint8_t lowest_interrupt_priority = 15;
+
+/**
+ * @brief Relocate the vector table into RAM
+ *
+ * Copies the core exception vectors of the active vector table into a RAM
+ * table aligned to satisfy the VTOR alignment rules and points VTOR at it.
+ * Peripheral interrupt slots start empty, as the startup table is not
+ * required to have them. Afterwards, handlers can be installed directly into
+ * their vector slot with `enable_interrupt()`, so interrupts are dispatched
+ * by the hardware without any intermediate lookup.
+ *
+ * Calling this more than once has no effect. `enable_interrupt()` calls this
+ * automatically.
+ */
+void initialize_interrupts();
+
+/**
+ * @return true - the vector table has been relocated to RAM
+ */
+[[nodiscard]] bool interrupts_initialized();
+
+/**
+ * @brief Install a handler into an interrupt's vector slot and enable it
+ *
+ * @param p_irq - interrupt request to enable
+ * @param p_handler - function called directly by the hardware when the
+ * interrupt fires. Consider marking it with HAL_STM32F4_RAMFUNC.
+ * @throws hal::argument_out_of_domain - if p_irq is not a valid interrupt
+ */
+void enable_interrupt(irq p_irq, interrupt_handler p_handler);
+
+/**
+ * @brief Disable an interrupt in the NVIC
+ *
+ * The handler remains in the vector table.
+ *
+ * @param p_irq - interrupt request to disable
+ * @throws hal::argument_out_of_domain - if p_irq is not a valid interrupt
+ */
+void disable_interrupt(irq p_irq);
+
+/**
+ * @param p_irq - interrupt request to check
+ * @return true - the interrupt is enabled in the NVIC
+ * @throws hal::argument_out_of_domain - if p_irq is not a valid interrupt
+ */
+[[nodiscard]] bool is_interrupt_enabled(irq p_irq);
+
+/**
+ * @param p_irq - interrupt request
+ * @return interrupt_handler - the handler installed for the interrupt, or
+ * nullptr if interrupts have not been initialized
+ * @throws hal::argument_out_of_domain - if p_irq is not a valid interrupt
+ */
+[[nodiscard]] interrupt_handler interrupt_vector(irq p_irq);
+
+/**
+ * @brief Set the priority of an interrupt
+ *
+ * How the priority is split between preemption priority and sub-priority is
+ * decided by `set_priority_grouping()`. Give latency critical interrupts a
+ * lower number than bulk I/O interrupts so that they preempt them.
+ *
+ * @param p_irq - interrupt request
+ * @param p_priority - 0 (most urgent) to `lowest_interrupt_priority`
+ * @throws hal::argument_out_of_domain - if p_irq is not a valid interrupt or
+ * the priority is out of range
+ */
+void set_interrupt_priority(irq p_irq, std::uint8_t p_priority);
+
+/**
+ * @param p_irq - interrupt request
+ * @return std::uint8_t - priority of the interrupt from 0 to
+ * `lowest_interrupt_priority`
+ * @throws hal::argument_out_of_domain - if p_irq is not a valid interrupt
+ */
+[[nodiscard]] std::uint8_t interrupt_priority(irq p_irq);
+
+/**
+ * @brief Select how many priority bits are used for preemption
+ *
+ * The stm32f4 implements 4 priority bits. Preemption bits decide whether an
+ * interrupt can interrupt another running handler; the remaining sub-priority
+ * bits only order pending interrupts.
+ *
+ * @param p_preemption_bits - 0 to 4 bits of preemption priority
+ * @throws hal::argument_out_of_domain - if p_preemption_bits is above 4
+ */
+void set_priority_grouping(std::uint8_t p_preemption_bits);
+
+/**
+ * @brief Masks all configurable interrupts for its lifetime (PRIMASK)
+ *
+ * Restores the previous mask on destruction, so critical sections can nest.
+ * A core waiting with `wait_for_interrupt()` inside a critical section still
+ * wakes up when an interrupt becomes pending; the handler runs once the
+ * section ends. Checking a condition set by a handler and then waiting inside
+ * one critical section can therefore not miss the interrupt.
+ *
+ * Does nothing on non-ARM builds.
+ */
+class critical_section
+{
+public:
+  critical_section();
+  critical_section(critical_section const&) = delete;
+  critical_section& operator=(critical_section const&) = delete;
+  ~critical_section();
+
+private:
+  std::uint32_t m_previous_mask = 0;
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,163 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+
+#include <libhal/units.hpp>
+
+#include "constants.hpp"
+
+namespace hal::stm32f4 {
+/// Low power modes of the stm32f4, from highest to lowest power
+enum class power_mode : std::uint8_t
+{
+  /// Core clock stopped, peripherals and clocks keep running
+  sleep,
+  /// All clocks in the core domain stopped, SRAM and registers retained
+  stop,
+  /// Core domain powered off, only the backup domain is retained
+  standby,
+};
+
+/// Gpio edge that wakes the device
+enum class wake_edge : std::uint8_t
+{
+  rising,
+  falling,
+  both,
+};
+
+/// Trade-offs between stop mode current and wake-up time
+struct stop_settings
+{
+  /// Run the voltage regulator in low power mode while stopped. Lowers the
+  /// stop current at the cost of a longer regulator start-up on wake.
+  bool low_power_regulator = true;
+  /// Power down the flash while stopped. Lowers the stop current at the cost
+  /// of waiting for the flash to power up on wake.
+  bool flash_power_down = false;
+};
+
+/**
+ * @brief Enter sleep mode until an enabled interrupt fires
+ *
+ * Drop in replacement for busy waiting idle loops. Wake-up takes a few cycles
+ * since all clocks keep running.
+ */
+void sleep();
+
+/**
+ * @brief Enter stop mode until a wake-up event, then restore the clock tree
+ *
+ * Any EXTI line configured with `enable_pin_wake()` or `enable_rtc_wake()`,
+ * and any pending interrupt (even one that is disabled in the NVIC), wakes the
+ * device. Enabled interrupts run after the clocks have been restored.
+ *
+ * The device always wakes from stop running from the 16MHz HSI. Before
+ * returning, this re-enables the HSE and main PLL if they were enabled before
+ * stopping and switches the system clock back to its previous source, so
+ * drivers see the same clock rates as before.
+ *
+ * The hardware wake-up time (regulator and flash start-up) depends on
+ * `p_settings` and is listed in the datasheet as tWUSTOP. The time spent
+ * restoring the clock tree after that is returned, so that the total wake-up
+ * latency can be bounded against control deadlines.
+ *
+ * @param p_settings - stop mode current vs wake-up time trade-offs
+ * @return std::uint32_t - cycles spent restoring the clock tree after waking,
+ * measured with the DWT cycle counter. Zero if the cycle counter is not
+ * enabled (see `enable_cycle_counter()`). Also recorded into
+ * `profile(profile_point::stop_wake)` when profiling is enabled.
+ */
+std::uint32_t stop(stop_settings const& p_settings = {});
+
+/**
+ * @brief Enter standby mode, never returns
+ *
+ * The device resets on wake-up from the WKUP pin (see `enable_wakeup_pin()`)
+ * or the RTC wakeup timer (see `enable_rtc_wake()`). SRAM and registers are
+ * lost. Use `woke_from_standby()` on boot to tell a standby wake-up apart from
+ * a power-on reset.
+ */
+[[noreturn]] void standby();
+
+/**
+ * @brief Wake the device from sleep or stop on an edge of a gpio pin
+ *
+ * The pin's EXTI line generates a wake-up event, so no interrupt handler is
+ * required. Only one port can be connected to each pin number.
+ *
+ * @param p_port - gpio port of the pin
+ * @param p_pin - pin number 0 to 15
+ * @param p_edge - edge(s) that wake the device
+ * @throws hal::argument_out_of_domain - if the port is not a gpio port or the
+ * pin is above 15
+ */
+void enable_pin_wake(peripheral p_port, std::uint8_t p_pin, wake_edge p_edge);
+
+/**
+ * @brief Stop waking the device from edges on a pin number
+ *
+ * @param p_pin - pin number 0 to 15
+ * @throws hal::argument_out_of_domain - if the pin is above 15
+ */
+void disable_pin_wake(std::uint8_t p_pin);
+
+/**
+ * @brief Periodically wake the device from sleep, stop or standby using the
+ * RTC wakeup timer
+ *
+ * The RTC is clocked from the LSE if it has already been selected as the RTC
+ * clock, otherwise the LSI is started and selected. The LSI frequency varies
+ * between parts by up to ±50%, so use the LSE when the period must be
+ * accurate.
+ *
+ * @param p_period - time between wake-ups, from 0.5ms to 32s with a
+ * resolution of 0.5ms
+ * @throws hal::argument_out_of_domain - if the period is out of range
+ * @throws hal::operation_not_supported - if the RTC is already clocked from
+ * the HSE
+ */
+void enable_rtc_wake(hal::time_duration p_period);
+
+/**
+ * @brief Stop the RTC wakeup timer
+ *
+ */
+void disable_rtc_wake();
+
+/**
+ * @brief Enable or disable the WKUP pin (PA0) as a standby wake-up source
+ *
+ * A rising edge on the pin wakes the device from standby.
+ *
+ * @param p_enable - true to wake from standby on the WKUP pin
+ */
+void enable_wakeup_pin(bool p_enable);
+
+/**
+ * @return true - the device was reset by waking up from standby
+ */
+[[nodiscard]] bool woke_from_standby();
+
+/**
+ * @brief Clear the standby and wake-up flags
+ *
+ * Must be called after handling a standby wake-up so that the next reset is
+ * not mistaken for one.
+ */
+void clear_wake_flags();
+}  // namespace hal::stm32f4
@@ -17,6 +17,7 @@
 #include <libhal/output_pin.hpp>
 
 #include "pin.hpp"
+#include "ramfunc.hpp"
 
 namespace hal::stm32f4 {
 class output_pin : public hal::output_pin
@@ -35,8 +36,8 @@ public:
 
 private:
   void driver_configure(settings const& p_settings) override;
-  void driver_level(bool p_high) override;
-  bool driver_level() override;
+  HAL_STM32F4_RAMFUNC void driver_level(bool p_high) override;
+  HAL_STM32F4_RAMFUNC bool driver_level() override;
 
   hal::stm32f4::peripheral m_port{};
   std::uint8_t m_pin{};
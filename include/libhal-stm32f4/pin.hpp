@@ -20,6 +20,54 @@
 #include <libhal/units.hpp>
 
 namespace hal::stm32f4 {
+/**
+ * @brief Output slew rate of a pin
+ *
+ * Faster settings allow higher signal frequencies at the cost of more current
+ * and more EMI from the sharper edges.
+ */
+enum class pin_speed : std::uint8_t
+{
+  /// Up to 4MHz
+  low = 0b00,
+  /// Up to 25MHz
+  medium = 0b01,
+  /// Up to 50MHz
+  fast = 0b10,
+  /// Up to 100MHz
+  high = 0b11,
+};
+
+/**
+ * @brief Select the slowest pin speed able to carry a signal
+ *
+ * Maximum frequencies are from the stm32f411 datasheet I/O AC
+ * characteristics at VDD >= 2.7V and 50pF. The speed is chosen so that the
+ * signal frequency is at most half of the maximum, which keeps the edges
+ * short relative to the bit period.
+ *
+ * @param p_frequency - frequency of the fastest signal on the pin, for
+ * example the SCK frequency of a spi bus
+ * @return constexpr pin_speed - slowest speed suitable for the signal
+ */
+constexpr pin_speed pin_speed_for(hal::hertz p_frequency)
+{
+  constexpr hal::hertz low_max = 4'000'000.0f;
+  constexpr hal::hertz medium_max = 25'000'000.0f;
+  constexpr hal::hertz fast_max = 50'000'000.0f;
+
+  if (p_frequency * 2 <= low_max) {
+    return pin_speed::low;
+  }
+  if (p_frequency * 2 <= medium_max) {
+    return pin_speed::medium;
+  }
+  if (p_frequency * 2 <= fast_max) {
+    return pin_speed::fast;
+  }
+  return pin_speed::high;
+}
+
 /**
  * @brief stm32f4 pin multiplexing and control driver used drivers and apps
  * seeking to tune the pins.
@@ -84,6 +132,14 @@ public:
    */
   pin const& open_drain(bool p_enable = true) const noexcept;
 
+  /**
+   * @brief Set the output slew rate of this pin
+   *
+   * @param p_speed - output speed
+   * @return pin& - reference to this pin for chaining
+   */
+  pin const& speed(pin_speed p_speed) const noexcept;
+
 private:
   peripheral m_port{};
   std::uint8_t m_pin{};
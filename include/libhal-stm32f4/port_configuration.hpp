@@ -0,0 +1,167 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+
+#include <libhal/units.hpp>
+
+#include "constants.hpp"
+#include "pin.hpp"
+
+namespace hal::stm32f4 {
+/**
+ * @brief Accumulates the configuration of any number of pins on one gpio port
+ * and commits it with a single read-modify-write per register.
+ *
+ * `pin` performs one read-modify-write per setting per pin, which adds up
+ * during board bring-up. Settings that are not given for a pin are left
+ * untouched. The pin mode is written last, so a pin never switches to its
+ * alternate function before its alternate function number, output type and
+ * speed are in place, or to an output before its level is in place.
+ *
+ * Example:
+ *
+ *     port_configuration(peripheral::gpio_a)
+ *       .function(5, pin::pin_function::alternate5)
+ *       .function(6, pin::pin_function::alternate5)
+ *       .function(7, pin::pin_function::alternate5)
+ *       .speed(5, pin_speed::fast)
+ *       .speed(7, pin_speed::fast)
+ *       .commit();
+ */
+class port_configuration
+{
+public:
+  /**
+   * @brief Start a configuration of a gpio port and power it on
+   *
+   * @param p_port - gpio port to configure
+   */
+  explicit port_configuration(peripheral p_port);
+
+  /**
+   * @brief Set the function of a pin
+   *
+   * @param p_pin - pin number 0 to 15
+   * @param p_function - the pin function (I, O, analog, alternatex)
+   * @return port_configuration& - reference to this for chaining
+   * @throws hal::argument_out_of_domain - if the pin is above 15
+   */
+  port_configuration& function(std::uint8_t p_pin,
+                               pin::pin_function p_function);
+
+  /**
+   * @brief Set the internal resistor connected to a pin
+   *
+   * @param p_pin - pin number 0 to 15
+   * @param p_resistor - resistor type
+   * @return port_configuration& - reference to this for chaining
+   * @throws hal::argument_out_of_domain - if the pin is above 15
+   */
+  port_configuration& resistor(std::uint8_t p_pin,
+                               hal::pin_resistor p_resistor);
+
+  /**
+   * @brief Select open drain or push-pull output for a pin
+   *
+   * @param p_pin - pin number 0 to 15
+   * @param p_enable - true for open drain, false for push-pull
+   * @return port_configuration& - reference to this for chaining
+   * @throws hal::argument_out_of_domain - if the pin is above 15
+   */
+  port_configuration& open_drain(std::uint8_t p_pin, bool p_enable = true);
+
+  /**
+   * @brief Set the output slew rate of a pin
+   *
+   * @param p_pin - pin number 0 to 15
+   * @param p_speed - output speed, see `pin_speed_for()`
+   * @return port_configuration& - reference to this for chaining
+   * @throws hal::argument_out_of_domain - if the pin is above 15
+   */
+  port_configuration& speed(std::uint8_t p_pin, pin_speed p_speed);
+
+  /**
+   * @brief Set the level a pin drives once it is an output
+   *
+   * The level is written before the pin mode, so a pin switched to an output
+   * never glitches to the wrong level.
+   *
+   * @param p_pin - pin number 0 to 15
+   * @param p_high - true to drive the pin high
+   * @return port_configuration& - reference to this for chaining
+   * @throws hal::argument_out_of_domain - if the pin is above 15
+   */
+  port_configuration& level(std::uint8_t p_pin, bool p_high);
+
+  /**
+   * @brief Route a pin to a function as a push-pull pin without resistor
+   *
+   * Same as `function()`, `open_drain(p_pin, false)`,
+   * `resistor(p_pin, pin_resistor::none)` and `speed()`, without checking the
+   * pin number, for drivers routing pins taken from their route tables which
+   * must not throw. Only pin numbers 0 to 15 are meaningful, others wrap.
+   *
+   * @param p_pin - pin number 0 to 15
+   * @param p_function - the pin function (I, O, analog, alternatex)
+   * @param p_speed - output speed, see `pin_speed_for()`
+   * @return port_configuration& - reference to this for chaining
+   */
+  port_configuration& route(std::uint8_t p_pin,
+                            pin::pin_function p_function,
+                            pin_speed p_speed) noexcept;
+
+  /**
+   * @brief Write the accumulated settings to the port's registers
+   *
+   * Registers without any settings are not accessed. The accumulated settings
+   * are kept, so committing again re-applies them.
+   */
+  void commit() const noexcept;
+
+private:
+  friend class board_configuration;
+
+  /// Selects the constructor leaving the port's power to the caller
+  struct unpowered
+  {};
+
+  port_configuration(peripheral p_port, unpowered);
+
+  void insert_function(std::uint8_t p_pin,
+                       pin::pin_function p_function) noexcept;
+  void insert_resistor(std::uint8_t p_pin,
+                       hal::pin_resistor p_resistor) noexcept;
+  void insert_open_drain(std::uint8_t p_pin, bool p_enable) noexcept;
+  void insert_speed(std::uint8_t p_pin, pin_speed p_speed) noexcept;
+
+  /// Bits of a register to replace and their new values
+  struct field_update
+  {
+    std::uint32_t mask = 0;
+    std::uint32_t value = 0;
+  };
+
+  peripheral m_port;
+  field_update m_mode{};
+  field_update m_output_type{};
+  field_update m_speed{};
+  field_update m_pull{};
+  field_update m_alternate_low{};
+  field_update m_alternate_high{};
+  field_update m_output{};
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,168 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <span>
+
+#include "ramfunc.hpp"
+
+/// When set to 1, drivers record the cycle count of each of their operations
+/// into the histogram returned by `hal::stm32f4::profile()`. Must be defined
+/// for the whole library build (CMake option LIBHAL_STM32F4_PROFILE).
+#if !defined(LIBHAL_STM32F4_PROFILE)
+#define LIBHAL_STM32F4_PROFILE 0
+#endif
+
+namespace hal::stm32f4 {
+/// Driver operations that are profiled
+enum class profile_point : std::uint8_t
+{
+  /// spi::transfer()
+  spi_transfer,
+  /// spi::configure()
+  spi_configure,
+  /// output_pin::configure() and input_pin::configure()
+  pin_configure,
+  /// Enabling a peripheral's clock
+  power_on,
+  /// Disabling a peripheral's clock
+  power_off,
+  /// Restoring the clock tree after waking from stop()
+  stop_wake,
+  /// Handling a dma half or full transfer interrupt
+  dma_complete,
+  max,
+};
+
+/**
+ * @brief Fixed size histogram of latencies with power of two buckets
+ *
+ * Bucket 0 holds samples of 0 cycles and bucket N holds samples in the range
+ * [2^(N-1), 2^N). Recording a sample is a handful of instructions and never
+ * allocates, so it is usable from interrupt context. Recording into the same
+ * histogram from an interrupt and from thread mode at the same time may lose
+ * a sample.
+ */
+class latency_histogram
+{
+public:
+  /// One bucket for zero plus one for each bit of a 32-bit cycle count
+  static constexpr std::size_t bucket_count = 33;
+
+  /**
+   * @brief Add a sample to the histogram
+   *
+   * @param p_cycles - latency of the operation in cycles
+   */
+  HAL_STM32F4_RAMFUNC void record(std::uint32_t p_cycles);
+
+  /**
+   * @brief Remove all samples
+   *
+   */
+  void reset();
+
+  /**
+   * @brief Estimate a percentile of the recorded latencies
+   *
+   * @param p_percentile - percentile from 0.0 to 1.0, for example 0.99 for p99
+   * @return std::uint32_t - upper bound, in cycles, of the bucket containing
+   * the percentile, limited to the largest sample recorded. Returns 0 if no
+   * samples have been recorded.
+   */
+  [[nodiscard]] std::uint32_t percentile(float p_percentile) const;
+
+  /**
+   * @return std::uint32_t - number of samples recorded
+   */
+  [[nodiscard]] std::uint32_t count() const
+  {
+    return m_count;
+  }
+
+  /**
+   * @return std::uint32_t - smallest sample recorded, 0 if empty
+   */
+  [[nodiscard]] std::uint32_t min() const
+  {
+    return m_count ? m_min : 0;
+  }
+
+  /**
+   * @return std::uint32_t - largest sample recorded
+   */
+  [[nodiscard]] std::uint32_t max() const
+  {
+    return m_max;
+  }
+
+  /**
+   * @return std::uint32_t - average of all samples recorded, 0 if empty
+   */
+  [[nodiscard]] std::uint32_t mean() const
+  {
+    return m_count ? static_cast<std::uint32_t>(m_sum / m_count) : 0;
+  }
+
+  /**
+   * @return std::span<std::uint32_t const> - number of samples in each bucket
+   */
+  [[nodiscard]] std::span<std::uint32_t const> buckets() const
+  {
+    return m_buckets;
+  }
+
+private:
+  std::array<std::uint32_t, bucket_count> m_buckets{};
+  std::uint64_t m_sum = 0;
+  std::uint32_t m_count = 0;
+  std::uint32_t m_min = UINT32_MAX;
+  std::uint32_t m_max = 0;
+};
+
+/**
+ * @brief Get the latency histogram for a driver operation
+ *
+ * Histograms are only filled when the library is built with
+ * LIBHAL_STM32F4_PROFILE and the cycle counter is enabled.
+ *
+ * @param p_point - driver operation
+ * @return latency_histogram& - histogram of cycle counts for the operation
+ */
+latency_histogram& profile(profile_point p_point);
+
+/**
+ * @brief Clear every driver operation histogram
+ *
+ */
+void reset_profiles();
+
+/**
+ * @brief Enable the DWT cycle counter used for profiling
+ *
+ * Sets TRCENA in the debug exception and monitor control register and starts
+ * the cycle counter. This is also done by `hal::cortex_m::dwt_counter`.
+ */
+void enable_cycle_counter();
+
+/**
+ * @return std::uint32_t - current value of the DWT cycle counter
+ */
+[[nodiscard]] std::uint32_t cycle_count();
+}  // namespace hal::stm32f4
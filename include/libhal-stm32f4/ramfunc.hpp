@@ -0,0 +1,46 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+/**
+ * @brief Place a function in SRAM so it executes with zero flash wait states
+ *
+ * Functions marked with this attribute are emitted into the `.data.ramfunc`
+ * input section. The stm32f4 linker scripts place that section inside of the
+ * `.data` output section, so the startup code copies these functions from
+ * flash into SRAM along with the rest of the initialized data before `main()`
+ * is called. Because the code never executes from flash, it is also unaffected
+ * by flash stalls while the flash is being erased or programmed.
+ *
+ * RAM and flash are further apart than the range of a `bl` instruction, so the
+ * attribute also marks the function as `long_call`. Apply it to the
+ * declaration that callers see.
+ *
+ * Keep RAM functions small and make sure anything they call is either inlined
+ * or also RAM resident, otherwise execution will bounce back out to flash.
+ *
+ * Builds that are not targeting ARM (such as host unit tests) expand this
+ * macro to nothing.
+ *
+ * Usage:
+ *
+ *     HAL_STM32F4_RAMFUNC void my_isr();
+ */
+#if defined(__arm__) && !defined(HAL_STM32F4_DISABLE_RAMFUNC)
+#define HAL_STM32F4_RAMFUNC                                                    \
+  __attribute__((section(".data.ramfunc"), long_call, noinline))
+#else
+#define HAL_STM32F4_RAMFUNC
+#endif
@@ -0,0 +1,238 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <span>
+
+#include <libhal/units.hpp>
+
+#include "constants.hpp"
+#include "low_power.hpp"
+
+namespace hal::stm32f4 {
+/**
+ * @brief Host side stand-in for the stm32f4 peripheral registers
+ *
+ * While an instance is alive, every register block used by the drivers in this
+ * library is redirected into host memory and the drivers' register accesses
+ * are routed through behavioral models of the peripherals. This allows the
+ * unmodified driver code to run in unit tests and other host builds.
+ *
+ * - RCC: enable bits behave as plain memory. Writes to a gpio or spi register
+ *   block whose clock is not enabled are counted by `unclocked_writes()`.
+ *   Oscillators, the PLL and system clock switches are ready immediately.
+ *   Entering stop disables the HSE and PLL and selects the HSI, like hardware.
+ * - Flash: plain memory, so wait states are in effect as soon as written.
+ * - GPIO: writes to the set/reset register update the output data register
+ *   and the set/reset register reads back as zero. The input data register is
+ *   controlled via `gpio_input()`.
+ * - EXTI: level changes made with `gpio_input()` set the pending bit of the
+ *   gpio lines whose selected port and trigger edge match, and run the line's
+ *   interrupt handler if the line is unmasked. Pending bits are write 1 to
+ *   clear.
+ * - SPI: BSY is always clear. Writing the data register records the byte,
+ *   sets RXNE and loads the next response byte into the data register.
+ *   Reading the data register clears RXNE. A byte written while RXNE is set
+ *   waits in the transmit buffer, clearing TXE, and is shifted out on the
+ *   first status read after RXNE is cleared. `spi_overrun_next()` and
+ *   `spi_overrun_on_read()` make such a byte shift while RXNE is still set
+ *   instead: its response is lost and OVR is set. Reading the data register
+ *   then the status register clears OVR, that status read still returning it
+ *   set. When no response bytes are queued, the bus behaves as if MOSI were
+ *   looped back to MISO.
+ *   A bus enabled in receive-only mode shifts in the queued response bytes,
+ *   or zeros, when `spi_clock_in()` is called, each time software reads the
+ *   counter of the dma stream receiving from it, and once more when it is
+ *   disabled, as the byte in progress completes.
+ * - DMA: peripheral to memory streams move bytes from the spi buses they
+ *   serve, update the half/complete flags, reload in circular mode and run
+ *   the stream's interrupt handler if enabled. The flag clear registers are
+ *   write 1 to clear. Memory to peripheral streams feeding an enabled spi bus
+ *   run to completion when the core waits (WFI/WFE), along with the streams
+ *   receiving from those buses. Circular ones only move bytes when
+ *   `spi_clock_out()` is called. DMA2 streams serving TIM1 requests move one
+ *   element of their memory data size per request, in either direction.
+ * - Timers: TIM1 to TIM5 count at `timer_clock` / (PSC + 1) while enabled,
+ *   whatever the clock profile, wrap after ARR, raise the update and compare
+ *   flags and run their interrupt handler if enabled. The status register is
+ *   write 0 to clear.
+ *   TIM1 update and compare 1 events request a DMA2 transfer if enabled.
+ *   Time only passes when `elapse()` is called, or when the core waits
+ *   (WFI/WFE) with no dma transfer running, in which case it passes until the
+ *   next enabled timer interrupt.
+ * - NVIC: the set/clear enable registers behave as write 1 to set/clear and
+ *   VTOR initially points to an empty vector table standing in for flash.
+ * - DWT: while enabled, the cycle counter advances by one each time it is
+ *   read through the register hooks.
+ * - Low power: WFI/WFE count an entry into the power mode selected by SCR and
+ *   PWR, then return immediately as if woken.
+ *
+ * Only one simulation may be active at a time. The simulation relies on the
+ * driver register hooks which are only compiled in for non-ARM builds (see
+ * LIBHAL_STM32F4_MMIO_HOOKS).
+ */
+class register_simulation
+{
+public:
+  /// Number of bytes that can be recorded or queued per spi bus
+  static constexpr std::size_t spi_buffer_size = 256;
+  /// Input clock of the general purpose timers
+  static constexpr hal::hertz timer_clock = 16'000'000.0f;
+
+  /**
+   * @brief Redirect all peripheral registers to host memory
+   *
+   * Registers are set to their reset values.
+   *
+   * @throws hal::device_or_resource_busy - if another simulation is active
+   * @throws hal::operation_not_supported - if register hooks are disabled
+   */
+  register_simulation();
+
+  register_simulation(register_simulation& p_other) = delete;
+  register_simulation& operator=(register_simulation& p_other) = delete;
+  register_simulation(register_simulation&& p_other) noexcept = delete;
+  register_simulation& operator=(register_simulation&& p_other) noexcept =
+    delete;
+
+  /**
+   * @brief Restore the original register addresses
+   *
+   */
+  ~register_simulation();
+
+  /**
+   * @brief Drive the levels seen on a gpio port's input pins
+   *
+   * @param p_port - gpio port
+   * @param p_levels - bit N represents the level of pin N
+   */
+  void gpio_input(peripheral p_port, std::uint16_t p_levels);
+
+  /**
+   * @brief Get the levels a gpio port is driving on its output pins
+   *
+   * @param p_port - gpio port
+   * @return std::uint16_t - bit N represents the level of pin N
+   */
+  [[nodiscard]] std::uint16_t gpio_output(peripheral p_port) const;
+
+  /**
+   * @brief Queue bytes to be returned by the spi bus on MISO
+   *
+   * @param p_bus - spi bus number 1-5
+   * @param p_data - bytes to return, in order, for each byte transferred.
+   * Bytes beyond `spi_buffer_size` are dropped.
+   */
+  void spi_respond_with(std::uint8_t p_bus, std::span<hal::byte const> p_data);
+
+  /**
+   * @brief Get the bytes transmitted on MOSI since the last clear
+   *
+   * @param p_bus - spi bus number 1-5
+   * @return std::span<hal::byte const> - transmitted bytes, saturates at
+   * `spi_buffer_size`
+   */
+  [[nodiscard]] std::span<hal::byte const> spi_transmitted(
+    std::uint8_t p_bus) const;
+
+  /**
+   * @brief Let a bus enabled in receive-only mode shift in bytes
+   *
+   * Bytes come from the response queue, zeros once it is exhausted. Does
+   * nothing unless the bus is enabled in receive-only mode.
+   *
+   * @param p_bus - spi bus number 1-5
+   * @param p_count - number of bytes to shift in
+   */
+  void spi_clock_in(std::uint8_t p_bus, std::size_t p_count);
+
+  /**
+   * @brief Let a bus fed by a circular dma stream shift out bytes
+   *
+   * Does nothing unless a circular dma stream is feeding the bus.
+   *
+   * @param p_bus - spi bus number 1-5
+   * @param p_count - number of bytes to shift out
+   */
+  void spi_clock_out(std::uint8_t p_bus, std::size_t p_count);
+
+  /**
+   * @brief Make the next byte written while RXNE is set overrun the bus
+   *
+   * Stands in for an interrupt holding off software for longer than a byte
+   * time during a pipelined transfer.
+   *
+   * @param p_bus - spi bus number 1-5
+   */
+  void spi_overrun_next(std::uint8_t p_bus);
+
+  /**
+   * @brief Make the byte waiting in the transmit buffer overrun the bus when
+   * the data register is next read
+   *
+   * Stands in for an interrupt landing between a status poll that saw RXNE
+   * and the data register read, and lasting longer than a byte time.
+   *
+   * @param p_bus - spi bus number 1-5
+   */
+  void spi_overrun_on_read(std::uint8_t p_bus);
+
+  /**
+   * @brief Let time pass for the timers
+   *
+   * Timer interrupt handlers due in that time are run as their events occur.
+   *
+   * @param p_duration - time to pass, rounded down to a timer clock cycle
+   */
+  void elapse(hal::time_duration p_duration);
+
+  /**
+   * @brief Time passed since the simulation started
+   *
+   * Includes time passed by `elapse()` and while the core waited.
+   *
+   * @return hal::time_duration - simulated time
+   */
+  [[nodiscard]] hal::time_duration elapsed() const;
+
+  /**
+   * @brief Clear the transmit record and response queue of a spi bus
+   *
+   * @param p_bus - spi bus number 1-5
+   */
+  void spi_clear(std::uint8_t p_bus);
+
+  /**
+   * @brief Number of register writes to peripherals whose clock was disabled
+   *
+   * On hardware these writes are silently dropped.
+   *
+   * @return std::uint32_t - number of writes
+   */
+  [[nodiscard]] std::uint32_t unclocked_writes() const;
+
+  /**
+   * @brief Number of times the core has entered a power mode
+   *
+   * @param p_mode - power mode
+   * @return std::uint32_t - number of WFI/WFE executed in that mode
+   */
+  [[nodiscard]] std::uint32_t power_mode_entries(power_mode p_mode) const;
+};
+}  // namespace hal::stm32f4
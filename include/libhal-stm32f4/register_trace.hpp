@@ -0,0 +1,136 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <span>
+
+/// When set to 1, every driver register access is reported to an observer.
+/// Always enabled for host builds, where the register simulation depends on
+/// it. On target it defaults to 0, which compiles every register access down to
+/// a plain volatile load or store. Define it to 1 for the whole library build
+/// (CMake option LIBHAL_STM32F4_MMIO_HOOKS) to use `register_trace` on target.
+#if !defined(LIBHAL_STM32F4_MMIO_HOOKS)
+#if defined(__arm__)
+#define LIBHAL_STM32F4_MMIO_HOOKS 0
+#else
+#define LIBHAL_STM32F4_MMIO_HOOKS 1
+#endif
+#endif
+
+namespace hal::stm32f4 {
+/// Kind of access a driver performed on a register
+enum class register_access : std::uint8_t
+{
+  /// A single volatile load
+  read,
+  /// A single volatile store
+  write,
+  /// A volatile load followed by a volatile store of the modified value
+  modify,
+};
+
+/**
+ * @brief Counts and records the register accesses performed by drivers
+ *
+ * While an instance is alive, every register access made by the drivers in
+ * this library is counted and the first `capacity` accesses are recorded in
+ * order. Register traffic is the primary cost of most driver operations, so
+ * the counts serve as a cost model for catching regressions: reset the trace,
+ * perform one driver operation, then inspect `access_counts()`.
+ *
+ * A trace can be created on top of a `register_simulation` to observe drivers
+ * running on the host. Destroy the trace before the simulation. Only one trace
+ * may be active at a time.
+ *
+ * Requires LIBHAL_STM32F4_MMIO_HOOKS, otherwise nothing is recorded.
+ */
+class register_trace
+{
+public:
+  /// Number of accesses that are recorded in order
+  static constexpr std::size_t capacity = 128;
+  /// Whether drivers were built with register hooks
+  static constexpr bool enabled = LIBHAL_STM32F4_MMIO_HOOKS;
+
+  /// Number of accesses of each kind
+  struct counts
+  {
+    std::uint32_t reads = 0;
+    std::uint32_t writes = 0;
+    std::uint32_t modifies = 0;
+
+    /**
+     * @return std::uint32_t - number of bus transactions, a modify is counted
+     * as a read and a write
+     */
+    [[nodiscard]] constexpr std::uint32_t bus_accesses() const
+    {
+      return reads + writes + (2 * modifies);
+    }
+
+    constexpr bool operator==(counts const&) const = default;
+  };
+
+  /// A single recorded access
+  struct entry
+  {
+    register_access kind;
+    std::uintptr_t address;
+  };
+
+  /**
+   * @brief Start tracing register accesses
+   *
+   * @throws hal::device_or_resource_busy - if another trace is active
+   */
+  register_trace();
+
+  register_trace(register_trace& p_other) = delete;
+  register_trace& operator=(register_trace& p_other) = delete;
+  register_trace(register_trace&& p_other) noexcept = delete;
+  register_trace& operator=(register_trace&& p_other) noexcept = delete;
+
+  /**
+   * @brief Stop tracing and restore the previously installed observer
+   *
+   */
+  ~register_trace();
+
+  /**
+   * @brief Clear the counts and recorded accesses
+   *
+   */
+  void reset();
+
+  /**
+   * @return counts - accesses since construction or the last reset
+   */
+  [[nodiscard]] counts access_counts() const;
+
+  /**
+   * @return std::span<entry const> - the recorded accesses, in order
+   */
+  [[nodiscard]] std::span<entry const> entries() const;
+
+  /**
+   * @return std::uint32_t - number of accesses that were counted but not
+   * recorded because the record was full
+   */
+  [[nodiscard]] std::uint32_t dropped() const;
+};
+}  // namespace hal::stm32f4
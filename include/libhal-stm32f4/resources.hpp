@@ -0,0 +1,258 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include <span>
+
+#include <libhal-util/enum.hpp>
+#include <libhal/error.hpp>
+
+#include "constants.hpp"
+#include "spi_pins.hpp"
+
+namespace hal::stm32f4 {
+/// Kinds of hardware resources drivers take exclusive use of
+enum class resource_type : std::uint8_t
+{
+  /// A peripheral instance, such as a spi bus or a timer
+  peripheral,
+  /// A gpio pin
+  pin,
+  /// A dma stream
+  dma_stream,
+  /// An interrupt and its vector
+  irq,
+};
+
+/// A hardware resource
+struct resource
+{
+  resource_type type;
+  /// Identifies the resource among those of its type, below 256
+  std::uint8_t id;
+
+  constexpr bool operator==(resource const&) const = default;
+};
+
+constexpr resource peripheral_resource(peripheral p_peripheral)
+{
+  return { resource_type::peripheral,
+           static_cast<std::uint8_t>(hal::value(p_peripheral)) };
+}
+
+constexpr resource pin_resource(peripheral p_port, std::uint8_t p_pin)
+{
+  return { resource_type::pin,
+           static_cast<std::uint8_t>((hal::value(p_port) * 16U) + p_pin) };
+}
+
+constexpr resource dma_stream_resource(std::uint8_t p_controller,
+                                       std::uint8_t p_stream)
+{
+  return { resource_type::dma_stream,
+           static_cast<std::uint8_t>(((p_controller - 1U) * 8U) + p_stream) };
+}
+
+constexpr resource irq_resource(irq p_irq)
+{
+  return { resource_type::irq, static_cast<std::uint8_t>(hal::value(p_irq)) };
+}
+
+/// Resources used by one driver instance
+struct resource_list
+{
+  static constexpr std::size_t capacity = 8;
+
+  std::array<resource, capacity> items{};
+  std::size_t count = 0;
+
+  /**
+   * @param p_resource - resource to append
+   * @return resource_list& - *this
+   * @throws hal::resource_unavailable_try_again - if the list is full
+   */
+  constexpr resource_list& add(resource p_resource)
+  {
+    if (count == capacity) {
+      hal::safe_throw(hal::resource_unavailable_try_again(nullptr));
+    }
+    items[count++] = p_resource;
+    return *this;
+  }
+
+  [[nodiscard]] constexpr std::span<resource const> list() const
+  {
+    return std::span(items).first(count);
+  }
+};
+
+/**
+ * @brief Resources used by a spi bus routed to a set of pins
+ *
+ * @param p_bus - spi bus number 1-5
+ * @param p_pins - pins the bus is routed to
+ * @return resource_list - the bus and its pins
+ * @throws hal::argument_out_of_domain - if a pin cannot carry its signal on
+ * the bus
+ */
+constexpr resource_list spi_resources(std::uint8_t p_bus,
+                                      spi_pins const& p_pins)
+{
+  if (!is_valid_spi_pins(p_bus, p_pins)) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+
+  resource_list resources;
+  resources.add(peripheral_resource(spi_peripherals[p_bus - 1]));
+  for (auto const& pin : { p_pins.clock, p_pins.data_in, p_pins.data_out }) {
+    resources.add(pin_resource(pin.port, pin.pin));
+  }
+  return resources;
+}
+
+/**
+ * @brief Resources used by a spi bus on its default pins
+ *
+ * @param p_bus - spi bus number 1-5
+ * @return resource_list - the bus and its pins
+ */
+constexpr resource_list spi_resources(std::uint8_t p_bus)
+{
+  if (p_bus < 1 || p_bus > spi_bus_count) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+  return spi_resources(p_bus, default_spi_pins[p_bus - 1]);
+}
+
+/**
+ * @return resource_list - resources used by the `scheduler`
+ */
+constexpr resource_list scheduler_resources()
+{
+  resource_list resources;
+  resources.add(peripheral_resource(peripheral::timer5))
+    .add(irq_resource(irq::tim5));
+  return resources;
+}
+
+/**
+ * @brief Find a resource used by more than one driver
+ *
+ * Evaluated at compile time, this checks a statically declared board:
+ *
+ *     constexpr std::array board{
+ *       hal::stm32f4::spi_resources(1),
+ *       hal::stm32f4::spi_resources(3),
+ *       hal::stm32f4::scheduler_resources(),
+ *     };
+ *     static_assert(!hal::stm32f4::find_resource_conflict(board));
+ *
+ * @param p_lists - resources of each driver
+ * @return std::optional<resource> - a resource listed twice, or std::nullopt
+ */
+constexpr std::optional<resource> find_resource_conflict(
+  std::span<resource_list const> p_lists)
+{
+  for (std::size_t i = 0; i < p_lists.size(); i++) {
+    for (std::size_t j = 0; j < p_lists[i].count; j++) {
+      auto const candidate = p_lists[i].items[j];
+      // Compare with every resource listed after this one
+      for (std::size_t k = i; k < p_lists.size(); k++) {
+        auto const first = k == i ? j + 1 : 0;
+        for (std::size_t m = first; m < p_lists[k].count; m++) {
+          if (p_lists[k].items[m] == candidate) {
+            return candidate;
+          }
+        }
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+/**
+ * @brief Take a resource if no one else has
+ *
+ * Safe to call from interrupts.
+ *
+ * @param p_resource - resource to take
+ * @return true - the resource was free and is now taken
+ */
+bool try_claim_resource(resource p_resource);
+
+/**
+ * @brief Give back a resource taken with `try_claim_resource()`
+ *
+ * @param p_resource - resource to give back
+ */
+void release_resource(resource p_resource);
+
+/**
+ * @param p_resource - resource to check
+ * @return true - a driver is using the resource
+ */
+[[nodiscard]] bool is_resource_claimed(resource p_resource);
+
+/**
+ * @brief Exclusive use of a list of resources, for the lifetime of the object
+ *
+ * Drivers hold one for the resources they were constructed with, so that two
+ * drivers configured to use the same pin or peripheral fail to construct
+ * instead of silently reconfiguring each other's hardware.
+ */
+class resource_claim
+{
+public:
+  /// Holds no resources
+  resource_claim() = default;
+
+  /**
+   * @brief Take every resource of a list, or none
+   *
+   * @param p_resources - resources to take
+   * @throws hal::device_or_resource_busy - if a resource is already taken
+   */
+  explicit resource_claim(resource_list const& p_resources);
+
+  /**
+   * @brief Take every resource of a list, or none, without throwing
+   *
+   * @param p_resources - resources to take
+   * @return std::optional<resource_claim> - the claim, std::nullopt if a
+   * resource is already taken
+   */
+  [[nodiscard]] static std::optional<resource_claim> try_claim(
+    resource_list const& p_resources) noexcept;
+
+  resource_claim(resource_claim const&) = delete;
+  resource_claim& operator=(resource_claim const&) = delete;
+  resource_claim(resource_claim&& p_other) noexcept;
+  resource_claim& operator=(resource_claim&& p_other) noexcept;
+
+  /// Give back the resources
+  ~resource_claim();
+
+private:
+  bool claim(resource_list const& p_resources) noexcept;
+  void release() noexcept;
+
+  resource_list m_resources{};
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,210 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <libhal/functional.hpp>
+#include <libhal/initializers.hpp>
+#include <libhal/steady_clock.hpp>
+#include <libhal/units.hpp>
+
+#include "clock.hpp"
+#include "resources.hpp"
+
+/// Maximum number of tasks queued in the scheduler at once
+#if !defined(LIBHAL_STM32F4_SCHEDULER_CAPACITY)
+#define LIBHAL_STM32F4_SCHEDULER_CAPACITY 16
+#endif
+
+namespace hal::stm32f4 {
+/// Settings of a `scheduler`
+struct scheduler_settings
+{
+  /// Rate of the counter, the resolution of deadlines
+  hal::hertz tick_rate = 1'000'000.0f;
+};
+
+/**
+ * @brief Tickless run-to-completion task scheduler
+ *
+ * Tasks are callbacks queued to run at a deadline, once or periodically. Due
+ * tasks run one after the other, each to completion, in deadline order. While
+ * nothing is due, `run()` programs a TIM5 compare for the earliest deadline
+ * and sleeps with WFI, so the core wakes exactly when the next task is due
+ * instead of on a periodic tick.
+ *
+ * TIM5 runs freely as a 32-bit counter, extended to 64 bits in its overflow
+ * interrupt. The scheduler is also a `hal::steady_clock` reading that counter,
+ * so it can be handed to anything needing one.
+ *
+ * After every `set_clock_profile()` the TIM5 prescaler is recomputed for the
+ * new timer clock and the counter carries on from where it was, so
+ * `uptime()` stays continuous and `frequency()` reports the new tick rate.
+ * Deadlines are kept in ticks, so they only move if the new timer clock
+ * cannot give the same tick rate.
+ *
+ * Tasks may be posted or cancelled from interrupts. Only one scheduler may
+ * exist at a time.
+ */
+class scheduler : public hal::steady_clock
+{
+public:
+  /// Maximum number of queued tasks
+  static constexpr std::size_t capacity = LIBHAL_STM32F4_SCHEDULER_CAPACITY;
+
+  /// Identifies a queued task, never 0
+  using task_id = std::uint32_t;
+  using task = hal::callback<void()>;
+
+  using settings = scheduler_settings;
+
+  /**
+   * @brief Start TIM5 and take over its interrupt
+   *
+   * @param p_settings - scheduler settings
+   * @throws hal::operation_not_supported - if the tick rate cannot be
+   * derived from the timer clock
+   * @throws hal::device_or_resource_busy - if TIM5 or its interrupt is used
+   * by another driver
+   */
+  scheduler(hal::runtime, settings const& p_settings = {});
+
+  scheduler(scheduler& p_other) = delete;
+  scheduler& operator=(scheduler& p_other) = delete;
+  scheduler(scheduler&& p_other) noexcept = delete;
+  scheduler& operator=(scheduler&& p_other) noexcept = delete;
+
+  /**
+   * @brief Stop TIM5, dropping every queued task
+   */
+  ~scheduler() override;
+
+  /**
+   * @brief Queue a task to run as soon as possible
+   *
+   * @param p_task - task to run once
+   * @return task_id - id of the queued task
+   * @throws hal::resource_unavailable_try_again - if `capacity` tasks are
+   * already queued
+   */
+  task_id post(task p_task);
+
+  /**
+   * @brief Queue a task to run once a delay has passed
+   *
+   * @param p_delay - time to wait, rounded up to a tick
+   * @param p_task - task to run once
+   * @return task_id - id of the queued task
+   * @throws hal::resource_unavailable_try_again - if `capacity` tasks are
+   * already queued
+   */
+  task_id post_after(hal::time_duration p_delay, task p_task);
+
+  /**
+   * @brief Queue a task to run periodically, starting one period from now
+   *
+   * Deadlines are spaced by exactly one period, so a late run does not delay
+   * the following ones. The task runs until cancelled.
+   *
+   * @param p_period - time between runs, rounded up to a tick
+   * @param p_task - task to run
+   * @return task_id - id of the queued task
+   * @throws hal::argument_out_of_domain - if the period is shorter than a tick
+   * @throws hal::resource_unavailable_try_again - if `capacity` tasks are
+   * already queued
+   */
+  task_id post_every(hal::time_duration p_period, task p_task);
+
+  /**
+   * @brief Remove a task from the queue
+   *
+   * A task may cancel itself while running, which stops a periodic task.
+   *
+   * @param p_id - id of the task
+   * @return true - the task was queued and will not run again
+   */
+  bool cancel(task_id p_id);
+
+  /**
+   * @return std::size_t - number of queued tasks
+   */
+  [[nodiscard]] std::size_t pending() const;
+
+  /**
+   * @brief Run every task that is due, without waiting
+   *
+   * @return true - tasks are still queued
+   */
+  bool run_due();
+
+  /**
+   * @brief Run tasks as they become due until the queue is empty
+   *
+   * Sleeps with WFI until the next deadline, or until an interrupt posts a
+   * task.
+   */
+  void run();
+
+  /**
+   * @brief Program the TIM5 compare to wake the core at a tick
+   *
+   * Lets other run loops driven by this clock, such as an `executor`, sleep
+   * with WFI until a deadline. Only the lower 32 bits are compared, so a
+   * deadline past the next counter overflow wakes the core early.
+   *
+   * @param p_deadline - `uptime()` at which to wake
+   * @return true - the deadline is still ahead and the core may sleep
+   */
+  bool wake_at(std::uint64_t p_deadline);
+
+private:
+  struct entry
+  {
+    task handler{};
+    std::uint64_t deadline = 0;
+    /// Ticks between runs, 0 for tasks that run once
+    std::uint64_t period = 0;
+    std::uint16_t generation = 0;
+    bool used = false;
+    bool running = false;
+    bool cancelled = false;
+  };
+
+  hal::hertz driver_frequency() override;
+  std::uint64_t driver_uptime() override;
+
+  std::uint64_t to_ticks(hal::time_duration p_duration) const;
+  task_id insert(std::uint64_t p_deadline,
+                 std::uint64_t p_period,
+                 task&& p_task);
+  void enqueue(std::uint8_t p_slot);
+  void retime();
+  static void handle_interrupt();
+
+  resource_claim m_resources;
+  std::array<entry, capacity> m_entries{};
+  /// Slots of queued tasks, ordered by deadline
+  std::array<std::uint8_t, capacity> m_order{};
+  std::size_t m_count = 0;
+  std::uint32_t volatile m_epoch = 0;
+  hal::hertz m_tick_rate = 0.0f;
+  /// Tick rate asked for, kept to re-time after clock changes
+  hal::hertz m_requested_tick_rate = 0.0f;
+  clock_change_listener m_clock_listener{ [this]() { retime(); } };
+};
+}  // namespace hal::stm32f4
@@ -14,53 +14,264 @@
 
 #pragma once
 
+#include <array>
 #include <cstdint>
 
 #include <span>
+#include <system_error>
 
+#include <libhal/functional.hpp>
 #include <libhal/initializers.hpp>
+#include <libhal/output_pin.hpp>
 #include <libhal/spi.hpp>
 
+#include "clock.hpp"
 #include "constants.hpp"
 #include "pin.hpp"
+#include "ramfunc.hpp"
+#include "resources.hpp"
+#include "spi_pins.hpp"
+#include "spi_segment.hpp"
 
 namespace hal::stm32f4 {
+/**
+ * @brief Spi controller driver
+ *
+ * The baud rate prescaler is recomputed after every `set_clock_profile()`, so
+ * the bus keeps the clock rate closest to the configured one, but never above
+ * it, whatever the clock tree.
+ *
+ * `transfer()` exchanges one byte at a time, waiting for each received byte
+ * before sending the next, so interrupts can never make it lose data.
+ * `transaction()` writes the next byte while the previous one is shifting to
+ * keep the clock running. It therefore tolerates interrupts holding off the
+ * cpu for at most one byte time, 8 clock periods (1us at 8MHz). Longer, and
+ * received bytes are dropped, which `transaction()` reports.
+ */
 class spi : public hal::spi
 {
 public:
   /**
-   * @brief Construct a new spi object
+   * @brief Called from the dma interrupt with the half of the stream buffer
+   * that was just sent
+   *
+   * The half may be refilled while the other half is sent, until the dma
+   * wraps around to it again.
+   */
+  using stream_handler = hal::callback<void(std::span<hal::byte>)>;
+
+  /**
+   * @brief Construct a new spi object using the bus's default pins
+   *
+   * See `default_spi_pins` for the pins used by each bus.
    *
    * @param p_bus SPI bus number 1-5
    * @param p_settings
+   * @throws hal::operation_not_supported - if the bus number is invalid
+   * @throws hal::device_or_resource_busy - if the bus or one of its pins is
+   * used by another driver
    */
   spi(hal::runtime, std::uint8_t p_bus, spi::settings const& p_settings = {});
 
+  /**
+   * @brief Construct a new spi object routed to specific pins
+   *
+   * Use `checked_spi_pins()` to validate the pins at compile time.
+   *
+   * @param p_bus SPI bus number 1-5
+   * @param p_pins - pins to route the bus to, see `spi_routes`
+   * @param p_settings
+   * @throws hal::operation_not_supported - if the bus number is invalid
+   * @throws hal::argument_out_of_domain - if a pin cannot carry its signal on
+   * the bus
+   * @throws hal::device_or_resource_busy - if the bus or one of its pins is
+   * used by another driver
+   */
+  spi(hal::runtime,
+      std::uint8_t p_bus,
+      spi_pins const& p_pins,
+      spi::settings const& p_settings = {});
+
+  /**
+   * @brief Construct a new spi object routed to specific pins, without
+   * throwing
+   *
+   * For firmware built without exception support: reports errors through
+   * `p_error` and, unlike the other constructors, references no exception
+   * machinery. Pass the results of `checked_spi_pins()` and
+   * `checked_spi_settings()` to rule out every error but a busy resource at
+   * compile time.
+   *
+   * If construction fails, nothing is claimed or powered on and the object
+   * may only be destroyed.
+   *
+   * @param p_bus SPI bus number 1-5
+   * @param p_pins - pins to route the bus to, see `spi_routes`
+   * @param p_settings
+   * @param p_error - set to `std::errc{}` on success, otherwise to
+   * `operation_not_supported` if the bus number is invalid or the clock rate
+   * is too slow, `argument_out_of_domain` if a pin cannot carry its signal on
+   * the bus, or `device_or_resource_busy` if the bus or one of its pins is used
+   * by another driver
+   */
+  spi(hal::runtime,
+      std::uint8_t p_bus,
+      spi_pins const& p_pins,
+      spi::settings const& p_settings,
+      std::errc& p_error) noexcept;
+
   spi(spi& p_other) = delete;
   spi& operator=(spi& p_other) = delete;
   spi(spi&& p_other) noexcept = delete;
   spi& operator=(spi&& p_other) noexcept = delete;
   ~spi();
 
+  /**
+   * @brief Exchange a list of segments back to back
+   *
+   * Unlike a series of `transfer()` calls, the bus does not go idle between
+   * segments, so a command, address and payload are sent without gaps.
+   *
+   * If an interrupt holds off the cpu for longer than one byte time, the
+   * controller overruns and drops received bytes. The transaction then lets
+   * the bus finish, leaves the `data_in` bytes that were dropped untouched
+   * and carries on with the rest of the segments.
+   *
+   * @param p_segments - segments to exchange, in order
+   * @return true - every received byte was stored
+   * @return false - an overrun dropped received bytes
+   */
+  HAL_STM32F4_RAMFUNC bool transaction(
+    std::span<spi_segment const> p_segments) noexcept;
+
+  /**
+   * @brief Exchange a list of segments within one chip select assertion
+   *
+   * @param p_chip_select - driven low for the whole transaction and driven
+   * high once the last byte has been shifted out
+   * @param p_segments - segments to exchange, in order
+   * @return true - every received byte was stored
+   * @return false - an overrun dropped received bytes, see `transaction()`
+   */
+  bool transaction(hal::output_pin& p_chip_select,
+                   std::span<spi_segment const> p_segments);
+
+  /**
+   * @brief Send a buffer over and over, without gaps
+   *
+   * A circular dma stream feeds the bus, so bytes follow each other at the
+   * full clock rate until `stop_stream()`, as needed by DAC chains or LED
+   * strips. Once the first half of the buffer is sent, `p_on_sent` is called
+   * with it, then with the second half, and so on: refilling each half when
+   * it is passed keeps the output continuous. Received bytes are discarded.
+   *
+   * A running stream is stopped first. `transfer()` and `transaction()` must
+   * not be used while streaming. A clock profile switched to while streaming
+   * leaves the prescaler as is, so the stream runs at the rate the new clock
+   * gives it; the bus is re-timed by `stop_stream()`.
+   *
+   * @param p_buffer - circular buffer, its size must be even, up to 65534
+   * @param p_on_sent - called with each half of the buffer once sent
+   * @throws hal::argument_out_of_domain - if the buffer size is invalid
+   * @throws hal::device_or_resource_busy - if no dma stream is free for the
+   * bus
+   */
+  void start_stream(std::span<hal::byte> p_buffer, stream_handler p_on_sent);
+
+  /**
+   * @brief Stop streaming once the byte being shifted out is complete
+   *
+   * Releases the dma stream and applies the prescaler of a clock profile
+   * switched to while streaming. No callback is made for the partially sent
+   * half. Does nothing if no stream is running.
+   */
+  void stop_stream();
+
+  /**
+   * @return true - the bus is sending the stream buffer
+   */
+  [[nodiscard]] bool streaming() const;
+
+  using hal::spi::configure;
+
+  /**
+   * @brief Configure the bus without throwing
+   *
+   * @param p_settings - settings to apply
+   * @param p_error - set to `std::errc{}` on success, or to
+   * `operation_not_supported`, leaving the bus untouched, if the clock rate is
+   * too slow
+   */
+  void configure(settings const& p_settings, std::errc& p_error) noexcept;
+
 private:
-  /// Information used to configure the spi bus
-  struct bus_info
-  {
-    /// peripheral id used to power on the spi peripheral at creation
-    peripheral peripheral_id;
-    /// spi data pin
-    pin clock;
-    /// spi clock pin
-    pin data_out;
-    /// spi clock pin
-    pin data_in;
-  };
   void driver_configure(settings const& p_settings) override;
-  void driver_transfer(std::span<hal::byte const> p_data_out,
-                       std::span<hal::byte> p_data_in,
-                       hal::byte p_filler) override;
+  HAL_STM32F4_RAMFUNC void driver_transfer(
+    std::span<hal::byte const> p_data_out,
+    std::span<hal::byte> p_data_in,
+    hal::byte p_filler) noexcept override;
+  HAL_STM32F4_RAMFUNC bool run(std::span<spi_segment const> p_segments,
+                               bool p_pipelined) noexcept;
+  std::errc initialize(std::uint8_t p_bus,
+                       spi_pins const& p_pins,
+                       spi::settings const& p_settings) noexcept;
+  void retime();
+  void handle_stream_interrupt();
 
-  peripheral m_peripheral_id;
-  void* m_peripheral_register;
+  /// Routes of the clock, data in and data out signals
+  std::array<spi_route, 3> m_routes{};
+  resource_claim m_resources;
+  peripheral m_peripheral_id{};
+  /// nullptr until constructed successfully
+  void* m_peripheral_register = nullptr;
+  /// Configured clock rate, restored as closely as possible on clock changes
+  hal::hertz m_clock_rate = 0.0f;
+  clock_change_listener m_clock_listener{ [this]() { retime(); } };
+  std::span<hal::byte> m_stream_buffer{};
+  stream_handler m_on_sent{};
+  std::uint8_t m_bus = 0;
+  std::uint8_t m_dma_controller = 0;
+  std::uint8_t m_dma_stream = 0;
+  std::uint8_t m_dma_channel = 0;
+  bool m_streaming = false;
+  /// The clock changed while streaming, re-time once the stream stops
+  bool m_retime_pending = false;
 };
+
+namespace internal {
+/// Never defined: calling them in a constant expression reports the error
+void spi_bus_number_out_of_range();
+void spi_clock_rate_out_of_reach();
+}  // namespace internal
+
+/**
+ * @brief Validate spi settings at compile time
+ *
+ * Compilation fails with an error mentioning `spi_clock_rate_out_of_reach` if
+ * the bus cannot run as slow as the clock rate with the clock tree of the
+ * profile.
+ *
+ *     constexpr auto settings = checked_spi_settings(
+ *       1, { .clock_rate = 1'000'000.0f }, hsi_pll_100mhz_profile);
+ *
+ * @param p_bus - spi bus number 1-5
+ * @param p_settings - settings to validate
+ * @param p_profile - clock profile the bus will run with
+ * @return consteval hal::spi::settings - p_settings
+ */
+consteval hal::spi::settings checked_spi_settings(
+  std::uint8_t p_bus,
+  hal::spi::settings p_settings,
+  clock_profile const& p_profile = hsi_16mhz_profile)
+{
+  if (p_bus < 1 || p_bus > spi_bus_count) {
+    internal::spi_bus_number_out_of_range();
+  }
+  auto const input_clock = clock_rate(spi_peripherals[p_bus - 1],
+                                      calculate_clock_rates(p_profile));
+  if (!(input_clock / p_settings.clock_rate < 257.0f)) {
+    internal::spi_clock_rate_out_of_reach();
+  }
+  return p_settings;
+}
 }  // namespace hal::stm32f4
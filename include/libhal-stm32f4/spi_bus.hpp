@@ -0,0 +1,224 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include <span>
+
+#include <libhal/functional.hpp>
+#include <libhal/initializers.hpp>
+#include <libhal/output_pin.hpp>
+#include <libhal/spi.hpp>
+#include <libhal/units.hpp>
+
+#include "clock.hpp"
+#include "constants.hpp"
+#include "pin.hpp"
+#include "resources.hpp"
+#include "spi_pins.hpp"
+#include "spi_segment.hpp"
+
+namespace hal::stm32f4 {
+/**
+ * @brief Spi bus shared by several devices
+ *
+ * Each device on the bus is a `spi_bus::device`, which implements `hal::spi`
+ * so that existing drivers can use it unchanged. A device's control register
+ * values are computed once when it is configured. Switching between devices
+ * only writes the control registers, and transfers to the device that was
+ * used last do not touch them at all. Devices select themselves with a gpio
+ * chip select, or with the bus's hardware NSS pin.
+ *
+ * Devices recompute their baud rate prescaler after every
+ * `set_clock_profile()`, keeping the clock rate closest to the configured one
+ * without exceeding it, or the slowest one if it is now out of reach.
+ *
+ * Transactions can also be queued from several clients with `enqueue()` and
+ * are run in order by `process()`. Transfers made through a device's
+ * `hal::spi` interface first run any queued transactions, so the bus is
+ * always used in submission order.
+ *
+ * The bus is not safe to use from interrupts.
+ */
+class spi_bus
+{
+public:
+  /// Maximum number of queued transactions
+  static constexpr std::size_t queue_capacity = 8;
+
+  /**
+   * @brief A device on a shared spi bus
+   *
+   * Must not be destroyed while it has queued transactions.
+   */
+  class device : public hal::spi
+  {
+  public:
+    /**
+     * @brief Add a device selected by a gpio chip select to the bus
+     *
+     * @param p_bus - bus the device is connected to
+     * @param p_chip_select - pin driven low while the device is selected.
+     * It is driven high here.
+     * @param p_settings - bus settings of the device
+     */
+    device(spi_bus& p_bus,
+           hal::output_pin& p_chip_select,
+           settings const& p_settings = {});
+
+    /**
+     * @brief Add a device selected by the bus's hardware NSS pin
+     *
+     * @param p_bus - bus the device is connected to
+     * @param p_settings - bus settings of the device
+     * @throws hal::operation_not_supported - if the bus was not given an NSS
+     * pin
+     */
+    device(spi_bus& p_bus, settings const& p_settings = {});
+
+    device(device& p_other) = delete;
+    device& operator=(device& p_other) = delete;
+    device(device&& p_other) noexcept = delete;
+    device& operator=(device&& p_other) noexcept = delete;
+    ~device() override;
+
+    /**
+     * @brief Exchange a list of segments within one chip select assertion
+     *
+     * Queued transactions are run first. The bus does not go idle between
+     * segments, so, as with `spi::transaction()`, interrupts holding off the
+     * cpu for longer than one byte time drop received bytes. `transfer()`
+     * and queued transactions exchange one byte at a time and cannot.
+     *
+     * @param p_segments - segments to exchange, in order
+     * @return true - every received byte was stored
+     * @return false - an overrun dropped received bytes
+     */
+    bool transaction(std::span<spi_segment const> p_segments);
+
+  private:
+    friend class spi_bus;
+
+    void driver_configure(settings const& p_settings) override;
+    void driver_transfer(std::span<hal::byte const> p_data_out,
+                         std::span<hal::byte> p_data_in,
+                         hal::byte p_filler) override;
+    void retime();
+
+    spi_bus* m_bus;
+    hal::output_pin* m_chip_select;
+    /// Control register 1 value with the peripheral disabled
+    std::uint32_t m_control1 = 0;
+    std::uint32_t m_control2 = 0;
+    /// Requested clock rate, kept to re-time after clock changes
+    hal::hertz m_clock_rate = 0.0f;
+    clock_change_listener m_clock_listener{ [this]() { retime(); } };
+  };
+
+  /// A transfer waiting in the queue
+  struct transaction
+  {
+    /// Device to transfer with
+    device* target = nullptr;
+    /// Bytes to send, followed by `filler`
+    std::span<hal::byte const> data_out{};
+    /// Received bytes, must stay valid until the transaction completes
+    std::span<hal::byte> data_in{};
+    hal::byte filler = hal::spi::default_filler;
+    /// Called once the transaction has completed, may be empty
+    hal::callback<void()> on_complete{};
+  };
+
+  /**
+   * @brief Construct a shared bus using the bus's default pins
+   *
+   * @param p_bus - spi bus number 1-5
+   * @throws hal::operation_not_supported - if the bus number is invalid
+   * @throws hal::device_or_resource_busy - if the bus or one of its pins is
+   * used by another driver
+   */
+  spi_bus(hal::runtime, std::uint8_t p_bus);
+
+  /**
+   * @brief Construct a shared bus routed to specific pins
+   *
+   * @param p_bus - spi bus number 1-5
+   * @param p_pins - pins to route the bus to
+   * @param p_hardware_chip_select - NSS pin used by devices constructed
+   * without a gpio chip select. NSS is low while the peripheral is enabled.
+   * @throws hal::operation_not_supported - if the bus number is invalid
+   * @throws hal::argument_out_of_domain - if a pin cannot carry its signal on
+   * the bus
+   * @throws hal::device_or_resource_busy - if the bus or one of its pins is
+   * used by another driver
+   */
+  spi_bus(hal::runtime,
+          std::uint8_t p_bus,
+          spi_pins const& p_pins,
+          std::optional<spi_pin> p_hardware_chip_select = std::nullopt);
+
+  spi_bus(spi_bus& p_other) = delete;
+  spi_bus& operator=(spi_bus& p_other) = delete;
+  spi_bus(spi_bus&& p_other) noexcept = delete;
+  spi_bus& operator=(spi_bus&& p_other) noexcept = delete;
+  ~spi_bus();
+
+  /**
+   * @brief Queue a transaction to be run by `process()`
+   *
+   * @param p_transaction - transaction to queue
+   * @throws hal::argument_out_of_domain - if the transaction has no device or
+   * its device is on another bus
+   * @throws hal::resource_unavailable_try_again - if the queue is full
+   */
+  void enqueue(transaction p_transaction);
+
+  /**
+   * @brief Run all queued transactions in the order they were queued
+   *
+   * Transactions queued by completion callbacks are run too.
+   */
+  void process();
+
+  /**
+   * @return std::size_t - number of queued transactions
+   */
+  [[nodiscard]] std::size_t pending() const;
+
+private:
+  void select(device& p_device);
+  bool run(device& p_device,
+           std::span<spi_segment const> p_segments,
+           bool p_pipelined);
+  void use_clock_rate(hal::hertz p_clock_rate);
+  void forget(device& p_device);
+
+  std::array<spi_route, 4> m_routes;
+  std::size_t m_route_count;
+  resource_claim m_resources;
+  std::array<transaction, queue_capacity> m_queue{};
+  std::size_t m_queue_head = 0;
+  std::size_t m_queue_size = 0;
+  device* m_active = nullptr;
+  std::uint32_t m_control2 = 0;
+  pin_speed m_pin_speed = pin_speed::low;
+  peripheral m_peripheral_id;
+  void* m_peripheral_register;
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,163 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <span>
+
+#include <libhal/functional.hpp>
+#include <libhal/initializers.hpp>
+#include <libhal/spi.hpp>
+#include <libhal/units.hpp>
+
+#include "clock.hpp"
+#include "constants.hpp"
+#include "resources.hpp"
+#include "spi_pins.hpp"
+
+namespace hal::stm32f4 {
+/**
+ * @brief Continuous receive-only spi capture into a circular buffer
+ *
+ * Puts a spi bus into receive-only mode, where the controller clocks SCK
+ * continuously without sending anything, and lets a dma stream land the
+ * received bytes in a circular buffer. The CPU is only involved once per
+ * half buffer, which is enough to stream from devices such as ADCs at the
+ * full bus rate.
+ *
+ * MOSI is not used and its pin is left untouched. Devices that need a chip
+ * select should be selected before `start()` and released after `stop()`.
+ *
+ * The baud rate prescaler is recomputed after every `set_clock_profile()`.
+ * A running capture keeps clocking with its previous prescaler, which may
+ * now give a different rate, until it is restarted.
+ *
+ * Construction enables the DWT cycle counter (see `enable_cycle_counter()`),
+ * which `stop()` uses to time one SPI clock.
+ */
+class spi_capture
+{
+public:
+  /**
+   * @brief Called from the dma interrupt with the half of the buffer that was
+   * just filled
+   *
+   * The first half is passed once it is full, then the second half, and so
+   * on. The half must be consumed before the dma wraps around to it again.
+   */
+  using handler = hal::callback<void(std::span<hal::byte const>)>;
+
+  /**
+   * @brief Construct a capture on a bus's default pins
+   *
+   * @param p_bus - spi bus number 1-5
+   * @param p_buffer - circular buffer, its size must be even, up to 65534
+   * @param p_on_data - called with each half of the buffer once filled
+   * @param p_settings - bus settings
+   * @throws hal::operation_not_supported - if the bus number or clock rate is
+   * invalid
+   * @throws hal::argument_out_of_domain - if the buffer size is invalid
+   * @throws hal::device_or_resource_busy - if no dma stream is free for the
+   * bus, or the bus or one of its pins is used by another driver
+   */
+  spi_capture(hal::runtime,
+              std::uint8_t p_bus,
+              std::span<hal::byte> p_buffer,
+              handler p_on_data,
+              hal::spi::settings const& p_settings = {});
+
+  /**
+   * @brief Construct a capture routed to specific pins
+   *
+   * @param p_bus - spi bus number 1-5
+   * @param p_pins - pins to route the bus to, `data_out` is not used
+   * @param p_buffer - circular buffer, its size must be even, up to 65534
+   * @param p_on_data - called with each half of the buffer once filled
+   * @param p_settings - bus settings
+   * @throws hal::operation_not_supported - if the bus number or clock rate is
+   * invalid
+   * @throws hal::argument_out_of_domain - if the buffer size is invalid or a
+   * pin cannot carry its signal on the bus
+   * @throws hal::device_or_resource_busy - if no dma stream is free for the
+   * bus, or the bus or one of its pins is used by another driver
+   */
+  spi_capture(hal::runtime,
+              std::uint8_t p_bus,
+              spi_pins const& p_pins,
+              std::span<hal::byte> p_buffer,
+              handler p_on_data,
+              hal::spi::settings const& p_settings = {});
+
+  spi_capture(spi_capture& p_other) = delete;
+  spi_capture& operator=(spi_capture& p_other) = delete;
+  spi_capture(spi_capture&& p_other) noexcept = delete;
+  spi_capture& operator=(spi_capture&& p_other) noexcept = delete;
+
+  /**
+   * @brief Stop capturing and release the bus and dma stream
+   */
+  ~spi_capture();
+
+  /**
+   * @brief Start clocking bytes into the buffer from its beginning
+   *
+   * Does nothing if the capture is already running.
+   */
+  void start();
+
+  /**
+   * @brief Stop clocking without cutting a byte short
+   *
+   * Follows the reference manual's procedure for disabling a receive-only
+   * master: wait for a byte to be received, wait one more SPI clock, timed
+   * with the DWT cycle counter, then disable the peripheral and wait for the
+   * final byte. Interrupts are masked until the peripheral is disabled, for
+   * up to one byte time. No callbacks are made for the partially filled half.
+   * Does nothing if the capture is not running.
+   */
+  void stop();
+
+  /**
+   * @return true - the bus is clocking bytes into the buffer
+   */
+  [[nodiscard]] bool running() const;
+
+private:
+  void handle_interrupt();
+  void retime();
+  [[nodiscard]] std::uint32_t clock_cycles(std::uint32_t p_control1) const;
+
+  /// Routes of the clock and data in signals
+  std::array<spi_route, 2> m_routes;
+  resource_claim m_resources;
+  std::span<hal::byte> m_buffer;
+  handler m_on_data;
+  peripheral m_peripheral_id;
+  void* m_peripheral_register;
+  /// Control register 1 value with the peripheral disabled
+  std::uint32_t m_control1 = 0;
+  /// CPU cycles in one SPI clock period
+  std::uint32_t m_clock_cycles = 0;
+  /// Requested clock rate, kept to re-time after clock changes
+  hal::hertz m_clock_rate = 0.0f;
+  std::uint8_t m_dma_controller = 0;
+  std::uint8_t m_dma_stream = 0;
+  std::uint8_t m_dma_channel = 0;
+  bool m_running = false;
+  clock_change_listener m_clock_listener{ [this]() { retime(); } };
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,195 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include <span>
+
+#include <libhal/functional.hpp>
+#include <libhal/initializers.hpp>
+#include <libhal/output_pin.hpp>
+#include <libhal/spi.hpp>
+#include <libhal/units.hpp>
+
+#include "clock.hpp"
+#include "constants.hpp"
+#include "resources.hpp"
+#include "spi_pins.hpp"
+
+namespace hal::stm32f4 {
+/**
+ * @brief Runs dma transfers on several spi buses at the same time
+ *
+ * `hal::stm32f4::spi` blocks until its transfer is done, so only one bus is
+ * ever active. The engine instead starts a transfer on a bus and returns
+ * right away, letting transfers on other buses run in parallel. The caller
+ * then waits for any or all of them, sleeping with WFI in the meantime.
+ *
+ * Each bus needs a receive and a transmit dma stream. Some buses can only be
+ * served by streams another bus also needs (for example SPI1, SPI4 and SPI5
+ * all compete for DMA2 streams 0 and 3 to 5), so the streams of all buses are
+ * assigned together when the engine is constructed, in a way that gives every
+ * bus its own streams.
+ *
+ * The baud rate prescalers are recomputed after every `set_clock_profile()`,
+ * once each bus's running transfer is done, so every bus keeps the clock rate
+ * closest to its configured one without exceeding it.
+ *
+ * Transfers are not started or waited on from interrupts.
+ */
+class spi_engine
+{
+public:
+  /// A bus run by the engine
+  struct bus_settings
+  {
+    /// spi bus number 1-5
+    std::uint8_t bus;
+    /// Pins to route the bus to, the bus's default pins if not set
+    std::optional<spi_pins> pins = std::nullopt;
+    hal::spi::settings settings = {};
+  };
+
+  /**
+   * @brief Take control of a set of spi buses
+   *
+   * @param p_buses - buses to run, each bus at most once
+   * @throws hal::operation_not_supported - if a bus number or clock rate is
+   * invalid
+   * @throws hal::argument_out_of_domain - if a bus is listed twice or a pin
+   * cannot carry its signal on its bus
+   * @throws hal::device_or_resource_busy - if the dma streams cannot be
+   * assigned because other drivers are using them, or a bus or one of its
+   * pins is used by another driver
+   */
+  spi_engine(hal::runtime, std::span<bus_settings const> p_buses);
+
+  spi_engine(spi_engine& p_other) = delete;
+  spi_engine& operator=(spi_engine& p_other) = delete;
+  spi_engine(spi_engine&& p_other) noexcept = delete;
+  spi_engine& operator=(spi_engine&& p_other) noexcept = delete;
+
+  /**
+   * @brief Wait for all transfers, then release the buses and dma streams
+   */
+  ~spi_engine();
+
+  /**
+   * @brief Start a transfer on a bus and return without waiting for it
+   *
+   * The buffers must stay valid until the transfer is done.
+   *
+   * @param p_bus - spi bus number 1-5
+   * @param p_data_out - bytes to send, followed by p_filler
+   * @param p_data_in - received bytes, extra bytes are dropped
+   * @param p_filler - byte sent once p_data_out is exhausted
+   * @param p_chip_select - if set, driven low until the transfer is done
+   * @throws hal::argument_out_of_domain - if the bus is not run by the engine
+   * @throws hal::device_or_resource_busy - if the bus is still transferring
+   */
+  void start(std::uint8_t p_bus,
+             std::span<hal::byte const> p_data_out,
+             std::span<hal::byte> p_data_in,
+             hal::byte p_filler = hal::spi::default_filler,
+             hal::output_pin* p_chip_select = nullptr);
+
+  /**
+   * @brief Call a handler whenever a transfer on a bus finishes
+   *
+   * The handler is called from the dma interrupt, or from `start()` for
+   * empty transfers, before the transfer is reported by `wait_any()`.
+   *
+   * @param p_bus - spi bus number 1-5
+   * @param p_handler - called once each transfer is done, may be empty
+   * @throws hal::argument_out_of_domain - if the bus is not run by the engine
+   */
+  void on_finished(std::uint8_t p_bus, hal::callback<void()> p_handler);
+
+  /**
+   * @param p_bus - spi bus number 1-5
+   * @return true - a transfer is still running on the bus
+   * @throws hal::argument_out_of_domain - if the bus is not run by the engine
+   */
+  [[nodiscard]] bool busy(std::uint8_t p_bus) const;
+
+  /**
+   * @brief Wait for a transfer to finish
+   *
+   * Each finished transfer is reported once.
+   *
+   * @return std::uint8_t - bus number of a finished transfer, or 0 if there
+   * are no transfers left to report
+   */
+  std::uint8_t wait_any();
+
+  /**
+   * @brief Wait for every transfer to finish
+   *
+   * Marks all finished transfers as reported.
+   */
+  void wait_all();
+
+private:
+  /// A dma stream and the channel connecting it to the bus's requests,
+  /// controller 0 until claimed
+  struct stream_id
+  {
+    std::uint8_t controller = 0;
+    std::uint8_t stream = 0;
+    std::uint8_t channel = 0;
+  };
+
+  struct channel
+  {
+    std::array<spi_route, 3> routes{};
+    resource_claim resources{};
+    std::span<hal::byte const> data_out{};
+    std::span<hal::byte> data_in{};
+    /// Bytes transferred by previous phases
+    std::size_t position = 0;
+    /// Bytes transferred by the running phase
+    std::size_t phase_length = 0;
+    hal::output_pin* chip_select = nullptr;
+    hal::callback<void()> on_finished{};
+    void* peripheral_register = nullptr;
+    peripheral peripheral_id{};
+    /// Requested clock rate, kept to re-time after clock changes
+    hal::hertz clock_rate = 0.0f;
+    stream_id receive{};
+    stream_id transmit{};
+    std::uint8_t bus = 0;
+    hal::byte filler = 0;
+    /// Destination of received bytes beyond p_data_in
+    hal::byte discard = 0;
+    bool volatile busy = false;
+    bool volatile finished = false;
+  };
+
+  channel& find(std::uint8_t p_bus);
+  void begin_phase(channel& p_channel);
+  void handle_interrupt(channel& p_channel);
+  void finish(channel& p_channel);
+  void release_channels();
+  void retime();
+
+  std::array<channel, spi_bus_count> m_channels{};
+  std::size_t m_channel_count = 0;
+  clock_change_listener m_clock_listener{ [this]() { retime(); } };
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,227 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "constants.hpp"
+#include "pin.hpp"
+
+namespace hal::stm32f4 {
+/// Location of a gpio pin
+struct spi_pin
+{
+  peripheral port;
+  std::uint8_t pin;
+
+  constexpr bool operator==(spi_pin const&) const = default;
+};
+
+/// Pins routed to a spi bus
+struct spi_pins
+{
+  /// SCK
+  spi_pin clock;
+  /// MISO, data into the controller
+  spi_pin data_in;
+  /// MOSI, data out of the controller
+  spi_pin data_out;
+};
+
+/// Signals of a spi bus
+enum class spi_signal : std::uint8_t
+{
+  clock,
+  data_in,
+  data_out,
+  /// NSS, only used by `spi_bus` devices selected in hardware. The spi
+  /// driver selects devices in software and leaves these pins free.
+  chip_select,
+};
+
+/// A pin that can carry a spi signal and the alternate function that routes it
+struct spi_route
+{
+  std::uint8_t bus;
+  spi_signal signal;
+  spi_pin location;
+  pin::pin_function function;
+};
+
+/// Every spi pin route of the stm32f411, from the datasheet alternate function
+/// mapping table. Port E is only bonded out on the 100 pin package.
+inline constexpr std::array spi_routes{
+  // clang-format off
+  spi_route{ 1, spi_signal::chip_select, { peripheral::gpio_a, 4 }, pin::pin_function::alternate5 },
+  spi_route{ 1, spi_signal::chip_select, { peripheral::gpio_a, 15 }, pin::pin_function::alternate5 },
+  spi_route{ 1, spi_signal::clock, { peripheral::gpio_a, 5 }, pin::pin_function::alternate5 },
+  spi_route{ 1, spi_signal::clock, { peripheral::gpio_b, 3 }, pin::pin_function::alternate5 },
+  spi_route{ 1, spi_signal::data_in, { peripheral::gpio_a, 6 }, pin::pin_function::alternate5 },
+  spi_route{ 1, spi_signal::data_in, { peripheral::gpio_b, 4 }, pin::pin_function::alternate5 },
+  spi_route{ 1, spi_signal::data_out, { peripheral::gpio_a, 7 }, pin::pin_function::alternate5 },
+  spi_route{ 1, spi_signal::data_out, { peripheral::gpio_b, 5 }, pin::pin_function::alternate5 },
+
+  spi_route{ 2, spi_signal::chip_select, { peripheral::gpio_b, 9 }, pin::pin_function::alternate5 },
+  spi_route{ 2, spi_signal::chip_select, { peripheral::gpio_b, 12 }, pin::pin_function::alternate5 },
+  spi_route{ 2, spi_signal::clock, { peripheral::gpio_b, 10 }, pin::pin_function::alternate5 },
+  spi_route{ 2, spi_signal::clock, { peripheral::gpio_b, 13 }, pin::pin_function::alternate5 },
+  spi_route{ 2, spi_signal::clock, { peripheral::gpio_c, 7 }, pin::pin_function::alternate5 },
+  spi_route{ 2, spi_signal::clock, { peripheral::gpio_d, 3 }, pin::pin_function::alternate5 },
+  spi_route{ 2, spi_signal::data_in, { peripheral::gpio_b, 14 }, pin::pin_function::alternate5 },
+  spi_route{ 2, spi_signal::data_in, { peripheral::gpio_c, 2 }, pin::pin_function::alternate5 },
+  spi_route{ 2, spi_signal::data_out, { peripheral::gpio_b, 15 }, pin::pin_function::alternate5 },
+  spi_route{ 2, spi_signal::data_out, { peripheral::gpio_c, 3 }, pin::pin_function::alternate5 },
+
+  spi_route{ 3, spi_signal::chip_select, { peripheral::gpio_a, 4 }, pin::pin_function::alternate6 },
+  spi_route{ 3, spi_signal::chip_select, { peripheral::gpio_a, 15 }, pin::pin_function::alternate6 },
+  spi_route{ 3, spi_signal::clock, { peripheral::gpio_b, 3 }, pin::pin_function::alternate6 },
+  spi_route{ 3, spi_signal::clock, { peripheral::gpio_b, 12 }, pin::pin_function::alternate7 },
+  spi_route{ 3, spi_signal::clock, { peripheral::gpio_c, 10 }, pin::pin_function::alternate6 },
+  spi_route{ 3, spi_signal::data_in, { peripheral::gpio_b, 4 }, pin::pin_function::alternate6 },
+  spi_route{ 3, spi_signal::data_in, { peripheral::gpio_c, 11 }, pin::pin_function::alternate6 },
+  spi_route{ 3, spi_signal::data_out, { peripheral::gpio_b, 5 }, pin::pin_function::alternate6 },
+  spi_route{ 3, spi_signal::data_out, { peripheral::gpio_c, 12 }, pin::pin_function::alternate6 },
+  spi_route{ 3, spi_signal::data_out, { peripheral::gpio_d, 6 }, pin::pin_function::alternate5 },
+
+  spi_route{ 4, spi_signal::chip_select, { peripheral::gpio_b, 12 }, pin::pin_function::alternate6 },
+  spi_route{ 4, spi_signal::chip_select, { peripheral::gpio_e, 4 }, pin::pin_function::alternate5 },
+  spi_route{ 4, spi_signal::chip_select, { peripheral::gpio_e, 11 }, pin::pin_function::alternate5 },
+  spi_route{ 4, spi_signal::clock, { peripheral::gpio_b, 13 }, pin::pin_function::alternate6 },
+  spi_route{ 4, spi_signal::clock, { peripheral::gpio_e, 2 }, pin::pin_function::alternate5 },
+  spi_route{ 4, spi_signal::clock, { peripheral::gpio_e, 12 }, pin::pin_function::alternate5 },
+  spi_route{ 4, spi_signal::data_in, { peripheral::gpio_a, 11 }, pin::pin_function::alternate6 },
+  spi_route{ 4, spi_signal::data_in, { peripheral::gpio_e, 5 }, pin::pin_function::alternate5 },
+  spi_route{ 4, spi_signal::data_in, { peripheral::gpio_e, 13 }, pin::pin_function::alternate5 },
+  spi_route{ 4, spi_signal::data_out, { peripheral::gpio_a, 1 }, pin::pin_function::alternate5 },
+  spi_route{ 4, spi_signal::data_out, { peripheral::gpio_e, 6 }, pin::pin_function::alternate5 },
+  spi_route{ 4, spi_signal::data_out, { peripheral::gpio_e, 14 }, pin::pin_function::alternate5 },
+
+  spi_route{ 5, spi_signal::chip_select, { peripheral::gpio_b, 1 }, pin::pin_function::alternate6 },
+  spi_route{ 5, spi_signal::chip_select, { peripheral::gpio_e, 4 }, pin::pin_function::alternate6 },
+  spi_route{ 5, spi_signal::chip_select, { peripheral::gpio_e, 11 }, pin::pin_function::alternate6 },
+  spi_route{ 5, spi_signal::clock, { peripheral::gpio_b, 0 }, pin::pin_function::alternate6 },
+  spi_route{ 5, spi_signal::clock, { peripheral::gpio_e, 2 }, pin::pin_function::alternate6 },
+  spi_route{ 5, spi_signal::clock, { peripheral::gpio_e, 12 }, pin::pin_function::alternate6 },
+  spi_route{ 5, spi_signal::data_in, { peripheral::gpio_a, 12 }, pin::pin_function::alternate6 },
+  spi_route{ 5, spi_signal::data_in, { peripheral::gpio_e, 5 }, pin::pin_function::alternate6 },
+  spi_route{ 5, spi_signal::data_in, { peripheral::gpio_e, 13 }, pin::pin_function::alternate6 },
+  spi_route{ 5, spi_signal::data_out, { peripheral::gpio_a, 10 }, pin::pin_function::alternate6 },
+  spi_route{ 5, spi_signal::data_out, { peripheral::gpio_b, 8 }, pin::pin_function::alternate6 },
+  spi_route{ 5, spi_signal::data_out, { peripheral::gpio_e, 6 }, pin::pin_function::alternate6 },
+  spi_route{ 5, spi_signal::data_out, { peripheral::gpio_e, 14 }, pin::pin_function::alternate6 },
+  // clang-format on
+};
+
+/// Number of spi buses on the stm32f411
+inline constexpr std::uint8_t spi_bus_count = 5;
+
+/// Peripheral of each bus (index 0 is bus 1)
+inline constexpr std::array<peripheral, spi_bus_count> spi_peripherals{
+  peripheral::spi1, peripheral::spi2, peripheral::spi3,
+  peripheral::spi4, peripheral::spi5,
+};
+
+/// Pins used by each bus (index 0 is bus 1) when none are given
+inline constexpr std::array<spi_pins, spi_bus_count> default_spi_pins{
+  spi_pins{ .clock = { peripheral::gpio_a, 5 },
+            .data_in = { peripheral::gpio_a, 6 },
+            .data_out = { peripheral::gpio_a, 7 } },
+  spi_pins{ .clock = { peripheral::gpio_b, 10 },
+            .data_in = { peripheral::gpio_b, 14 },
+            .data_out = { peripheral::gpio_b, 15 } },
+  spi_pins{ .clock = { peripheral::gpio_b, 3 },
+            .data_in = { peripheral::gpio_b, 4 },
+            .data_out = { peripheral::gpio_b, 5 } },
+  spi_pins{ .clock = { peripheral::gpio_b, 13 },
+            .data_in = { peripheral::gpio_a, 11 },
+            .data_out = { peripheral::gpio_a, 1 } },
+  spi_pins{ .clock = { peripheral::gpio_b, 0 },
+            .data_in = { peripheral::gpio_a, 12 },
+            .data_out = { peripheral::gpio_b, 8 } },
+};
+
+/**
+ * @brief Find the route of a spi signal to a pin
+ *
+ * @param p_bus - spi bus number 1-5
+ * @param p_signal - spi signal
+ * @param p_pin - pin to carry the signal
+ * @return constexpr std::optional<spi_route> - route of the signal, or
+ * std::nullopt if the pin cannot carry the signal on that bus
+ */
+constexpr std::optional<spi_route> find_spi_route(std::uint8_t p_bus,
+                                                  spi_signal p_signal,
+                                                  spi_pin p_pin)
+{
+  for (auto const& route : spi_routes) {
+    if (route.bus == p_bus && route.signal == p_signal &&
+        route.location == p_pin) {
+      return route;
+    }
+  }
+  return std::nullopt;
+}
+
+/**
+ * @param p_bus - spi bus number 1-5
+ * @param p_pins - pins to route the bus to
+ * @return true - every pin can carry its signal on the bus
+ */
+constexpr bool is_valid_spi_pins(std::uint8_t p_bus, spi_pins const& p_pins)
+{
+  return find_spi_route(p_bus, spi_signal::clock, p_pins.clock) &&
+         find_spi_route(p_bus, spi_signal::data_in, p_pins.data_in) &&
+         find_spi_route(p_bus, spi_signal::data_out, p_pins.data_out);
+}
+
+namespace internal {
+/// Never defined: calling it in a constant expression reports the error
+void spi_pins_cannot_be_routed_to_bus();
+}  // namespace internal
+
+/**
+ * @brief Validate a spi pin selection at compile time
+ *
+ * Compilation fails with an error mentioning
+ * `spi_pins_cannot_be_routed_to_bus` if a pin cannot carry its signal.
+ *
+ *     constexpr auto pins = checked_spi_pins(
+ *       1,
+ *       { .clock = { peripheral::gpio_b, 3 },
+ *         .data_in = { peripheral::gpio_b, 4 },
+ *         .data_out = { peripheral::gpio_b, 5 } });
+ *     hal::stm32f4::spi bus(hal::runtime{}, 1, pins);
+ *
+ * @param p_bus - spi bus number 1-5
+ * @param p_pins - pins to route the bus to
+ * @return consteval spi_pins - p_pins
+ */
+consteval spi_pins checked_spi_pins(std::uint8_t p_bus, spi_pins p_pins)
+{
+  if (!is_valid_spi_pins(p_bus, p_pins)) {
+    internal::spi_pins_cannot_be_routed_to_bus();
+  }
+  return p_pins;
+}
+
+static_assert(is_valid_spi_pins(1, default_spi_pins[0]));
+static_assert(is_valid_spi_pins(2, default_spi_pins[1]));
+static_assert(is_valid_spi_pins(3, default_spi_pins[2]));
+static_assert(is_valid_spi_pins(4, default_spi_pins[3]));
+static_assert(is_valid_spi_pins(5, default_spi_pins[4]));
+}  // namespace hal::stm32f4
@@ -0,0 +1,42 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <span>
+
+#include <libhal/spi.hpp>
+#include <libhal/units.hpp>
+
+namespace hal::stm32f4 {
+/**
+ * @brief One part of a spi transaction, such as a command, an address or a
+ * payload
+ *
+ * A segment is as long as the longer of its two buffers:
+ *
+ * - write only: leave `data_in` empty, received bytes are dropped
+ * - read only: leave `data_out` empty, `filler` is sent for every byte
+ * - full duplex: provide both, `filler` pads `data_out` if it is shorter
+ */
+struct spi_segment
+{
+  /// Bytes to send
+  std::span<hal::byte const> data_out{};
+  /// Received bytes, extra bytes are dropped
+  std::span<hal::byte> data_in{};
+  /// Byte sent once `data_out` is exhausted
+  hal::byte filler = hal::spi::default_filler;
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,246 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+
+#include <span>
+
+namespace hal::stm32f4 {
+/**
+ * @brief Lock-free single producer, single consumer ring buffer
+ *
+ * Hands elements from one context to another, typically between an interrupt
+ * handler and the application, without disabling interrupts and without
+ * allocating. Exactly one context may call the producer functions and
+ * exactly one other context the consumer functions.
+ *
+ * Besides copying elements in and out, the ring hands out contiguous spans of
+ * its storage with `write_span()` and `read_span()`, so a dma transfer or a
+ * driver can fill or drain the storage directly, followed by `commit_write()`
+ * or `commit_read()`.
+ *
+ * Each side only writes its own index. Indices are published with release
+ * stores and observed with acquire loads, which orders the element accesses
+ * around them (a DMB on Cortex-M4). Indices run freely and wrap through the
+ * full range of std::size_t, which stays consistent because the capacity is
+ * a power of two.
+ *
+ * @tparam T - element type, trivially copyable
+ * @tparam Capacity - number of elements, a power of two
+ */
+template<typename T, std::size_t Capacity>
+class spsc_ring
+{
+public:
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "spsc_ring capacity must be a power of two");
+  static_assert(std::is_trivially_copyable_v<T>,
+                "spsc_ring elements must be trivially copyable");
+  static_assert(std::atomic<std::size_t>::is_always_lock_free);
+
+  spsc_ring() = default;
+  spsc_ring(spsc_ring const&) = delete;
+  spsc_ring& operator=(spsc_ring const&) = delete;
+
+  /**
+   * @return std::size_t - maximum number of elements held
+   */
+  [[nodiscard]] static constexpr std::size_t capacity()
+  {
+    return Capacity;
+  }
+
+  /**
+   * @brief Number of elements held
+   *
+   * Exact from the producer or consumer while the other side is idle,
+   * otherwise a snapshot.
+   *
+   * @return std::size_t - number of elements
+   */
+  [[nodiscard]] std::size_t size() const
+  {
+    // The tail is loaded first so it cannot overtake the head, which can only
+    // grow, and the difference cannot underflow
+    auto const tail = m_tail.load(std::memory_order_acquire);
+    auto const head = m_head.load(std::memory_order_acquire);
+    return std::min(head - tail, Capacity);
+  }
+
+  [[nodiscard]] bool empty() const
+  {
+    return size() == 0;
+  }
+
+  [[nodiscard]] bool full() const
+  {
+    return size() == Capacity;
+  }
+
+  /**
+   * @brief Producer: append an element
+   *
+   * @param p_value - element to append
+   * @return true - appended, false - the ring is full
+   */
+  bool push(T const& p_value)
+  {
+    auto const head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+    m_storage[head & mask] = p_value;
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Producer: append as many elements as fit
+   *
+   * @param p_values - elements to append, in order
+   * @return std::size_t - number of elements appended
+   */
+  std::size_t write(std::span<T const> p_values)
+  {
+    std::size_t written = 0;
+    // At most two spans, before and after the end of the storage
+    while (written < p_values.size()) {
+      auto destination = write_span();
+      if (destination.empty()) {
+        break;
+      }
+      auto const count =
+        std::min(destination.size(), p_values.size() - written);
+      std::copy_n(p_values.begin() + written, count, destination.begin());
+      commit_write(count);
+      written += count;
+    }
+    return written;
+  }
+
+  /**
+   * @brief Producer: get the free storage following the last element
+   *
+   * The span ends at the end of the storage, so it may be shorter than the
+   * free space. Elements stored in it become visible to the consumer once
+   * committed with `commit_write()`.
+   *
+   * @return std::span<T> - contiguous free storage, empty if the ring is full
+   */
+  [[nodiscard]] std::span<T> write_span()
+  {
+    auto const head = m_head.load(std::memory_order_relaxed);
+    auto const free =
+      Capacity - (head - m_tail.load(std::memory_order_acquire));
+    auto const offset = head & mask;
+    return std::span<T>(m_storage).subspan(offset,
+                                           std::min(free, Capacity - offset));
+  }
+
+  /**
+   * @brief Producer: publish elements stored in the span from `write_span()`
+   *
+   * @param p_count - number of elements, at most the size of that span
+   */
+  void commit_write(std::size_t p_count)
+  {
+    auto const head = m_head.load(std::memory_order_relaxed);
+    m_head.store(head + p_count, std::memory_order_release);
+  }
+
+  /**
+   * @brief Consumer: remove the oldest element
+   *
+   * @return std::optional<T> - the element, or std::nullopt if empty
+   */
+  std::optional<T> pop()
+  {
+    auto const tail = m_tail.load(std::memory_order_relaxed);
+    if (m_head.load(std::memory_order_acquire) == tail) {
+      return std::nullopt;
+    }
+    T const value = m_storage[tail & mask];
+    m_tail.store(tail + 1, std::memory_order_release);
+    return value;
+  }
+
+  /**
+   * @brief Consumer: remove as many elements as are available and fit
+   *
+   * @param p_values - destination of the elements, oldest first
+   * @return std::size_t - number of elements removed
+   */
+  std::size_t read(std::span<T> p_values)
+  {
+    std::size_t read_count = 0;
+    while (read_count < p_values.size()) {
+      auto source = read_span();
+      if (source.empty()) {
+        break;
+      }
+      auto const count = std::min(source.size(), p_values.size() - read_count);
+      std::copy_n(source.begin(), count, p_values.begin() + read_count);
+      commit_read(count);
+      read_count += count;
+    }
+    return read_count;
+  }
+
+  /**
+   * @brief Consumer: get the oldest elements
+   *
+   * The span ends at the end of the storage, so it may hold fewer elements
+   * than the ring. The elements stay in the ring until released with
+   * `commit_read()`.
+   *
+   * @return std::span<T const> - contiguous elements, empty if the ring is
+   * empty
+   */
+  [[nodiscard]] std::span<T const> read_span() const
+  {
+    auto const tail = m_tail.load(std::memory_order_relaxed);
+    auto const available = m_head.load(std::memory_order_acquire) - tail;
+    auto const offset = tail & mask;
+    return std::span<T const>(m_storage).subspan(
+      offset, std::min(available, Capacity - offset));
+  }
+
+  /**
+   * @brief Consumer: release elements obtained from `read_span()`
+   *
+   * @param p_count - number of elements, at most the size of that span
+   */
+  void commit_read(std::size_t p_count)
+  {
+    auto const tail = m_tail.load(std::memory_order_relaxed);
+    m_tail.store(tail + p_count, std::memory_order_release);
+  }
+
+private:
+  static constexpr std::size_t mask = Capacity - 1;
+
+  std::array<T, Capacity> m_storage{};
+  /// Index of the next element to write, only written by the producer
+  std::atomic<std::size_t> m_head = 0;
+  /// Index of the next element to read, only written by the consumer
+  std::atomic<std::size_t> m_tail = 0;
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+# Copyright 2024 Khalil Estell
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Report the functions placed in RAM by HAL_STM32F4_RAMFUNC.
+
+Reads a GNU ld map file (link with -Wl,-Map=app.map) and lists every
+`.data.ramfunc` input section with its address, size, object file and
+symbols. Exits with an error if a section was not placed in SRAM or if the
+total size exceeds the budget given with --max-bytes.
+
+Helpers called from RAM functions must be inlined into them. --inlined
+takes a regular expression and fails if a symbol matching it was emitted
+out of line anywhere else, for example into flash.
+
+    python3 scripts/ramfunc_report.py app.map --max-bytes 4096 \
+        --inlined 'stm32f4::(segment_cursor|exchange)\b'
+"""
+
+import argparse
+import re
+import sys
+
+SRAM_START = 0x2000_0000
+SRAM_SIZE = 128 * 1024
+
+RAMFUNC = ".data.ramfunc"
+SECTION = re.compile(r"^ (\.[^\s*]\S*)"
+                     r"(?:\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(.*))?$")
+PLACEMENT = re.compile(r"^\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(.*)$")
+SYMBOL = re.compile(r"^\s+(0x[0-9a-f]+)\s{2,}(\S.*)$")
+
+
+def parse(lines):
+    sections = []
+    current = None
+    for line in lines:
+        line = line.rstrip("\n")
+        match = SECTION.match(line)
+        if match:
+            current = {"name": match.group(1), "symbols": []}
+            sections.append(current)
+            if match.group(2):
+                current["address"] = int(match.group(2), 16)
+                current["size"] = int(match.group(3), 16)
+                current["object"] = match.group(4)
+            continue
+        if current is None:
+            continue
+        if "address" not in current:
+            match = PLACEMENT.match(line)
+            if match:
+                current["address"] = int(match.group(1), 16)
+                current["size"] = int(match.group(2), 16)
+                current["object"] = match.group(3)
+                continue
+            current = None
+            continue
+        match = SYMBOL.match(line)
+        if match:
+            current["symbols"].append(match.group(2))
+        else:
+            current = None
+    return [section for section in sections if "address" in section]
+
+
+def is_ramfunc(section):
+    return section["name"].startswith(RAMFUNC)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("map_file", help="GNU ld map file")
+    parser.add_argument("--max-bytes", type=int, default=None,
+                        help="fail if the RAM resident code exceeds this")
+    parser.add_argument("--inlined", default=None,
+                        help="fail if a symbol matching this regular "
+                        "expression exists outside of RAM functions")
+    args = parser.parse_args()
+
+    with open(args.map_file, encoding="utf-8") as map_file:
+        everything = parse(map_file)
+    sections = [section for section in everything if is_ramfunc(section)]
+
+    failed = False
+    total = 0
+    for section in sections:
+        address = section["address"]
+        size = section["size"]
+        total += size
+        in_sram = SRAM_START <= address and \
+            address + size <= SRAM_START + SRAM_SIZE
+        status = "" if in_sram else "  <-- NOT IN SRAM"
+        failed = failed or not in_sram
+        print(f"0x{address:08x} {size:6d} {section['object']}{status}")
+        for symbol in section["symbols"]:
+            print(f"{'':18}{symbol}")
+
+    print(f"total: {total} bytes in {len(sections)} sections")
+    if args.max_bytes is not None and total > args.max_bytes:
+        print(f"error: RAM resident code exceeds {args.max_bytes} bytes")
+        failed = True
+
+    if args.inlined is not None:
+        pattern = re.compile(args.inlined)
+        for section in everything:
+            if is_ramfunc(section):
+                continue
+            for symbol in section["symbols"]:
+                if pattern.search(symbol):
+                    print(f"error: {symbol} was not inlined, it is in "
+                          f"{section['name']} at 0x{section['address']:08x}")
+                    failed = True
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,168 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+#include <libhal-stm32f4/boot.hpp>
+#include <libhal-stm32f4/profile.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal-util/enum.hpp>
+#include <libhal/error.hpp>
+
+#include "dwt_reg.hpp"
+#include "mmio.hpp"
+#include "rcc_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+constexpr auto boot_phase_count = hal::value(boot_phase::max);
+
+std::array<std::uint32_t, boot_phase_count> boot_cycles{};
+std::uint32_t marked_phases = 0;
+
+/// Clock enable register of each bus in `board_configuration::m_enable`
+std::uint32_t volatile& enable_register(std::size_t p_index)
+{
+  switch (p_index) {
+    case 0:
+      return rcc->ahb1enr;
+    case 1:
+      return rcc->ahb2enr;
+    case 2:
+      return rcc->apb1enr;
+    default:
+      return rcc->apb2enr;
+  }
+}
+
+#if defined(__arm__) && LIBHAL_STM32F4_PROFILE
+void start_boot_timing()
+{
+  enable_cycle_counter();
+  mmio_write(dwt->cyccnt, 0U);
+  mark_boot_phase(boot_phase::data_initialized);
+}
+
+/// Runs after the data and bss sections are initialized, before any static
+/// constructor
+[[gnu::used, gnu::section(".preinit_array")]] void (*const boot_timing)() =
+  start_boot_timing;
+#endif
+}  // namespace
+
+void mark_boot_phase(boot_phase p_phase)
+{
+  auto const index = hal::value(p_phase);
+  if (index >= boot_phase_count) {
+    return;
+  }
+  boot_cycles[index] = cycle_count();
+  marked_phases |= 1U << index;
+}
+
+std::optional<std::uint32_t> boot_phase_cycles(boot_phase p_phase)
+{
+  auto const index = hal::value(p_phase);
+  if (index >= boot_phase_count || (marked_phases & (1U << index)) == 0) {
+    return std::nullopt;
+  }
+  return boot_cycles[index];
+}
+
+void reset_boot_phases()
+{
+  boot_cycles = {};
+  marked_phases = 0;
+}
+
+board_configuration::board_configuration()
+  // Ports are powered together on commit
+  : m_ports([]<std::size_t... Index>(std::index_sequence<Index...>) {
+    return std::array{ port_configuration(
+      static_cast<peripheral>(ahb1_bus + Index),
+      port_configuration::unpowered{})... };
+  }(std::make_index_sequence<port_count>{}))
+{
+}
+
+board_configuration& board_configuration::clocks(
+  clock_profile const& p_profile)
+{
+  // Fail here rather than half way through the commit
+  static_cast<void>(calculate_clock_rates(p_profile));
+  m_clocks = p_profile;
+  return *this;
+}
+
+board_configuration& board_configuration::power(peripheral p_peripheral)
+{
+  auto const id = hal::value(p_peripheral);
+  std::size_t index = 0;
+  switch (id / bus_id_offset) {
+    case ahb1_bus / bus_id_offset:
+      index = 0;
+      break;
+    case ahb2_bus / bus_id_offset:
+      index = 1;
+      break;
+    case apb1_bus / bus_id_offset:
+      index = 2;
+      break;
+    case apb2_bus / bus_id_offset:
+      index = 3;
+      break;
+    default:
+      hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  m_enable[index] |= 1U << (id % bus_id_offset);
+  return *this;
+}
+
+port_configuration& board_configuration::port(peripheral p_port)
+{
+  auto const index = hal::value(p_port) - ahb1_bus;
+  if (index >= port_count) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  power(p_port);
+  return m_ports[index];
+}
+
+void board_configuration::commit() const
+{
+  if (m_clocks) {
+    set_clock_profile(*m_clocks);
+  }
+
+  for (std::size_t i = 0; i < m_enable.size(); i++) {
+    if (m_enable[i] != 0) {
+      mmio_update(enable_register(i), m_enable[i], m_enable[i]);
+    }
+  }
+  // The errata sheet requires two cycles between enabling a peripheral's
+  // clock and accessing it, reading back an enable register covers the delay
+  static_cast<void>(mmio_read(rcc->ahb1enr));
+
+  for (std::size_t i = 0; i < m_ports.size(); i++) {
+    auto const port_bit = bit_mask::from(static_cast<std::uint32_t>(i));
+    if (bit_extract(port_bit, m_enable[0])) {
+      m_ports[i].commit();
+    }
+  }
+}
+}  // namespace hal::stm32f4
@@ -0,0 +1,340 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <bit>
+#include <cstdint>
+#include <utility>
+
+#include <libhal-stm32f4/clock.hpp>
+#include <libhal-stm32f4/constants.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal-util/enum.hpp>
+
+#include "flash_reg.hpp"
+#include "mmio.hpp"
+#include "power.hpp"
+#include "pwr_reg.hpp"
+#include "rcc_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+/// SW and SWS values
+constexpr std::uint32_t switch_hsi = 0b00;
+constexpr std::uint32_t switch_hse = 0b01;
+constexpr std::uint32_t switch_pll = 0b10;
+/// VOS values
+constexpr std::uint32_t voltage_scale3 = 0b01;
+constexpr std::uint32_t voltage_scale2 = 0b10;
+constexpr std::uint32_t voltage_scale1 = 0b11;
+
+/// HSE frequency of the last profile switched to
+hal::hertz hse_frequency = 0.0f;
+clock_change_listener* listeners = nullptr;
+
+/// RM0383 table 5: wait states for a 2.7V to 3.6V supply
+std::uint32_t flash_wait_states(hal::hertz p_ahb)
+{
+  if (p_ahb <= 30e6f) {
+    return 0;
+  }
+  if (p_ahb <= 64e6f) {
+    return 1;
+  }
+  if (p_ahb <= 90e6f) {
+    return 2;
+  }
+  return 3;
+}
+
+std::uint32_t voltage_scale(hal::hertz p_system)
+{
+  if (p_system <= 64e6f) {
+    return voltage_scale3;
+  }
+  if (p_system <= 84e6f) {
+    return voltage_scale2;
+  }
+  return voltage_scale1;
+}
+
+/// HPRE: 0xxx not divided, 1000 to 1111 divide by 2 to 512 skipping 32
+std::uint32_t encode_ahb_divider(std::uint16_t p_divider)
+{
+  if (p_divider == 1) {
+    return 0;
+  }
+  auto const shift = static_cast<std::uint32_t>(std::countr_zero(p_divider));
+  return 0b1000U | (shift - (shift > 4 ? 2U : 1U));
+}
+
+float decode_ahb_divider(std::uint32_t p_value)
+{
+  if (p_value < 0b1000U) {
+    return 1.0f;
+  }
+  auto const code = p_value & 0b111U;
+  return static_cast<float>(1U << (code + (code >= 4 ? 2U : 1U)));
+}
+
+/// PPRE: 0xx not divided, 100 to 111 divide by 2 to 16
+std::uint32_t encode_apb_divider(std::uint8_t p_divider)
+{
+  if (p_divider == 1) {
+    return 0;
+  }
+  return 0b100U |
+         (static_cast<std::uint32_t>(std::countr_zero(p_divider)) - 1U);
+}
+
+float decode_apb_divider(std::uint32_t p_value)
+{
+  if (p_value < 0b100U) {
+    return 1.0f;
+  }
+  return static_cast<float>(1U << ((p_value & 0b11U) + 1U));
+}
+
+std::uint32_t encode_pll(pll_settings const& p_pll)
+{
+  return bit_value(0U)
+    .insert<pll_config::input_divider>(std::uint32_t{ p_pll.m })
+    .insert<pll_config::vco_multiplier>(std::uint32_t{ p_pll.n })
+    .insert<pll_config::system_divider>(std::uint32_t{ p_pll.p / 2U } - 1U)
+    .insert<pll_config::source>(static_cast<std::uint32_t>(p_pll.use_hse))
+    .insert<pll_config::usb_divider>(std::uint32_t{ p_pll.q })
+    .get();
+}
+
+std::uint32_t system_clock_switch(system_clock_source p_source)
+{
+  switch (p_source) {
+    case system_clock_source::hse:
+      return switch_hse;
+    case system_clock_source::pll:
+      return switch_pll;
+    default:
+      return switch_hsi;
+  }
+}
+
+void select_system_clock(std::uint32_t p_switch)
+{
+  mmio_modify(rcc->cfgr).insert<rcc_cnfg::system_clock_switch>(p_switch);
+  while (bit_extract<rcc_cnfg::system_clock_status_switch>(
+           mmio_read(rcc->cfgr)) != p_switch) {
+    continue;
+  }
+}
+
+void set_flash_wait_states(std::uint32_t p_wait_states)
+{
+  mmio_modify(flash->acr).insert<flash_access_control::latency>(p_wait_states);
+  // The new latency must be in effect before the clock is raised
+  while (bit_extract<flash_access_control::latency>(mmio_read(flash->acr)) !=
+         p_wait_states) {
+    continue;
+  }
+}
+
+void set_bus_dividers(clock_profile const& p_profile)
+{
+  mmio_modify(rcc->cfgr)
+    .insert<rcc_cnfg::ahb_prescalar>(
+      encode_ahb_divider(p_profile.ahb_divider))
+    .insert<rcc_cnfg::apb1_prescalar>(
+      encode_apb_divider(p_profile.apb1_divider))
+    .insert<rcc_cnfg::apb2_prescalar>(
+      encode_apb_divider(p_profile.apb2_divider));
+}
+
+void stop_pll()
+{
+  mmio_clear_bit(rcc->cr, clock_control::pll_enable);
+  while (bit_extract<clock_control::pll_ready>(mmio_read(rcc->cr))) {
+    continue;
+  }
+}
+
+void start_hse(bool p_bypass)
+{
+  auto const control = mmio_read(rcc->cr);
+  auto const bypassed = bit_extract<clock_control::hse_bypass>(control) != 0;
+  if (bit_extract<clock_control::hse_ready>(control) && bypassed == p_bypass) {
+    return;
+  }
+  // The bypass can only be changed while the oscillator is off, so nothing
+  // may run from it meanwhile
+  select_system_clock(switch_hsi);
+  stop_pll();
+  mmio_clear_bit(rcc->cr, clock_control::hse_enable);
+  while (bit_extract<clock_control::hse_ready>(mmio_read(rcc->cr))) {
+    continue;
+  }
+  mmio_write_bit(rcc->cr, clock_control::hse_bypass, p_bypass);
+  mmio_set_bit(rcc->cr, clock_control::hse_enable);
+  while (!bit_extract<clock_control::hse_ready>(mmio_read(rcc->cr))) {
+    continue;
+  }
+}
+
+void start_pll(clock_profile const& p_profile, hal::hertz p_system)
+{
+  auto const config = encode_pll(p_profile.pll);
+  auto const running =
+    bit_extract<clock_control::pll_ready>(mmio_read(rcc->cr)) != 0;
+  if (running && mmio_read(rcc->pllcfgr) == config) {
+    return;
+  }
+
+  // The PLL can only be reconfigured while it is stopped, which it can not be
+  // while it clocks the system
+  auto const status =
+    bit_extract<rcc_cnfg::system_clock_status_switch>(mmio_read(rcc->cfgr));
+  if (status == switch_pll) {
+    select_system_clock(switch_hsi);
+  }
+  stop_pll();
+
+  // The voltage scale can only be changed while the PLL is stopped
+  power(peripheral::power).on();
+  mmio_modify(pwr->cr)
+    .insert<power_control::voltage_scaling>(voltage_scale(p_system));
+  mmio_write(rcc->pllcfgr, config);
+  mmio_set_bit(rcc->cr, clock_control::pll_enable);
+  while (!bit_extract<clock_control::pll_ready>(mmio_read(rcc->cr))) {
+    continue;
+  }
+}
+
+hal::hertz system_clock_rate(std::uint32_t p_status)
+{
+  switch (p_status) {
+    case switch_hse:
+      return hse_frequency;
+    case switch_pll: {
+      auto const config = mmio_read(rcc->pllcfgr);
+      auto const input = bit_extract<pll_config::source>(config) != 0
+                           ? hse_frequency
+                           : hsi_frequency;
+      auto const m = bit_extract<pll_config::input_divider>(config);
+      auto const n = bit_extract<pll_config::vco_multiplier>(config);
+      auto const p = (bit_extract<pll_config::system_divider>(config) + 1) * 2;
+      if (m == 0) {
+        return 0.0f;
+      }
+      return input / static_cast<float>(m) * static_cast<float>(n) /
+             static_cast<float>(p);
+    }
+    default:
+      return hsi_frequency;
+  }
+}
+}  // namespace
+
+void set_clock_profile(clock_profile const& p_profile)
+{
+  auto const target = calculate_clock_rates(p_profile);
+  auto const current = current_clock_rates();
+  auto const uses_hse = p_profile.source == system_clock_source::hse ||
+                        (p_profile.source == system_clock_source::pll &&
+                         p_profile.pll.use_hse);
+
+  if (uses_hse) {
+    start_hse(p_profile.hse_bypass);
+    hse_frequency = p_profile.hse_frequency;
+  }
+  if (p_profile.source == system_clock_source::pll) {
+    start_pll(p_profile, target.system);
+  }
+
+  // Whichever of the current or target wait states and dividers are applied
+  // while switching, the clocks stay within their limits
+  auto const wait_states = flash_wait_states(target.ahb);
+  auto const current_wait_states =
+    bit_extract<flash_access_control::latency>(mmio_read(flash->acr));
+  if (wait_states > current_wait_states) {
+    set_flash_wait_states(wait_states);
+  }
+  auto const speeding_up = target.system >= current.system;
+  if (speeding_up) {
+    set_bus_dividers(p_profile);
+  }
+  select_system_clock(system_clock_switch(p_profile.source));
+  if (!speeding_up) {
+    set_bus_dividers(p_profile);
+  }
+  if (wait_states < current_wait_states) {
+    set_flash_wait_states(wait_states);
+  }
+
+  if (p_profile.source != system_clock_source::pll) {
+    stop_pll();
+  }
+  if (!uses_hse) {
+    mmio_clear_bit(rcc->cr, clock_control::hse_enable);
+  }
+
+  for (auto* listener = listeners; listener; listener = listener->m_next) {
+    listener->m_handler();
+  }
+}
+
+clock_rates current_clock_rates()
+{
+  auto const config = mmio_read(rcc->cfgr);
+  auto const system = system_clock_rate(
+    bit_extract<rcc_cnfg::system_clock_status_switch>(config));
+  auto const ahb =
+    system / decode_ahb_divider(bit_extract<rcc_cnfg::ahb_prescalar>(config));
+  auto const apb1_divider =
+    decode_apb_divider(bit_extract<rcc_cnfg::apb1_prescalar>(config));
+  auto const apb2_divider =
+    decode_apb_divider(bit_extract<rcc_cnfg::apb2_prescalar>(config));
+  auto const apb1 = ahb / apb1_divider;
+  auto const apb2 = ahb / apb2_divider;
+  return {
+    .system = system,
+    .ahb = ahb,
+    .apb1 = apb1,
+    .apb2 = apb2,
+    .apb1_timer = apb1_divider == 1.0f ? apb1 : 2.0f * apb1,
+    .apb2_timer = apb2_divider == 1.0f ? apb2 : 2.0f * apb2,
+  };
+}
+
+hal::hertz clock_rate(peripheral p_peripheral)
+{
+  return clock_rate(p_peripheral, current_clock_rates());
+}
+
+clock_change_listener::clock_change_listener(handler p_handler)
+  : m_handler(std::move(p_handler))
+{
+  auto** last = &listeners;
+  while (*last) {
+    last = &(*last)->m_next;
+  }
+  *last = this;
+}
+
+clock_change_listener::~clock_change_listener()
+{
+  for (auto** link = &listeners; *link; link = &(*link)->m_next) {
+    if (*link == this) {
+      *link = m_next;
+      return;
+    }
+  }
+}
+}  // namespace hal::stm32f4
@@ -0,0 +1,367 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <span>
+#include <utility>
+
+#include <libhal-stm32f4/coroutine.hpp>
+#include <libhal-stm32f4/interrupt.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal-util/enum.hpp>
+#include <libhal/error.hpp>
+
+#include "exti_reg.hpp"
+#include "mmio.hpp"
+#include "power.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+struct alignas(std::max_align_t) frame
+{
+  std::array<std::byte, frame_pool::frame_size> storage;
+};
+
+std::array<frame, frame_pool::frame_count> frames{};
+std::array<bool, frame_pool::frame_count> frame_used{};
+
+/// Completion waiting on each gpio EXTI line
+std::array<completion*, exti_gpio_line_count> edge_waiters{};
+
+void handle_pin_edges()
+{
+  auto const pending =
+    mmio_read(exti->pr) & mmio_read(exti->imr) & ((1U << 16) - 1U);
+  for (std::uint8_t line = 0; line < exti_gpio_line_count; line++) {
+    auto const mask = bit_mask::from(line);
+    if (!bit_extract(mask, pending)) {
+      continue;
+    }
+    mmio_write(exti->pr, bit_value(0U).set(mask).get());
+    mmio_clear_bit(exti->imr, mask);
+    if (auto* waiter = std::exchange(edge_waiters[line], nullptr)) {
+      waiter->complete();
+    }
+  }
+}
+}  // namespace
+
+void* frame_pool::allocate(std::size_t p_size)
+{
+  if (p_size > frame_size) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+
+  critical_section section;
+  for (std::size_t i = 0; i < frame_count; i++) {
+    if (!frame_used[i]) {
+      frame_used[i] = true;
+      return frames[i].storage.data();
+    }
+  }
+  hal::safe_throw(hal::resource_unavailable_try_again(nullptr));
+}
+
+void frame_pool::release(void* p_frame) noexcept
+{
+  critical_section section;
+  for (std::size_t i = 0; i < frame_count; i++) {
+    if (frames[i].storage.data() == p_frame) {
+      frame_used[i] = false;
+      return;
+    }
+  }
+}
+
+std::size_t frame_pool::available()
+{
+  critical_section section;
+  std::size_t count = 0;
+  for (auto const used : frame_used) {
+    count += used ? 0 : 1;
+  }
+  return count;
+}
+
+executor::executor(hal::steady_clock& p_clock)
+  : m_clock(&p_clock)
+{
+}
+
+executor::executor(scheduler& p_scheduler)
+  : m_clock(&p_scheduler)
+  , m_wake_timer(&p_scheduler)
+{
+}
+
+executor::~executor()
+{
+  for (auto& handle : m_tasks) {
+    if (handle) {
+      handle.destroy();
+      handle = nullptr;
+    }
+  }
+}
+
+void executor::spawn(task&& p_task)
+{
+  for (auto& handle : m_tasks) {
+    if (!handle) {
+      handle = std::exchange(p_task.m_handle, nullptr);
+      if (handle) {
+        schedule(handle);
+      }
+      return;
+    }
+  }
+  hal::safe_throw(hal::resource_unavailable_try_again(this));
+}
+
+void executor::schedule(std::coroutine_handle<> p_coroutine)
+{
+  critical_section section;
+  if (m_ready_size == ready_capacity) {
+    hal::safe_throw(hal::resource_unavailable_try_again(this));
+  }
+  m_ready[(m_ready_head + m_ready_size) % ready_capacity] = p_coroutine;
+  m_ready_size = m_ready_size + 1;
+}
+
+std::coroutine_handle<> executor::take_ready()
+{
+  critical_section section;
+  if (m_ready_size == 0) {
+    return nullptr;
+  }
+  auto const coroutine = m_ready[m_ready_head];
+  m_ready_head = (m_ready_head + 1) % ready_capacity;
+  m_ready_size = m_ready_size - 1;
+  return coroutine;
+}
+
+bool executor::run_ready()
+{
+  resume_due_timers();
+
+  while (auto coroutine = take_ready()) {
+    coroutine.resume();
+
+    // Free the frames of finished tasks right away so new tasks can start
+    for (auto& handle : m_tasks) {
+      if (!handle || !handle.done()) {
+        continue;
+      }
+      auto const exception = handle.promise().exception;
+      handle.destroy();
+      handle = nullptr;
+      if (exception) {
+        std::rethrow_exception(exception);
+      }
+    }
+  }
+
+  return running() != 0;
+}
+
+void executor::run()
+{
+  while (run_ready()) {
+    critical_section section;
+    if (m_ready_size != 0) {
+      continue;
+    }
+    // Interrupts are masked, so a completion cannot slip in between the
+    // check and WFI. It still wakes the core and runs once unmasked.
+    if (m_timer_count == 0) {
+      wait_for_interrupt();
+    } else if (m_wake_timer && m_wake_timer->wake_at(m_timers[0].deadline)) {
+      wait_for_interrupt();
+    }
+  }
+}
+
+std::size_t executor::running() const
+{
+  std::size_t count = 0;
+  for (auto const& handle : m_tasks) {
+    count += handle ? 1 : 0;
+  }
+  return count;
+}
+
+executor::delay_awaiter executor::delay(hal::time_duration p_duration)
+{
+  if (p_duration.count() <= 0) {
+    return { *this, 0 };
+  }
+  auto const ticks_per_ns = static_cast<double>(m_clock->frequency()) / 1e9;
+  auto const ticks =
+    static_cast<std::uint64_t>(static_cast<double>(p_duration.count()) *
+                               ticks_per_ns) +
+    1U;
+  return { *this, ticks };
+}
+
+void executor::delay_awaiter::await_suspend(
+  std::coroutine_handle<> p_coroutine)
+{
+  m_executor->add_timer(m_ticks, p_coroutine);
+}
+
+void executor::add_timer(std::uint64_t p_ticks,
+                         std::coroutine_handle<> p_coroutine)
+{
+  if (m_timer_count == m_timers.size()) {
+    hal::safe_throw(hal::resource_unavailable_try_again(this));
+  }
+
+  timer const entry{ .deadline = m_clock->uptime() + p_ticks,
+                     .coroutine = p_coroutine };
+  // Keep the list ordered by deadline, equal deadlines in arrival order
+  auto position = m_timer_count;
+  while (position > 0 && m_timers[position - 1].deadline > entry.deadline) {
+    m_timers[position] = m_timers[position - 1];
+    position--;
+  }
+  m_timers[position] = entry;
+  m_timer_count++;
+}
+
+bool executor::resume_due_timers()
+{
+  if (m_timer_count == 0) {
+    return false;
+  }
+
+  auto const now = m_clock->uptime();
+  std::size_t due = 0;
+  while (due < m_timer_count && m_timers[due].deadline <= now) {
+    schedule(m_timers[due].coroutine);
+    due++;
+  }
+  for (std::size_t i = due; i < m_timer_count; i++) {
+    m_timers[i - due] = m_timers[i];
+  }
+  m_timer_count -= due;
+  return due != 0;
+}
+
+completion::completion(executor& p_executor)
+  : m_executor(&p_executor)
+{
+}
+
+void completion::complete()
+{
+  critical_section section;
+  m_done = true;
+  if (auto waiter = std::exchange(m_waiter, nullptr)) {
+    m_executor->schedule(waiter);
+  }
+}
+
+void completion::reset()
+{
+  critical_section section;
+  m_done = false;
+  m_waiter = nullptr;
+}
+
+bool completion::done() const
+{
+  return m_done;
+}
+
+bool completion::await_suspend(std::coroutine_handle<> p_coroutine)
+{
+  critical_section section;
+  if (m_done) {
+    return false;
+  }
+  m_waiter = p_coroutine;
+  return true;
+}
+
+spi_transfer_awaiter::spi_transfer_awaiter(
+  executor& p_executor,
+  spi_engine& p_engine,
+  std::uint8_t p_bus,
+  std::span<hal::byte const> p_data_out,
+  std::span<hal::byte> p_data_in,
+  hal::byte p_filler)
+  : m_completion(p_executor)
+  , m_engine(&p_engine)
+  , m_data_out(p_data_out)
+  , m_data_in(p_data_in)
+  , m_bus(p_bus)
+  , m_filler(p_filler)
+{
+}
+
+bool spi_transfer_awaiter::await_suspend(std::coroutine_handle<> p_coroutine)
+{
+  m_engine->on_finished(m_bus, [this]() { m_completion.complete(); });
+  m_engine->start(m_bus, m_data_out, m_data_in, m_filler);
+  return m_completion.await_suspend(p_coroutine);
+}
+
+void spi_transfer_awaiter::await_resume()
+{
+  // Drop the handler, it refers to this awaiter which is about to go away
+  m_engine->on_finished(m_bus, {});
+}
+
+pin_edge_awaiter::pin_edge_awaiter(executor& p_executor,
+                                   peripheral p_port,
+                                   std::uint8_t p_pin,
+                                   wake_edge p_edge)
+  : m_completion(p_executor)
+  , m_port(p_port)
+  , m_pin(p_pin)
+  , m_edge(p_edge)
+{
+  if (p_pin >= exti_gpio_line_count ||
+      hal::value(p_port) > hal::value(peripheral::gpio_h)) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+}
+
+bool pin_edge_awaiter::await_suspend(std::coroutine_handle<> p_coroutine)
+{
+  if (edge_waiters[m_pin]) {
+    hal::safe_throw(hal::device_or_resource_busy(this));
+  }
+
+  power(peripheral::system_config_controller).on();
+  bit_mask const port_mask = { .position = (m_pin % 4U) * 4U, .width = 4 };
+  mmio_modify(syscfg->exticr[m_pin / 4])
+    .insert(port_mask, hal::value(m_port));
+
+  auto const line = bit_mask::from(m_pin);
+  mmio_write_bit(exti->rtsr, line, m_edge != wake_edge::falling);
+  mmio_write_bit(exti->ftsr, line, m_edge != wake_edge::rising);
+  // Drop an edge latched before this wait
+  mmio_write(exti->pr, bit_value(0U).set(line).get());
+
+  edge_waiters[m_pin] = &m_completion;
+  enable_interrupt(exti_irq(m_pin), handle_pin_edges);
+  mmio_set_bit(exti->imr, line);
+  return m_completion.await_suspend(p_coroutine);
+}
+}  // namespace hal::stm32f4
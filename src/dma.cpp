@@ -0,0 +1,141 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include <libhal-stm32f4/interrupt.hpp>
+#include <libhal-stm32f4/resources.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal/error.hpp>
+
+#include "dma.hpp"
+#include "mmio.hpp"
+#include "power.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+constexpr std::size_t total_stream_count = 2 * dma_stream_count;
+
+std::array<hal::callback<void()>, total_stream_count> handlers{};
+
+std::size_t stream_index(std::uint8_t p_controller, std::uint8_t p_stream)
+{
+  if (p_controller < 1 || p_controller > 2 || p_stream >= dma_stream_count) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+  return ((p_controller - 1U) * dma_stream_count) + p_stream;
+}
+
+dma_reg_t* get_dma_reg(std::uint8_t p_controller)
+{
+  return p_controller == 1 ? dma_reg1 : dma_reg2;
+}
+
+template<std::size_t index>
+void dma_interrupt()
+{
+  if (handlers[index]) {
+    handlers[index]();
+  }
+}
+
+template<std::size_t... indices>
+constexpr auto make_dma_interrupts(std::index_sequence<indices...>)
+{
+  return std::array<interrupt_handler, sizeof...(indices)>{
+    &dma_interrupt<indices>...
+  };
+}
+
+constexpr auto dma_interrupts =
+  make_dma_interrupts(std::make_index_sequence<total_stream_count>{});
+}  // namespace
+
+dma_stream_reg_t& dma_stream(dma_request p_request)
+{
+  stream_index(p_request.controller, p_request.stream);
+  return get_dma_reg(p_request.controller)->stream[p_request.stream];
+}
+
+dma_request claim_dma_stream(std::span<dma_request const> p_options)
+{
+  for (auto const& option : p_options) {
+    stream_index(option.controller, option.stream);
+    if (try_claim_resource(
+          dma_stream_resource(option.controller, option.stream))) {
+      power(option.controller == 1 ? peripheral::dma1 : peripheral::dma2).on();
+      return option;
+    }
+  }
+  hal::safe_throw(hal::device_or_resource_busy(nullptr));
+}
+
+void release_dma_stream(dma_request p_request)
+{
+  auto const index = stream_index(p_request.controller, p_request.stream);
+  auto const stream =
+    dma_stream_resource(p_request.controller, p_request.stream);
+  if (!is_resource_claimed(stream)) {
+    return;
+  }
+  disable_interrupt(dma_stream_irq(p_request.controller, p_request.stream));
+  stop_dma_stream(p_request);
+  handlers[index] = {};
+  release_resource(stream);
+}
+
+bool is_dma_stream_claimed(std::uint8_t p_controller, std::uint8_t p_stream)
+{
+  stream_index(p_controller, p_stream);
+  return is_resource_claimed(dma_stream_resource(p_controller, p_stream));
+}
+
+void on_dma_interrupt(dma_request p_request, hal::callback<void()> p_handler)
+{
+  auto const index = stream_index(p_request.controller, p_request.stream);
+  handlers[index] = std::move(p_handler);
+  enable_interrupt(dma_stream_irq(p_request.controller, p_request.stream),
+                   dma_interrupts[index]);
+}
+
+std::uint32_t take_dma_flags(dma_request p_request)
+{
+  auto* reg = get_dma_reg(p_request.controller);
+  auto const offset = dma_flag_offset(p_request.stream);
+  auto const high = p_request.stream >= 4;
+
+  constexpr auto all_flags = dma_stream_flags::all.value<std::uint32_t>();
+
+  auto const status = mmio_read(high ? reg->hisr : reg->lisr);
+  auto const flags = (status >> offset) & all_flags;
+  if (flags != 0) {
+    // Flag clear registers are write 1 to clear
+    mmio_write(high ? reg->hifcr : reg->lifcr, flags << offset);
+  }
+  return flags;
+}
+
+void stop_dma_stream(dma_request p_request)
+{
+  auto& stream = dma_stream(p_request);
+  mmio_clear_bit(stream.cr, dma_stream_config::enable);
+  // The stream finishes its current transfer before the enable bit clears
+  while (bit_extract<dma_stream_config::enable>(mmio_read(stream.cr))) {
+    continue;
+  }
+  take_dma_flags(p_request);
+}
+}  // namespace hal::stm32f4
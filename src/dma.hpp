@@ -0,0 +1,105 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+
+#include <span>
+
+#include <libhal/functional.hpp>
+
+#include "dma_reg.hpp"
+
+// Stream allocation and interrupt dispatch shared by the dma based drivers
+
+namespace hal::stm32f4 {
+/// A dma stream and the channel connecting it to a peripheral's request
+struct dma_request
+{
+  /// DMA controller 1 or 2
+  std::uint8_t controller;
+  /// Stream 0-7
+  std::uint8_t stream;
+  /// Channel 0-7
+  std::uint8_t channel;
+
+  constexpr bool operator==(dma_request const&) const = default;
+};
+
+/**
+ * @brief Registers of a dma stream
+ *
+ * @param p_request - stream to access
+ * @return dma_stream_reg_t& - the stream's registers
+ */
+dma_stream_reg_t& dma_stream(dma_request p_request);
+
+/**
+ * @brief Claim the first free stream from a list of options
+ *
+ * Powers on the stream's controller. Controllers are left powered when their
+ * streams are released.
+ *
+ * @param p_options - streams that can serve the peripheral request, in order
+ * of preference
+ * @return dma_request - the claimed stream
+ * @throws hal::device_or_resource_busy - if every option is already claimed
+ */
+dma_request claim_dma_stream(std::span<dma_request const> p_options);
+
+/**
+ * @brief Disable, then release a stream claimed by `claim_dma_stream()`
+ *
+ * Also disables the stream's interrupt and removes its handler.
+ *
+ * @param p_request - stream to release
+ */
+void release_dma_stream(dma_request p_request);
+
+/**
+ * @brief Check if a stream is claimed
+ *
+ * @param p_controller - dma controller 1 or 2
+ * @param p_stream - stream 0-7
+ * @return true - the stream is in use
+ */
+[[nodiscard]] bool is_dma_stream_claimed(std::uint8_t p_controller,
+                                         std::uint8_t p_stream);
+
+/**
+ * @brief Call a handler from the interrupt of a stream
+ *
+ * @param p_request - stream whose interrupt to handle
+ * @param p_handler - called from the interrupt
+ */
+void on_dma_interrupt(dma_request p_request, hal::callback<void()> p_handler);
+
+/**
+ * @brief Read and clear the interrupt flags of a stream
+ *
+ * @param p_request - stream whose flags to take
+ * @return std::uint32_t - the stream's flags, see `dma_stream_flags`
+ */
+std::uint32_t take_dma_flags(dma_request p_request);
+
+/**
+ * @brief Disable a stream and wait for it to stop
+ *
+ * Clears the stream's interrupt flags so that it can be enabled again.
+ *
+ * @param p_request - stream to stop
+ */
+void stop_dma_stream(dma_request p_request);
+}  // namespace hal::stm32f4
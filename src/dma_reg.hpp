@@ -0,0 +1,159 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <libhal-stm32f4/constants.hpp>
+#include <libhal-util/bit.hpp>
+
+namespace hal::stm32f4 {
+/// Registers of one dma stream
+struct dma_stream_reg_t
+{
+  /// Offset: 0x00 Stream configuration register
+  std::uint32_t volatile cr;
+  /// Offset: 0x04 Stream number of data register
+  std::uint32_t volatile ndtr;
+  /// Offset: 0x08 Stream peripheral address register
+  std::uint32_t volatile par;
+  /// Offset: 0x0C Stream memory 0 address register
+  std::uint32_t volatile m0ar;
+  /// Offset: 0x10 Stream memory 1 address register
+  std::uint32_t volatile m1ar;
+  /// Offset: 0x14 Stream FIFO control register
+  std::uint32_t volatile fcr;
+};
+
+/// Number of streams per dma controller
+inline constexpr std::size_t dma_stream_count = 8;
+
+/// DMA controller registers
+struct dma_reg_t
+{
+  /// Offset: 0x00 Low interrupt status register (streams 0-3)
+  std::uint32_t volatile lisr;
+  /// Offset: 0x04 High interrupt status register (streams 4-7)
+  std::uint32_t volatile hisr;
+  /// Offset: 0x08 Low interrupt flag clear register (streams 0-3)
+  std::uint32_t volatile lifcr;
+  /// Offset: 0x0C High interrupt flag clear register (streams 4-7)
+  std::uint32_t volatile hifcr;
+  /// Offset: 0x10 Streams 0-7
+  std::array<dma_stream_reg_t, dma_stream_count> stream;
+};
+
+/// DMA stream configuration register
+struct dma_stream_config
+{
+  /// Stream enable, reads as 0 once the stream has actually stopped
+  static constexpr auto enable = bit_mask::from<0>();
+
+  /// Transfer error interrupt enable
+  static constexpr auto transfer_error_interrupt_enable = bit_mask::from<2>();
+
+  /// Half transfer interrupt enable
+  static constexpr auto half_transfer_interrupt_enable = bit_mask::from<3>();
+
+  /// Transfer complete interrupt enable
+  static constexpr auto transfer_complete_interrupt_enable =
+    bit_mask::from<4>();
+
+  /// Data transfer direction, see `dma_direction`
+  static constexpr auto direction = bit_mask::from<7, 6>();
+
+  /// Circular mode, the counter reloads once it reaches 0
+  static constexpr auto circular_mode = bit_mask::from<8>();
+
+  /// Increment the peripheral address after each transfer
+  static constexpr auto peripheral_increment = bit_mask::from<9>();
+
+  /// Increment the memory address after each transfer
+  static constexpr auto memory_increment = bit_mask::from<10>();
+
+  /// Peripheral data size, 0: byte, 1: half-word, 2: word
+  static constexpr auto peripheral_size = bit_mask::from<12, 11>();
+
+  /// Memory data size, 0: byte, 1: half-word, 2: word
+  static constexpr auto memory_size = bit_mask::from<14, 13>();
+
+  /// Priority level, 0: low to 3: very high
+  static constexpr auto priority = bit_mask::from<17, 16>();
+
+  /// Channel (request) selection
+  static constexpr auto channel = bit_mask::from<27, 25>();
+};
+
+/// Values of `dma_stream_config::direction`
+struct dma_direction
+{
+  static constexpr std::uint32_t peripheral_to_memory = 0b00;
+  static constexpr std::uint32_t memory_to_peripheral = 0b01;
+  static constexpr std::uint32_t memory_to_memory = 0b10;
+};
+
+/// Flags of a stream in the interrupt status and flag clear registers,
+/// relative to the stream's offset (see `dma_flag_offset()`)
+struct dma_stream_flags
+{
+  static constexpr auto fifo_error = bit_mask::from<0>();
+  static constexpr auto direct_mode_error = bit_mask::from<2>();
+  static constexpr auto transfer_error = bit_mask::from<3>();
+  static constexpr auto half_transfer = bit_mask::from<4>();
+  static constexpr auto transfer_complete = bit_mask::from<5>();
+  /// All flags of a stream
+  static constexpr auto all = bit_mask::from<5, 0>();
+};
+
+/**
+ * @brief Position of a stream's flags within LISR/HISR and LIFCR/HIFCR
+ *
+ * @param p_stream - stream number 0-7
+ * @return std::uint32_t - bit offset of the stream's flags
+ */
+constexpr std::uint32_t dma_flag_offset(std::uint8_t p_stream)
+{
+  constexpr std::array<std::uint32_t, 4> offsets{ 0, 6, 16, 22 };
+  return offsets[p_stream % 4];
+}
+
+/**
+ * @brief Interrupt of a dma stream
+ *
+ * @param p_controller - dma controller 1 or 2
+ * @param p_stream - stream number 0-7
+ * @return irq - the stream's interrupt
+ */
+constexpr irq dma_stream_irq(std::uint8_t p_controller, std::uint8_t p_stream)
+{
+  constexpr std::array<irq, dma_stream_count> dma1{
+    irq::dma1_channel0, irq::dma1_channel1, irq::dma1_channel2,
+    irq::dma1_channel3, irq::dma1_channel4, irq::dma1_channel5,
+    irq::dma1_channel6, irq::dma1_channel7,
+  };
+  constexpr std::array<irq, dma_stream_count> dma2{
+    irq::dma2_channel0, irq::dma2_channel1, irq::dma2_channel2,
+    irq::dma2_channel3, irq::dma2_channel4, irq::dma2_channel5,
+    irq::dma2_channel6, irq::dma2_channel7,
+  };
+  return p_controller == 1 ? dma1[p_stream] : dma2[p_stream];
+}
+
+inline constexpr intptr_t ahb1_base = 0x4002'0000UL;
+
+inline dma_reg_t* dma_reg1 = reinterpret_cast<dma_reg_t*>(ahb1_base + 0x6000);
+inline dma_reg_t* dma_reg2 = reinterpret_cast<dma_reg_t*>(ahb1_base + 0x6400);
+}  // namespace hal::stm32f4
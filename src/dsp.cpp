@@ -0,0 +1,307 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include <libhal-stm32f4/dsp.hpp>
+#include <libhal/error.hpp>
+
+#include "simd.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+/// Both lanes set to 1, multiplying by it sums the lanes of the other operand
+constexpr q15x2 ones = 0x0001'0001;
+
+q15 saturate_q15(std::int64_t p_accumulator)
+{
+  constexpr std::int64_t lowest = std::numeric_limits<q15>::min();
+  constexpr std::int64_t highest = std::numeric_limits<q15>::max();
+  return static_cast<q15>(std::clamp(p_accumulator >> 15, lowest, highest));
+}
+
+template<typename T>
+void validate_lengths(std::span<T const> p_a, std::span<T const> p_b)
+{
+  if (p_a.size() != p_b.size()) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+}
+
+template<typename T>
+T mean(std::int64_t p_sum, std::size_t p_count)
+{
+  return static_cast<T>(p_sum / static_cast<std::int64_t>(p_count));
+}
+}  // namespace
+
+std::int64_t dot_product(std::span<q15 const> p_a, std::span<q15 const> p_b)
+{
+  validate_lengths(p_a, p_b);
+  auto const* a = p_a.data();
+  auto const* b = p_b.data();
+  auto const size = p_a.size();
+
+  std::int64_t sum = 0;
+  std::size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    sum = smlald(load_q15x2(a + i), load_q15x2(b + i), sum);
+    sum = smlald(load_q15x2(a + i + 2), load_q15x2(b + i + 2), sum);
+  }
+  for (; i < size; i++) {
+    sum += std::int32_t{ a[i] } * b[i];
+  }
+  return sum;
+}
+
+std::int64_t dot_product(std::span<q31 const> p_a, std::span<q31 const> p_b)
+{
+  validate_lengths(p_a, p_b);
+  // The M4 has no 32-bit lane SIMD, the compiler turns this into SMULL and
+  // shifts
+  std::int64_t sum = 0;
+  for (std::size_t i = 0; i < p_a.size(); i++) {
+    sum += (std::int64_t{ p_a[i] } * p_b[i]) >> 14;
+  }
+  return sum;
+}
+
+sample_statistics<q15> statistics(std::span<q15 const> p_samples)
+{
+  if (p_samples.empty()) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+  auto const* samples = p_samples.data();
+  auto const size = p_samples.size();
+
+  auto const first = pack_q15x2(samples[0], samples[0]);
+  q15x2 lowest = first;
+  q15x2 highest = first;
+  std::int64_t sum = 0;
+  std::size_t i = 0;
+  for (; i + 2 <= size; i += 2) {
+    auto const pair = load_q15x2(samples + i);
+    lowest = min_q15x2(lowest, pair);
+    highest = max_q15x2(highest, pair);
+    sum = smlald(pair, ones, sum);
+  }
+  if (i < size) {
+    auto const last = pack_q15x2(samples[i], samples[i]);
+    lowest = min_q15x2(lowest, last);
+    highest = max_q15x2(highest, last);
+    sum += samples[i];
+  }
+
+  return {
+    .min = std::min(lane0(lowest), lane1(lowest)),
+    .max = std::max(lane0(highest), lane1(highest)),
+    .mean = mean<q15>(sum, size),
+  };
+}
+
+sample_statistics<q31> statistics(std::span<q31 const> p_samples)
+{
+  if (p_samples.empty()) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+
+  q31 lowest = p_samples[0];
+  q31 highest = p_samples[0];
+  std::int64_t sum = 0;
+  for (auto const sample : p_samples) {
+    lowest = std::min(lowest, sample);
+    highest = std::max(highest, sample);
+    sum += sample;
+  }
+  return { .min = lowest,
+           .max = highest,
+           .mean = mean<q31>(sum, p_samples.size()) };
+}
+
+fir_q15::fir_q15(std::span<q15 const> p_coefficients,
+                 std::span<q15> p_buffer,
+                 std::uint32_t p_decimation)
+  : m_coefficients(p_coefficients)
+  , m_buffer(p_buffer)
+  , m_decimation(p_decimation)
+{
+  if (p_coefficients.empty() || p_decimation == 0 ||
+      p_buffer.size() < p_coefficients.size() - 1 + p_decimation) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  reset();
+}
+
+std::span<q15> fir_q15::process(std::span<q15 const> p_input,
+                                std::span<q15> p_output)
+{
+  auto const output_size = p_input.size() / m_decimation;
+  if (p_input.size() % m_decimation != 0 || p_input.size() > max_block() ||
+      p_output.size() < output_size) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+
+  auto const taps = m_coefficients.size();
+  auto const history = taps - 1;
+  auto const* coefficients = m_coefficients.data();
+  auto* buffer = m_buffer.data();
+  std::ranges::copy(p_input, buffer + history);
+
+  // The window of an output sample holds its input sample last. Coefficient
+  // pair (k, k + 1) meets window pair (taps - 2 - k, taps - 1 - k) crossed,
+  // which is exactly what SMLALDX multiplies.
+  std::size_t out = 0;
+  for (std::size_t n = m_decimation - 1; n < p_input.size();
+       n += m_decimation) {
+    q15 const* window = buffer + n;
+    std::int64_t accumulator = 0;
+    std::size_t k = 0;
+    for (; k + 2 <= taps; k += 2) {
+      accumulator = smlaldx(load_q15x2(coefficients + k),
+                            load_q15x2(window + taps - 2 - k),
+                            accumulator);
+    }
+    if (k < taps) {
+      accumulator += std::int32_t{ coefficients[k] } * window[0];
+    }
+    p_output[out++] = saturate_q15(accumulator);
+  }
+
+  std::copy(buffer + p_input.size(), buffer + p_input.size() + history, buffer);
+  return p_output.first(output_size);
+}
+
+void fir_q15::reset()
+{
+  std::ranges::fill(m_buffer, q15{ 0 });
+}
+
+std::size_t fir_q15::max_block() const
+{
+  return m_buffer.size() - (m_coefficients.size() - 1);
+}
+
+biquad_cascade::biquad_cascade(std::span<biquad_coefficients const> p_sections,
+                               std::span<biquad_state> p_state)
+  : m_sections(p_sections)
+  , m_state(p_state)
+{
+  if (p_state.size() != p_sections.size()) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  reset();
+}
+
+std::span<float> biquad_cascade::process(std::span<float const> p_input,
+                                         std::span<float> p_output)
+{
+  if (p_output.size() < p_input.size()) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  auto const size = p_input.size();
+  float const* source = p_input.data();
+  float* destination = p_output.data();
+
+  if (m_sections.empty()) {
+    std::copy(source, source + size, destination);
+  }
+
+  for (std::size_t section = 0; section < m_sections.size(); section++) {
+    auto const [b0, b1, b2, a1, a2] = m_sections[section];
+    auto [d0, d1] = m_state[section];
+    for (std::size_t i = 0; i < size; i++) {
+      auto const x = source[i];
+      auto const y = (b0 * x) + d0;
+      d0 = (b1 * x) - (a1 * y) + d1;
+      d1 = (b2 * x) - (a2 * y);
+      destination[i] = y;
+    }
+    m_state[section] = { d0, d1 };
+    source = destination;
+  }
+  return p_output.first(size);
+}
+
+void biquad_cascade::reset()
+{
+  std::ranges::fill(m_state, biquad_state{});
+}
+
+namespace reference {
+std::int64_t dot_product(std::span<q15 const> p_a, std::span<q15 const> p_b)
+{
+  validate_lengths(p_a, p_b);
+  std::int64_t sum = 0;
+  for (std::size_t i = 0; i < p_a.size(); i++) {
+    sum += std::int32_t{ p_a[i] } * p_b[i];
+  }
+  return sum;
+}
+
+sample_statistics<q15> statistics(std::span<q15 const> p_samples)
+{
+  if (p_samples.empty()) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+
+  q15 lowest = p_samples[0];
+  q15 highest = p_samples[0];
+  std::int64_t sum = 0;
+  for (auto const sample : p_samples) {
+    lowest = std::min(lowest, sample);
+    highest = std::max(highest, sample);
+    sum += sample;
+  }
+  return { .min = lowest,
+           .max = highest,
+           .mean = mean<q15>(sum, p_samples.size()) };
+}
+
+void fir(std::span<q15 const> p_coefficients,
+         std::span<q15 const> p_input,
+         std::span<q15> p_output,
+         std::uint32_t p_decimation)
+{
+  for (std::size_t out = 0; out < p_input.size() / p_decimation; out++) {
+    auto const n = ((out + 1) * p_decimation) - 1;
+    std::int64_t accumulator = 0;
+    for (std::size_t k = 0; k < p_coefficients.size() && k <= n; k++) {
+      accumulator += std::int32_t{ p_coefficients[k] } * p_input[n - k];
+    }
+    p_output[out] = saturate_q15(accumulator);
+  }
+}
+
+void biquad(std::span<biquad_coefficients const> p_sections,
+            std::span<float const> p_input,
+            std::span<float> p_output)
+{
+  std::ranges::copy(p_input, p_output.begin());
+  for (auto const& section : p_sections) {
+    float d0 = 0.0f;
+    float d1 = 0.0f;
+    for (std::size_t i = 0; i < p_input.size(); i++) {
+      auto const x = p_output[i];
+      auto const y = (section.b0 * x) + d0;
+      d0 = (section.b1 * x) - (section.a1 * y) + d1;
+      d1 = (section.b2 * x) - (section.a2 * y);
+      p_output[i] = y;
+    }
+  }
+}
+}  // namespace reference
+}  // namespace hal::stm32f4
@@ -0,0 +1,59 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+
+#include <libhal-util/bit.hpp>
+
+namespace hal::stm32f4 {
+/// Data watchpoint and trace unit registers
+struct dwt_reg_t
+{
+  /// Offset: 0x000 Control Register
+  std::uint32_t volatile ctrl;
+  /// Offset: 0x004 Cycle Count Register
+  std::uint32_t volatile cyccnt;
+};
+
+/// Core debug registers
+struct core_debug_reg_t
+{
+  /// Offset: 0x000 Debug Halting Control and Status Register
+  std::uint32_t volatile dhcsr;
+  /// Offset: 0x004 Debug Core Register Selector Register
+  std::uint32_t volatile dcrsr;
+  /// Offset: 0x008 Debug Core Register Data Register
+  std::uint32_t volatile dcrdr;
+  /// Offset: 0x00C Debug Exception and Monitor Control Register
+  std::uint32_t volatile demcr;
+};
+
+struct dwt_control
+{
+  /// Enable the cycle counter
+  static constexpr auto cycle_count_enable = bit_mask::from<0>();
+};
+
+struct debug_exception_monitor_control
+{
+  /// Global enable for the DWT and ITM units
+  static constexpr auto trace_enable = bit_mask::from<24>();
+};
+
+inline dwt_reg_t* dwt = reinterpret_cast<dwt_reg_t*>(0xE000'1000);
+inline core_debug_reg_t* core_debug =
+  reinterpret_cast<core_debug_reg_t*>(0xE000'EDF0);
+}  // namespace hal::stm32f4
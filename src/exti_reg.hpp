@@ -0,0 +1,83 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <libhal-stm32f4/constants.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal-util/enum.hpp>
+
+namespace hal::stm32f4 {
+/// External interrupt/event controller registers
+struct exti_reg_t
+{
+  /// Offset: 0x00 Interrupt Mask Register
+  std::uint32_t volatile imr;
+  /// Offset: 0x04 Event Mask Register
+  std::uint32_t volatile emr;
+  /// Offset: 0x08 Rising Trigger Selection Register
+  std::uint32_t volatile rtsr;
+  /// Offset: 0x0C Falling Trigger Selection Register
+  std::uint32_t volatile ftsr;
+  /// Offset: 0x10 Software Interrupt Event Register
+  std::uint32_t volatile swier;
+  /// Offset: 0x14 Pending Register (write 1 to clear)
+  std::uint32_t volatile pr;
+};
+
+/// System configuration controller registers
+struct syscfg_reg_t
+{
+  /// Offset: 0x00 Memory Remap Register
+  std::uint32_t volatile memrmp;
+  /// Offset: 0x04 Peripheral Mode Configuration Register
+  std::uint32_t volatile pmc;
+  /// Offset: 0x08 External Interrupt Configuration Registers, 4 bits per line
+  /// selecting the gpio port of lines 0 to 15
+  std::array<std::uint32_t volatile, 4> exticr;
+  std::array<std::uint32_t volatile, 2> reserved0;
+  /// Offset: 0x20 Compensation Cell Control Register
+  std::uint32_t volatile cmpcr;
+};
+
+/// EXTI lines 0 to 15 are connected to the gpio pin of the same number
+inline constexpr std::uint8_t exti_gpio_line_count = 16;
+/// EXTI line connected to the RTC wakeup timer
+inline constexpr std::uint8_t exti_rtc_wakeup_line = 22;
+
+/**
+ * @brief Get the interrupt raised by a gpio EXTI line
+ *
+ * Lines 5 to 9 and 10 to 15 share an interrupt.
+ *
+ * @param p_line - EXTI line 0-15
+ * @return irq - interrupt of the line
+ */
+constexpr irq exti_irq(std::uint8_t p_line)
+{
+  if (p_line <= 4) {
+    return static_cast<irq>(hal::value(irq::exti0) + p_line);
+  }
+  if (p_line <= 9) {
+    return irq::exi9_5;
+  }
+  return irq::exti15_10;
+}
+
+inline exti_reg_t* exti = reinterpret_cast<exti_reg_t*>(0x4001'3C00);
+inline syscfg_reg_t* syscfg = reinterpret_cast<syscfg_reg_t*>(0x4001'3800);
+}  // namespace hal::stm32f4
@@ -0,0 +1,56 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+
+#include <libhal-util/bit.hpp>
+
+namespace hal::stm32f4 {
+/// Flash interface registers
+struct flash_reg_t
+{
+  /// Offset: 0x00 Access Control Register
+  std::uint32_t volatile acr;
+  /// Offset: 0x04 Key Register
+  std::uint32_t volatile keyr;
+  /// Offset: 0x08 Option Key Register
+  std::uint32_t volatile optkeyr;
+  /// Offset: 0x0C Status Register
+  std::uint32_t volatile sr;
+  /// Offset: 0x10 Control Register
+  std::uint32_t volatile cr;
+  /// Offset: 0x14 Option Control Register
+  std::uint32_t volatile optcr;
+};
+
+/// Flash Access Control Register
+struct flash_access_control
+{
+  /// Wait states inserted in flash reads, in CPU cycles
+  static constexpr auto latency = bit_mask::from<3, 0>();
+
+  /// Prefetch enable
+  static constexpr auto prefetch_enable = bit_mask::from<8>();
+
+  /// Instruction cache enable
+  static constexpr auto instruction_cache_enable = bit_mask::from<9>();
+
+  /// Data cache enable
+  static constexpr auto data_cache_enable = bit_mask::from<10>();
+};
+
+inline flash_reg_t* flash = reinterpret_cast<flash_reg_t*>(0x4002'3C00);
+}  // namespace hal::stm32f4
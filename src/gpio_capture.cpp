@@ -0,0 +1,220 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include <libhal-stm32f4/clock.hpp>
+#include <libhal-stm32f4/gpio_capture.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal-util/enum.hpp>
+#include <libhal/error.hpp>
+
+#include "dma.hpp"
+#include "gpio_reg.hpp"
+#include "mmio.hpp"
+#include "power.hpp"
+#include "profile_scope.hpp"
+#include "timer_common.hpp"
+#include "timer_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+/// TIM1_UP is routed to DMA2 stream 5 on channel 6 only
+constexpr dma_request capture_dma{ .controller = 2, .stream = 5, .channel = 6 };
+/// NDTR is a 16-bit counter and the buffer is split into two halves
+constexpr std::size_t max_buffer_size = 65534;
+constexpr std::uint32_t very_high_priority = 0b11;
+constexpr std::uint32_t half_word = 0b01;
+
+resource_list timer_resources()
+{
+  resource_list resources;
+  resources.add(peripheral_resource(peripheral::timer1));
+  return resources;
+}
+}  // namespace
+
+gpio_capture::gpio_capture(peripheral p_port,
+                           std::span<std::uint16_t> p_buffer,
+                           handler p_on_samples,
+                           gpio_capture_settings const& p_settings)
+  : m_resources(timer_resources())
+  , m_buffer(p_buffer)
+  , m_on_samples(std::move(p_on_samples))
+  , m_port(p_port)
+{
+  if (hal::value(p_port) > hal::value(peripheral::gpio_h) ||
+      p_buffer.empty() || p_buffer.size() % 2 != 0 ||
+      p_buffer.size() > max_buffer_size) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  auto const period = calculate_timer_period(clock_rate(peripheral::timer1),
+                                             p_settings.sample_rate);
+  if (!period) {
+    hal::safe_throw(hal::operation_not_supported(this));
+  }
+  m_sample_rate = period->rate();
+  m_requested_rate = p_settings.sample_rate;
+
+  auto const options = std::array{ capture_dma };
+  claim_dma_stream(options);
+
+  power(peripheral::timer1).on();
+  mmio_write(timer_reg1->cr1,
+             bit_value(0U).set<timer_control1::update_request_source>().get());
+  mmio_write(timer_reg1->psc, period->prescaler);
+  mmio_write(timer_reg1->arr, period->reload);
+
+  on_dma_interrupt(capture_dma, [this]() { handle_interrupt(); });
+}
+
+gpio_capture::~gpio_capture()
+{
+  stop();
+  release_dma_stream(capture_dma);
+  mmio_write(timer_reg1->cr1, 0U);
+  power(peripheral::timer1).off();
+}
+
+void gpio_capture::start(mode p_mode, trigger p_trigger)
+{
+  stop();
+
+  m_mode = p_mode;
+  m_trigger = p_trigger;
+  m_triggered = false;
+  m_remaining = m_buffer.size();
+
+  // Without a trigger, a one shot capture delivers the whole buffer once it
+  // is full. Otherwise the buffer is filled continuously and searched, half
+  // by half, for the trigger.
+  auto const circular = p_mode == mode::circular || p_trigger.mask != 0;
+  auto config =
+    bit_value(0U)
+      .insert<dma_stream_config::channel>(std::uint32_t{ capture_dma.channel })
+      .insert<dma_stream_config::priority>(very_high_priority)
+      .insert<dma_stream_config::peripheral_size>(half_word)
+      .insert<dma_stream_config::memory_size>(half_word)
+      .set<dma_stream_config::memory_increment>()
+      .insert<dma_stream_config::direction>(
+        dma_direction::peripheral_to_memory)
+      .set<dma_stream_config::transfer_complete_interrupt_enable>();
+  if (circular) {
+    config.set<dma_stream_config::circular_mode>()
+      .set<dma_stream_config::half_transfer_interrupt_enable>();
+  }
+
+  auto& stream = dma_stream(capture_dma);
+  mmio_write(stream.par, mmio_address(&get_reg(m_port)->input_data));
+  mmio_write(stream.m0ar, mmio_address(m_buffer.data()));
+  mmio_write(stream.ndtr, static_cast<std::uint32_t>(m_buffer.size()));
+  // Direct mode, each sample is stored as soon as it is taken
+  mmio_write(stream.fcr, 0U);
+  mmio_write(stream.cr, config.get());
+  mmio_write(stream.cr, config.set<dma_stream_config::enable>().get());
+
+  // Restart the counter without requesting a transfer, then take a sample
+  // at every update
+  m_running = true;
+  mmio_write(timer_reg1->egr,
+             bit_value(0U).set<timer_event_generation::update>().get());
+  mmio_write(timer_reg1->sr, 0U);
+  mmio_write(timer_reg1->dier,
+             bit_value(0U).set<timer_dma_requests::update>().get());
+  mmio_set_bit(timer_reg1->cr1, timer_control1::counter_enable);
+}
+
+void gpio_capture::stop()
+{
+  if (!m_running) {
+    return;
+  }
+  mmio_clear_bit(timer_reg1->cr1, timer_control1::counter_enable);
+  mmio_write(timer_reg1->dier, 0U);
+  stop_dma_stream(capture_dma);
+  m_running = false;
+}
+
+bool gpio_capture::running() const
+{
+  return m_running;
+}
+
+bool gpio_capture::triggered() const
+{
+  return m_triggered;
+}
+
+hal::hertz gpio_capture::sample_rate() const
+{
+  return m_sample_rate;
+}
+
+void gpio_capture::retime()
+{
+  m_sample_rate = retime_timer(
+    timer_reg1, clock_rate(peripheral::timer1), m_requested_rate);
+}
+
+void gpio_capture::handle_interrupt()
+{
+  profile_scope scope(profile_point::dma_complete);
+  auto const flags = take_dma_flags(capture_dma);
+  auto const circular = bit_extract<dma_stream_config::circular_mode>(
+    mmio_read(dma_stream(capture_dma).cr));
+  auto const half = m_buffer.size() / 2;
+
+  // The half transfer flag is also raised when its interrupt is disabled
+  if (circular && bit_extract<dma_stream_flags::half_transfer>(flags)) {
+    deliver(m_buffer.first(half));
+  }
+  if (bit_extract<dma_stream_flags::transfer_complete>(flags)) {
+    deliver(circular ? m_buffer.last(half) : m_buffer);
+  }
+}
+
+void gpio_capture::deliver(std::span<std::uint16_t const> p_samples)
+{
+  if (!m_running) {
+    return;
+  }
+
+  if (!m_triggered) {
+    auto const match = std::ranges::find_if(
+      p_samples, [this](std::uint16_t p_sample) {
+        return m_trigger.matches(p_sample);
+      });
+    if (match == p_samples.end()) {
+      return;
+    }
+    m_triggered = true;
+    p_samples = p_samples.subspan(
+      static_cast<std::size_t>(match - p_samples.begin()));
+  }
+
+  if (m_mode == mode::one_shot) {
+    p_samples = p_samples.first(std::min(p_samples.size(), m_remaining));
+    m_remaining -= p_samples.size();
+    if (m_remaining == 0) {
+      stop();
+    }
+  }
+  if (!p_samples.empty()) {
+    m_on_samples(p_samples);
+  }
+}
+}  // namespace hal::stm32f4
@@ -53,10 +53,12 @@ struct stm32f4_gpio_t
 };
 
 inline constexpr intptr_t ahb_base = 0x4002'0000UL;
+/// Address of the first gpio port, can be redirected for host testing
+inline intptr_t gpio_base = ahb_base;
 static inline stm32f4_gpio_t* get_reg(hal::stm32f4::peripheral p_port)
 {
   // STM has dedicated memory blocks where every 2^10 is a new
-  return reinterpret_cast<stm32f4_gpio_t*>(ahb_base +
+  return reinterpret_cast<stm32f4_gpio_t*>(gpio_base +
                                            (static_cast<int>(p_port) << 10));
 }
 }  // namespace hal::stm32f4
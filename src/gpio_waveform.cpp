@@ -0,0 +1,172 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include <libhal-stm32f4/clock.hpp>
+#include <libhal-stm32f4/gpio_waveform.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal-util/enum.hpp>
+#include <libhal/error.hpp>
+
+#include "dma.hpp"
+#include "gpio_reg.hpp"
+#include "mmio.hpp"
+#include "power.hpp"
+#include "profile_scope.hpp"
+#include "timer_common.hpp"
+#include "timer_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+/// TIM1_UP is routed to DMA2 stream 5 on channel 6 only
+constexpr dma_request waveform_dma{ .controller = 2,
+                                    .stream = 5,
+                                    .channel = 6 };
+/// NDTR is a 16-bit counter
+constexpr std::size_t max_words = 65535;
+constexpr std::uint32_t very_high_priority = 0b11;
+constexpr std::uint32_t word = 0b10;
+
+resource_list timer_resources()
+{
+  resource_list resources;
+  resources.add(peripheral_resource(peripheral::timer1));
+  return resources;
+}
+}  // namespace
+
+gpio_waveform::gpio_waveform(peripheral p_port,
+                             handler p_on_finished,
+                             gpio_waveform_settings const& p_settings)
+  : m_resources(timer_resources())
+  , m_on_finished(std::move(p_on_finished))
+  , m_port(p_port)
+{
+  if (hal::value(p_port) > hal::value(peripheral::gpio_h)) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  auto const period = calculate_timer_period(clock_rate(peripheral::timer1),
+                                             p_settings.word_rate);
+  if (!period) {
+    hal::safe_throw(hal::operation_not_supported(this));
+  }
+  m_word_rate = period->rate();
+  m_requested_rate = p_settings.word_rate;
+
+  auto const options = std::array{ waveform_dma };
+  claim_dma_stream(options);
+
+  power(peripheral::timer1).on();
+  mmio_write(timer_reg1->cr1,
+             bit_value(0U).set<timer_control1::update_request_source>().get());
+  mmio_write(timer_reg1->psc, period->prescaler);
+  mmio_write(timer_reg1->arr, period->reload);
+
+  on_dma_interrupt(waveform_dma, [this]() { handle_interrupt(); });
+}
+
+gpio_waveform::~gpio_waveform()
+{
+  stop();
+  release_dma_stream(waveform_dma);
+  mmio_write(timer_reg1->cr1, 0U);
+  power(peripheral::timer1).off();
+}
+
+void gpio_waveform::play(std::span<std::uint32_t const> p_words, mode p_mode)
+{
+  if (p_words.empty() || p_words.size() > max_words) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  stop();
+
+  // Word accesses to the set/reset register update set and reset bits with a
+  // single bus write, so the pins of a word change together
+  auto config =
+    bit_value(0U)
+      .insert<dma_stream_config::channel>(std::uint32_t{ waveform_dma.channel })
+      .insert<dma_stream_config::priority>(very_high_priority)
+      .insert<dma_stream_config::peripheral_size>(word)
+      .insert<dma_stream_config::memory_size>(word)
+      .set<dma_stream_config::memory_increment>()
+      .insert<dma_stream_config::direction>(
+        dma_direction::memory_to_peripheral);
+  if (p_mode == mode::repeat) {
+    config.set<dma_stream_config::circular_mode>();
+  } else {
+    config.set<dma_stream_config::transfer_complete_interrupt_enable>();
+  }
+
+  auto& stream = dma_stream(waveform_dma);
+  mmio_write(stream.par, mmio_address(&get_reg(m_port)->set));
+  mmio_write(stream.m0ar, mmio_address(p_words.data()));
+  mmio_write(stream.ndtr, static_cast<std::uint32_t>(p_words.size()));
+  // Direct mode, each word is fetched when it is requested
+  mmio_write(stream.fcr, 0U);
+  mmio_write(stream.cr, config.get());
+  mmio_write(stream.cr, config.set<dma_stream_config::enable>().get());
+
+  // Restart the counter without requesting a transfer, then write a word at
+  // every update
+  m_playing = true;
+  mmio_write(timer_reg1->egr,
+             bit_value(0U).set<timer_event_generation::update>().get());
+  mmio_write(timer_reg1->sr, 0U);
+  mmio_write(timer_reg1->dier,
+             bit_value(0U).set<timer_dma_requests::update>().get());
+  mmio_set_bit(timer_reg1->cr1, timer_control1::counter_enable);
+}
+
+void gpio_waveform::stop()
+{
+  if (!m_playing) {
+    return;
+  }
+  mmio_clear_bit(timer_reg1->cr1, timer_control1::counter_enable);
+  mmio_write(timer_reg1->dier, 0U);
+  stop_dma_stream(waveform_dma);
+  m_playing = false;
+}
+
+bool gpio_waveform::playing() const
+{
+  return m_playing;
+}
+
+hal::hertz gpio_waveform::word_rate() const
+{
+  return m_word_rate;
+}
+
+void gpio_waveform::retime()
+{
+  m_word_rate = retime_timer(
+    timer_reg1, clock_rate(peripheral::timer1), m_requested_rate);
+}
+
+void gpio_waveform::handle_interrupt()
+{
+  profile_scope scope(profile_point::dma_complete);
+  auto const flags = take_dma_flags(waveform_dma);
+  if (!m_playing ||
+      !bit_extract<dma_stream_flags::transfer_complete>(flags)) {
+    return;
+  }
+  stop();
+  m_on_finished();
+}
+}  // namespace hal::stm32f4
@@ -15,12 +15,14 @@
 #include <cstdint>
 
 #include <libhal-stm32f4/input_pin.hpp>
+#include <libhal-stm32f4/port_configuration.hpp>
 
 #include "gpio_reg.hpp"
 #include "power.hpp"
+#include "profile_scope.hpp"
 #include <libhal-util/bit.hpp>
 
-#include "gpio_reg.hpp"
+#include "mmio.hpp"
 
 namespace hal::stm32f4 {
 input_pin::input_pin(hal::stm32f4::peripheral p_port,
@@ -34,22 +36,20 @@ input_pin::input_pin(hal::stm32f4::peripheral p_port,
 
 void input_pin::driver_configure(settings const& p_settings)
 {
-  bit_mask pin_mode_mask = { .position = 2 * static_cast<uint32_t>(m_pin),
-                             .width = 2 };
-
-  bit_modify(get_reg(m_port)->pin_mode).clear(pin_mode_mask);
-
-  pin(m_port, m_pin)
-    .function(pin::pin_function::input)
-    .open_drain(false)
-    .resistor(p_settings.resistor);
+  profile_scope scope(profile_point::pin_configure);
+  port_configuration(m_port)
+    .function(m_pin, pin::pin_function::input)
+    .open_drain(m_pin, false)
+    .resistor(m_pin, p_settings.resistor)
+    .commit();
 }
 
 bool input_pin::driver_level()
 {
   bit_mask input_data_mask = { .position = static_cast<uint32_t>(m_pin),
                                .width = 1 };
-  auto pin_value = bit_extract(input_data_mask, get_reg(m_port)->input_data);
+  auto pin_value =
+    bit_extract(input_data_mask, mmio_read(get_reg(m_port)->input_data));
   return static_cast<bool>(pin_value);
 }
 }  // namespace hal::stm32f4
@@ -0,0 +1,175 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+
+#include <libhal-stm32f4/constants.hpp>
+#include <libhal-stm32f4/interrupt.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal-util/enum.hpp>
+#include <libhal/error.hpp>
+
+#include "mmio.hpp"
+#include "nvic_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+constexpr std::size_t vector_count = core_vector_count + hal::value(irq::max);
+/// VTOR requires the table to be aligned to the next power of two of its size,
+/// and to at least 128 bytes.
+constexpr std::size_t vector_table_alignment = std::max<std::size_t>(
+  128,
+  std::bit_ceil(vector_count * sizeof(std::uint32_t)));
+
+alignas(vector_table_alignment)
+  std::array<interrupt_handler, vector_count> vector_table{};
+
+std::size_t validate(irq p_irq)
+{
+  auto const index = static_cast<std::size_t>(hal::value(p_irq));
+  if (index >= hal::value(irq::max)) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+  return index;
+}
+
+bit_mask enable_mask(std::size_t p_index)
+{
+  return bit_mask::from(static_cast<std::uint32_t>(p_index % 32));
+}
+
+void memory_barrier()
+{
+#if defined(__arm__)
+  asm volatile("dsb 0xF" ::: "memory");
+  asm volatile("isb 0xF" ::: "memory");
+#endif
+}
+}  // namespace
+
+void initialize_interrupts()
+{
+  if (interrupts_initialized()) {
+    return;
+  }
+
+  // VTOR resets to 0, which aliases the start of flash, so the initial value
+  // always points at the active table. Startup tables may stop after the
+  // core vectors, so only those are copied and the peripheral slots start
+  // empty.
+  auto const* current_table =
+    static_cast<interrupt_handler const*>(mmio_pointer(mmio_read(scb->vtor)));
+  auto const peripheral_slots =
+    std::copy_n(current_table, core_vector_count, vector_table.begin());
+  std::fill(peripheral_slots, vector_table.end(), nullptr);
+
+  mmio_write(scb->vtor, mmio_address(vector_table.data()));
+  memory_barrier();
+}
+
+bool interrupts_initialized()
+{
+  return mmio_pointer(mmio_read(scb->vtor)) == vector_table.data();
+}
+
+void enable_interrupt(irq p_irq, interrupt_handler p_handler)
+{
+  auto const index = validate(p_irq);
+  initialize_interrupts();
+
+  vector_table[core_vector_count + index] = p_handler;
+  memory_barrier();
+  // Enable registers are write 1 to set, so no read-modify-write is needed
+  mmio_write(nvic->iser[index / 32],
+             bit_value(0U).set(enable_mask(index)).get());
+}
+
+void disable_interrupt(irq p_irq)
+{
+  auto const index = validate(p_irq);
+  mmio_write(nvic->icer[index / 32],
+             bit_value(0U).set(enable_mask(index)).get());
+  memory_barrier();
+}
+
+bool is_interrupt_enabled(irq p_irq)
+{
+  auto const index = validate(p_irq);
+  return bit_extract(enable_mask(index), mmio_read(nvic->iser[index / 32]));
+}
+
+interrupt_handler interrupt_vector(irq p_irq)
+{
+  auto const index = validate(p_irq);
+  if (!interrupts_initialized()) {
+    return nullptr;
+  }
+  return vector_table[core_vector_count + index];
+}
+
+void set_interrupt_priority(irq p_irq, std::uint8_t p_priority)
+{
+  auto const index = validate(p_irq);
+  if (p_priority > lowest_interrupt_priority) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+  // Only the upper bits of each priority field are implemented
+  mmio_write(nvic->ip[index],
+             static_cast<std::uint8_t>(p_priority
+                                       << (8 - nvic_priority_bits)));
+}
+
+std::uint8_t interrupt_priority(irq p_irq)
+{
+  auto const index = validate(p_irq);
+  return static_cast<std::uint8_t>(mmio_read(nvic->ip[index]) >>
+                                   (8 - nvic_priority_bits));
+}
+
+void set_priority_grouping(std::uint8_t p_preemption_bits)
+{
+  if (p_preemption_bits > nvic_priority_bits) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+  // PRIGROUP is the bit position of the binary point within the 8-bit
+  // priority field. Preemption bits are above it.
+  auto const priority_group = static_cast<std::uint32_t>(7 - p_preemption_bits);
+  mmio_write(
+    scb->aircr,
+    bit_value(0U)
+      .insert<application_interrupt_reset_control::vector_key>(
+        application_interrupt_reset_control::vector_key_value)
+      .insert<application_interrupt_reset_control::priority_group>(
+        priority_group)
+      .get());
+}
+
+critical_section::critical_section()
+{
+#if defined(__arm__)
+  asm volatile("mrs %0, primask" : "=r"(m_previous_mask));
+  asm volatile("cpsid i" ::: "memory");
+#endif
+}
+
+critical_section::~critical_section()
+{
+#if defined(__arm__)
+  asm volatile("msr primask, %0" ::"r"(m_previous_mask) : "memory");
+#endif
+}
+}  // namespace hal::stm32f4
@@ -0,0 +1,317 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdint>
+
+#include <libhal-stm32f4/constants.hpp>
+#include <libhal-stm32f4/low_power.hpp>
+#include <libhal-stm32f4/profile.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal-util/enum.hpp>
+#include <libhal/error.hpp>
+
+#include "dwt_reg.hpp"
+#include "exti_reg.hpp"
+#include "mmio.hpp"
+#include "nvic_reg.hpp"
+#include "power.hpp"
+#include "pwr_reg.hpp"
+#include "rcc_reg.hpp"
+#include "rtc_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+/// Clock sources in use before entering stop
+struct clock_tree
+{
+  bool hse = false;
+  bool hse_bypass = false;
+  bool pll = false;
+  std::uint32_t system_clock = 0;
+};
+
+/// RTCSEL values
+constexpr std::uint32_t rtc_clock_none = 0b00;
+constexpr std::uint32_t rtc_clock_lse = 0b01;
+constexpr std::uint32_t rtc_clock_lsi = 0b10;
+/// The wakeup timer is clocked from RTCCLK / 16
+constexpr std::uint32_t lsi_wakeup_rate = 32'000 / 16;
+constexpr std::uint32_t lse_wakeup_rate = 32'768 / 16;
+constexpr std::uint32_t max_wakeup_ticks = 1 << 16;
+
+clock_tree save_clock_tree()
+{
+  auto const control = mmio_read(rcc->cr);
+  return {
+    .hse = bit_extract<clock_control::hse_enable>(control) != 0,
+    .hse_bypass = bit_extract<clock_control::hse_bypass>(control) != 0,
+    .pll = bit_extract<clock_control::pll_enable>(control) != 0,
+    .system_clock =
+      bit_extract<rcc_cnfg::system_clock_switch>(mmio_read(rcc->cfgr)),
+  };
+}
+
+void restore_clock_tree(clock_tree const& p_clocks)
+{
+  if (p_clocks.hse) {
+    mmio_modify(rcc->cr)
+      .insert<clock_control::hse_bypass>(
+        static_cast<std::uint32_t>(p_clocks.hse_bypass))
+      .set<clock_control::hse_enable>();
+    while (!bit_extract<clock_control::hse_ready>(mmio_read(rcc->cr))) {
+      continue;
+    }
+  }
+
+  // The PLL configuration is retained in stop, only its enable bit is cleared
+  if (p_clocks.pll) {
+    mmio_set_bit(rcc->cr, clock_control::pll_enable);
+    while (!bit_extract<clock_control::pll_ready>(mmio_read(rcc->cr))) {
+      continue;
+    }
+  }
+
+  if (p_clocks.system_clock != 0) {
+    mmio_modify(rcc->cfgr)
+      .insert<rcc_cnfg::system_clock_switch>(p_clocks.system_clock);
+    while (bit_extract<rcc_cnfg::system_clock_status_switch>(
+             mmio_read(rcc->cfgr)) != p_clocks.system_clock) {
+      continue;
+    }
+  }
+}
+
+/// Clear the RTC wakeup flag so that it can wake the device again
+void clear_rtc_wake_flag()
+{
+  if (!bit_extract<rtc_status::wakeup_timer_flag>(mmio_read(rtc->isr))) {
+    return;
+  }
+  mmio_modify(rtc->isr).clear<rtc_status::wakeup_timer_flag>();
+  // Pending bits are write 1 to clear
+  mmio_write(exti->pr,
+             bit_value(0U).set(bit_mask::from(exti_rtc_wakeup_line)).get());
+}
+
+void clear_event_register()
+{
+#if defined(__arm__)
+  // Set the event register, then consume it, so that only events arriving
+  // from here on wake the next WFE
+  asm volatile("sev" ::: "memory");
+  asm volatile("wfe" ::: "memory");
+#endif
+}
+
+void unlock_rtc()
+{
+  mmio_write(rtc->wpr, rtc_unlock_key1);
+  mmio_write(rtc->wpr, rtc_unlock_key2);
+}
+
+void lock_rtc()
+{
+  mmio_write(rtc->wpr, rtc_lock_key);
+}
+
+std::uint32_t select_rtc_clock()
+{
+  auto const source =
+    bit_extract<backup_domain_control::rtc_clock_select>(mmio_read(rcc->bdcr));
+
+  switch (source) {
+    case rtc_clock_lse:
+      return lse_wakeup_rate;
+    case rtc_clock_lsi:
+      break;
+    case rtc_clock_none:
+      mmio_modify(rcc->bdcr)
+        .insert<backup_domain_control::rtc_clock_select>(rtc_clock_lsi);
+      break;
+    default:
+      hal::safe_throw(hal::operation_not_supported(nullptr));
+  }
+
+  mmio_set_bit(rcc->csr, clock_status::lsi_enable);
+  while (!bit_extract<clock_status::lsi_ready>(mmio_read(rcc->csr))) {
+    continue;
+  }
+  return lsi_wakeup_rate;
+}
+
+void validate_gpio_pin(std::uint8_t p_pin)
+{
+  if (p_pin >= exti_gpio_line_count) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+}
+}  // namespace
+
+void sleep()
+{
+  mmio_modify(scb->scr).clear<system_control::sleep_deep>();
+  wait_for_interrupt();
+}
+
+std::uint32_t stop(stop_settings const& p_settings)
+{
+  power(peripheral::power).on();
+  auto const clocks = save_clock_tree();
+  clear_rtc_wake_flag();
+
+  mmio_modify(pwr->cr)
+    .clear<power_control::power_down_deep_sleep>()
+    .insert<power_control::low_power_deep_sleep>(
+      static_cast<std::uint32_t>(p_settings.low_power_regulator))
+    .insert<power_control::flash_power_down>(
+      static_cast<std::uint32_t>(p_settings.flash_power_down));
+  // SEVONPEND changes what wakes WFE, so it is put back as found on wake
+  auto const send_event_on_pending =
+    bit_extract<system_control::send_event_on_pending>(mmio_read(scb->scr));
+  mmio_modify(scb->scr)
+    .set<system_control::sleep_deep>()
+    .set<system_control::send_event_on_pending>();
+
+  clear_event_register();
+  wait_for_event();
+
+  // Read directly, like profile_scope, so the measurement does not show up in
+  // register traces
+  auto const wake_cycle = dwt->cyccnt;
+  mmio_modify(scb->scr)
+    .clear<system_control::sleep_deep>()
+    .insert<system_control::send_event_on_pending>(send_event_on_pending);
+  restore_clock_tree(clocks);
+  auto const restore_cycles = dwt->cyccnt - wake_cycle;
+
+#if LIBHAL_STM32F4_PROFILE
+  profile(profile_point::stop_wake).record(restore_cycles);
+#endif
+  return restore_cycles;
+}
+
+void standby()
+{
+  power(peripheral::power).on();
+  // A set wakeup flag would wake the device immediately
+  clear_rtc_wake_flag();
+  mmio_modify(pwr->cr)
+    .set<power_control::clear_wakeup_flag>()
+    .set<power_control::power_down_deep_sleep>();
+  mmio_modify(scb->scr).set<system_control::sleep_deep>();
+
+  while (true) {
+    wait_for_interrupt();
+  }
+}
+
+void enable_pin_wake(peripheral p_port, std::uint8_t p_pin, wake_edge p_edge)
+{
+  validate_gpio_pin(p_pin);
+  auto const port = hal::value(p_port);
+  if (port > hal::value(peripheral::gpio_h)) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+
+  power(peripheral::system_config_controller).on();
+  bit_mask const port_mask = { .position = (p_pin % 4U) * 4U, .width = 4 };
+  mmio_modify(syscfg->exticr[p_pin / 4]).insert(port_mask, port);
+
+  auto const line = bit_mask::from(p_pin);
+  mmio_write_bit(exti->rtsr, line, p_edge != wake_edge::falling);
+  mmio_write_bit(exti->ftsr, line, p_edge != wake_edge::rising);
+  mmio_set_bit(exti->emr, line);
+}
+
+void disable_pin_wake(std::uint8_t p_pin)
+{
+  validate_gpio_pin(p_pin);
+  auto const line = bit_mask::from(p_pin);
+  mmio_clear_bit(exti->emr, line);
+  mmio_clear_bit(exti->rtsr, line);
+  mmio_clear_bit(exti->ftsr, line);
+}
+
+void enable_rtc_wake(hal::time_duration p_period)
+{
+  using period = std::chrono::duration<std::uint64_t, std::micro>;
+  auto const microseconds =
+    std::chrono::duration_cast<period>(p_period).count();
+
+  power(peripheral::power).on();
+  mmio_set_bit(pwr->cr, power_control::disable_backup_protection);
+  auto const rate = select_rtc_clock();
+  auto const ticks = (microseconds * rate) / 1'000'000;
+  if (p_period.count() <= 0 || ticks == 0 || ticks > max_wakeup_ticks) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+  mmio_set_bit(rcc->bdcr, backup_domain_control::rtc_enable);
+
+  unlock_rtc();
+  mmio_modify(rtc->cr)
+    .clear<rtc_control::wakeup_timer_enable>()
+    .clear<rtc_control::wakeup_timer_interrupt>();
+  while (!bit_extract<rtc_status::wakeup_timer_write_flag>(
+    mmio_read(rtc->isr))) {
+    continue;
+  }
+  mmio_write(rtc->wutr, static_cast<std::uint32_t>(ticks - 1));
+  mmio_modify(rtc->isr).clear<rtc_status::wakeup_timer_flag>();
+  mmio_modify(rtc->cr)
+    .insert<rtc_control::wakeup_clock_select>(0b000U)
+    .set<rtc_control::wakeup_timer_interrupt>()
+    .set<rtc_control::wakeup_timer_enable>();
+  lock_rtc();
+
+  auto const line = bit_mask::from(exti_rtc_wakeup_line);
+  mmio_set_bit(exti->rtsr, line);
+  mmio_set_bit(exti->emr, line);
+}
+
+void disable_rtc_wake()
+{
+  power(peripheral::power).on();
+  mmio_set_bit(pwr->cr, power_control::disable_backup_protection);
+  unlock_rtc();
+  mmio_modify(rtc->cr)
+    .clear<rtc_control::wakeup_timer_enable>()
+    .clear<rtc_control::wakeup_timer_interrupt>();
+  lock_rtc();
+
+  auto const line = bit_mask::from(exti_rtc_wakeup_line);
+  mmio_clear_bit(exti->emr, line);
+  mmio_clear_bit(exti->rtsr, line);
+}
+
+void enable_wakeup_pin(bool p_enable)
+{
+  power(peripheral::power).on();
+  mmio_write_bit(pwr->csr, power_status::enable_wakeup_pin, p_enable);
+}
+
+bool woke_from_standby()
+{
+  power(peripheral::power).on();
+  return bit_extract<power_status::standby_flag>(mmio_read(pwr->csr));
+}
+
+void clear_wake_flags()
+{
+  power(peripheral::power).on();
+  mmio_modify(pwr->cr)
+    .set<power_control::clear_standby_flag>()
+    .set<power_control::clear_wakeup_flag>();
+}
+}  // namespace hal::stm32f4
@@ -0,0 +1,359 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <libhal-stm32f4/bit_band.hpp>
+#include <libhal-stm32f4/register_trace.hpp>
+#include <libhal-util/bit.hpp>
+
+namespace hal::stm32f4 {
+/**
+ * @brief Observer of the register accesses performed by drivers
+ *
+ * Host builds install an observer to model peripheral behavior (status flags,
+ * set/reset registers, etc) on top of plain memory. `register_trace` installs
+ * one to count accesses. Only called when LIBHAL_STM32F4_MMIO_HOOKS is 1.
+ */
+class mmio_observer
+{
+public:
+  /**
+   * @brief Called before a register is loaded
+   *
+   * @param p_kind - read, or the read half of a modify
+   * @param p_address - address of the register
+   */
+  virtual void before_read(register_access p_kind,
+                           std::uintptr_t p_address) = 0;
+  /**
+   * @brief Called after a register is stored
+   *
+   * @param p_kind - write, or the write half of a modify
+   * @param p_address - address of the register
+   */
+  virtual void after_write(register_access p_kind,
+                           std::uintptr_t p_address) = 0;
+  /**
+   * @brief Called right before the core executes WFI or WFE
+   *
+   * Depending on SCR and the power controller, this is where the device
+   * enters sleep, stop or standby.
+   */
+  virtual void before_wait()
+  {
+  }
+
+protected:
+  ~mmio_observer() = default;
+};
+
+/// Currently installed observer, nullptr if no one is observing
+inline mmio_observer* mmio_hook = nullptr;
+
+namespace internal {
+inline void notify_read([[maybe_unused]] register_access p_kind,
+                        [[maybe_unused]] void const volatile* p_register)
+{
+#if LIBHAL_STM32F4_MMIO_HOOKS
+  if (mmio_hook) {
+    mmio_hook->before_read(p_kind,
+                           reinterpret_cast<std::uintptr_t>(p_register));
+  }
+#endif
+}
+
+inline void notify_write([[maybe_unused]] register_access p_kind,
+                         [[maybe_unused]] void const volatile* p_register)
+{
+#if LIBHAL_STM32F4_MMIO_HOOKS
+  if (mmio_hook) {
+    mmio_hook->after_write(p_kind,
+                           reinterpret_cast<std::uintptr_t>(p_register));
+  }
+#endif
+}
+
+inline void notify_wait()
+{
+#if LIBHAL_STM32F4_MMIO_HOOKS
+  if (mmio_hook) {
+    mmio_hook->before_wait();
+  }
+#endif
+}
+}  // namespace internal
+
+/**
+ * @brief Load the value of a register
+ *
+ * @param p_register - register to read
+ * @return T - current value of the register
+ */
+template<std::unsigned_integral T>
+[[nodiscard]] inline T mmio_read(T const volatile& p_register)
+{
+  internal::notify_read(register_access::read, &p_register);
+  return p_register;
+}
+
+/**
+ * @brief Store a value into a register
+ *
+ * @param p_register - register to write
+ * @param p_value - value to store in the register
+ */
+template<std::unsigned_integral T>
+inline void mmio_write(T volatile& p_register, std::type_identity_t<T> p_value)
+{
+  p_register = p_value;
+  internal::notify_write(register_access::write, &p_register);
+}
+
+/**
+ * @brief Replace the bits of a register selected by a mask
+ *
+ * Performs a single read-modify-write, like mmio_modify, but the selected bits
+ * do not need to be contiguous. Used to commit many fields at once.
+ *
+ * @param p_register - register to update
+ * @param p_mask - bits to replace
+ * @param p_value - new value of the selected bits, other bits are ignored
+ */
+template<std::unsigned_integral T>
+inline void mmio_update(T volatile& p_register,
+                        std::type_identity_t<T> p_mask,
+                        std::type_identity_t<T> p_value)
+{
+  internal::notify_read(register_access::modify, &p_register);
+  T const current = p_register;
+  p_register = static_cast<T>((current & ~p_mask) | (p_value & p_mask));
+  internal::notify_write(register_access::modify, &p_register);
+}
+
+/**
+ * @brief Set or clear a single register bit with one store
+ *
+ * On target, registers in the peripheral bit-band region (APB1, APB2 and AHB1)
+ * are written through the alias word of the bit. The bus performs the
+ * read-modify-write, so an interrupt updating other bits of the same register
+ * can not be lost and no critical section is needed. Other registers fall
+ * back to a read-modify-write. Host builds update the register in place and
+ * report a single write, as on target.
+ *
+ * Not for registers holding write 1 to clear or write 0 to clear flags: the
+ * bus writes back every bit it read.
+ *
+ * @param p_register - register to update
+ * @param p_bit - single bit field
+ * @param p_value - new value of the bit
+ */
+inline void mmio_write_bit(std::uint32_t volatile& p_register,
+                           bit_mask p_bit,
+                           bool p_value)
+{
+  auto const mask = p_bit.value<std::uint32_t>();
+  if (auto* alias = internal::bit_band_word(p_register, p_bit.position)) {
+    *alias = static_cast<std::uint32_t>(p_value);
+    internal::notify_write(register_access::write, &p_register);
+    return;
+  }
+#if defined(__arm__)
+  internal::notify_read(register_access::modify, &p_register);
+  std::uint32_t const current = p_register;
+  p_register = p_value ? (current | mask) : (current & ~mask);
+  internal::notify_write(register_access::modify, &p_register);
+#else
+  std::uint32_t const current = p_register;
+  p_register = p_value ? (current | mask) : (current & ~mask);
+  internal::notify_write(register_access::write, &p_register);
+#endif
+}
+
+/**
+ * @brief Set a single register bit with one store, see mmio_write_bit()
+ *
+ * @param p_register - register to update
+ * @param p_bit - single bit field
+ */
+inline void mmio_set_bit(std::uint32_t volatile& p_register, bit_mask p_bit)
+{
+  mmio_write_bit(p_register, p_bit, true);
+}
+
+/**
+ * @brief Clear a single register bit with one store, see mmio_write_bit()
+ *
+ * @param p_register - register to update
+ * @param p_bit - single bit field
+ */
+inline void mmio_clear_bit(std::uint32_t volatile& p_register, bit_mask p_bit)
+{
+  mmio_write_bit(p_register, p_bit, false);
+}
+
+/**
+ * @brief Load a single register bit
+ *
+ * Reads through the bit-band alias on target when possible, which saves
+ * shifting and masking the register value.
+ *
+ * @param p_register - register to read
+ * @param p_bit - single bit field
+ * @return true - the bit is set
+ * @return false - the bit is clear
+ */
+[[nodiscard]] inline bool mmio_read_bit(
+  std::uint32_t const volatile& p_register,
+  bit_mask p_bit)
+{
+  internal::notify_read(register_access::read, &p_register);
+  if (auto const* alias = internal::bit_band_word(p_register, p_bit.position)) {
+    return *alias != 0;
+  }
+  return bit_extract(p_bit, std::uint32_t{ p_register }) != 0;
+}
+
+/**
+ * @brief Suspend the core until an interrupt is pending (WFI)
+ *
+ * Does nothing besides notifying the register hook on non-ARM builds.
+ */
+inline void wait_for_interrupt()
+{
+  internal::notify_wait();
+#if defined(__arm__)
+  asm volatile("wfi" ::: "memory");
+#endif
+}
+
+/**
+ * @brief Suspend the core until an event is received (WFE)
+ *
+ * Returns immediately if the event register was already set, clearing it.
+ * Does nothing besides notifying the register hook on non-ARM builds.
+ */
+inline void wait_for_event()
+{
+  internal::notify_wait();
+#if defined(__arm__)
+  asm volatile("wfe" ::: "memory");
+#endif
+}
+
+namespace internal {
+/// Host only: bases of the memory regions handed out by mmio_address()
+inline std::array<std::uintptr_t, 256> address_regions{};
+inline std::size_t next_address_region = 1;
+/// Host only: size of the region addressable from each base
+inline constexpr std::uintptr_t address_region_size = 1 << 24;
+}  // namespace internal
+
+/**
+ * @brief Convert a pointer into the value stored in a 32-bit address register
+ *
+ * Registers such as VTOR hold addresses. On target this is a plain cast. On
+ * 64-bit hosts, pointers do not fit into 32 bits, so the value is a handle
+ * made of a region number in the upper 8 bits and an offset into that region
+ * in the lower 24 bits. Handles can be incremented like addresses as long as
+ * they stay within 16MB of the original pointer.
+ *
+ * @param p_pointer - pointer to store in an address register
+ * @return std::uint32_t - value to write to the register
+ */
+inline std::uint32_t mmio_address(void const volatile* p_pointer)
+{
+  auto const address = reinterpret_cast<std::uintptr_t>(p_pointer);
+  if constexpr (sizeof(std::uintptr_t) <= sizeof(std::uint32_t)) {
+    return static_cast<std::uint32_t>(address);
+  } else {
+    using internal::address_region_size;
+    using internal::address_regions;
+    for (std::size_t region = 1; region < address_regions.size(); region++) {
+      auto const base = address_regions[region];
+      if (base != 0 && base <= address &&
+          address - base < address_region_size) {
+        return static_cast<std::uint32_t>((region << 24) | (address - base));
+      }
+    }
+
+    auto const region = internal::next_address_region;
+    internal::next_address_region =
+      (internal::next_address_region % (address_regions.size() - 1)) + 1;
+    address_regions[region] = address;
+    return static_cast<std::uint32_t>(region << 24);
+  }
+}
+
+/**
+ * @brief Convert the value of a 32-bit address register back into a pointer
+ *
+ * Inverse of mmio_address().
+ *
+ * @param p_address - value read from an address register
+ * @return void* - pointer the register refers to
+ */
+inline void* mmio_pointer(std::uint32_t p_address)
+{
+  if constexpr (sizeof(std::uintptr_t) <= sizeof(std::uint32_t)) {
+    return reinterpret_cast<void*>(p_address);
+  } else {
+    auto const base = internal::address_regions[p_address >> 24];
+    return reinterpret_cast<void*>(
+      base + (p_address & (internal::address_region_size - 1)));
+  }
+}
+
+/**
+ * @brief Drop in replacement for `hal::bit_modify` that goes through the
+ * register accessors.
+ *
+ * Reads the register on construction and writes the modified value back on
+ * destruction, exactly like `hal::bit_modify`.
+ */
+template<std::unsigned_integral T>
+class mmio_modify : public bit_value<T>
+{
+public:
+  explicit mmio_modify(T volatile& p_register)
+    : bit_value<T>(load(p_register))
+    , m_register(&p_register)
+  {
+  }
+
+  mmio_modify(mmio_modify const&) = delete;
+  mmio_modify& operator=(mmio_modify const&) = delete;
+
+  ~mmio_modify()
+  {
+    *m_register = this->get();
+    internal::notify_write(register_access::modify, m_register);
+  }
+
+private:
+  static T load(T volatile& p_register)
+  {
+    internal::notify_read(register_access::modify, &p_register);
+    return p_register;
+  }
+
+  T volatile* m_register;
+};
+}  // namespace hal::stm32f4
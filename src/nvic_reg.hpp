@@ -0,0 +1,87 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <libhal-util/bit.hpp>
+
+namespace hal::stm32f4 {
+/// Nested vectored interrupt controller registers
+struct nvic_reg_t
+{
+  /// Offset: 0x000 Interrupt Set Enable Registers
+  std::array<std::uint32_t volatile, 8> iser;
+  std::array<std::uint32_t volatile, 24> reserved0;
+  /// Offset: 0x080 Interrupt Clear Enable Registers
+  std::array<std::uint32_t volatile, 8> icer;
+  std::array<std::uint32_t volatile, 24> reserved1;
+  /// Offset: 0x100 Interrupt Set Pending Registers
+  std::array<std::uint32_t volatile, 8> ispr;
+  std::array<std::uint32_t volatile, 24> reserved2;
+  /// Offset: 0x180 Interrupt Clear Pending Registers
+  std::array<std::uint32_t volatile, 8> icpr;
+  std::array<std::uint32_t volatile, 24> reserved3;
+  /// Offset: 0x200 Interrupt Active bit Registers
+  std::array<std::uint32_t volatile, 8> iabr;
+  std::array<std::uint32_t volatile, 56> reserved4;
+  /// Offset: 0x300 Interrupt Priority Registers (8-bit wide)
+  std::array<std::uint8_t volatile, 240> ip;
+};
+
+/// System control block registers
+struct scb_reg_t
+{
+  /// Offset: 0x000 CPUID Base Register
+  std::uint32_t volatile cpuid;
+  /// Offset: 0x004 Interrupt Control and State Register
+  std::uint32_t volatile icsr;
+  /// Offset: 0x008 Vector Table Offset Register
+  std::uint32_t volatile vtor;
+  /// Offset: 0x00C Application Interrupt and Reset Control Register
+  std::uint32_t volatile aircr;
+  /// Offset: 0x010 System Control Register
+  std::uint32_t volatile scr;
+  /// Offset: 0x014 Configuration Control Register
+  std::uint32_t volatile ccr;
+  /// Offset: 0x018 System Handlers Priority Registers (8-bit wide)
+  std::array<std::uint8_t volatile, 12> shp;
+  /// Offset: 0x024 System Handler Control and State Register
+  std::uint32_t volatile shcsr;
+};
+
+/// Application Interrupt and Reset Control Register
+struct application_interrupt_reset_control
+{
+  /// Priority grouping, the binary point position of the priority fields
+  static constexpr auto priority_group = bit_mask::from<10, 8>();
+
+  /// Must be written with 0x05FA for a write to take effect
+  static constexpr auto vector_key = bit_mask::from<31, 16>();
+
+  /// Value of the vector key
+  static constexpr std::uint32_t vector_key_value = 0x05FA;
+};
+
+/// Number of priority bits implemented by the stm32f4, stored in the upper
+/// bits of each 8-bit priority field
+inline constexpr std::uint8_t nvic_priority_bits = 4;
+/// Number of core exception vectors before the first peripheral interrupt
+inline constexpr std::size_t core_vector_count = 16;
+
+inline nvic_reg_t* nvic = reinterpret_cast<nvic_reg_t*>(0xE000'E100);
+inline scb_reg_t* scb = reinterpret_cast<scb_reg_t*>(0xE000'ED00);
+}  // namespace hal::stm32f4
@@ -13,8 +13,11 @@
 // limitations under the License.
 
 #include "gpio_reg.hpp"
+#include "mmio.hpp"
 #include "power.hpp"
+#include "profile_scope.hpp"
 #include <libhal-stm32f4/output_pin.hpp>
+#include <libhal-stm32f4/port_configuration.hpp>
 #include <libhal-util/bit.hpp>
 
 namespace hal::stm32f4 {
@@ -30,23 +33,23 @@ output_pin::output_pin(hal::stm32f4::peripheral p_port,
 
 void output_pin::driver_configure(settings const& p_settings)
 {
-  bit_mask pin_mode_mask = { .position = 2 * static_cast<uint32_t>(m_pin),
-                             .width = 2 };
-  bit_modify(get_reg(m_port)->pin_mode).insert(pin_mode_mask, 0b01U);
-
-  pin(m_port, m_pin)
-    .function(pin::pin_function::output)
-    .open_drain(p_settings.open_drain)
-    .resistor(p_settings.resistor);
+  profile_scope scope(profile_point::pin_configure);
+  port_configuration(m_port)
+    .function(m_pin, pin::pin_function::output)
+    .open_drain(m_pin, p_settings.open_drain)
+    .resistor(m_pin, p_settings.resistor)
+    .commit();
 }
 
 void output_pin::driver_level(bool p_high)
 {
   bit_mask set_bit = { .position = static_cast<uint32_t>(m_pin), .width = 1 };
   if (p_high) {
-    get_reg(m_port)->set = bit_value(0U).set(set_bit).to<std::uint16_t>();
+    mmio_write(get_reg(m_port)->set,
+               bit_value(0U).set(set_bit).to<std::uint16_t>());
   } else {
-    get_reg(m_port)->reset = bit_value(0U).set(set_bit).to<std::uint16_t>();
+    mmio_write(get_reg(m_port)->reset,
+               bit_value(0U).set(set_bit).to<std::uint16_t>());
   }
 }
 
@@ -54,6 +57,7 @@ bool output_pin::driver_level()
 {
   bit_mask output_data_mask = { .position = static_cast<uint32_t>(m_pin),
                                 .width = 1 };
-  return bit_extract(output_data_mask, get_reg(m_port)->output_data);
+  return bit_extract(output_data_mask,
+                     mmio_read(get_reg(m_port)->output_data));
 }
 }  // namespace hal::stm32f4
@@ -20,6 +20,7 @@
 #include <libhal/units.hpp>
 
 #include "gpio_reg.hpp"
+#include "mmio.hpp"
 #include "power.hpp"
 
 namespace hal::stm32f4 {
@@ -40,24 +41,25 @@ pin const& pin::function(
 
   switch (p_function) {
     case pin_function::input:
-      bit_modify(port_reg->pin_mode).insert(pin_mode_mask, 0b00U);
+      mmio_modify(port_reg->pin_mode).insert(pin_mode_mask, 0b00U);
       break;
     case pin_function::output:
-      bit_modify(port_reg->pin_mode).insert(pin_mode_mask, 0b01U);
+      mmio_modify(port_reg->pin_mode).insert(pin_mode_mask, 0b01U);
       break;
     case pin_function::analog:
-      bit_modify(port_reg->pin_mode).insert(pin_mode_mask, 0b11U);
+      mmio_modify(port_reg->pin_mode).insert(pin_mode_mask, 0b11U);
       break;
     default:
-      bit_modify(port_reg->pin_mode).insert(pin_mode_mask, 0b10U);
+      mmio_modify(port_reg->pin_mode).insert(pin_mode_mask, 0b10U);
       uint8_t alt_func = static_cast<uint8_t>(p_function) - 3U;
       bit_mask alt_func_mask = { .position =
                                    (static_cast<uint32_t>(m_pin) * 4U) % 32,
                                  .width = 4 };
       if (m_pin < 8) {
-        bit_modify(port_reg->alt_function_low).insert(alt_func_mask, alt_func);
+        mmio_modify(port_reg->alt_function_low).insert(alt_func_mask, alt_func);
       } else {
-        bit_modify(port_reg->alt_function_high).insert(alt_func_mask, alt_func);
+        mmio_modify(port_reg->alt_function_high)
+          .insert(alt_func_mask, alt_func);
       }
       break;
   }
@@ -72,16 +74,16 @@ pin const& pin::resistor(hal::pin_resistor p_resistor) const noexcept
                          .width = 2 };
   switch (p_resistor) {
     case pin_resistor::none:
-      hal::bit_modify(port_reg->pull_up_pull_down).insert(port_mask, 0b00U);
+      mmio_modify(port_reg->pull_up_pull_down).insert(port_mask, 0b00U);
       break;
     case pin_resistor::pull_up:
-      hal::bit_modify(port_reg->pull_up_pull_down).insert(port_mask, 0b01U);
+      mmio_modify(port_reg->pull_up_pull_down).insert(port_mask, 0b01U);
       break;
     case pin_resistor::pull_down:
-      hal::bit_modify(port_reg->pull_up_pull_down).insert(port_mask, 0b10U);
+      mmio_modify(port_reg->pull_up_pull_down).insert(port_mask, 0b10U);
       break;
     default:
-      hal::bit_modify(port_reg->pull_up_pull_down).insert(port_mask, 0b00U);
+      mmio_modify(port_reg->pull_up_pull_down).insert(port_mask, 0b00U);
       break;
   }
   return *this;
@@ -91,10 +93,18 @@ pin const& pin::open_drain(bool p_enable) const noexcept
 {
   // modify output_type to p_enable
   auto port_reg = get_reg(m_port);
-  bit_mask pin_mask = { .position = static_cast<uint32_t>(m_pin), .width = 1 };
+  mmio_write_bit(port_reg->output_type, bit_mask::from(m_pin), p_enable);
+  return *this;
+}
+
+pin const& pin::speed(pin_speed p_speed) const noexcept
+{
+  auto port_reg = get_reg(m_port);
+  bit_mask speed_mask = { .position = 2 * static_cast<uint32_t>(m_pin),
+                          .width = 2 };
 
-  bit_modify(port_reg->output_type)
-    .insert(pin_mask, static_cast<uint32_t>(p_enable));
+  mmio_modify(port_reg->output_speed)
+    .insert(speed_mask, static_cast<uint32_t>(p_speed));
   return *this;
 }
 
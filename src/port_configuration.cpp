@@ -0,0 +1,209 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+
+#include <libhal-stm32f4/port_configuration.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal/error.hpp>
+
+#include "gpio_reg.hpp"
+#include "mmio.hpp"
+#include "power.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+constexpr std::uint8_t pins_per_port = 16;
+
+std::uint8_t validate(std::uint8_t p_pin)
+{
+  if (p_pin >= pins_per_port) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+  return p_pin;
+}
+
+template<typename Field>
+void insert(Field& p_field, bit_mask p_mask, std::uint32_t p_value)
+{
+  auto const mask = p_mask.value<std::uint32_t>();
+  p_field.mask |= mask;
+  p_field.value =
+    (p_field.value & ~mask) | ((p_value << p_mask.position) & mask);
+}
+
+template<typename Field>
+void commit_field(std::uint32_t volatile& p_register, Field const& p_field)
+{
+  if (p_field.mask != 0) {
+    mmio_update(p_register, p_field.mask, p_field.value);
+  }
+}
+}  // namespace
+
+port_configuration::port_configuration(peripheral p_port)
+  : m_port(p_port)
+{
+  power(p_port).on();
+}
+
+port_configuration::port_configuration(peripheral p_port, unpowered)
+  : m_port(p_port)
+{
+}
+
+port_configuration& port_configuration::function(
+  std::uint8_t p_pin,
+  pin::pin_function p_function)
+{
+  insert_function(validate(p_pin), p_function);
+  return *this;
+}
+
+port_configuration& port_configuration::resistor(std::uint8_t p_pin,
+                                                 hal::pin_resistor p_resistor)
+{
+  insert_resistor(validate(p_pin), p_resistor);
+  return *this;
+}
+
+port_configuration& port_configuration::open_drain(std::uint8_t p_pin,
+                                                   bool p_enable)
+{
+  insert_open_drain(validate(p_pin), p_enable);
+  return *this;
+}
+
+port_configuration& port_configuration::speed(std::uint8_t p_pin,
+                                              pin_speed p_speed)
+{
+  insert_speed(validate(p_pin), p_speed);
+  return *this;
+}
+
+port_configuration& port_configuration::route(
+  std::uint8_t p_pin,
+  pin::pin_function p_function,
+  pin_speed p_speed) noexcept
+{
+  auto const pin = static_cast<std::uint8_t>(p_pin % pins_per_port);
+  insert_function(pin, p_function);
+  insert_open_drain(pin, false);
+  insert_resistor(pin, pin_resistor::none);
+  insert_speed(pin, p_speed);
+  return *this;
+}
+
+void port_configuration::insert_function(std::uint8_t p_pin,
+                                         pin::pin_function p_function) noexcept
+{
+  auto const position = static_cast<std::uint32_t>(p_pin);
+  bit_mask const mode_mask = { .position = position * 2U, .width = 2 };
+
+  switch (p_function) {
+    case pin::pin_function::input:
+      insert(m_mode, mode_mask, 0b00U);
+      break;
+    case pin::pin_function::output:
+      insert(m_mode, mode_mask, 0b01U);
+      break;
+    case pin::pin_function::analog:
+      insert(m_mode, mode_mask, 0b11U);
+      break;
+    default: {
+      insert(m_mode, mode_mask, 0b10U);
+      auto const alternate = static_cast<std::uint32_t>(p_function) -
+                             static_cast<std::uint32_t>(
+                               pin::pin_function::alternate0);
+      bit_mask const alternate_mask = { .position = (position * 4U) % 32,
+                                        .width = 4 };
+      if (position < 8) {
+        insert(m_alternate_low, alternate_mask, alternate);
+      } else {
+        insert(m_alternate_high, alternate_mask, alternate);
+      }
+      break;
+    }
+  }
+}
+
+void port_configuration::insert_resistor(std::uint8_t p_pin,
+                                         hal::pin_resistor p_resistor) noexcept
+{
+  auto const position = static_cast<std::uint32_t>(p_pin);
+  bit_mask const pull_mask = { .position = position * 2U, .width = 2 };
+
+  switch (p_resistor) {
+    case pin_resistor::pull_up:
+      insert(m_pull, pull_mask, 0b01U);
+      break;
+    case pin_resistor::pull_down:
+      insert(m_pull, pull_mask, 0b10U);
+      break;
+    case pin_resistor::none:
+      [[fallthrough]];
+    default:
+      insert(m_pull, pull_mask, 0b00U);
+      break;
+  }
+}
+
+void port_configuration::insert_open_drain(std::uint8_t p_pin,
+                                           bool p_enable) noexcept
+{
+  auto const position = static_cast<std::uint32_t>(p_pin);
+  insert(m_output_type,
+         bit_mask{ .position = position, .width = 1 },
+         static_cast<std::uint32_t>(p_enable));
+}
+
+void port_configuration::insert_speed(std::uint8_t p_pin,
+                                      pin_speed p_speed) noexcept
+{
+  auto const position = static_cast<std::uint32_t>(p_pin);
+  insert(m_speed,
+         bit_mask{ .position = position * 2U, .width = 2 },
+         static_cast<std::uint32_t>(p_speed));
+}
+
+port_configuration& port_configuration::level(std::uint8_t p_pin,
+                                              bool p_high)
+{
+  auto const position = static_cast<std::uint32_t>(validate(p_pin));
+  insert(m_output,
+         bit_mask{ .position = position, .width = 1 },
+         static_cast<std::uint32_t>(p_high));
+  return *this;
+}
+
+void port_configuration::commit() const noexcept
+{
+  auto* reg = get_reg(m_port);
+  // Levels go through the set/reset register, which needs no read
+  auto const set = m_output.mask & m_output.value;
+  auto const reset = m_output.mask & ~m_output.value;
+  if (set != 0) {
+    mmio_write(reg->set, static_cast<std::uint16_t>(set));
+  }
+  if (reset != 0) {
+    mmio_write(reg->reset, static_cast<std::uint16_t>(reset));
+  }
+  commit_field(reg->alt_function_low, m_alternate_low);
+  commit_field(reg->alt_function_high, m_alternate_high);
+  commit_field(reg->output_type, m_output_type);
+  commit_field(reg->output_speed, m_speed);
+  commit_field(reg->pull_up_pull_down, m_pull);
+  commit_field(reg->pin_mode, m_mode);
+}
+}  // namespace hal::stm32f4
@@ -17,7 +17,9 @@
 
 #include <libhal-stm32f4/constants.hpp>
 
+#include "mmio.hpp"
 #include "power.hpp"
+#include "profile_scope.hpp"
 #include "rcc_reg.hpp"
 
 namespace hal::stm32f4 {
@@ -54,23 +56,25 @@ power::power(peripheral p_peripheral)
 
 void power::on()
 {
+  profile_scope scope(profile_point::power_on);
   if (m_enable_register) {
-    hal::bit_modify(*m_enable_register).set(bit_mask::from(m_bit_position));
+    mmio_set_bit(*m_enable_register, bit_mask::from(m_bit_position));
   }
 }
 
 bool power::is_on()
 {
   if (m_enable_register) {
-    return hal::bit_extract(bit_mask::from(m_bit_position), *m_enable_register);
+    return mmio_read_bit(*m_enable_register, bit_mask::from(m_bit_position));
   }
   return true;
 }
 
 void power::off()
 {
+  profile_scope scope(profile_point::power_off);
   if (m_enable_register) {
-    hal::bit_modify(*m_enable_register).clear(bit_mask::from(m_bit_position));
+    mmio_clear_bit(*m_enable_register, bit_mask::from(m_bit_position));
   }
 }
 }  // namespace hal::stm32f4
\ No newline at end of file
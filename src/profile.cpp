@@ -0,0 +1,97 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+#include <libhal-stm32f4/profile.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal-util/enum.hpp>
+
+#include "dwt_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+std::array<latency_histogram, hal::value(profile_point::max)> histograms{};
+}  // namespace
+
+void latency_histogram::record(std::uint32_t p_cycles)
+{
+  // Bucket N holds [2^(N-1), 2^N), which is the bit width of the sample
+  m_buckets[std::bit_width(p_cycles)]++;
+  m_sum += p_cycles;
+  m_count++;
+  if (p_cycles < m_min) {
+    m_min = p_cycles;
+  }
+  if (p_cycles > m_max) {
+    m_max = p_cycles;
+  }
+}
+
+void latency_histogram::reset()
+{
+  *this = latency_histogram{};
+}
+
+std::uint32_t latency_histogram::percentile(float p_percentile) const
+{
+  if (m_count == 0) {
+    return 0;
+  }
+
+  auto const rank = static_cast<std::uint32_t>(
+    std::ceil(static_cast<float>(m_count) * p_percentile));
+  std::uint32_t cumulative = 0;
+
+  for (std::size_t bucket = 0; bucket < m_buckets.size(); bucket++) {
+    cumulative += m_buckets[bucket];
+    if (cumulative >= rank && cumulative != 0) {
+      // Largest value that fits in `bucket` bits
+      auto const upper_bound =
+        bucket == 0 ? 0U : static_cast<std::uint32_t>((1ULL << bucket) - 1);
+      return std::min(upper_bound, m_max);
+    }
+  }
+
+  return m_max;
+}
+
+latency_histogram& profile(profile_point p_point)
+{
+  return histograms[hal::value(p_point)];
+}
+
+void reset_profiles()
+{
+  for (auto& histogram : histograms) {
+    histogram.reset();
+  }
+}
+
+void enable_cycle_counter()
+{
+  bit_modify(core_debug->demcr)
+    .set<debug_exception_monitor_control::trace_enable>();
+  bit_modify(dwt->ctrl).set<dwt_control::cycle_count_enable>();
+}
+
+std::uint32_t cycle_count()
+{
+  return dwt->cyccnt;
+}
+}  // namespace hal::stm32f4
@@ -0,0 +1,60 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+
+#include <libhal-stm32f4/profile.hpp>
+
+#include "dwt_reg.hpp"
+
+namespace hal::stm32f4 {
+/**
+ * @brief Records the cycles spent between construction and destruction into
+ * the histogram of a profile point.
+ *
+ * Compiles to nothing unless LIBHAL_STM32F4_PROFILE is set. The cycle counter
+ * is read directly rather than through the mmio accessors so that profiling
+ * does not show up in register traces.
+ */
+class profile_scope
+{
+public:
+#if LIBHAL_STM32F4_PROFILE
+  explicit profile_scope(profile_point p_point)
+    : m_start(dwt->cyccnt)
+    , m_point(p_point)
+  {
+  }
+
+  ~profile_scope()
+  {
+    profile(m_point).record(dwt->cyccnt - m_start);
+  }
+
+private:
+  std::uint32_t m_start;
+  profile_point m_point;
+#else
+  explicit profile_scope(profile_point)
+  {
+  }
+#endif
+
+public:
+  profile_scope(profile_scope const&) = delete;
+  profile_scope& operator=(profile_scope const&) = delete;
+};
+}  // namespace hal::stm32f4
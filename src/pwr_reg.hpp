@@ -0,0 +1,84 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+
+#include <libhal-util/bit.hpp>
+
+namespace hal::stm32f4 {
+/// Power controller registers
+struct pwr_reg_t
+{
+  /// Offset: 0x00 Power Control Register
+  std::uint32_t volatile cr;
+  /// Offset: 0x04 Power Control/Status Register
+  std::uint32_t volatile csr;
+};
+
+/// Power Control Register
+struct power_control
+{
+  /// Low-power deep sleep: 0 main regulator on in stop, 1 low-power regulator
+  static constexpr auto low_power_deep_sleep = bit_mask::from<0>();
+
+  /// Power down deep sleep: 0 enter stop, 1 enter standby on deep sleep
+  static constexpr auto power_down_deep_sleep = bit_mask::from<1>();
+
+  /// Clear wakeup flag (write 1)
+  static constexpr auto clear_wakeup_flag = bit_mask::from<2>();
+
+  /// Clear standby flag (write 1)
+  static constexpr auto clear_standby_flag = bit_mask::from<3>();
+
+  /// Disable backup domain write protection
+  static constexpr auto disable_backup_protection = bit_mask::from<8>();
+
+  /// Flash power down in stop mode
+  static constexpr auto flash_power_down = bit_mask::from<9>();
+
+  /// Regulator voltage scaling, applied while the PLL is on
+  /// 01: scale 3 (up to 64MHz), 10: scale 2 (up to 84MHz), 11: scale 1
+  static constexpr auto voltage_scaling = bit_mask::from<15, 14>();
+};
+
+/// Power Control/Status Register
+struct power_status
+{
+  /// A wakeup event was received from the WKUP pin or the RTC
+  static constexpr auto wakeup_flag = bit_mask::from<0>();
+
+  /// The device has been in standby mode
+  static constexpr auto standby_flag = bit_mask::from<1>();
+
+  /// Enable the WKUP pin (PA0) as a standby wakeup source
+  static constexpr auto enable_wakeup_pin = bit_mask::from<8>();
+};
+
+/// Cortex-M System Control Register
+struct system_control
+{
+  /// Re-enter sleep when returning from an interrupt handler to thread mode
+  static constexpr auto sleep_on_exit = bit_mask::from<1>();
+
+  /// Use deep sleep (stop or standby) instead of sleep
+  static constexpr auto sleep_deep = bit_mask::from<2>();
+
+  /// Pending interrupts, including disabled ones, generate wake up events
+  static constexpr auto send_event_on_pending = bit_mask::from<4>();
+};
+
+inline pwr_reg_t* pwr = reinterpret_cast<pwr_reg_t*>(0x4000'7000);
+}  // namespace hal::stm32f4
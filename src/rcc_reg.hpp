@@ -90,6 +90,77 @@ struct reset_and_clock_control_t
   std::uint32_t volatile dckcfgr;
 };
 
+/// Clock Control Register
+struct clock_control
+{
+  /// Internal high speed oscillator enable
+  static constexpr auto hsi_enable = bit_mask::from<0>();
+
+  /// Internal high speed oscillator ready
+  static constexpr auto hsi_ready = bit_mask::from<1>();
+
+  /// External high speed oscillator enable
+  static constexpr auto hse_enable = bit_mask::from<16>();
+
+  /// External high speed oscillator ready
+  static constexpr auto hse_ready = bit_mask::from<17>();
+
+  /// External high speed oscillator bypassed with an external clock
+  static constexpr auto hse_bypass = bit_mask::from<18>();
+
+  /// Main PLL enable
+  static constexpr auto pll_enable = bit_mask::from<24>();
+
+  /// Main PLL ready
+  static constexpr auto pll_ready = bit_mask::from<25>();
+};
+
+/// PLL Configuration Register
+struct pll_config
+{
+  /// Division factor of the PLL input clock, 2 to 63
+  static constexpr auto input_divider = bit_mask::from<5, 0>();
+
+  /// Multiplication factor of the VCO, 50 to 432
+  static constexpr auto vco_multiplier = bit_mask::from<14, 6>();
+
+  /// Division factor of the system clock output
+  /// 00: 2, 01: 4, 10: 6, 11: 8
+  static constexpr auto system_divider = bit_mask::from<17, 16>();
+
+  /// PLL input clock: 0 HSI, 1 HSE
+  static constexpr auto source = bit_mask::from<22>();
+
+  /// Division factor of the USB OTG FS and SDIO clock output, 2 to 15
+  static constexpr auto usb_divider = bit_mask::from<27, 24>();
+};
+
+/// Backup Domain Control Register
+struct backup_domain_control
+{
+  /// External low speed oscillator enable
+  static constexpr auto lse_enable = bit_mask::from<0>();
+
+  /// External low speed oscillator ready
+  static constexpr auto lse_ready = bit_mask::from<1>();
+
+  /// RTC clock source: 00 none, 01 LSE, 10 LSI, 11 HSE divided
+  static constexpr auto rtc_clock_select = bit_mask::from<9, 8>();
+
+  /// RTC clock enable
+  static constexpr auto rtc_enable = bit_mask::from<15>();
+};
+
+/// Clock Control and Status Register
+struct clock_status
+{
+  /// Internal low speed oscillator enable
+  static constexpr auto lsi_enable = bit_mask::from<0>();
+
+  /// Internal low speed oscillator ready
+  static constexpr auto lsi_ready = bit_mask::from<1>();
+};
+
 struct rcc_cnfg
 {
   /// System clock switch
@@ -0,0 +1,1190 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include <libhal-stm32f4/register_simulation.hpp>
+#include <libhal-stm32f4/spi_pins.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal-util/enum.hpp>
+#include <libhal/error.hpp>
+
+#include "dma_reg.hpp"
+#include "dwt_reg.hpp"
+#include "exti_reg.hpp"
+#include "gpio_reg.hpp"
+#include "mmio.hpp"
+#include "nvic_reg.hpp"
+#include "flash_reg.hpp"
+#include "pwr_reg.hpp"
+#include "rcc_reg.hpp"
+#include "rtc_reg.hpp"
+#include "spi_reg.hpp"
+#include "timer_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+/// Each gpio port occupies 1kB of address space
+constexpr std::size_t gpio_port_stride = 1 << 10;
+/// Number of gpio ports addressable from gpio_base (A through H)
+constexpr std::size_t gpio_port_count = 8;
+/// TIM2 to TIM5, followed by TIM1
+constexpr std::size_t simulated_timer_count = general_timer_count + 1;
+constexpr std::size_t timer1_index = general_timer_count;
+
+struct spi_channel
+{
+  std::array<hal::byte, register_simulation::spi_buffer_size> transmitted{};
+  std::array<hal::byte, register_simulation::spi_buffer_size> responses{};
+  std::size_t transmitted_count = 0;
+  std::size_t response_count = 0;
+  std::size_t response_index = 0;
+  /// Byte last shifted in, what the data register reads as
+  hal::byte received = 0;
+  /// Byte waiting in the transmit buffer for the shift register to free up
+  hal::byte queued = 0;
+  bool transmit_queued = false;
+  /// The next byte written while RXNE is set overruns
+  bool overrun_next = false;
+  /// The byte waiting in the transmit buffer overruns on the next data
+  /// register read
+  bool overrun_on_read = false;
+  /// Data register read while OVR was set, the next status read clears it
+  bool overrun_read = false;
+  /// The status read clearing OVR happened, OVR is gone on the next read
+  bool overrun_clearing = false;
+  /// SPE as of the last write to control register 1
+  bool enabled = false;
+};
+
+struct simulated_registers
+{
+  alignas(gpio_port_stride)
+    std::array<std::byte, gpio_port_stride * gpio_port_count> gpio{};
+  reset_and_clock_control_t rcc{};
+  std::array<spi_reg_t, spi_bus_count> spi{};
+  std::array<dma_reg_t, 2> dma{};
+  dwt_reg_t dwt{};
+  core_debug_reg_t core_debug{};
+  nvic_reg_t nvic{};
+  scb_reg_t scb{};
+  pwr_reg_t pwr{};
+  flash_reg_t flash{};
+  exti_reg_t exti{};
+  syscfg_reg_t syscfg{};
+  rtc_reg_t rtc{};
+  std::array<timer_reg_t, simulated_timer_count> timer{};
+  /// Stands in for the vector table at the start of flash
+  std::array<void (*)(), 128> flash_vectors{};
+};
+
+struct original_registers
+{
+  intptr_t gpio;
+  reset_and_clock_control_t* rcc;
+  std::array<spi_reg_t*, spi_bus_count> spi;
+  std::array<dma_reg_t*, 2> dma;
+  dwt_reg_t* dwt;
+  core_debug_reg_t* core_debug;
+  nvic_reg_t* nvic;
+  scb_reg_t* scb;
+  pwr_reg_t* pwr;
+  flash_reg_t* flash;
+  exti_reg_t* exti;
+  syscfg_reg_t* syscfg;
+  rtc_reg_t* rtc;
+  std::array<timer_reg_t*, simulated_timer_count> timer;
+};
+
+bool is_clocked(peripheral p_peripheral, reset_and_clock_control_t& p_rcc)
+{
+  auto const id = hal::value(p_peripheral);
+  auto const mask = bit_mask::from(id % bus_id_offset);
+  switch (id / bus_id_offset) {
+    case 0:
+      return bit_extract(mask, p_rcc.ahb1enr);
+    case 1:
+      return bit_extract(mask, p_rcc.ahb2enr);
+    case 3:
+      return bit_extract(mask, p_rcc.apb1enr);
+    case 4:
+      return bit_extract(mask, p_rcc.apb2enr);
+    default:
+      return true;
+  }
+}
+
+class simulation_model : public mmio_observer
+{
+public:
+  void reset()
+  {
+    std::memset(static_cast<void*>(&m_registers), 0, sizeof(m_registers));
+    m_spi = {};
+    m_dma_lengths = {};
+    m_nvic_enabled = {};
+    m_power_mode_entries = {};
+    m_timers = {};
+    m_elapsed_cycles = 0;
+    m_unclocked_writes = 0;
+    m_exti_pending = 0;
+
+    // Reset values from RM0383 section 8.4 and 6.3
+    gpio_port(peripheral::gpio_a).pin_mode = 0xA800'0000;
+    gpio_port(peripheral::gpio_a).output_speed = 0x0C00'0000;
+    gpio_port(peripheral::gpio_a).pull_up_pull_down = 0x6400'0000;
+    gpio_port(peripheral::gpio_b).pin_mode = 0x0000'0280;
+    gpio_port(peripheral::gpio_b).output_speed = 0x0000'00C0;
+    gpio_port(peripheral::gpio_b).pull_up_pull_down = 0x0000'0100;
+    m_registers.rcc.cr = 0x0000'0083;
+    m_registers.rcc.pllcfgr = 0x2400'3010;
+    m_registers.pwr.cr = 0x0000'8000;
+    m_registers.scb.vtor = mmio_address(m_registers.flash_vectors.data());
+    // Reset values from RM0383 section 13.4, TIM2 and TIM5 are 32-bit
+    m_registers.timer[0].arr = 0xFFFF'FFFF;
+    m_registers.timer[1].arr = 0xFFFF;
+    m_registers.timer[2].arr = 0xFFFF;
+    m_registers.timer[3].arr = 0xFFFF'FFFF;
+    m_registers.timer[timer1_index].arr = 0xFFFF;
+    m_registers.scb.aircr = 0xFA05'0000;
+    m_registers.rtc.isr = 0x0000'0007;
+
+    for (auto& bus : m_registers.spi) {
+      bus.sr = status_register::tx_buffer_empty.value<std::uint32_t>();
+    }
+  }
+
+  /// Latch edges on the EXTI lines connected to a gpio port's pins
+  void gpio_input(peripheral p_port, std::uint16_t p_levels)
+  {
+    auto& port = gpio_port(p_port);
+    auto const previous = port.input_data;
+    port.input_data = p_levels;
+
+    auto const& exti_reg = m_registers.exti;
+    auto const edges = (exti_reg.rtsr & p_levels & ~previous) |
+                       (exti_reg.ftsr & previous & ~p_levels);
+    for (std::uint8_t line = 0; line < exti_gpio_line_count; line++) {
+      bit_mask const port_mask = { .position = (line % 4U) * 4U, .width = 4 };
+      if (!bit_extract(bit_mask::from(line), edges) ||
+          bit_extract(port_mask, m_registers.syscfg.exticr[line / 4]) !=
+            hal::value(p_port)) {
+        continue;
+      }
+      m_exti_pending |= 1U << line;
+      m_registers.exti.pr = m_exti_pending;
+      if (bit_extract(bit_mask::from(line), exti_reg.imr)) {
+        interrupt(exti_irq(line));
+      }
+    }
+  }
+
+  stm32f4_gpio_t& gpio_port(peripheral p_port)
+  {
+    auto offset = static_cast<std::size_t>(hal::value(p_port)) << 10;
+    return *reinterpret_cast<stm32f4_gpio_t*>(&m_registers.gpio[offset]);
+  }
+
+  spi_channel& spi(std::uint8_t p_bus)
+  {
+    if (p_bus < 1 || p_bus > spi_bus_count) {
+      hal::safe_throw(hal::argument_out_of_domain(this));
+    }
+    return m_spi[p_bus - 1];
+  }
+
+  void redirect()
+  {
+    m_original = {
+      .gpio = gpio_base,
+      .rcc = rcc,
+      .spi = { spi_reg1, spi_reg2, spi_reg3, spi_reg4, spi_reg5 },
+      .dma = { dma_reg1, dma_reg2 },
+      .dwt = dwt,
+      .core_debug = core_debug,
+      .nvic = nvic,
+      .scb = scb,
+      .pwr = pwr,
+      .flash = flash,
+      .exti = exti,
+      .syscfg = syscfg,
+      .rtc = rtc,
+      .timer = { timer_reg2, timer_reg3, timer_reg4, timer_reg5, timer_reg1 },
+    };
+
+    gpio_base = reinterpret_cast<intptr_t>(m_registers.gpio.data());
+    rcc = &m_registers.rcc;
+    spi_reg1 = &m_registers.spi[0];
+    spi_reg2 = &m_registers.spi[1];
+    spi_reg3 = &m_registers.spi[2];
+    spi_reg4 = &m_registers.spi[3];
+    spi_reg5 = &m_registers.spi[4];
+    dma_reg1 = &m_registers.dma[0];
+    dma_reg2 = &m_registers.dma[1];
+    dwt = &m_registers.dwt;
+    core_debug = &m_registers.core_debug;
+    nvic = &m_registers.nvic;
+    scb = &m_registers.scb;
+    pwr = &m_registers.pwr;
+    flash = &m_registers.flash;
+    exti = &m_registers.exti;
+    syscfg = &m_registers.syscfg;
+    rtc = &m_registers.rtc;
+    timer_reg2 = &m_registers.timer[0];
+    timer_reg3 = &m_registers.timer[1];
+    timer_reg4 = &m_registers.timer[2];
+    timer_reg5 = &m_registers.timer[3];
+    timer_reg1 = &m_registers.timer[timer1_index];
+  }
+
+  void restore()
+  {
+    gpio_base = m_original.gpio;
+    rcc = m_original.rcc;
+    spi_reg1 = m_original.spi[0];
+    spi_reg2 = m_original.spi[1];
+    spi_reg3 = m_original.spi[2];
+    spi_reg4 = m_original.spi[3];
+    spi_reg5 = m_original.spi[4];
+    dma_reg1 = m_original.dma[0];
+    dma_reg2 = m_original.dma[1];
+    dwt = m_original.dwt;
+    core_debug = m_original.core_debug;
+    nvic = m_original.nvic;
+    scb = m_original.scb;
+    pwr = m_original.pwr;
+    flash = m_original.flash;
+    exti = m_original.exti;
+    syscfg = m_original.syscfg;
+    rtc = m_original.rtc;
+    timer_reg2 = m_original.timer[0];
+    timer_reg3 = m_original.timer[1];
+    timer_reg4 = m_original.timer[2];
+    timer_reg5 = m_original.timer[3];
+    timer_reg1 = m_original.timer[timer1_index];
+  }
+
+  /// Shift in a byte if the bus is enabled in receive-only mode
+  void elapse_cycles(std::uint64_t p_cycles)
+  {
+    elapse(p_cycles);
+  }
+
+  std::uint64_t elapsed_cycles() const
+  {
+    return m_elapsed_cycles;
+  }
+
+  void spi_clock_in(std::size_t p_index)
+  {
+    if (spi_receive_only(p_index)) {
+      spi_receive(p_index, m_registers.spi[p_index]);
+    }
+  }
+
+  void spi_clock_out(std::size_t p_index)
+  {
+    auto* stream = spi_transmit_stream(p_index);
+    if (stream &&
+        bit_extract<dma_stream_config::circular_mode>(stream->cr)) {
+      spi_dma_shift(p_index, *stream);
+    }
+  }
+
+  std::uint32_t unclocked_writes() const
+  {
+    return m_unclocked_writes;
+  }
+
+  std::uint32_t power_mode_entries(power_mode p_mode) const
+  {
+    return m_power_mode_entries[hal::value(p_mode)];
+  }
+
+  void before_wait() override
+  {
+    auto const deep_sleep =
+      bit_extract<system_control::sleep_deep>(m_registers.scb.scr);
+    auto const standby = bit_extract<power_control::power_down_deep_sleep>(
+      m_registers.pwr.cr);
+
+    // Time passes while the core waits, so dma transfers complete or, if
+    // there are none, the core sleeps until the next timer interrupt
+    if (!spi_dma_run()) {
+      elapse(cycles_to_timer_interrupt());
+    }
+
+    if (!deep_sleep) {
+      m_power_mode_entries[hal::value(power_mode::sleep)]++;
+    } else if (standby) {
+      m_power_mode_entries[hal::value(power_mode::standby)]++;
+    } else {
+      // The device wakes from stop running from the HSI with the HSE and PLL
+      // disabled
+      m_power_mode_entries[hal::value(power_mode::stop)]++;
+      bit_modify(m_registers.rcc.cr)
+        .clear<clock_control::hse_enable>()
+        .clear<clock_control::hse_ready>()
+        .clear<clock_control::pll_enable>()
+        .clear<clock_control::pll_ready>();
+      bit_modify(m_registers.rcc.cfgr)
+        .clear<rcc_cnfg::system_clock_switch>()
+        .clear<rcc_cnfg::system_clock_status_switch>();
+    }
+  }
+
+  void before_read(register_access, std::uintptr_t p_address) override
+  {
+    // Polling the cycle counter is what takes the cycles it counts
+    auto& dwt_reg = m_registers.dwt;
+    if (p_address == address_of(dwt_reg.cyccnt) &&
+        bit_extract<dwt_control::cycle_count_enable>(dwt_reg.ctrl)) {
+      dwt_reg.cyccnt = dwt_reg.cyccnt + 1;
+      return;
+    }
+
+    for (std::size_t i = 0; i < spi_bus_count; i++) {
+      auto& bus = m_registers.spi[i];
+      auto& channel = m_spi[i];
+      if (p_address != address_of(bus.dr) && p_address != address_of(bus.sr)) {
+        continue;
+      }
+      // The status read clearing OVR still returns it set
+      if (channel.overrun_clearing) {
+        channel.overrun_clearing = false;
+        bit_modify(bus.sr).clear<status_register::overrun_flag>();
+      }
+      if (p_address == address_of(bus.dr)) {
+        if (channel.overrun_on_read && channel.transmit_queued) {
+          // Software was held off between its status poll and this read, so
+          // the waiting byte was shifted while RXNE was still set
+          channel.overrun_on_read = false;
+          channel.transmit_queued = false;
+          bit_modify(bus.sr).set<status_register::tx_buffer_empty>();
+          spi_overrun(i, bus, channel.queued);
+        }
+        bit_modify(bus.sr).clear<status_register::rx_buffer_not_empty>();
+        channel.overrun_read =
+          bit_extract<status_register::overrun_flag>(bus.sr);
+      } else {
+        spi_shift_queued(i, bus);
+        if (channel.overrun_read) {
+          channel.overrun_read = false;
+          channel.overrun_clearing = true;
+        }
+      }
+    }
+
+    // A receive-only bus clocks continuously, so a byte arrives each time
+    // software polls the progress of the stream receiving from it
+    for (std::size_t i = 0; i < spi_bus_count; i++) {
+      auto* stream = spi_receive_stream(i);
+      if (stream && p_address == address_of(stream->ndtr)) {
+        spi_clock_in(i);
+      }
+    }
+  }
+
+  void after_write(register_access, std::uintptr_t p_address) override
+  {
+    auto const gpio_start = address_of(m_registers.gpio[0]);
+    auto const gpio_end = gpio_start + m_registers.gpio.size();
+
+    if (gpio_start <= p_address && p_address < gpio_end) {
+      auto const offset = p_address - gpio_start;
+      auto const port = static_cast<peripheral>(offset / gpio_port_stride);
+      gpio_write(port, offset % gpio_port_stride);
+      return;
+    }
+
+    if (nvic_write(p_address)) {
+      return;
+    }
+
+    if (dma_write(p_address)) {
+      return;
+    }
+
+    if (timer_write(p_address)) {
+      return;
+    }
+
+    if (p_address == address_of(m_registers.exti.pr)) {
+      // Pending bits are write 1 to clear
+      m_exti_pending &= ~m_registers.exti.pr;
+      m_registers.exti.pr = m_exti_pending;
+      return;
+    }
+
+    if (p_address == address_of(m_registers.rcc.cr) ||
+        p_address == address_of(m_registers.rcc.cfgr) ||
+        p_address == address_of(m_registers.rcc.csr) ||
+        p_address == address_of(m_registers.rcc.bdcr)) {
+      rcc_write();
+      return;
+    }
+
+    if (p_address == address_of(m_registers.rtc.cr)) {
+      // The wakeup timer can be written as soon as it is disabled
+      auto& rtc_reg = m_registers.rtc;
+      auto const enabled =
+        bit_extract<rtc_control::wakeup_timer_enable>(rtc_reg.cr);
+      bit_modify(rtc_reg.isr).insert<rtc_status::wakeup_timer_write_flag>(
+        static_cast<std::uint32_t>(!enabled));
+      return;
+    }
+
+    for (std::size_t i = 0; i < spi_bus_count; i++) {
+      auto& bus = m_registers.spi[i];
+      auto const start = address_of(bus);
+      if (start <= p_address && p_address < start + sizeof(bus)) {
+        spi_write(i, bus, p_address);
+        return;
+      }
+    }
+  }
+
+private:
+  template<typename T>
+  static std::uintptr_t address_of(T const volatile& p_object)
+  {
+    return reinterpret_cast<std::uintptr_t>(&p_object);
+  }
+
+  void gpio_write(peripheral p_port, std::uintptr_t p_offset)
+  {
+    if (!is_clocked(p_port, m_registers.rcc)) {
+      m_unclocked_writes++;
+      return;
+    }
+
+    auto& port = gpio_port(p_port);
+    constexpr std::uintptr_t set_reset_offset = offsetof(stm32f4_gpio_t, set);
+    // Writes to either half of the set/reset register take effect
+    // immediately. Set takes priority over reset, per the reference manual.
+    if (p_offset == set_reset_offset || p_offset == set_reset_offset + 2) {
+      std::uint32_t const set = port.set;
+      std::uint32_t const reset = port.reset;
+      port.output_data = (port.output_data & ~reset) | set;
+      port.set = 0;
+      port.reset = 0;
+    }
+  }
+
+  void rcc_write()
+  {
+    // Oscillators and the PLL are ready as soon as they are enabled and the
+    // system clock switches immediately
+    auto& rcc_reg = m_registers.rcc;
+    auto const control = rcc_reg.cr;
+    bit_modify(rcc_reg.cr)
+      .insert<clock_control::hsi_ready>(
+        bit_extract<clock_control::hsi_enable>(control))
+      .insert<clock_control::hse_ready>(
+        bit_extract<clock_control::hse_enable>(control))
+      .insert<clock_control::pll_ready>(
+        bit_extract<clock_control::pll_enable>(control));
+    bit_modify(rcc_reg.cfgr)
+      .insert<rcc_cnfg::system_clock_status_switch>(
+        bit_extract<rcc_cnfg::system_clock_switch>(rcc_reg.cfgr));
+    bit_modify(rcc_reg.csr).insert<clock_status::lsi_ready>(
+      bit_extract<clock_status::lsi_enable>(rcc_reg.csr));
+    bit_modify(rcc_reg.bdcr)
+      .insert<backup_domain_control::lse_ready>(
+        bit_extract<backup_domain_control::lse_enable>(rcc_reg.bdcr));
+  }
+
+  bool nvic_write(std::uintptr_t p_address)
+  {
+    auto& nvic_reg = m_registers.nvic;
+    for (std::size_t i = 0; i < nvic_reg.iser.size(); i++) {
+      // Enable registers are write 1 to set/clear and both read back the
+      // current enable state.
+      if (p_address == address_of(nvic_reg.iser[i])) {
+        m_nvic_enabled[i] |= nvic_reg.iser[i];
+      } else if (p_address == address_of(nvic_reg.icer[i])) {
+        m_nvic_enabled[i] &= ~nvic_reg.icer[i];
+      } else {
+        continue;
+      }
+      nvic_reg.iser[i] = m_nvic_enabled[i];
+      nvic_reg.icer[i] = m_nvic_enabled[i];
+      return true;
+    }
+    return false;
+  }
+
+  void spi_write(std::size_t p_index,
+                 spi_reg_t& p_bus,
+                 std::uintptr_t p_address)
+  {
+    if (!is_clocked(spi_peripherals[p_index], m_registers.rcc)) {
+      m_unclocked_writes++;
+      return;
+    }
+
+    if (p_address == address_of(p_bus.cr1)) {
+      auto& channel = m_spi[p_index];
+      auto const was_enabled = channel.enabled;
+      channel.enabled = bit_extract<control_register1::enable>(p_bus.cr1);
+      // Disabling a receive-only bus lets the byte in progress complete
+      if (was_enabled && !channel.enabled &&
+          bit_extract<control_register1::rx_only>(p_bus.cr1)) {
+        spi_receive(p_index, p_bus);
+      }
+      return;
+    }
+
+    if (p_address != address_of(p_bus.dr)) {
+      return;
+    }
+
+    auto& channel = m_spi[p_index];
+    auto const transmitted = static_cast<hal::byte>(p_bus.dr);
+    p_bus.dr = channel.received;
+    if (bit_extract<status_register::rx_buffer_not_empty>(p_bus.sr) &&
+        channel.overrun_next) {
+      // Software was held off for longer than a byte time, so the byte was
+      // shifted anyway
+      channel.overrun_next = false;
+      spi_overrun(p_index, p_bus, transmitted);
+      return;
+    }
+    if (bit_extract<status_register::rx_buffer_not_empty>(p_bus.sr)) {
+      // The shift register is done but its byte has not been read yet, so
+      // this byte waits in the transmit buffer
+      channel.queued = transmitted;
+      channel.transmit_queued = true;
+      bit_modify(p_bus.sr).clear<status_register::tx_buffer_empty>();
+      return;
+    }
+    spi_shift(p_index, p_bus, transmitted);
+  }
+
+  /// A byte shifted while RXNE is set, its response is lost
+  void spi_overrun(std::size_t p_index,
+                   spi_reg_t& p_bus,
+                   hal::byte p_transmitted)
+  {
+    auto& channel = m_spi[p_index];
+    auto const unread = channel.received;
+    spi_shift(p_index, p_bus, p_transmitted);
+    channel.received = unread;
+    p_bus.dr = unread;
+    bit_modify(p_bus.sr).set<status_register::overrun_flag>();
+  }
+
+  void spi_shift_queued(std::size_t p_index, spi_reg_t& p_bus)
+  {
+    auto& channel = m_spi[p_index];
+    if (channel.transmit_queued &&
+        !bit_extract<status_register::rx_buffer_not_empty>(p_bus.sr)) {
+      channel.transmit_queued = false;
+      bit_modify(p_bus.sr).set<status_register::tx_buffer_empty>();
+      spi_shift(p_index, p_bus, channel.queued);
+    }
+  }
+
+  void spi_shift(std::size_t p_index,
+                 spi_reg_t& p_bus,
+                 hal::byte p_transmitted)
+  {
+    auto& channel = m_spi[p_index];
+    if (channel.transmitted_count < channel.transmitted.size()) {
+      channel.transmitted[channel.transmitted_count++] = p_transmitted;
+    }
+
+    auto response = p_transmitted;
+    if (channel.response_index < channel.response_count) {
+      response = channel.responses[channel.response_index++];
+    }
+
+    channel.received = response;
+    p_bus.dr = response;
+    bit_modify(p_bus.sr).set<status_register::rx_buffer_not_empty>();
+  }
+
+  bool spi_receive_only(std::size_t p_index)
+  {
+    auto const& bus = m_registers.spi[p_index];
+    return m_spi[p_index].enabled &&
+           bit_extract<control_register1::rx_only>(bus.cr1);
+  }
+
+  /// Stream the bus's receive DMA requests are currently served by
+  dma_stream_reg_t* spi_receive_stream(std::size_t p_index)
+  {
+    auto const& bus = m_registers.spi[p_index];
+    if (!bit_extract<control_register2::rx_dma_enable>(bus.cr2)) {
+      return nullptr;
+    }
+    return dma_stream_for(address_of(bus.dr),
+                          dma_direction::peripheral_to_memory);
+  }
+
+  /// Enabled stream transferring to or from a peripheral register
+  dma_stream_reg_t* dma_stream_for(std::uintptr_t p_register,
+                                   std::uint32_t p_direction)
+  {
+    auto const address =
+      mmio_address(reinterpret_cast<void const volatile*>(p_register));
+    for (auto& controller : m_registers.dma) {
+      for (auto& stream : controller.stream) {
+        if (bit_extract<dma_stream_config::enable>(stream.cr) &&
+            bit_extract<dma_stream_config::direction>(stream.cr) ==
+              p_direction &&
+            stream.par == address) {
+          return &stream;
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  /// A byte shifted in while MOSI is disabled
+  void spi_receive(std::size_t p_index, spi_reg_t& p_bus)
+  {
+    auto& channel = m_spi[p_index];
+    hal::byte received = 0;
+    if (channel.response_index < channel.response_count) {
+      received = channel.responses[channel.response_index++];
+    }
+
+    if (auto* stream = spi_receive_stream(p_index)) {
+      dma_store(*stream, received);
+      return;
+    }
+
+    if (bit_extract<status_register::rx_buffer_not_empty>(p_bus.sr)) {
+      bit_modify(p_bus.sr).set<status_register::overrun_flag>();
+      return;
+    }
+    channel.received = received;
+    p_bus.dr = received;
+    bit_modify(p_bus.sr).set<status_register::rx_buffer_not_empty>();
+  }
+
+  /// Stream the bus's transmit DMA requests are currently served by
+  dma_stream_reg_t* spi_transmit_stream(std::size_t p_index)
+  {
+    auto const& bus = m_registers.spi[p_index];
+    if (!m_spi[p_index].enabled ||
+        !bit_extract<control_register2::tx_dma_enable>(bus.cr2)) {
+      return nullptr;
+    }
+    return dma_stream_for(address_of(bus.dr),
+                          dma_direction::memory_to_peripheral);
+  }
+
+  /// Shift out the next byte of a bus's transmit stream
+  void spi_dma_shift(std::size_t p_index, dma_stream_reg_t& p_stream)
+  {
+    auto& bus = m_registers.spi[p_index];
+    spi_shift(p_index, bus, dma_load(p_stream));
+    if (auto* receive = spi_receive_stream(p_index)) {
+      bit_modify(bus.sr).clear<status_register::rx_buffer_not_empty>();
+      dma_store(*receive, static_cast<hal::byte>(bus.dr));
+    }
+  }
+
+  /// Run every enabled spi transmit dma transfer to completion
+  /// @return true - a transfer made progress
+  bool spi_dma_run()
+  {
+    bool ran = false;
+    bool progress = true;
+    while (progress) {
+      progress = false;
+      for (std::size_t i = 0; i < spi_bus_count; i++) {
+        // Completion handlers may start the next transfer, so the stream is
+        // looked up again for every byte. Circular streams never complete,
+        // they only move when clocked out.
+        auto* stream = spi_transmit_stream(i);
+        if (stream &&
+            !bit_extract<dma_stream_config::circular_mode>(stream->cr)) {
+          spi_dma_shift(i, *stream);
+          progress = true;
+          ran = true;
+        }
+      }
+    }
+    return ran;
+  }
+
+  /// Bytes moved by each transfer of a stream, from its memory data size
+  static std::size_t dma_element_size(dma_stream_reg_t const& p_stream)
+  {
+    return std::size_t{ 1 }
+           << bit_extract<dma_stream_config::memory_size>(p_stream.cr);
+  }
+
+  /// Memory location of the next transfer of a stream
+  hal::byte* dma_memory(dma_stream_reg_t& p_stream)
+  {
+    auto const [controller, stream] = dma_locate(p_stream);
+    auto const length = m_dma_lengths[controller][stream];
+    auto* memory = static_cast<hal::byte*>(mmio_pointer(p_stream.m0ar));
+    if (!bit_extract<dma_stream_config::memory_increment>(p_stream.cr)) {
+      return memory;
+    }
+    return memory + ((length - p_stream.ndtr) * dma_element_size(p_stream));
+  }
+
+  /// Move one byte from a peripheral into memory
+  void dma_store(dma_stream_reg_t& p_stream, hal::byte p_byte)
+  {
+    *dma_memory(p_stream) = p_byte;
+    dma_advance(p_stream);
+  }
+
+  /// Move one byte from memory to a peripheral
+  hal::byte dma_load(dma_stream_reg_t& p_stream)
+  {
+    auto const byte = *dma_memory(p_stream);
+    dma_advance(p_stream);
+    return byte;
+  }
+
+  /// Serve a peripheral's request by moving one element between the stream's
+  /// peripheral register and memory
+  void dma_transfer(dma_stream_reg_t& p_stream)
+  {
+    auto* peripheral = static_cast<hal::byte*>(mmio_pointer(p_stream.par));
+    auto* memory = dma_memory(p_stream);
+    auto const size = dma_element_size(p_stream);
+    if (bit_extract<dma_stream_config::direction>(p_stream.cr) ==
+        dma_direction::peripheral_to_memory) {
+      std::memcpy(memory, peripheral, size);
+    } else {
+      std::memcpy(peripheral, memory, size);
+      after_write(register_access::write,
+                  reinterpret_cast<std::uintptr_t>(peripheral));
+    }
+    dma_advance(p_stream);
+  }
+
+  /// Count down a transfer, update the stream's flags and interrupt
+  void dma_advance(dma_stream_reg_t& p_stream)
+  {
+    auto const [controller, stream] = dma_locate(p_stream);
+    auto const length = m_dma_lengths[controller][stream];
+    p_stream.ndtr = p_stream.ndtr - 1;
+
+    auto flags = bit_value(0U);
+    using config = dma_stream_config;
+    std::uint32_t const control = p_stream.cr;
+    bool raise = false;
+    if (p_stream.ndtr == length / 2) {
+      flags.set<dma_stream_flags::half_transfer>();
+      raise = bit_extract<config::half_transfer_interrupt_enable>(control);
+    }
+    if (p_stream.ndtr == 0) {
+      flags.set<dma_stream_flags::transfer_complete>();
+      raise = raise ||
+              bit_extract<config::transfer_complete_interrupt_enable>(control);
+      if (bit_extract<dma_stream_config::circular_mode>(p_stream.cr)) {
+        p_stream.ndtr = length;
+      } else {
+        bit_modify(p_stream.cr).clear<dma_stream_config::enable>();
+      }
+    }
+
+    auto& reg = m_registers.dma[controller];
+    auto const offset = dma_flag_offset(static_cast<std::uint8_t>(stream));
+    auto& status = stream >= 4 ? reg.hisr : reg.lisr;
+    status = status | (flags.get() << offset);
+
+    if (raise) {
+      interrupt(dma_stream_irq(static_cast<std::uint8_t>(controller + 1),
+                               static_cast<std::uint8_t>(stream)));
+    }
+  }
+
+  std::pair<std::size_t, std::size_t> dma_locate(
+    dma_stream_reg_t const& p_stream)
+  {
+    for (std::size_t controller = 0; controller < 2; controller++) {
+      auto const& streams = m_registers.dma[controller].stream;
+      for (std::size_t stream = 0; stream < streams.size(); stream++) {
+        if (&streams[stream] == &p_stream) {
+          return { controller, stream };
+        }
+      }
+    }
+    return { 0, 0 };
+  }
+
+  bool dma_write(std::uintptr_t p_address)
+  {
+    for (std::size_t controller = 0; controller < 2; controller++) {
+      auto& reg = m_registers.dma[controller];
+      // Flag clear registers are write 1 to clear and read as 0
+      if (p_address == address_of(reg.lifcr)) {
+        reg.lisr = reg.lisr & ~reg.lifcr;
+        reg.lifcr = 0;
+        return true;
+      }
+      if (p_address == address_of(reg.hifcr)) {
+        reg.hisr = reg.hisr & ~reg.hifcr;
+        reg.hifcr = 0;
+        return true;
+      }
+      for (std::size_t stream = 0; stream < reg.stream.size(); stream++) {
+        if (p_address == address_of(reg.stream[stream].cr)) {
+          // The counter is reloaded from its initial value in circular mode
+          if (bit_extract<dma_stream_config::enable>(reg.stream[stream].cr)) {
+            m_dma_lengths[controller][stream] = reg.stream[stream].ndtr;
+          }
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  /// State of a general purpose timer not held in its registers
+  struct timer_state
+  {
+    /// Flags raised by the timer, SR reads back these
+    std::uint32_t flags = 0;
+    /// Input clock cycles counted towards the next counter tick
+    std::uint64_t phase = 0;
+  };
+
+  static constexpr std::array<irq, simulated_timer_count> timer_update_irqs{
+    irq::tim2, irq::tim3, irq::tim4, irq::tim5, irq::tim1_up
+  };
+  static constexpr std::array<irq, simulated_timer_count> timer_compare_irqs{
+    irq::tim2, irq::tim3, irq::tim4, irq::tim5, irq::tim1_cc
+  };
+
+  /// A timer event whose DMA request is routed to a DMA2 stream
+  struct timer_dma_route
+  {
+    std::size_t timer;
+    /// Event, the request is enabled by the DIER bit 8 positions above it
+    bit_mask event;
+    std::uint8_t stream;
+    std::uint8_t channel;
+  };
+
+  /// RM0383 table 28, the DMA2 requests of TIM1
+  static constexpr std::array timer_dma_routes{
+    timer_dma_route{ timer1_index, timer_events::update, 5, 6 },
+    timer_dma_route{ timer1_index, timer_events::compare1, 1, 6 },
+    timer_dma_route{ timer1_index, timer_events::compare1, 3, 6 },
+  };
+  static constexpr std::uint64_t no_timer_event = UINT64_MAX;
+
+  bool timer_write(std::uintptr_t p_address)
+  {
+    for (std::size_t i = 0; i < simulated_timer_count; i++) {
+      auto& reg = m_registers.timer[i];
+      auto& state = m_timers[i];
+      if (p_address == address_of(reg.sr)) {
+        // Flags are write 0 to clear
+        state.flags &= reg.sr;
+        reg.sr = state.flags;
+        return true;
+      }
+      if (p_address == address_of(reg.egr)) {
+        if (bit_extract<timer_event_generation::update>(reg.egr)) {
+          reg.cnt = 0;
+          state.phase = 0;
+          if (!bit_extract<timer_control1::update_request_source>(reg.cr1)) {
+            timer_raise(i, timer_events::update.value<std::uint32_t>());
+          }
+        }
+        reg.egr = 0;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Raise flags, serve the DMA requests they make and run the timer's
+  /// interrupt if one of them is enabled
+  void timer_raise(std::size_t p_index, std::uint32_t p_flags)
+  {
+    auto& reg = m_registers.timer[p_index];
+    m_timers[p_index].flags |= p_flags;
+    reg.sr = m_timers[p_index].flags;
+
+    for (auto const& route : timer_dma_routes) {
+      auto const requested = route.event.value<std::uint32_t>();
+      if (route.timer != p_index || (p_flags & requested) == 0 ||
+          (reg.dier & (requested << 8)) == 0) {
+        continue;
+      }
+      auto& stream = m_registers.dma[1].stream[route.stream];
+      if (bit_extract<dma_stream_config::enable>(stream.cr) &&
+          bit_extract<dma_stream_config::channel>(stream.cr) ==
+            route.channel) {
+        dma_transfer(stream);
+      }
+    }
+
+    auto const enabled =
+      p_flags & reg.dier & timer_events::all.value<std::uint32_t>();
+    if (enabled == 0) {
+      return;
+    }
+    auto const update_irq = timer_update_irqs[p_index];
+    auto const compare_irq = timer_compare_irqs[p_index];
+    auto const update = timer_events::update.value<std::uint32_t>();
+    if ((enabled & update) != 0 || update_irq == compare_irq) {
+      interrupt(update_irq);
+    }
+    if ((enabled & ~update) != 0 && update_irq != compare_irq) {
+      interrupt(compare_irq);
+    }
+  }
+
+  /// Counter ticks until the next enabled event, or no_timer_event
+  std::uint64_t ticks_to_timer_interrupt(std::size_t p_index)
+  {
+    auto const& reg = m_registers.timer[p_index];
+    if (!bit_extract<timer_control1::counter_enable>(reg.cr1)) {
+      return no_timer_event;
+    }
+    auto const period = std::uint64_t{ reg.arr } + 1U;
+    auto const count = std::uint64_t{ reg.cnt };
+    auto ticks = no_timer_event;
+    if (bit_extract<timer_events::update>(reg.dier)) {
+      ticks = period - count;
+    }
+    for (std::size_t channel = 0; channel < reg.ccr.size(); channel++) {
+      auto const compare = std::uint64_t{ reg.ccr[channel] };
+      if (!bit_extract(bit_mask::from(channel + 1U), reg.dier) ||
+          compare >= period) {
+        continue;
+      }
+      // A match with the current count happened already
+      auto const distance =
+        compare > count ? compare - count : period - count + compare;
+      ticks = std::min(ticks, distance);
+    }
+    return ticks;
+  }
+
+  /// Input clock cycles until a running timer raises an enabled interrupt
+  std::uint64_t cycles_to_timer_interrupt()
+  {
+    std::uint64_t cycles = 0;
+    for (std::size_t i = 0; i < simulated_timer_count; i++) {
+      auto const ticks = ticks_to_timer_interrupt(i);
+      if (ticks == no_timer_event) {
+        continue;
+      }
+      auto const cycles_per_tick =
+        std::uint64_t{ m_registers.timer[i].psc } + 1;
+      auto const timer_cycles = ticks * cycles_per_tick - m_timers[i].phase;
+      if (cycles == 0 || timer_cycles < cycles) {
+        cycles = timer_cycles;
+      }
+    }
+    return cycles;
+  }
+
+  /// Count the ticks of a running timer, raising its flags on the way
+  void timer_count(std::size_t p_index, std::uint64_t p_ticks)
+  {
+    auto& reg = m_registers.timer[p_index];
+    while (p_ticks > 0) {
+      auto const period = std::uint64_t{ reg.arr } + 1U;
+      auto const count = std::uint64_t{ reg.cnt };
+      auto step = std::min(p_ticks, period - count);
+      for (auto const compare : reg.ccr) {
+        if (compare > count && compare < period) {
+          step = std::min(step, compare - count);
+        }
+      }
+
+      p_ticks -= step;
+      auto next = count + step;
+      std::uint32_t flags = 0;
+      if (next == period) {
+        next = 0;
+        flags |= timer_events::update.value<std::uint32_t>();
+      }
+      reg.cnt = static_cast<std::uint32_t>(next);
+      for (std::size_t channel = 0; channel < reg.ccr.size(); channel++) {
+        if (reg.ccr[channel] == next) {
+          flags |= bit_mask::from(channel + 1U).value<std::uint32_t>();
+        }
+      }
+      if (flags != 0) {
+        timer_raise(p_index, flags);
+      }
+    }
+  }
+
+  /// Let time pass for every running timer
+  void elapse(std::uint64_t p_cycles)
+  {
+    m_elapsed_cycles += p_cycles;
+    for (std::size_t i = 0; i < simulated_timer_count; i++) {
+      auto const& reg = m_registers.timer[i];
+      if (!bit_extract<timer_control1::counter_enable>(reg.cr1)) {
+        continue;
+      }
+      auto& state = m_timers[i];
+      auto const cycles_per_tick = std::uint64_t{ reg.psc } + 1;
+      auto const cycles = state.phase + p_cycles;
+      state.phase = cycles % cycles_per_tick;
+      timer_count(i, cycles / cycles_per_tick);
+    }
+  }
+
+  /// Run the handler of an interrupt if it is enabled
+  void interrupt(irq p_irq)
+  {
+    auto const index = static_cast<std::size_t>(hal::value(p_irq));
+    if (!bit_extract(bit_mask::from(static_cast<std::uint32_t>(index % 32)),
+                     m_nvic_enabled[index / 32])) {
+      return;
+    }
+    auto const* vectors =
+      static_cast<void (*const*)()>(mmio_pointer(m_registers.scb.vtor));
+    if (auto* handler = vectors[core_vector_count + index]) {
+      handler();
+    }
+  }
+
+  simulated_registers m_registers{};
+  original_registers m_original{};
+  std::array<spi_channel, spi_bus_count> m_spi{};
+  std::array<std::array<std::uint32_t, dma_stream_count>, 2> m_dma_lengths{};
+  std::array<std::uint32_t, 8> m_nvic_enabled{};
+  std::array<std::uint32_t, 3> m_power_mode_entries{};
+  std::uint32_t m_unclocked_writes = 0;
+  std::uint32_t m_exti_pending = 0;
+  std::array<timer_state, simulated_timer_count> m_timers{};
+  std::uint64_t m_elapsed_cycles = 0;
+};
+
+simulation_model model{};
+bool active = false;
+}  // namespace
+
+register_simulation::register_simulation()
+{
+  if constexpr (!LIBHAL_STM32F4_MMIO_HOOKS) {
+    hal::safe_throw(hal::operation_not_supported(this));
+  }
+  if (active) {
+    hal::safe_throw(hal::device_or_resource_busy(this));
+  }
+
+  model.reset();
+  model.redirect();
+  mmio_hook = &model;
+  active = true;
+}
+
+register_simulation::~register_simulation()
+{
+  mmio_hook = nullptr;
+  model.restore();
+  active = false;
+}
+
+void register_simulation::gpio_input(peripheral p_port, std::uint16_t p_levels)
+{
+  model.gpio_input(p_port, p_levels);
+}
+
+std::uint16_t register_simulation::gpio_output(peripheral p_port) const
+{
+  return static_cast<std::uint16_t>(model.gpio_port(p_port).output_data);
+}
+
+void register_simulation::spi_respond_with(std::uint8_t p_bus,
+                                           std::span<hal::byte const> p_data)
+{
+  auto& channel = model.spi(p_bus);
+  auto const length = std::min(p_data.size(), channel.responses.size());
+  std::copy_n(p_data.begin(), length, channel.responses.begin());
+  channel.response_count = length;
+  channel.response_index = 0;
+}
+
+std::span<hal::byte const> register_simulation::spi_transmitted(
+  std::uint8_t p_bus) const
+{
+  auto& channel = model.spi(p_bus);
+  return std::span(channel.transmitted).first(channel.transmitted_count);
+}
+
+void register_simulation::spi_clock_in(std::uint8_t p_bus, std::size_t p_count)
+{
+  model.spi(p_bus);
+  for (std::size_t i = 0; i < p_count; i++) {
+    model.spi_clock_in(p_bus - 1U);
+  }
+}
+
+void register_simulation::spi_clock_out(std::uint8_t p_bus,
+                                        std::size_t p_count)
+{
+  model.spi(p_bus);
+  for (std::size_t i = 0; i < p_count; i++) {
+    model.spi_clock_out(p_bus - 1U);
+  }
+}
+
+void register_simulation::spi_overrun_next(std::uint8_t p_bus)
+{
+  model.spi(p_bus).overrun_next = true;
+}
+
+void register_simulation::spi_overrun_on_read(std::uint8_t p_bus)
+{
+  model.spi(p_bus).overrun_on_read = true;
+}
+
+void register_simulation::elapse(hal::time_duration p_duration)
+{
+  auto const cycles = static_cast<double>(p_duration.count()) *
+                      static_cast<double>(timer_clock) / 1e9;
+  model.elapse_cycles(static_cast<std::uint64_t>(cycles));
+}
+
+hal::time_duration register_simulation::elapsed() const
+{
+  auto const nanoseconds = static_cast<double>(model.elapsed_cycles()) * 1e9 /
+                           static_cast<double>(timer_clock);
+  return hal::time_duration(static_cast<std::int64_t>(nanoseconds));
+}
+
+void register_simulation::spi_clear(std::uint8_t p_bus)
+{
+  model.spi(p_bus) = {};
+}
+
+std::uint32_t register_simulation::unclocked_writes() const
+{
+  return model.unclocked_writes();
+}
+
+std::uint32_t register_simulation::power_mode_entries(power_mode p_mode) const
+{
+  return model.power_mode_entries(p_mode);
+}
+}  // namespace hal::stm32f4
@@ -0,0 +1,152 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <cstdint>
+
+#include <libhal-stm32f4/register_trace.hpp>
+#include <libhal/error.hpp>
+
+#include "mmio.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+class trace_recorder : public mmio_observer
+{
+public:
+  void start()
+  {
+    reset();
+    m_next = mmio_hook;
+    mmio_hook = this;
+  }
+
+  void stop()
+  {
+    mmio_hook = m_next;
+    m_next = nullptr;
+  }
+
+  void reset()
+  {
+    m_counts = {};
+    m_recorded = 0;
+    m_dropped = 0;
+  }
+
+  void before_read(register_access p_kind, std::uintptr_t p_address) override
+  {
+    if (m_next) {
+      m_next->before_read(p_kind, p_address);
+    }
+
+    // The read half of a modify is counted once its write completes
+    if (p_kind == register_access::read) {
+      m_counts.reads++;
+      record(p_kind, p_address);
+    }
+  }
+
+  void after_write(register_access p_kind, std::uintptr_t p_address) override
+  {
+    if (m_next) {
+      m_next->after_write(p_kind, p_address);
+    }
+
+    if (p_kind == register_access::modify) {
+      m_counts.modifies++;
+    } else {
+      m_counts.writes++;
+    }
+    record(p_kind, p_address);
+  }
+
+  void before_wait() override
+  {
+    if (m_next) {
+      m_next->before_wait();
+    }
+  }
+
+  register_trace::counts const& counts() const
+  {
+    return m_counts;
+  }
+
+  std::span<register_trace::entry const> entries() const
+  {
+    return std::span(m_entries).first(m_recorded);
+  }
+
+  std::uint32_t dropped() const
+  {
+    return m_dropped;
+  }
+
+private:
+  void record(register_access p_kind, std::uintptr_t p_address)
+  {
+    if (m_recorded < m_entries.size()) {
+      m_entries[m_recorded++] = { .kind = p_kind, .address = p_address };
+    } else {
+      m_dropped++;
+    }
+  }
+
+  std::array<register_trace::entry, register_trace::capacity> m_entries{};
+  register_trace::counts m_counts{};
+  std::size_t m_recorded = 0;
+  std::uint32_t m_dropped = 0;
+  mmio_observer* m_next = nullptr;
+};
+
+trace_recorder recorder{};
+bool active = false;
+}  // namespace
+
+register_trace::register_trace()
+{
+  if (active) {
+    hal::safe_throw(hal::device_or_resource_busy(this));
+  }
+  recorder.start();
+  active = true;
+}
+
+register_trace::~register_trace()
+{
+  recorder.stop();
+  active = false;
+}
+
+void register_trace::reset()
+{
+  recorder.reset();
+}
+
+register_trace::counts register_trace::access_counts() const
+{
+  return recorder.counts();
+}
+
+std::span<register_trace::entry const> register_trace::entries() const
+{
+  return recorder.entries();
+}
+
+std::uint32_t register_trace::dropped() const
+{
+  return recorder.dropped();
+}
+}  // namespace hal::stm32f4
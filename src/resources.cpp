@@ -0,0 +1,118 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+#include <libhal-stm32f4/interrupt.hpp>
+#include <libhal-stm32f4/resources.hpp>
+#include <libhal/error.hpp>
+
+namespace hal::stm32f4 {
+namespace {
+/// One bit per resource id, for each resource type
+std::array<std::array<std::uint32_t, 8>, 4> claimed{};
+
+std::uint32_t& claim_word(resource p_resource)
+{
+  return claimed[hal::value(p_resource.type)][p_resource.id / 32U];
+}
+
+std::uint32_t claim_bit(resource p_resource)
+{
+  return 1U << (p_resource.id % 32U);
+}
+}  // namespace
+
+bool try_claim_resource(resource p_resource)
+{
+  critical_section section;
+  auto& word = claim_word(p_resource);
+  if (word & claim_bit(p_resource)) {
+    return false;
+  }
+  word |= claim_bit(p_resource);
+  return true;
+}
+
+void release_resource(resource p_resource)
+{
+  critical_section section;
+  claim_word(p_resource) &= ~claim_bit(p_resource);
+}
+
+bool is_resource_claimed(resource p_resource)
+{
+  return (claim_word(p_resource) & claim_bit(p_resource)) != 0;
+}
+
+resource_claim::resource_claim(resource_list const& p_resources)
+{
+  if (!claim(p_resources)) {
+    hal::safe_throw(hal::device_or_resource_busy(this));
+  }
+}
+
+std::optional<resource_claim> resource_claim::try_claim(
+  resource_list const& p_resources) noexcept
+{
+  std::optional<resource_claim> result(std::in_place);
+  if (!result->claim(p_resources)) {
+    return std::nullopt;
+  }
+  return result;
+}
+
+resource_claim::resource_claim(resource_claim&& p_other) noexcept
+  : m_resources(std::exchange(p_other.m_resources, {}))
+{
+}
+
+resource_claim& resource_claim::operator=(resource_claim&& p_other) noexcept
+{
+  if (this != &p_other) {
+    release();
+    m_resources = std::exchange(p_other.m_resources, {});
+  }
+  return *this;
+}
+
+resource_claim::~resource_claim()
+{
+  release();
+}
+
+bool resource_claim::claim(resource_list const& p_resources) noexcept
+{
+  for (auto const& item : p_resources.list()) {
+    if (!try_claim_resource(item)) {
+      // All or nothing, give back what was taken so far
+      release();
+      return false;
+    }
+    m_resources.items[m_resources.count++] = item;
+  }
+  return true;
+}
+
+void resource_claim::release() noexcept
+{
+  for (auto const& item : m_resources.list()) {
+    release_resource(item);
+  }
+  m_resources = {};
+}
+}  // namespace hal::stm32f4
@@ -0,0 +1,77 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+
+#include <libhal-util/bit.hpp>
+
+namespace hal::stm32f4 {
+/// Real time clock registers, up to the write protection register
+struct rtc_reg_t
+{
+  /// Offset: 0x00 Time Register
+  std::uint32_t volatile tr;
+  /// Offset: 0x04 Date Register
+  std::uint32_t volatile dr;
+  /// Offset: 0x08 Control Register
+  std::uint32_t volatile cr;
+  /// Offset: 0x0C Initialization and Status Register
+  std::uint32_t volatile isr;
+  /// Offset: 0x10 Prescaler Register
+  std::uint32_t volatile prer;
+  /// Offset: 0x14 Wakeup Timer Register
+  std::uint32_t volatile wutr;
+  /// Offset: 0x18 Calibration Register
+  std::uint32_t volatile calibr;
+  /// Offset: 0x1C Alarm A Register
+  std::uint32_t volatile alrmar;
+  /// Offset: 0x20 Alarm B Register
+  std::uint32_t volatile alrmbr;
+  /// Offset: 0x24 Write Protection Register
+  std::uint32_t volatile wpr;
+};
+
+/// RTC Control Register
+struct rtc_control
+{
+  /// Wakeup clock selection, 0b000 selects RTCCLK / 16
+  static constexpr auto wakeup_clock_select = bit_mask::from<2, 0>();
+
+  /// Wakeup timer enable
+  static constexpr auto wakeup_timer_enable = bit_mask::from<10>();
+
+  /// Wakeup timer interrupt enable, also required for EXTI wakeup events
+  static constexpr auto wakeup_timer_interrupt = bit_mask::from<14>();
+};
+
+/// RTC Initialization and Status Register
+struct rtc_status
+{
+  /// Wakeup timer registers can be written
+  static constexpr auto wakeup_timer_write_flag = bit_mask::from<2>();
+
+  /// Wakeup timer reached zero (write 0 to clear)
+  static constexpr auto wakeup_timer_flag = bit_mask::from<10>();
+};
+
+/// Keys written in order to the write protection register to unlock the RTC
+inline constexpr std::uint32_t rtc_unlock_key1 = 0xCA;
+inline constexpr std::uint32_t rtc_unlock_key2 = 0x53;
+/// Any other value locks the RTC registers again
+inline constexpr std::uint32_t rtc_lock_key = 0xFF;
+
+inline rtc_reg_t* rtc = reinterpret_cast<rtc_reg_t*>(0x4000'2800);
+}  // namespace hal::stm32f4
@@ -0,0 +1,297 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+#include <libhal-stm32f4/clock.hpp>
+#include <libhal-stm32f4/interrupt.hpp>
+#include <libhal-stm32f4/scheduler.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal/error.hpp>
+
+#include "mmio.hpp"
+#include "power.hpp"
+#include "timer_common.hpp"
+#include "timer_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+constexpr std::uint32_t max_prescaler = 0xFFFF;
+
+scheduler* active_scheduler = nullptr;
+}  // namespace
+
+scheduler::scheduler(hal::runtime, settings const& p_settings)
+  : m_resources(scheduler_resources())
+{
+  auto const input_clock = clock_rate(peripheral::timer5);
+  auto const divider = std::round(input_clock / p_settings.tick_rate);
+  if (!(divider >= 1.0f) || divider > max_prescaler + 1.0f) {
+    hal::safe_throw(hal::operation_not_supported(this));
+  }
+  active_scheduler = this;
+
+  auto const prescaler = static_cast<std::uint32_t>(divider) - 1U;
+  m_tick_rate = input_clock / static_cast<float>(prescaler + 1U);
+  m_requested_tick_rate = p_settings.tick_rate;
+
+  power(peripheral::timer5).on();
+  mmio_write(timer_reg5->cr1, 0);
+  mmio_write(timer_reg5->psc, prescaler);
+  mmio_write(timer_reg5->arr, 0xFFFF'FFFF);
+  // Load the prescaler and restart the counter without raising the update
+  // flag, which would count as an overflow
+  mmio_write(
+    timer_reg5->cr1,
+    bit_value(0U).set<timer_control1::update_request_source>().get());
+  mmio_write(timer_reg5->egr,
+             bit_value(0U).set<timer_event_generation::update>().get());
+  mmio_write(timer_reg5->sr, 0);
+  mmio_write(timer_reg5->dier,
+             bit_value(0U)
+               .set<timer_events::update>()
+               .set<timer_events::compare1>()
+               .get());
+  enable_interrupt(irq::tim5, handle_interrupt);
+  mmio_set_bit(timer_reg5->cr1, timer_control1::counter_enable);
+}
+
+scheduler::~scheduler()
+{
+  mmio_write(timer_reg5->cr1, 0);
+  mmio_write(timer_reg5->dier, 0);
+  disable_interrupt(irq::tim5);
+  power(peripheral::timer5).off();
+  active_scheduler = nullptr;
+}
+
+scheduler::task_id scheduler::post(task p_task)
+{
+  return insert(uptime(), 0, std::move(p_task));
+}
+
+scheduler::task_id scheduler::post_after(hal::time_duration p_delay,
+                                         task p_task)
+{
+  return insert(uptime() + to_ticks(p_delay), 0, std::move(p_task));
+}
+
+scheduler::task_id scheduler::post_every(hal::time_duration p_period,
+                                         task p_task)
+{
+  auto const period = to_ticks(p_period);
+  if (period == 0) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  return insert(uptime() + period, period, std::move(p_task));
+}
+
+bool scheduler::cancel(task_id p_id)
+{
+  auto const slot = static_cast<std::uint8_t>(p_id & 0xFF);
+  auto const generation = static_cast<std::uint16_t>(p_id >> 8);
+  if (slot >= capacity) {
+    return false;
+  }
+
+  critical_section section;
+  auto& task_entry = m_entries[slot];
+  if (!task_entry.used || task_entry.generation != generation ||
+      task_entry.cancelled) {
+    return false;
+  }
+  if (task_entry.running) {
+    // Freed by run_due() once the task returns
+    task_entry.cancelled = true;
+    return true;
+  }
+
+  for (std::size_t i = 0; i < m_count; i++) {
+    if (m_order[i] == slot) {
+      for (std::size_t j = i + 1; j < m_count; j++) {
+        m_order[j - 1] = m_order[j];
+      }
+      m_count--;
+      break;
+    }
+  }
+  task_entry.used = false;
+  task_entry.handler = {};
+  return true;
+}
+
+std::size_t scheduler::pending() const
+{
+  return m_count;
+}
+
+bool scheduler::run_due()
+{
+  while (true) {
+    std::uint8_t slot = 0;
+    {
+      critical_section section;
+      if (m_count == 0 || m_entries[m_order[0]].deadline > uptime()) {
+        return m_count != 0;
+      }
+      slot = m_order[0];
+      for (std::size_t i = 1; i < m_count; i++) {
+        m_order[i - 1] = m_order[i];
+      }
+      m_count--;
+      m_entries[slot].running = true;
+    }
+
+    // Run with interrupts enabled, the entry stays reserved meanwhile
+    m_entries[slot].handler();
+
+    critical_section section;
+    auto& task_entry = m_entries[slot];
+    task_entry.running = false;
+    if (task_entry.period != 0 && !task_entry.cancelled) {
+      task_entry.deadline += task_entry.period;
+      enqueue(slot);
+    } else {
+      task_entry.used = false;
+      task_entry.handler = {};
+    }
+  }
+}
+
+void scheduler::run()
+{
+  while (run_due()) {
+    critical_section section;
+    if (m_count == 0) {
+      continue;
+    }
+    // An early wake up simply sets the compare again
+    if (wake_at(m_entries[m_order[0]].deadline)) {
+      wait_for_interrupt();
+    }
+  }
+}
+
+bool scheduler::wake_at(std::uint64_t p_deadline)
+{
+  mmio_write(timer_reg5->ccr[0], static_cast<std::uint32_t>(p_deadline));
+  // The counter may have passed the deadline before the compare was set
+  return p_deadline > uptime();
+}
+
+void scheduler::retime()
+{
+  auto const input_clock = clock_rate(peripheral::timer5);
+  auto const divider =
+    std::clamp(std::round(input_clock / m_requested_tick_rate),
+               1.0f,
+               max_prescaler + 1.0f);
+  auto const prescaler = static_cast<std::uint32_t>(divider) - 1U;
+
+  critical_section section;
+  auto const now = uptime();
+  mmio_write(timer_reg5->psc, prescaler);
+  // Load the prescaler at once. The update event clears the counter without
+  // raising the update flag, so the count is put back and any overflow not
+  // yet handled is folded into the epoch.
+  mmio_write(timer_reg5->egr,
+             bit_value(0U).set<timer_event_generation::update>().get());
+  mmio_write(timer_reg5->sr,
+             ~timer_events::update.value<std::uint32_t>());
+  mmio_write(timer_reg5->cnt, static_cast<std::uint32_t>(now));
+  m_epoch = static_cast<std::uint32_t>(now >> 32);
+  m_tick_rate = input_clock / static_cast<float>(prescaler + 1U);
+}
+
+hal::hertz scheduler::driver_frequency()
+{
+  return m_tick_rate;
+}
+
+std::uint64_t scheduler::driver_uptime()
+{
+  critical_section section;
+  std::uint64_t epoch = m_epoch;
+  auto count = mmio_read(timer_reg5->cnt);
+  // An overflow not yet handled by the interrupt, the counter is read again
+  // as it may have been read before the overflow
+  if (bit_extract<timer_events::update>(mmio_read(timer_reg5->sr))) {
+    epoch++;
+    count = mmio_read(timer_reg5->cnt);
+  }
+  return (epoch << 32) | count;
+}
+
+std::uint64_t scheduler::to_ticks(hal::time_duration p_duration) const
+{
+  if (p_duration.count() <= 0) {
+    return 0;
+  }
+  auto const ticks = std::ceil(static_cast<double>(p_duration.count()) *
+                               static_cast<double>(m_tick_rate) / 1e9);
+  return static_cast<std::uint64_t>(ticks);
+}
+
+scheduler::task_id scheduler::insert(std::uint64_t p_deadline,
+                                     std::uint64_t p_period,
+                                     task&& p_task)
+{
+  critical_section section;
+  for (std::size_t slot = 0; slot < capacity; slot++) {
+    auto& task_entry = m_entries[slot];
+    if (task_entry.used) {
+      continue;
+    }
+    task_entry.handler = std::move(p_task);
+    task_entry.deadline = p_deadline;
+    task_entry.period = p_period;
+    task_entry.cancelled = false;
+    task_entry.used = true;
+    // Never 0, so 0 can stand for no task
+    task_entry.generation = static_cast<std::uint16_t>(
+      task_entry.generation == 0xFFFF ? 1 : task_entry.generation + 1);
+    enqueue(static_cast<std::uint8_t>(slot));
+    return (static_cast<task_id>(task_entry.generation) << 8) | slot;
+  }
+  hal::safe_throw(hal::resource_unavailable_try_again(this));
+}
+
+void scheduler::enqueue(std::uint8_t p_slot)
+{
+  // Equal deadlines run in the order they were queued
+  auto const deadline = m_entries[p_slot].deadline;
+  auto position = m_count;
+  while (position > 0 && m_entries[m_order[position - 1]].deadline > deadline) {
+    m_order[position] = m_order[position - 1];
+    position--;
+  }
+  m_order[position] = p_slot;
+  m_count++;
+}
+
+void scheduler::handle_interrupt()
+{
+  auto const flags =
+    mmio_read(timer_reg5->sr) & timer_events::all.value<std::uint32_t>();
+  // Write 0 to clear only the flags that were read
+  mmio_write(timer_reg5->sr, ~flags);
+  if (bit_extract<timer_events::update>(flags) && active_scheduler) {
+    active_scheduler->m_epoch = active_scheduler->m_epoch + 1;
+  }
+  // Compare matches only wake the core, run() checks the deadlines
+}
+}  // namespace hal::stm32f4
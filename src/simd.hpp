@@ -0,0 +1,124 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <libhal-stm32f4/dsp.hpp>
+
+#if defined(__ARM_FEATURE_SIMD32)
+#include <arm_acle.h>
+#endif
+
+namespace hal::stm32f4 {
+// Cortex-M4 SIMD instructions operating on two q15 lanes packed into a 32-bit
+// word, lane 0 in the lower half. Builds without the DSP extension, including
+// host builds, get portable equivalents, so the kernels built on them run and
+// can be tested anywhere.
+
+/// Two q15 lanes packed into a word
+using q15x2 = std::uint32_t;
+
+/**
+ * @brief Load two consecutive samples, p_samples[0] into lane 0
+ *
+ * Compiles to a single LDR, Cortex-M4 supports unaligned word loads.
+ */
+inline q15x2 load_q15x2(q15 const* p_samples)
+{
+  q15x2 value;
+  std::memcpy(&value, p_samples, sizeof(value));
+  return value;
+}
+
+inline q15 lane0(q15x2 p_value)
+{
+  return static_cast<q15>(p_value & 0xFFFFU);
+}
+
+inline q15 lane1(q15x2 p_value)
+{
+  return static_cast<q15>(p_value >> 16);
+}
+
+inline q15x2 pack_q15x2(q15 p_lane0, q15 p_lane1)
+{
+  return static_cast<std::uint16_t>(p_lane0) |
+         (static_cast<q15x2>(static_cast<std::uint16_t>(p_lane1)) << 16);
+}
+
+/// SMLALD: p_accumulator + a0 * b0 + a1 * b1
+inline std::int64_t smlald(q15x2 p_a, q15x2 p_b, std::int64_t p_accumulator)
+{
+#if defined(__ARM_FEATURE_SIMD32)
+  return __smlald(static_cast<std::int32_t>(p_a),
+                  static_cast<std::int32_t>(p_b),
+                  p_accumulator);
+#else
+  return p_accumulator + (std::int32_t{ lane0(p_a) } * lane0(p_b)) +
+         (std::int32_t{ lane1(p_a) } * lane1(p_b));
+#endif
+}
+
+/// SMLALDX: p_accumulator + a0 * b1 + a1 * b0
+inline std::int64_t smlaldx(q15x2 p_a, q15x2 p_b, std::int64_t p_accumulator)
+{
+#if defined(__ARM_FEATURE_SIMD32)
+  return __smlaldx(static_cast<std::int32_t>(p_a),
+                   static_cast<std::int32_t>(p_b),
+                   p_accumulator);
+#else
+  return p_accumulator + (std::int32_t{ lane0(p_a) } * lane1(p_b)) +
+         (std::int32_t{ lane1(p_a) } * lane0(p_b));
+#endif
+}
+
+/// SSUB16 + SEL: larger sample of each lane
+inline q15x2 max_q15x2(q15x2 p_a, q15x2 p_b)
+{
+#if defined(__ARM_FEATURE_SIMD32)
+  // SEL depends on the GE flags set by SSUB16, so both must be in one block
+  q15x2 result;
+  asm("ssub16 %0, %1, %2\n\t"
+      "sel %0, %1, %2"
+      : "=&r"(result)
+      : "r"(p_a), "r"(p_b)
+      : "cc");
+  return result;
+#else
+  return pack_q15x2(std::max(lane0(p_a), lane0(p_b)),
+                    std::max(lane1(p_a), lane1(p_b)));
+#endif
+}
+
+/// SSUB16 + SEL: smaller sample of each lane
+inline q15x2 min_q15x2(q15x2 p_a, q15x2 p_b)
+{
+#if defined(__ARM_FEATURE_SIMD32)
+  q15x2 result;
+  asm("ssub16 %0, %1, %2\n\t"
+      "sel %0, %2, %1"
+      : "=&r"(result)
+      : "r"(p_a), "r"(p_b)
+      : "cc");
+  return result;
+#else
+  return pack_q15x2(std::min(lane0(p_a), lane0(p_b)),
+                    std::min(lane1(p_a), lane1(p_b)));
+#endif
+}
+}  // namespace hal::stm32f4
@@ -11,9 +11,12 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstdint>
-
-#include <bit>
+#include <system_error>
+#include <utility>
 
 #include "libhal-stm32f4/pin.hpp"
 #include <libhal-stm32f4/constants.hpp>
@@ -23,178 +26,148 @@
 #include <libhal-util/static_callable.hpp>
 #include <libhal/error.hpp>
 
+#include "dma.hpp"
+#include "mmio.hpp"
 #include "power.hpp"
+#include "profile_scope.hpp"
+#include "spi_common.hpp"
 #include "spi_reg.hpp"
 
 namespace hal::stm32f4 {
 namespace {
-inline spi_reg_t* get_spi_reg(peripheral p_id)
-{
-  switch (p_id) {
-    case peripheral::spi1:
-      return stm32f4::spi_reg1;
-    case peripheral::spi2:
-      return stm32f4::spi_reg2;
-    case peripheral::spi3:
-      return stm32f4::spi_reg3;
-    case peripheral::spi4:
-      return stm32f4::spi_reg4;
-    case peripheral::spi5:
-      return stm32f4::spi_reg5;
+/// NDTR is a 16-bit counter and the buffer is split into two halves
+constexpr std::size_t max_stream_buffer_size = 65534;
+constexpr std::uint32_t high_priority = 0b10;
 
+/// Raise the exception matching an error of the non-throwing api
+[[noreturn]] void throw_spi_error(std::errc p_error, void* p_source)
+{
+  switch (p_error) {
+    case std::errc::argument_out_of_domain:
+      hal::safe_throw(hal::argument_out_of_domain(p_source));
+    case std::errc::device_or_resource_busy:
+      hal::safe_throw(hal::device_or_resource_busy(p_source));
     default:
-      hal::safe_throw(hal::operation_not_supported(nullptr));
+      hal::safe_throw(hal::operation_not_supported(p_source));
   }
 }
+}  // namespace
 
-inline bool busy(spi_reg_t* p_reg)
-{
-  return bit_extract<status_register::busy_flag>(p_reg->sr);
-}
-inline bool tx_empty(spi_reg_t* p_reg)
+spi::spi(hal::runtime,
+         std::uint8_t p_bus_number,
+         spi::settings const& p_settings)
+  : spi(hal::runtime{}, p_bus_number, default_pins(p_bus_number), p_settings)
 {
-  return bit_extract<status_register::tx_buffer_empty>(p_reg->sr);
 }
-inline bool rx_not_empty(spi_reg_t* p_reg)
+
+spi::spi(hal::runtime,
+         std::uint8_t p_bus_number,
+         spi_pins const& p_pins,
+         spi::settings const& p_settings)
 {
-  return bit_extract<status_register::rx_buffer_not_empty>(p_reg->sr);
+  auto const error = initialize(p_bus_number, p_pins, p_settings);
+  if (error != std::errc{}) {
+    throw_spi_error(error, this);
+  }
 }
-}  // namespace
 
 spi::spi(hal::runtime,
          std::uint8_t p_bus_number,
-         spi::settings const& p_settings)
+         spi_pins const& p_pins,
+         spi::settings const& p_settings,
+         std::errc& p_error) noexcept
 {
-  // Datasheet: Chapter 4: Pin definition Table 9
-  switch (p_bus_number) {
-    case 1: {
-      m_peripheral_register = get_spi_reg(peripheral::spi1);
-      m_peripheral_id = peripheral::spi1;
-      pin clock(peripheral::gpio_a, 5);
-      pin data_in(peripheral::gpio_a, 7);
-      pin data_out(peripheral::gpio_a, 6);
-
-      clock.function(pin::pin_function::alternate5)
-        .open_drain(false)
-        .resistor(pin_resistor::none);
-      data_in.function(pin::pin_function::alternate5)
-        .open_drain(false)
-        .resistor(pin_resistor::none);
-      data_out.function(pin::pin_function::alternate5)
-        .open_drain(false)
-        .resistor(pin_resistor::none);
-      break;
-    }
-    case 2: {
-      m_peripheral_register = get_spi_reg(peripheral::spi2);
-      m_peripheral_id = peripheral::spi2;
-      pin clock(peripheral::gpio_b, 10);
-      pin data_in(peripheral::gpio_b, 14);
-      pin data_out(peripheral::gpio_b, 15);
-
-      clock.function(pin::pin_function::alternate5)
-        .open_drain(false)
-        .resistor(pin_resistor::none);
-      data_in.function(pin::pin_function::alternate5)
-        .open_drain(false)
-        .resistor(pin_resistor::none);
-      data_out.function(pin::pin_function::alternate5)
-        .open_drain(false)
-        .resistor(pin_resistor::none);
-      break;
-    }
-    case 3: {
-      m_peripheral_register = get_spi_reg(peripheral::spi3);
-      m_peripheral_id = peripheral::spi3;
-      pin clock(peripheral::gpio_b, 3);
-      pin data_in(peripheral::gpio_b, 5);
-      pin data_out(peripheral::gpio_b, 4);
-
-      clock.function(pin::pin_function::alternate7)
-        .open_drain(false)
-        .resistor(pin_resistor::none);
-      data_in.function(pin::pin_function::alternate7)
-        .open_drain(false)
-        .resistor(pin_resistor::none);
-      data_out.function(pin::pin_function::alternate7)
-        .open_drain(false)
-        .resistor(pin_resistor::none);
-      break;
-    }
-    case 4: {
-      m_peripheral_register = get_spi_reg(peripheral::spi4);
-      m_peripheral_id = peripheral::spi4;
-      pin clock(peripheral::gpio_b, 0);
-      pin data_in(peripheral::gpio_b, 8);
-      pin data_out(peripheral::gpio_a, 12);
-
-      clock.function(pin::pin_function::alternate6)
-        .open_drain(false)
-        .resistor(pin_resistor::none);
-      data_in.function(pin::pin_function::alternate6)
-        .open_drain(false)
-        .resistor(pin_resistor::none);
-      data_out.function(pin::pin_function::alternate6)
-        .open_drain(false)
-        .resistor(pin_resistor::none);
-      break;
-    }
-    case 5: {
-      m_peripheral_register = get_spi_reg(peripheral::spi5);
-      m_peripheral_id = peripheral::spi5;
-      pin clock(peripheral::gpio_b, 3);
-      pin data_in(peripheral::gpio_b, 5);
-      pin data_out(peripheral::gpio_b, 4);
-
-      clock.function(pin::pin::pin_function::alternate6)
-        .open_drain(false)
-        .resistor(pin_resistor::none);
-      data_in.function(pin::pin::pin_function::alternate6)
-        .open_drain(false)
-        .resistor(pin_resistor::none);
-      data_out.function(pin::pin_function::alternate6)
-        .open_drain(false)
-        .resistor(pin_resistor::none);
-      break;
+  p_error = initialize(p_bus_number, p_pins, p_settings);
+}
+
+std::errc spi::initialize(std::uint8_t p_bus_number,
+                          spi_pins const& p_pins,
+                          spi::settings const& p_settings) noexcept
+{
+  if (p_bus_number < 1 || p_bus_number > spi_bus_count) {
+    return std::errc::operation_not_supported;
+  }
+  auto const& bus = spi_buses[p_bus_number - 1];
+
+  std::array const routes{
+    find_spi_route(p_bus_number, spi_signal::clock, p_pins.clock),
+    find_spi_route(p_bus_number, spi_signal::data_in, p_pins.data_in),
+    find_spi_route(p_bus_number, spi_signal::data_out, p_pins.data_out),
+  };
+  for (std::size_t i = 0; i < routes.size(); i++) {
+    if (!routes[i]) {
+      return std::errc::argument_out_of_domain;
     }
-    default:
-      // "Supported spi busses are 1-5!";
-      hal::safe_throw(hal::operation_not_supported(this));
+    m_routes[i] = *routes[i];
   }
+
+  // Checked before anything is claimed, so a failure has no side effects
+  if (!find_baud_rate(clock_rate(bus.id), p_settings.clock_rate)) {
+    return std::errc::operation_not_supported;
+  }
+
+  resource_list resources{ .items = { peripheral_resource(bus.id) },
+                           .count = 1 };
+  for (auto const& route : m_routes) {
+    resources.items[resources.count++] =
+      pin_resource(route.location.port, route.location.pin);
+  }
+  auto claim = resource_claim::try_claim(resources);
+  if (!claim) {
+    return std::errc::device_or_resource_busy;
+  }
+  m_resources = std::move(*claim);
+  m_peripheral_id = bus.id;
+  m_peripheral_register = *bus.reg;
+  m_bus = p_bus_number;
+
   power(m_peripheral_id).on();
-  spi::driver_configure(p_settings);
-}  // namespace hal::lpc40
+  std::errc error{};
+  configure(p_settings, error);
+  return error;
+}
 
 spi::~spi()
 {
-  power(m_peripheral_id).off();
+  if (m_peripheral_register) {
+    stop_stream();
+    power(m_peripheral_id).off();
+  }
 }
 
 void spi::driver_configure(settings const& p_settings)
 {
+  std::errc error{};
+  configure(p_settings, error);
+  if (error != std::errc{}) {
+    throw_spi_error(error, this);
+  }
+}
+
+void spi::configure(settings const& p_settings, std::errc& p_error) noexcept
+{
+  profile_scope scope(profile_point::spi_configure);
   auto* reg = reinterpret_cast<spi_reg_t*>(m_peripheral_register);
 
+  // Setup operating frequency
+  auto const baud_rate =
+    find_baud_rate(clock_rate(m_peripheral_id), p_settings.clock_rate);
+  if (!baud_rate) {
+    p_error = std::errc::operation_not_supported;
+    return;
+  }
+  p_error = std::errc{};
+  m_clock_rate = p_settings.clock_rate;
+
   // Set SPI to master mode by clearing
-  bit_modify(reg->cr1).set(control_register1::master_selection);
+  mmio_modify(reg->cr1).set(control_register1::master_selection);
 
-  // Setup operating frequency
-  // TODO(#16): replace input clock with a get_frequency instruction
-  using namespace hal::literals;
-  auto const input_clock = 16.0_MHz;
-  auto const clock_divider = input_clock / p_settings.clock_rate;
-  auto prescaler = static_cast<std::uint16_t>(clock_divider);
-  if (prescaler <= 1) {
-    prescaler = 2;
-  } else if (prescaler > 256) {
-    hal::safe_throw(hal::operation_not_supported(this));
-  }
-
-  uint16_t baud_control = 15 - std::countl_zero(prescaler);
-  if (std::has_single_bit(prescaler)) {
-    baud_control--;
-  }
-  bit_modify(reg->cr1)
-    .insert<control_register1::baud_rate_control>(baud_control)
+  // Pins are configured here rather than at construction so that their
+  // slew rate follows the clock rate.
+  configure_spi_pins(m_routes, pin_speed_for(baud_rate->clock_rate));
+
+  mmio_modify(reg->cr1)
+    .insert<control_register1::baud_rate_control>(baud_rate->control)
     .insert<control_register1::clock_phase>(
       p_settings.data_valid_on_trailing_edge)
     .insert<control_register1::clock_polarity>(p_settings.clock_idles_high)
@@ -203,52 +176,185 @@ void spi::driver_configure(settings const& p_settings)
     .set<control_register1::internal_slave_select>()
     .clear<control_register1::frame_format>();
 
-  bit_modify(reg->cr2)
+  mmio_modify(reg->cr2)
     .set<control_register2::slave_select_output_enable>()
     .clear<control_register2::frame_format>();
 
-  bit_modify(reg->cr1).set<control_register1::master_selection>();
+  mmio_modify(reg->cr1).set<control_register1::master_selection>();
 
-  bit_modify(reg->cr1)
+  mmio_modify(reg->cr1)
     .set<control_register1::enable>()
     .clear<control_register1::internal_slave_select>();
 }
 
+void spi::retime()
+{
+  if (!m_peripheral_register) {
+    return;
+  }
+  // The dma keeps the bus busy for as long as the stream runs, so the new
+  // prescaler is applied once it stops
+  if (m_streaming) {
+    m_retime_pending = true;
+    return;
+  }
+  m_retime_pending = false;
+
+  auto* reg = reinterpret_cast<spi_reg_t*>(m_peripheral_register);
+  auto const baud_rate = retime_baud_rate(m_peripheral_id, m_clock_rate);
+
+  // The baud rate must not change while a byte is being shifted
+  while (busy(reg)) {
+    continue;
+  }
+  mmio_modify(reg->cr1).insert<control_register1::baud_rate_control>(
+    baud_rate.control);
+  configure_spi_pins(m_routes, pin_speed_for(baud_rate.clock_rate));
+}
+
 void spi::driver_transfer(std::span<hal::byte const> p_data_out,
                           std::span<hal::byte> p_data_in,
-                          hal::byte p_filler)
+                          hal::byte p_filler) noexcept
+{
+  spi_segment const segment{
+    .data_out = p_data_out,
+    .data_in = p_data_in,
+    .filler = p_filler,
+  };
+  run(std::span(&segment, 1), false);
+}
+
+bool spi::transaction(std::span<spi_segment const> p_segments) noexcept
+{
+  return run(p_segments, true);
+}
+
+bool spi::transaction(hal::output_pin& p_chip_select,
+                      std::span<spi_segment const> p_segments)
 {
   auto* reg = reinterpret_cast<spi_reg_t*>(m_peripheral_register);
-  size_t max_length = std::max(p_data_in.size(), p_data_out.size());
 
+  p_chip_select.level(false);
+  auto const intact = transaction(p_segments);
   while (busy(reg)) {
     continue;
   }
-  bit_modify(reg->cr1).set<control_register1::internal_slave_select>();
-  for (size_t index = 0; index < max_length; index++) {
-    hal::byte byte = 0;
+  p_chip_select.level(true);
+  return intact;
+}
 
-    if (index < p_data_out.size()) {
-      byte = p_data_out[index];
-    } else {
-      byte = p_filler;
-    }
+bool spi::run(std::span<spi_segment const> p_segments,
+              bool p_pipelined) noexcept
+{
+  profile_scope scope(profile_point::spi_transfer);
+  auto* reg = reinterpret_cast<spi_reg_t*>(m_peripheral_register);
 
-    while (!tx_empty(reg)) {
-      continue;
-    }
+  while (busy(reg)) {
+    continue;
+  }
+  mmio_set_bit(reg->cr1, control_register1::internal_slave_select);
+  auto const intact = exchange(reg,
+                               p_segments,
+                               p_pipelined ? exchange_mode::pipelined
+                                           : exchange_mode::lock_step);
+  mmio_clear_bit(reg->cr1, control_register1::internal_slave_select);
+  return intact;
+}
 
-    reg->dr = byte;
+void spi::start_stream(std::span<hal::byte> p_buffer, stream_handler p_on_sent)
+{
+  if (p_buffer.empty() || p_buffer.size() % 2 != 0 ||
+      p_buffer.size() > max_stream_buffer_size) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  stop_stream();
 
-    while (!rx_not_empty(reg)) {
-      continue;
-    }
+  auto* reg = reinterpret_cast<spi_reg_t*>(m_peripheral_register);
+  auto const dma = claim_spi_dma_stream(m_bus, true);
+  m_dma_controller = dma.controller;
+  m_dma_stream = dma.stream;
+  m_dma_channel = dma.channel;
+  m_stream_buffer = p_buffer;
+  m_on_sent = std::move(p_on_sent);
+  on_dma_interrupt(dma, [this]() { handle_stream_interrupt(); });
 
-    byte = static_cast<uint8_t>(reg->dr);
-    if (index < p_data_in.size()) {
-      p_data_in[index] = byte;
-    }
+  auto& stream = dma_stream(dma);
+  auto const config =
+    bit_value(0U)
+      .insert<dma_stream_config::channel>(std::uint32_t{ dma.channel })
+      .insert<dma_stream_config::priority>(high_priority)
+      .set<dma_stream_config::memory_increment>()
+      .set<dma_stream_config::circular_mode>()
+      .insert<dma_stream_config::direction>(
+        dma_direction::memory_to_peripheral)
+      .set<dma_stream_config::half_transfer_interrupt_enable>()
+      .set<dma_stream_config::transfer_complete_interrupt_enable>()
+      .get();
+
+  while (busy(reg)) {
+    continue;
+  }
+  mmio_write(stream.par, mmio_address(&reg->dr));
+  mmio_write(stream.m0ar, mmio_address(m_stream_buffer.data()));
+  mmio_write(stream.ndtr, static_cast<std::uint32_t>(m_stream_buffer.size()));
+  // Direct mode, each request moves one byte into the data register
+  mmio_write(stream.fcr, 0U);
+  mmio_write(stream.cr, config);
+  mmio_write(stream.cr,
+             bit_value(config).set<dma_stream_config::enable>().get());
+
+  // The transmit buffer is empty, so this requests the first byte
+  m_streaming = true;
+  mmio_set_bit(reg->cr2, control_register2::tx_dma_enable);
+}
+
+void spi::stop_stream()
+{
+  if (!m_streaming) {
+    return;
+  }
+
+  dma_request const dma{ m_dma_controller, m_dma_stream, m_dma_channel };
+  auto* reg = reinterpret_cast<spi_reg_t*>(m_peripheral_register);
+
+  // RM0383 20.3.8: once the last byte has been handed to the bus, wait for
+  // it to be shifted out before turning off the requests
+  stop_dma_stream(dma);
+  while (!tx_empty(reg) || busy(reg)) {
+    continue;
+  }
+  mmio_clear_bit(reg->cr2, control_register2::tx_dma_enable);
+  release_dma_stream(dma);
+
+  // Nothing read the received bytes, drop the last one and the overrun flag
+  (void)mmio_read(reg->dr);
+  (void)mmio_read(reg->sr);
+
+  m_stream_buffer = {};
+  m_on_sent = {};
+  m_streaming = false;
+  if (m_retime_pending) {
+    retime();
+  }
+}
+
+bool spi::streaming() const
+{
+  return m_streaming;
+}
+
+void spi::handle_stream_interrupt()
+{
+  profile_scope scope(profile_point::dma_complete);
+  auto const flags =
+    take_dma_flags({ m_dma_controller, m_dma_stream, m_dma_channel });
+  auto const half = m_stream_buffer.size() / 2;
+
+  if (bit_extract<dma_stream_flags::half_transfer>(flags)) {
+    m_on_sent(m_stream_buffer.first(half));
+  }
+  if (bit_extract<dma_stream_flags::transfer_complete>(flags)) {
+    m_on_sent(m_stream_buffer.last(half));
   }
-  bit_modify(reg->cr1).clear<control_register1::internal_slave_select>();
 }
 }  // namespace hal::stm32f4
@@ -0,0 +1,272 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <utility>
+
+#include <libhal-stm32f4/spi_bus.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal-util/enum.hpp>
+#include <libhal/error.hpp>
+
+#include "mmio.hpp"
+#include "power.hpp"
+#include "profile_scope.hpp"
+#include "spi_common.hpp"
+#include "spi_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+constexpr std::size_t data_route_count = 3;
+}  // namespace
+
+spi_bus::device::device(spi_bus& p_bus,
+                        hal::output_pin& p_chip_select,
+                        settings const& p_settings)
+  : m_bus(&p_bus)
+  , m_chip_select(&p_chip_select)
+{
+  m_chip_select->level(true);
+  device::driver_configure(p_settings);
+}
+
+spi_bus::device::device(spi_bus& p_bus, settings const& p_settings)
+  : m_bus(&p_bus)
+  , m_chip_select(nullptr)
+{
+  if (p_bus.m_route_count == data_route_count) {
+    hal::safe_throw(hal::operation_not_supported(this));
+  }
+  device::driver_configure(p_settings);
+}
+
+spi_bus::device::~device()
+{
+  m_bus->forget(*this);
+}
+
+void spi_bus::device::driver_configure(settings const& p_settings)
+{
+  profile_scope scope(profile_point::spi_configure);
+  auto const baud_rate =
+    calculate_baud_rate(m_bus->m_peripheral_id, p_settings.clock_rate);
+
+  auto control1 =
+    bit_value(0U)
+      .set<control_register1::master_selection>()
+      .insert<control_register1::baud_rate_control>(baud_rate.control)
+      .insert<control_register1::clock_phase>(
+        static_cast<std::uint32_t>(p_settings.data_valid_on_trailing_edge))
+      .insert<control_register1::clock_polarity>(
+        static_cast<std::uint32_t>(p_settings.clock_idles_high));
+  auto control2 = bit_value(0U);
+
+  if (m_chip_select) {
+    // Keep the internal NSS high so the controller never sees a mode fault
+    control1.set<control_register1::software_slave_management>()
+      .set<control_register1::internal_slave_select>();
+  } else {
+    // NSS is driven low while the peripheral is enabled
+    control2.set<control_register2::slave_select_output_enable>();
+  }
+
+  m_control1 = control1.get();
+  m_control2 = control2.get();
+  m_clock_rate = p_settings.clock_rate;
+  m_bus->use_clock_rate(baud_rate.clock_rate);
+  // Reload the control registers on the next transfer
+  m_bus->forget(*this);
+}
+
+void spi_bus::device::driver_transfer(std::span<hal::byte const> p_data_out,
+                                      std::span<hal::byte> p_data_in,
+                                      hal::byte p_filler)
+{
+  spi_segment const segment{
+    .data_out = p_data_out,
+    .data_in = p_data_in,
+    .filler = p_filler,
+  };
+  m_bus->process();
+  m_bus->run(*this, std::span(&segment, 1), false);
+}
+
+bool spi_bus::device::transaction(std::span<spi_segment const> p_segments)
+{
+  m_bus->process();
+  return m_bus->run(*this, p_segments, true);
+}
+
+void spi_bus::device::retime()
+{
+  auto const baud_rate =
+    retime_baud_rate(m_bus->m_peripheral_id, m_clock_rate);
+  m_control1 = bit_value(m_control1)
+                 .insert<control_register1::baud_rate_control>(
+                   baud_rate.control)
+                 .get();
+  m_bus->use_clock_rate(baud_rate.clock_rate);
+  // Transfers leave the bus idle, so the new prescaler is simply loaded on
+  // the next transfer
+  m_bus->forget(*this);
+}
+
+spi_bus::spi_bus(hal::runtime, std::uint8_t p_bus)
+  : spi_bus(hal::runtime{}, p_bus, default_pins(p_bus))
+{
+}
+
+spi_bus::spi_bus(hal::runtime,
+                 std::uint8_t p_bus,
+                 spi_pins const& p_pins,
+                 std::optional<spi_pin> p_hardware_chip_select)
+  : m_routes{
+    route_spi_signal(p_bus, spi_signal::clock, p_pins.clock),
+    route_spi_signal(p_bus, spi_signal::data_in, p_pins.data_in),
+    route_spi_signal(p_bus, spi_signal::data_out, p_pins.data_out),
+  }
+  , m_route_count(data_route_count)
+  , m_peripheral_id(spi_bus_resources(p_bus).id)
+  , m_peripheral_register(*spi_bus_resources(p_bus).reg)
+{
+  if (p_hardware_chip_select) {
+    m_routes[m_route_count++] = route_spi_signal(
+      p_bus, spi_signal::chip_select, *p_hardware_chip_select);
+  }
+  m_resources = resource_claim(
+    spi_route_resources(p_bus, std::span(m_routes).first(m_route_count)));
+
+  power(m_peripheral_id).on();
+  auto* reg = reinterpret_cast<spi_reg_t*>(m_peripheral_register);
+  mmio_write(reg->cr1, 0U);
+  mmio_write(reg->cr2, 0U);
+  configure_spi_pins(std::span(m_routes).first(m_route_count), m_pin_speed);
+}
+
+spi_bus::~spi_bus()
+{
+  power(m_peripheral_id).off();
+}
+
+void spi_bus::enqueue(transaction p_transaction)
+{
+  if (p_transaction.target == nullptr || p_transaction.target->m_bus != this) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+  if (m_queue_size == m_queue.size()) {
+    hal::safe_throw(hal::resource_unavailable_try_again(this));
+  }
+
+  auto const tail = (m_queue_head + m_queue_size) % m_queue.size();
+  m_queue[tail] = std::move(p_transaction);
+  m_queue_size++;
+}
+
+void spi_bus::process()
+{
+  while (m_queue_size != 0) {
+    auto current = std::move(m_queue[m_queue_head]);
+    m_queue[m_queue_head] = {};
+    m_queue_head = (m_queue_head + 1) % m_queue.size();
+    m_queue_size--;
+
+    spi_segment const segment{
+      .data_out = current.data_out,
+      .data_in = current.data_in,
+      .filler = current.filler,
+    };
+    run(*current.target, std::span(&segment, 1), false);
+    if (current.on_complete) {
+      current.on_complete();
+    }
+  }
+}
+
+std::size_t spi_bus::pending() const
+{
+  return m_queue_size;
+}
+
+void spi_bus::select(device& p_device)
+{
+  if (m_active == &p_device) {
+    return;
+  }
+
+  // The previous transfer left the bus idle, so the configuration can be
+  // swapped without waiting. Control register 1 is written with the
+  // peripheral disabled as the clock settings cannot change while enabled.
+  auto* reg = reinterpret_cast<spi_reg_t*>(m_peripheral_register);
+  mmio_write(reg->cr1, p_device.m_control1);
+  if (m_control2 != p_device.m_control2) {
+    mmio_write(reg->cr2, p_device.m_control2);
+    m_control2 = p_device.m_control2;
+  }
+  m_active = &p_device;
+}
+
+bool spi_bus::run(device& p_device,
+                  std::span<spi_segment const> p_segments,
+                  bool p_pipelined)
+{
+  profile_scope scope(profile_point::spi_transfer);
+  auto* reg = reinterpret_cast<spi_reg_t*>(m_peripheral_register);
+  auto const was_active = m_active == &p_device;
+  select(p_device);
+
+  if (p_device.m_chip_select) {
+    p_device.m_chip_select->level(false);
+  }
+  // Devices using a gpio chip select leave the peripheral enabled between
+  // transfers. Enabling the peripheral asserts the hardware NSS pin.
+  if (!was_active || !p_device.m_chip_select) {
+    mmio_write(reg->cr1,
+               bit_value(p_device.m_control1)
+                 .set<control_register1::enable>()
+                 .get());
+  }
+
+  auto const intact = exchange(reg,
+                               p_segments,
+                               p_pipelined ? exchange_mode::pipelined
+                                           : exchange_mode::lock_step);
+  while (busy(reg)) {
+    continue;
+  }
+
+  if (p_device.m_chip_select) {
+    p_device.m_chip_select->level(true);
+  } else {
+    mmio_write(reg->cr1, p_device.m_control1);
+  }
+  return intact;
+}
+
+void spi_bus::use_clock_rate(hal::hertz p_clock_rate)
+{
+  // Pins run at the speed needed by the fastest device on the bus
+  auto const speed = pin_speed_for(p_clock_rate);
+  if (hal::value(speed) > hal::value(m_pin_speed)) {
+    m_pin_speed = speed;
+    configure_spi_pins(std::span(m_routes).first(m_route_count), m_pin_speed);
+  }
+}
+
+void spi_bus::forget(device& p_device)
+{
+  if (m_active == &p_device) {
+    m_active = nullptr;
+  }
+}
+}  // namespace hal::stm32f4
@@ -0,0 +1,261 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <utility>
+
+#include <libhal-stm32f4/interrupt.hpp>
+#include <libhal-stm32f4/profile.hpp>
+#include <libhal-stm32f4/spi_capture.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal/error.hpp>
+
+#include "dma.hpp"
+#include "dwt_reg.hpp"
+#include "mmio.hpp"
+#include "power.hpp"
+#include "profile_scope.hpp"
+#include "spi_common.hpp"
+#include "spi_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+/// NDTR is a 16-bit counter and the buffer is split into two halves
+constexpr std::size_t max_buffer_size = 65534;
+constexpr std::uint32_t high_priority = 0b10;
+
+dma_request request_of(std::uint8_t p_controller,
+                       std::uint8_t p_stream,
+                       std::uint8_t p_channel)
+{
+  return {
+    .controller = p_controller,
+    .stream = p_stream,
+    .channel = p_channel,
+  };
+}
+}  // namespace
+
+spi_capture::spi_capture(hal::runtime,
+                         std::uint8_t p_bus,
+                         std::span<hal::byte> p_buffer,
+                         handler p_on_data,
+                         hal::spi::settings const& p_settings)
+  : spi_capture(hal::runtime{},
+                p_bus,
+                default_pins(p_bus),
+                p_buffer,
+                std::move(p_on_data),
+                p_settings)
+{
+}
+
+spi_capture::spi_capture(hal::runtime,
+                         std::uint8_t p_bus,
+                         spi_pins const& p_pins,
+                         std::span<hal::byte> p_buffer,
+                         handler p_on_data,
+                         hal::spi::settings const& p_settings)
+  : m_routes{
+    route_spi_signal(p_bus, spi_signal::clock, p_pins.clock),
+    route_spi_signal(p_bus, spi_signal::data_in, p_pins.data_in),
+  }
+  , m_resources(spi_route_resources(p_bus, m_routes))
+  , m_buffer(p_buffer)
+  , m_on_data(std::move(p_on_data))
+  , m_peripheral_id(spi_bus_resources(p_bus).id)
+  , m_peripheral_register(*spi_bus_resources(p_bus).reg)
+{
+  if (p_buffer.empty() || p_buffer.size() % 2 != 0 ||
+      p_buffer.size() > max_buffer_size) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+
+  auto const baud_rate =
+    calculate_baud_rate(m_peripheral_id, p_settings.clock_rate);
+  auto const dma = claim_spi_dma_stream(p_bus, false);
+  m_dma_controller = dma.controller;
+  m_dma_stream = dma.stream;
+  m_dma_channel = dma.channel;
+
+  power(m_peripheral_id).on();
+  configure_spi_pins(m_routes, pin_speed_for(baud_rate.clock_rate));
+  // stop() times one spi clock with the cycle counter
+  enable_cycle_counter();
+
+  m_clock_rate = p_settings.clock_rate;
+  m_control1 =
+    bit_value(0U)
+      .set<control_register1::master_selection>()
+      .insert<control_register1::baud_rate_control>(baud_rate.control)
+      .insert<control_register1::clock_phase>(
+        static_cast<std::uint32_t>(p_settings.data_valid_on_trailing_edge))
+      .insert<control_register1::clock_polarity>(
+        static_cast<std::uint32_t>(p_settings.clock_idles_high))
+      .set<control_register1::software_slave_management>()
+      .set<control_register1::internal_slave_select>()
+      .set<control_register1::rx_only>()
+      .get();
+
+  auto* reg = reinterpret_cast<spi_reg_t*>(m_peripheral_register);
+  mmio_write(reg->cr1, m_control1);
+  mmio_write(reg->cr2,
+             bit_value(0U).set<control_register2::rx_dma_enable>().get());
+
+  on_dma_interrupt(dma, [this]() { handle_interrupt(); });
+}
+
+spi_capture::~spi_capture()
+{
+  stop();
+  release_dma_stream(
+    request_of(m_dma_controller, m_dma_stream, m_dma_channel));
+  auto* reg = reinterpret_cast<spi_reg_t*>(m_peripheral_register);
+  mmio_write(reg->cr2, 0U);
+  power(m_peripheral_id).off();
+}
+
+void spi_capture::start()
+{
+  if (m_running) {
+    return;
+  }
+
+  auto const dma = request_of(m_dma_controller, m_dma_stream, m_dma_channel);
+  auto* reg = reinterpret_cast<spi_reg_t*>(m_peripheral_register);
+  auto& stream = dma_stream(dma);
+
+  // Drop any byte left over from a previous capture, also clearing overrun
+  (void)mmio_read(reg->dr);
+  (void)mmio_read(reg->sr);
+
+  auto const config =
+    bit_value(0U)
+      .insert<dma_stream_config::channel>(std::uint32_t{ dma.channel })
+      .insert<dma_stream_config::priority>(high_priority)
+      .set<dma_stream_config::memory_increment>()
+      .set<dma_stream_config::circular_mode>()
+      .insert<dma_stream_config::direction>(
+        dma_direction::peripheral_to_memory)
+      .set<dma_stream_config::half_transfer_interrupt_enable>()
+      .set<dma_stream_config::transfer_complete_interrupt_enable>()
+      .get();
+
+  mmio_write(stream.par, mmio_address(&reg->dr));
+  mmio_write(stream.m0ar, mmio_address(m_buffer.data()));
+  mmio_write(stream.ndtr, static_cast<std::uint32_t>(m_buffer.size()));
+  // Direct mode, each byte is written to memory as soon as it is received
+  mmio_write(stream.fcr, 0U);
+  mmio_write(stream.cr, config);
+  mmio_write(stream.cr,
+             bit_value(config).set<dma_stream_config::enable>().get());
+
+  // In receive-only mode, the clock starts as soon as the peripheral is
+  // enabled
+  m_clock_cycles = clock_cycles(m_control1);
+  m_running = true;
+  mmio_write(reg->cr1,
+             bit_value(m_control1).set<control_register1::enable>().get());
+}
+
+void spi_capture::stop()
+{
+  if (!m_running) {
+    return;
+  }
+
+  auto const dma = request_of(m_dma_controller, m_dma_stream, m_dma_channel);
+  auto* reg = reinterpret_cast<spi_reg_t*>(m_peripheral_register);
+  auto& stream = dma_stream(dma);
+
+  mmio_modify(stream.cr)
+    .clear<dma_stream_config::half_transfer_interrupt_enable>()
+    .clear<dma_stream_config::transfer_complete_interrupt_enable>();
+
+  // RM0383 20.3.8: the clock runs for as long as the peripheral is enabled,
+  // so it must be disabled right after a byte starts to be received. Wait
+  // for the dma to take a byte, then one SPI clock, then disable. An
+  // interrupt in between would let the next byte complete as well.
+  std::uint32_t remaining = 0;
+  {
+    critical_section section;
+    auto const previous = mmio_read(stream.ndtr);
+    remaining = previous;
+    while (remaining == previous) {
+      remaining = mmio_read(stream.ndtr);
+    }
+    auto const start = mmio_read(dwt->cyccnt);
+    while (mmio_read(dwt->cyccnt) - start < m_clock_cycles) {
+      continue;
+    }
+    mmio_write(reg->cr1, m_control1);
+  }
+
+  // The byte in progress is completed and taken by the dma
+  while (mmio_read(stream.ndtr) == remaining) {
+    continue;
+  }
+
+  stop_dma_stream(dma);
+  m_running = false;
+}
+
+bool spi_capture::running() const
+{
+  return m_running;
+}
+
+void spi_capture::retime()
+{
+  auto const baud_rate = retime_baud_rate(m_peripheral_id, m_clock_rate);
+  m_control1 = bit_value(m_control1)
+                 .insert<control_register1::baud_rate_control>(
+                   baud_rate.control)
+                 .get();
+  configure_spi_pins(m_routes, pin_speed_for(baud_rate.clock_rate));
+
+  // The prescaler of a running capture cannot change, but a cpu cycle is
+  // now a different length
+  if (m_running) {
+    auto* reg = reinterpret_cast<spi_reg_t*>(m_peripheral_register);
+    m_clock_cycles = clock_cycles(mmio_read(reg->cr1));
+  }
+}
+
+std::uint32_t spi_capture::clock_cycles(std::uint32_t p_control1) const
+{
+  // The spi input clock is the cpu clock divided by the bus divider
+  auto const bus_divider =
+    clock_rate(peripheral::cpu) / clock_rate(m_peripheral_id);
+  auto const control =
+    bit_extract<control_register1::baud_rate_control>(p_control1);
+  return static_cast<std::uint32_t>(static_cast<float>(2U << control) *
+                                    bus_divider);
+}
+
+void spi_capture::handle_interrupt()
+{
+  profile_scope scope(profile_point::dma_complete);
+  auto const flags =
+    take_dma_flags(request_of(m_dma_controller, m_dma_stream, m_dma_channel));
+  auto const half = m_buffer.size() / 2;
+
+  if (bit_extract<dma_stream_flags::half_transfer>(flags)) {
+    m_on_data(m_buffer.first(half));
+  }
+  if (bit_extract<dma_stream_flags::transfer_complete>(flags)) {
+    m_on_data(m_buffer.last(half));
+  }
+}
+}  // namespace hal::stm32f4
@@ -0,0 +1,462 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include <span>
+
+#include <libhal-stm32f4/clock.hpp>
+#include <libhal-stm32f4/constants.hpp>
+#include <libhal-stm32f4/port_configuration.hpp>
+#include <libhal-stm32f4/resources.hpp>
+#include <libhal-stm32f4/spi_pins.hpp>
+#include <libhal-stm32f4/spi_segment.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal/error.hpp>
+#include <libhal/spi.hpp>
+#include <libhal/units.hpp>
+
+#include "dma.hpp"
+#include "mmio.hpp"
+#include "spi_reg.hpp"
+
+// Building blocks shared by the spi drivers
+
+namespace hal::stm32f4 {
+inline void validate_spi_bus(std::uint8_t p_bus_number)
+{
+  if (p_bus_number < 1 || p_bus_number > spi_bus_count) {
+    // "Supported spi busses are 1-5!";
+    hal::safe_throw(hal::operation_not_supported(nullptr));
+  }
+}
+
+/// Fixed resources of a spi bus
+struct spi_bus_info
+{
+  peripheral id;
+  irq interrupt;
+  /// Points to the variable holding the register block's address, which host
+  /// builds redirect
+  spi_reg_t** reg;
+};
+
+/// Resources of each bus (index 0 is bus 1)
+inline constexpr std::array<spi_bus_info, spi_bus_count> spi_buses{ {
+  { peripheral::spi1, irq::spi1, &spi_reg1 },
+  { peripheral::spi2, irq::spi2, &spi_reg2 },
+  { peripheral::spi3, irq::spi3, &spi_reg3 },
+  { peripheral::spi4, irq::spi4, &spi_reg4 },
+  { peripheral::spi5, irq::spi5, &spi_reg5 },
+} };
+
+inline spi_bus_info const& spi_bus_resources(std::uint8_t p_bus_number)
+{
+  validate_spi_bus(p_bus_number);
+  return spi_buses[p_bus_number - 1];
+}
+
+/**
+ * @brief Resources used by a spi bus driver
+ *
+ * @param p_bus_number - spi bus number 1-5
+ * @param p_routes - pins the driver routes to the bus
+ * @return resource_list - the bus and its pins
+ */
+inline resource_list spi_route_resources(std::uint8_t p_bus_number,
+                                         std::span<spi_route const> p_routes)
+{
+  resource_list resources;
+  resources.add(peripheral_resource(spi_bus_resources(p_bus_number).id));
+  for (auto const& route : p_routes) {
+    resources.add(pin_resource(route.location.port, route.location.pin));
+  }
+  return resources;
+}
+
+inline spi_pins default_pins(std::uint8_t p_bus_number)
+{
+  validate_spi_bus(p_bus_number);
+  return default_spi_pins[p_bus_number - 1];
+}
+
+inline spi_route route_spi_signal(std::uint8_t p_bus_number,
+                                  spi_signal p_signal,
+                                  spi_pin p_pin)
+{
+  validate_spi_bus(p_bus_number);
+  auto const found = find_spi_route(p_bus_number, p_signal, p_pin);
+  if (!found) {
+    hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  }
+  return *found;
+}
+
+/// DMA stream able to serve a spi bus's receive or transmit requests
+struct spi_dma_route
+{
+  std::uint8_t bus;
+  /// true: transmit buffer empty requests, false: receive buffer not empty
+  bool transmit;
+  dma_request request;
+};
+
+// clang-format off
+/// RM0383 table 27 and 28: DMA1 and DMA2 request mapping
+inline constexpr std::array spi_dma_routes{
+  spi_dma_route{ 1, false, { .controller = 2, .stream = 0, .channel = 3 } },
+  spi_dma_route{ 1, false, { .controller = 2, .stream = 2, .channel = 3 } },
+  spi_dma_route{ 1, true,  { .controller = 2, .stream = 3, .channel = 3 } },
+  spi_dma_route{ 1, true,  { .controller = 2, .stream = 5, .channel = 3 } },
+  spi_dma_route{ 2, false, { .controller = 1, .stream = 3, .channel = 0 } },
+  spi_dma_route{ 2, true,  { .controller = 1, .stream = 4, .channel = 0 } },
+  spi_dma_route{ 3, false, { .controller = 1, .stream = 0, .channel = 0 } },
+  spi_dma_route{ 3, false, { .controller = 1, .stream = 2, .channel = 0 } },
+  spi_dma_route{ 3, true,  { .controller = 1, .stream = 5, .channel = 0 } },
+  spi_dma_route{ 3, true,  { .controller = 1, .stream = 7, .channel = 0 } },
+  spi_dma_route{ 4, false, { .controller = 2, .stream = 0, .channel = 4 } },
+  spi_dma_route{ 4, false, { .controller = 2, .stream = 3, .channel = 5 } },
+  spi_dma_route{ 4, true,  { .controller = 2, .stream = 1, .channel = 4 } },
+  spi_dma_route{ 4, true,  { .controller = 2, .stream = 4, .channel = 5 } },
+  spi_dma_route{ 5, false, { .controller = 2, .stream = 3, .channel = 2 } },
+  spi_dma_route{ 5, false, { .controller = 2, .stream = 5, .channel = 7 } },
+  spi_dma_route{ 5, true,  { .controller = 2, .stream = 4, .channel = 2 } },
+  spi_dma_route{ 5, true,  { .controller = 2, .stream = 6, .channel = 7 } },
+};
+// clang-format on
+
+/// DMA streams able to serve one kind of request of a spi bus
+struct spi_dma_options
+{
+  std::array<dma_request, 2> requests{};
+  std::size_t count = 0;
+
+  [[nodiscard]] std::span<dma_request const> list() const
+  {
+    return std::span(requests).first(count);
+  }
+};
+
+/**
+ * @brief Find the dma streams able to serve a spi bus's requests
+ *
+ * @param p_bus_number - spi bus number 1-5
+ * @param p_transmit - true for transmit requests, false for receive requests
+ * @return spi_dma_options - streams in order of preference
+ */
+constexpr spi_dma_options find_spi_dma_options(std::uint8_t p_bus_number,
+                                               bool p_transmit)
+{
+  spi_dma_options options;
+  for (auto const& route : spi_dma_routes) {
+    if (route.bus == p_bus_number && route.transmit == p_transmit) {
+      options.requests[options.count++] = route.request;
+    }
+  }
+  return options;
+}
+
+/**
+ * @brief Claim a free dma stream serving a spi bus's requests
+ *
+ * @param p_bus_number - spi bus number 1-5
+ * @param p_transmit - true for transmit requests, false for receive requests
+ * @return dma_request - the claimed stream
+ * @throws hal::device_or_resource_busy - if every stream able to serve the
+ * requests is in use
+ */
+inline dma_request claim_spi_dma_stream(std::uint8_t p_bus_number,
+                                        bool p_transmit)
+{
+  return claim_dma_stream(
+    find_spi_dma_options(p_bus_number, p_transmit).list());
+}
+
+/// Baud rate control setting and the clock rate it results in
+struct spi_baud_rate
+{
+  std::uint32_t control;
+  hal::hertz clock_rate;
+};
+
+/**
+ * @brief Select the fastest clock rate that does not exceed the requested one
+ *
+ * @param p_input_clock - clock of the bus, see `clock_rate()`
+ * @param p_clock_rate - requested clock rate
+ * @return std::optional<spi_baud_rate> - baud rate control setting,
+ * std::nullopt if the clock rate is too slow
+ */
+inline std::optional<spi_baud_rate> find_baud_rate(hal::hertz p_input_clock,
+                                                   hal::hertz p_clock_rate)
+{
+  auto const clock_divider = p_input_clock / p_clock_rate;
+  if (!(clock_divider < 257.0f)) {
+    return std::nullopt;
+  }
+  auto prescaler = static_cast<std::uint16_t>(clock_divider);
+  if (prescaler <= 1) {
+    prescaler = 2;
+  }
+
+  std::uint32_t baud_control = 15 - std::countl_zero(prescaler);
+  if (std::has_single_bit(prescaler)) {
+    baud_control--;
+  }
+  return spi_baud_rate{
+    .control = baud_control,
+    .clock_rate = p_input_clock / static_cast<float>(2U << baud_control),
+  };
+}
+
+/**
+ * @brief Select the fastest clock rate of a bus not exceeding the requested
+ * one, for its current input clock
+ *
+ * @param p_bus - spi peripheral
+ * @param p_clock_rate - requested clock rate
+ * @return spi_baud_rate - baud rate control setting
+ * @throws hal::operation_not_supported - if the clock rate is too slow
+ */
+inline spi_baud_rate calculate_baud_rate(peripheral p_bus,
+                                         hal::hertz p_clock_rate)
+{
+  auto const baud_rate = find_baud_rate(clock_rate(p_bus), p_clock_rate);
+  if (!baud_rate) {
+    hal::safe_throw(hal::operation_not_supported(nullptr));
+  }
+  return *baud_rate;
+}
+
+/**
+ * @brief Baud rate to switch a bus to after a clock change
+ *
+ * Keeps the clock rate closest to the requested one without exceeding it, or
+ * falls back to the slowest rate if the requested one is now out of reach.
+ *
+ * @param p_bus - spi peripheral
+ * @param p_clock_rate - requested clock rate
+ * @return spi_baud_rate - baud rate control setting
+ */
+inline spi_baud_rate retime_baud_rate(peripheral p_bus,
+                                      hal::hertz p_clock_rate) noexcept
+{
+  auto const input_clock = clock_rate(p_bus);
+  auto const slowest = input_clock / 256.0f;
+  return *find_baud_rate(input_clock, std::max(p_clock_rate, slowest));
+}
+
+/**
+ * @brief Route pins to a spi bus, committing pins sharing a port together
+ *
+ * Routes come from the route tables, so their pins are not checked again and
+ * this never throws, which the noexcept `spi` paths rely on.
+ *
+ * @param p_routes - routes of the pins to configure
+ * @param p_speed - output speed of the pins
+ */
+inline void configure_spi_pins(std::span<spi_route const> p_routes,
+                               pin_speed p_speed) noexcept
+{
+  for (std::size_t i = 0; i < p_routes.size(); i++) {
+    auto const port = p_routes[i].location.port;
+    auto const same_port = [port](spi_route const& p_route) {
+      return p_route.location.port == port;
+    };
+    if (std::any_of(p_routes.begin(), p_routes.begin() + i, same_port)) {
+      continue;
+    }
+
+    port_configuration configuration(port);
+    for (auto const& route : p_routes.subspan(i)) {
+      if (same_port(route)) {
+        configuration.route(route.location.pin, route.function, p_speed);
+      }
+    }
+    configuration.commit();
+  }
+}
+
+// The helpers below run inside the RAM resident transfer functions, so they
+// are always inlined rather than left as calls back into flash.
+
+[[gnu::always_inline]] inline bool busy(spi_reg_t* p_reg)
+{
+  return bit_extract<status_register::busy_flag>(mmio_read(p_reg->sr));
+}
+[[gnu::always_inline]] inline bool tx_empty(spi_reg_t* p_reg)
+{
+  return bit_extract<status_register::tx_buffer_empty>(mmio_read(p_reg->sr));
+}
+[[gnu::always_inline]] inline bool rx_not_empty(spi_reg_t* p_reg)
+{
+  return bit_extract<status_register::rx_buffer_not_empty>(
+    mmio_read(p_reg->sr));
+}
+
+/// Walks the bytes of a list of segments as if they were one buffer
+class segment_cursor
+{
+public:
+  [[gnu::always_inline]] explicit segment_cursor(
+    std::span<spi_segment const> p_segments)
+    : m_segments(p_segments)
+  {
+    skip_empty();
+  }
+
+  [[gnu::always_inline]] [[nodiscard]] bool done() const
+  {
+    return m_segments.empty();
+  }
+
+  /// Byte to send at the cursor, then advance
+  [[gnu::always_inline]] hal::byte take()
+  {
+    auto const& segment = m_segments.front();
+    auto const byte = m_index < segment.data_out.size()
+                        ? segment.data_out[m_index]
+                        : segment.filler;
+    advance();
+    return byte;
+  }
+
+  /// Store the byte received at the cursor, then advance
+  [[gnu::always_inline]] void put(hal::byte p_byte)
+  {
+    auto const& segment = m_segments.front();
+    if (m_index < segment.data_in.size()) {
+      segment.data_in[m_index] = p_byte;
+    }
+    advance();
+  }
+
+  /// Leave the byte at the cursor untouched, then advance
+  [[gnu::always_inline]] void skip()
+  {
+    advance();
+  }
+
+private:
+  [[gnu::always_inline]] static std::size_t length(
+    spi_segment const& p_segment)
+  {
+    return std::max(p_segment.data_out.size(), p_segment.data_in.size());
+  }
+
+  [[gnu::always_inline]] void skip_empty()
+  {
+    while (!m_segments.empty() && m_index == length(m_segments.front())) {
+      m_segments = m_segments.subspan(1);
+      m_index = 0;
+    }
+  }
+
+  [[gnu::always_inline]] void advance()
+  {
+    m_index++;
+    skip_empty();
+  }
+
+  std::span<spi_segment const> m_segments;
+  std::size_t m_index = 0;
+};
+
+/// How `exchange()` paces the bytes it writes
+enum class exchange_mode : std::uint8_t
+{
+  /// Each byte is written once the previous one has been read back. The
+  /// clock pauses between bytes, but no byte can be lost.
+  lock_step,
+  /// The next byte is written while the previous one is still shifting, so
+  /// the clock does not pause. A byte is lost if the loop is held off for
+  /// longer than one byte time.
+  pipelined,
+};
+
+/**
+ * @brief Exchange the bytes of a list of segments
+ *
+ * In pipelined mode, an interrupt delaying the loop by more than one byte
+ * time makes the controller overrun: a received byte is dropped because the
+ * one before it was not read yet. The overrun flag is cleared by the first
+ * status read following a data register read, so every status read is
+ * checked for it. Once an overrun is seen, the bus is left to finish the bytes
+ * already written, the byte still held by the data register is stored, the
+ * dropped bytes are skipped, leaving their `data_in` untouched, and the
+ * exchange carries on.
+ *
+ * @param p_reg - enabled spi peripheral
+ * @param p_segments - segments to exchange, in order
+ * @param p_mode - how the bytes are paced
+ * @return true - every received byte was stored
+ * @return false - an overrun dropped received bytes
+ */
+[[gnu::always_inline]] inline bool exchange(
+  spi_reg_t* p_reg,
+  std::span<spi_segment const> p_segments,
+  exchange_mode p_mode)
+{
+  segment_cursor transmit(p_segments);
+  segment_cursor receive(p_segments);
+  std::size_t const depth = p_mode == exchange_mode::pipelined ? 2 : 1;
+  // Bytes written but not read back yet
+  std::size_t in_flight = 0;
+  bool intact = true;
+
+  while (!receive.done()) {
+    auto status = mmio_read(p_reg->sr);
+
+    if (bit_extract<status_register::overrun_flag>(status)) {
+      while (bit_extract<status_register::busy_flag>(status)) {
+        status = mmio_read(p_reg->sr);
+      }
+      // Seen before the data register was read, it still holds the oldest
+      // unread byte and reading it, then the status, clears the overrun.
+      // Seen after, the read that saw it already cleared it.
+      if (bit_extract<status_register::rx_buffer_not_empty>(status)) {
+        receive.put(static_cast<hal::byte>(mmio_read(p_reg->dr)));
+        in_flight--;
+        (void)mmio_read(p_reg->sr);
+      }
+      for (; in_flight != 0; in_flight--) {
+        receive.skip();
+      }
+      intact = false;
+      continue;
+    }
+
+    if (!transmit.done() && in_flight < depth &&
+        bit_extract<status_register::tx_buffer_empty>(status)) {
+      mmio_write(p_reg->dr, transmit.take());
+      in_flight++;
+      continue;
+    }
+
+    if (in_flight != 0 &&
+        bit_extract<status_register::rx_buffer_not_empty>(status)) {
+      receive.put(static_cast<hal::byte>(mmio_read(p_reg->dr)));
+      in_flight--;
+    }
+  }
+  return intact;
+}
+}  // namespace hal::stm32f4
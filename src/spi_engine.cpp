@@ -0,0 +1,448 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include <libhal-stm32f4/interrupt.hpp>
+#include <libhal-stm32f4/spi_engine.hpp>
+#include <libhal-util/bit.hpp>
+#include <libhal/error.hpp>
+
+#include "dma.hpp"
+#include "mmio.hpp"
+#include "power.hpp"
+#include "spi_common.hpp"
+#include "spi_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+/// NDTR is a 16-bit counter, longer transfers are split into phases
+constexpr std::size_t max_phase_length = 0xFFFF;
+constexpr std::uint32_t very_high_priority = 0b11;
+
+/// Receive and transmit streams picked for each bus
+struct stream_assignment
+{
+  std::array<dma_request, spi_bus_count> receive{};
+  std::array<dma_request, spi_bus_count> transmit{};
+};
+
+std::size_t stream_slot(dma_request p_request)
+{
+  return ((p_request.controller - 1U) * dma_stream_count) + p_request.stream;
+}
+
+bool is_free(dma_request p_request,
+             std::array<bool, 2 * dma_stream_count> const& p_used)
+{
+  return !p_used[stream_slot(p_request)] &&
+         !is_dma_stream_claimed(p_request.controller, p_request.stream);
+}
+
+/// Backtracking search giving every bus distinct, unclaimed streams
+bool assign_streams(std::span<std::uint8_t const> p_buses,
+                    std::size_t p_index,
+                    std::array<bool, 2 * dma_stream_count>& p_used,
+                    stream_assignment& p_assignment)
+{
+  if (p_index == p_buses.size()) {
+    return true;
+  }
+
+  auto const bus = p_buses[p_index];
+  auto const receive_options = find_spi_dma_options(bus, false);
+  auto const transmit_options = find_spi_dma_options(bus, true);
+  for (auto const receive : receive_options.list()) {
+    if (!is_free(receive, p_used)) {
+      continue;
+    }
+    p_used[stream_slot(receive)] = true;
+
+    for (auto const transmit : transmit_options.list()) {
+      if (!is_free(transmit, p_used)) {
+        continue;
+      }
+      p_used[stream_slot(transmit)] = true;
+      p_assignment.receive[p_index] = receive;
+      p_assignment.transmit[p_index] = transmit;
+      if (assign_streams(p_buses, p_index + 1, p_used, p_assignment)) {
+        return true;
+      }
+      p_used[stream_slot(transmit)] = false;
+    }
+
+    p_used[stream_slot(receive)] = false;
+  }
+  return false;
+}
+}  // namespace
+
+spi_engine::spi_engine(hal::runtime, std::span<bus_settings const> p_buses)
+{
+  if (p_buses.size() > m_channels.size()) {
+    hal::safe_throw(hal::argument_out_of_domain(this));
+  }
+
+  std::array<std::uint8_t, spi_bus_count> bus_numbers{};
+  for (std::size_t i = 0; i < p_buses.size(); i++) {
+    auto const bus = p_buses[i].bus;
+    validate_spi_bus(bus);
+    auto const listed = std::span(bus_numbers).first(i);
+    if (std::ranges::find(listed, bus) != listed.end()) {
+      hal::safe_throw(hal::argument_out_of_domain(this));
+    }
+    bus_numbers[i] = bus;
+  }
+
+  // Validate everything before claiming any resources
+  std::array<std::array<spi_route, 3>, spi_bus_count> routes{};
+  std::array<spi_baud_rate, spi_bus_count> baud_rates{};
+  std::array<resource_claim, spi_bus_count> claims{};
+  for (std::size_t i = 0; i < p_buses.size(); i++) {
+    auto const& config = p_buses[i];
+    auto const pins = config.pins.value_or(default_pins(config.bus));
+    routes[i] = {
+      route_spi_signal(config.bus, spi_signal::clock, pins.clock),
+      route_spi_signal(config.bus, spi_signal::data_in, pins.data_in),
+      route_spi_signal(config.bus, spi_signal::data_out, pins.data_out),
+    };
+    baud_rates[i] = calculate_baud_rate(
+      spi_bus_resources(config.bus).id, config.settings.clock_rate);
+    claims[i] = resource_claim(spi_route_resources(config.bus, routes[i]));
+  }
+
+  std::array<bool, 2 * dma_stream_count> used{};
+  stream_assignment assignment;
+  if (!assign_streams(std::span(bus_numbers).first(p_buses.size()),
+                      0,
+                      used,
+                      assignment)) {
+    hal::safe_throw(hal::device_or_resource_busy(this));
+  }
+
+  // The destructor does not run if construction fails part way, so the
+  // channels set up so far are torn down here
+  struct rollback
+  {
+    spi_engine* engine;
+    ~rollback()
+    {
+      if (engine) {
+        engine->release_channels();
+      }
+    }
+  } guard{ this };
+
+  for (std::size_t i = 0; i < p_buses.size(); i++) {
+    auto const& config = p_buses[i];
+    auto& bus_channel = m_channels[i];
+    bus_channel.bus = config.bus;
+    bus_channel.routes = routes[i];
+    bus_channel.resources = std::move(claims[i]);
+    bus_channel.peripheral_id = spi_bus_resources(config.bus).id;
+    bus_channel.peripheral_register = *spi_bus_resources(config.bus).reg;
+    bus_channel.clock_rate = config.settings.clock_rate;
+    m_channel_count++;
+    power(bus_channel.peripheral_id).on();
+
+    auto const receive = claim_dma_stream(std::span(&assignment.receive[i], 1));
+    bus_channel.receive = {
+      receive.controller, receive.stream, receive.channel
+    };
+    auto const transmit =
+      claim_dma_stream(std::span(&assignment.transmit[i], 1));
+    bus_channel.transmit = {
+      transmit.controller, transmit.stream, transmit.channel
+    };
+
+    configure_spi_pins(bus_channel.routes,
+                       pin_speed_for(baud_rates[i].clock_rate));
+
+    auto* reg = reinterpret_cast<spi_reg_t*>(bus_channel.peripheral_register);
+    mmio_write(reg->cr2,
+               bit_value(0U).set<control_register2::rx_dma_enable>().get());
+    mmio_write(
+      reg->cr1,
+      bit_value(0U)
+        .set<control_register1::master_selection>()
+        .insert<control_register1::baud_rate_control>(baud_rates[i].control)
+        .insert<control_register1::clock_phase>(static_cast<std::uint32_t>(
+          config.settings.data_valid_on_trailing_edge))
+        .insert<control_register1::clock_polarity>(
+          static_cast<std::uint32_t>(config.settings.clock_idles_high))
+        .set<control_register1::software_slave_management>()
+        .set<control_register1::internal_slave_select>()
+        .set<control_register1::enable>()
+        .get());
+
+    on_dma_interrupt(receive,
+                     [this, &bus_channel]() { handle_interrupt(bus_channel); });
+  }
+  guard.engine = nullptr;
+}
+
+spi_engine::~spi_engine()
+{
+  wait_all();
+  release_channels();
+}
+
+void spi_engine::release_channels()
+{
+  for (auto& bus_channel : std::span(m_channels).first(m_channel_count)) {
+    for (auto const& stream : { bus_channel.receive, bus_channel.transmit }) {
+      if (stream.controller != 0) {
+        release_dma_stream(
+          { stream.controller, stream.stream, stream.channel });
+      }
+    }
+    auto* reg = reinterpret_cast<spi_reg_t*>(bus_channel.peripheral_register);
+    mmio_write(reg->cr1, 0U);
+    mmio_write(reg->cr2, 0U);
+    power(bus_channel.peripheral_id).off();
+  }
+  m_channel_count = 0;
+}
+
+void spi_engine::retime()
+{
+  for (auto& bus_channel : std::span(m_channels).first(m_channel_count)) {
+    auto* reg = reinterpret_cast<spi_reg_t*>(bus_channel.peripheral_register);
+    auto const baud_rate =
+      retime_baud_rate(bus_channel.peripheral_id, bus_channel.clock_rate);
+
+    // The baud rate must not change while a byte is being shifted
+    while (bus_channel.busy) {
+      continue;
+    }
+    while (stm32f4::busy(reg)) {
+      continue;
+    }
+    mmio_modify(reg->cr1).insert<control_register1::baud_rate_control>(
+      baud_rate.control);
+    configure_spi_pins(bus_channel.routes, pin_speed_for(baud_rate.clock_rate));
+  }
+}
+
+void spi_engine::start(std::uint8_t p_bus,
+                       std::span<hal::byte const> p_data_out,
+                       std::span<hal::byte> p_data_in,
+                       hal::byte p_filler,
+                       hal::output_pin* p_chip_select)
+{
+  auto& bus_channel = find(p_bus);
+  if (bus_channel.busy) {
+    hal::safe_throw(hal::device_or_resource_busy(this));
+  }
+
+  bus_channel.data_out = p_data_out;
+  bus_channel.data_in = p_data_in;
+  bus_channel.filler = p_filler;
+  bus_channel.chip_select = p_chip_select;
+  bus_channel.position = 0;
+  bus_channel.finished = false;
+  bus_channel.busy = true;
+
+  if (p_data_out.empty() && p_data_in.empty()) {
+    finish(bus_channel);
+    return;
+  }
+  if (bus_channel.chip_select) {
+    bus_channel.chip_select->level(false);
+  }
+  begin_phase(bus_channel);
+}
+
+void spi_engine::on_finished(std::uint8_t p_bus,
+                             hal::callback<void()> p_handler)
+{
+  find(p_bus).on_finished = std::move(p_handler);
+}
+
+bool spi_engine::busy(std::uint8_t p_bus) const
+{
+  return const_cast<spi_engine*>(this)->find(p_bus).busy;
+}
+
+std::uint8_t spi_engine::wait_any()
+{
+  auto const channels = std::span(m_channels).first(m_channel_count);
+  while (true) {
+    critical_section section;
+    bool running = false;
+    for (auto& bus_channel : channels) {
+      if (bus_channel.finished) {
+        bus_channel.finished = false;
+        return bus_channel.bus;
+      }
+      running = running || bus_channel.busy;
+    }
+    if (!running) {
+      return 0;
+    }
+    wait_for_interrupt();
+  }
+}
+
+void spi_engine::wait_all()
+{
+  auto const channels = std::span(m_channels).first(m_channel_count);
+  while (true) {
+    critical_section section;
+    auto const running = std::ranges::any_of(
+      channels, [](channel const& p_channel) { return p_channel.busy; });
+    if (!running) {
+      break;
+    }
+    wait_for_interrupt();
+  }
+
+  for (auto& bus_channel : channels) {
+    bus_channel.finished = false;
+  }
+}
+
+spi_engine::channel& spi_engine::find(std::uint8_t p_bus)
+{
+  for (auto& bus_channel : std::span(m_channels).first(m_channel_count)) {
+    if (bus_channel.bus == p_bus) {
+      return bus_channel;
+    }
+  }
+  hal::safe_throw(hal::argument_out_of_domain(this));
+}
+
+void spi_engine::begin_phase(channel& p_channel)
+{
+  auto const position = p_channel.position;
+  auto const out_left =
+    p_channel.data_out.size() - std::min(position, p_channel.data_out.size());
+  auto const in_left =
+    p_channel.data_in.size() - std::min(position, p_channel.data_in.size());
+
+  // A phase needs both streams to move the same number of bytes. Once one of
+  // the buffers runs out, its stream keeps going on a single byte instead:
+  // the filler is sent or the received bytes are discarded.
+  std::size_t length = std::max(out_left, in_left);
+  if (out_left != 0 && in_left != 0) {
+    length = std::min(out_left, in_left);
+  }
+  length = std::min(length, max_phase_length);
+  p_channel.phase_length = length;
+
+  auto const* source =
+    out_left != 0 ? &p_channel.data_out[position] : &p_channel.filler;
+  auto* destination =
+    in_left != 0 ? &p_channel.data_in[position] : &p_channel.discard;
+
+  auto* reg = reinterpret_cast<spi_reg_t*>(p_channel.peripheral_register);
+  dma_request const receive{ p_channel.receive.controller,
+                             p_channel.receive.stream,
+                             p_channel.receive.channel };
+  dma_request const transmit{ p_channel.transmit.controller,
+                              p_channel.transmit.stream,
+                              p_channel.transmit.channel };
+
+  auto& receive_stream = dma_stream(receive);
+  auto const receive_config =
+    bit_value(0U)
+      .insert<dma_stream_config::channel>(std::uint32_t{ receive.channel })
+      .insert<dma_stream_config::priority>(very_high_priority)
+      .insert<dma_stream_config::memory_increment>(
+        static_cast<std::uint32_t>(in_left != 0))
+      .insert<dma_stream_config::direction>(
+        dma_direction::peripheral_to_memory)
+      .set<dma_stream_config::transfer_complete_interrupt_enable>()
+      .get();
+  mmio_write(receive_stream.par, mmio_address(&reg->dr));
+  mmio_write(receive_stream.m0ar, mmio_address(destination));
+  mmio_write(receive_stream.ndtr, static_cast<std::uint32_t>(length));
+  mmio_write(receive_stream.cr, receive_config);
+  mmio_write(receive_stream.cr,
+             bit_value(receive_config).set<dma_stream_config::enable>().get());
+
+  // Receive is always higher priority than transmit so that a received byte
+  // is never overwritten by the next one
+  auto& transmit_stream = dma_stream(transmit);
+  auto const transmit_config =
+    bit_value(0U)
+      .insert<dma_stream_config::channel>(std::uint32_t{ transmit.channel })
+      .insert<dma_stream_config::memory_increment>(
+        static_cast<std::uint32_t>(out_left != 0))
+      .insert<dma_stream_config::direction>(
+        dma_direction::memory_to_peripheral)
+      .get();
+  mmio_write(transmit_stream.par, mmio_address(&reg->dr));
+  mmio_write(transmit_stream.m0ar, mmio_address(source));
+  mmio_write(transmit_stream.ndtr, static_cast<std::uint32_t>(length));
+  mmio_write(transmit_stream.cr, transmit_config);
+  mmio_write(transmit_stream.cr,
+             bit_value(transmit_config).set<dma_stream_config::enable>().get());
+
+  // The transmit buffer is empty, so this requests the first byte
+  mmio_write(reg->cr2,
+             bit_value(0U)
+               .set<control_register2::rx_dma_enable>()
+               .set<control_register2::tx_dma_enable>()
+               .get());
+}
+
+void spi_engine::handle_interrupt(channel& p_channel)
+{
+  dma_request const receive{ p_channel.receive.controller,
+                             p_channel.receive.stream,
+                             p_channel.receive.channel };
+  dma_request const transmit{ p_channel.transmit.controller,
+                              p_channel.transmit.stream,
+                              p_channel.transmit.channel };
+
+  auto const flags = take_dma_flags(receive);
+  if (!bit_extract<dma_stream_flags::transfer_complete>(flags)) {
+    return;
+  }
+  take_dma_flags(transmit);
+
+  auto* reg = reinterpret_cast<spi_reg_t*>(p_channel.peripheral_register);
+  mmio_write(reg->cr2,
+             bit_value(0U).set<control_register2::rx_dma_enable>().get());
+
+  p_channel.position += p_channel.phase_length;
+  auto const length =
+    std::max(p_channel.data_out.size(), p_channel.data_in.size());
+  if (p_channel.position < length) {
+    begin_phase(p_channel);
+    return;
+  }
+
+  if (p_channel.chip_select) {
+    while (stm32f4::busy(reg)) {
+      continue;
+    }
+    p_channel.chip_select->level(true);
+  }
+  finish(p_channel);
+}
+
+void spi_engine::finish(channel& p_channel)
+{
+  p_channel.busy = false;
+  p_channel.finished = true;
+  if (p_channel.on_finished) {
+    p_channel.on_finished();
+  }
+}
+}  // namespace hal::stm32f4
@@ -0,0 +1,124 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+
+#include <libhal-util/bit.hpp>
+#include <libhal/units.hpp>
+
+#include "mmio.hpp"
+#include "timer_reg.hpp"
+
+// Clocking shared by the timer based drivers
+
+namespace hal::stm32f4 {
+/// Prescaler and auto-reload values making a 16-bit timer update at a rate
+struct timer_period
+{
+  /// Clock counted by the timer, see `clock_rate()`
+  hal::hertz input_clock;
+  /// Value of PSC, the counter runs at the input clock / (prescaler + 1)
+  std::uint32_t prescaler;
+  /// Value of ARR, the counter updates every reload + 1 counts
+  std::uint32_t reload;
+
+  /**
+   * @return hal::hertz - update rate actually achieved
+   */
+  [[nodiscard]] hal::hertz rate() const
+  {
+    auto const counts = static_cast<float>(prescaler + 1U) *
+                        static_cast<float>(reload + 1U);
+    return input_clock / counts;
+  }
+};
+
+/**
+ * @brief Find the prescaler and reload values closest to an update rate
+ *
+ * The prescaler is kept as small as possible, for the finest resolution.
+ *
+ * @param p_input_clock - clock counted by the timer
+ * @param p_rate - update events per second
+ * @return std::optional<timer_period> - std::nullopt if the rate is above the
+ * input clock or too slow for a 16-bit prescaler and counter
+ */
+inline std::optional<timer_period> calculate_timer_period(
+  hal::hertz p_input_clock,
+  hal::hertz p_rate)
+{
+  constexpr float max_count = 65536.0f;
+  auto const total = std::round(p_input_clock / p_rate);
+  if (!(total >= 1.0f) || total > max_count * max_count) {
+    return std::nullopt;
+  }
+  auto const divider = std::ceil(total / max_count);
+  auto const reload = std::round(total / divider);
+  return timer_period{
+    .input_clock = p_input_clock,
+    .prescaler = static_cast<std::uint32_t>(divider) - 1U,
+    .reload = static_cast<std::uint32_t>(reload) - 1U,
+  };
+}
+
+/**
+ * @brief Find the timer period closest to an update rate after a clock
+ * change
+ *
+ * Rates out of reach for the new input clock are clamped to the fastest or
+ * slowest rate a 16-bit prescaler and counter can give.
+ *
+ * @param p_input_clock - clock counted by the timer
+ * @param p_rate - update events per second
+ * @return timer_period - prescaler and reload values
+ */
+inline timer_period retime_timer_period(hal::hertz p_input_clock,
+                                        hal::hertz p_rate)
+{
+  constexpr float max_count = 65536.0f;
+  auto const slowest = p_input_clock / (max_count * max_count);
+  return *calculate_timer_period(p_input_clock,
+                                 std::clamp(p_rate, slowest, p_input_clock));
+}
+
+/**
+ * @brief Re-time a timer's update rate after a clock change
+ *
+ * Writes the period closest to the rate, then generates an update event,
+ * which loads the prescaler and restarts the period at once. Drivers that
+ * only request transfers on overflows therefore neither lose nor gain a
+ * transfer when the timer is running.
+ *
+ * @param p_reg - timer to re-time
+ * @param p_input_clock - clock counted by the timer
+ * @param p_rate - update events per second
+ * @return hal::hertz - update rate actually achieved
+ */
+inline hal::hertz retime_timer(timer_reg_t* p_reg,
+                               hal::hertz p_input_clock,
+                               hal::hertz p_rate)
+{
+  auto const period = retime_timer_period(p_input_clock, p_rate);
+  mmio_write(p_reg->psc, period.prescaler);
+  mmio_write(p_reg->arr, period.reload);
+  mmio_write(p_reg->egr,
+             bit_value(0U).set<timer_event_generation::update>().get());
+  return period.rate();
+}
+}  // namespace hal::stm32f4
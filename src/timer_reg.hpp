@@ -0,0 +1,120 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <libhal-util/bit.hpp>
+
+namespace hal::stm32f4 {
+/// Timer registers, shared by the advanced (TIM1) and general purpose timers
+/// (TIM2 to TIM5)
+struct timer_reg_t
+{
+  /// Offset: 0x00 Control register 1
+  std::uint32_t volatile cr1;
+  /// Offset: 0x04 Control register 2
+  std::uint32_t volatile cr2;
+  /// Offset: 0x08 Slave mode control register
+  std::uint32_t volatile smcr;
+  /// Offset: 0x0C DMA/interrupt enable register
+  std::uint32_t volatile dier;
+  /// Offset: 0x10 Status register (write 0 to clear)
+  std::uint32_t volatile sr;
+  /// Offset: 0x14 Event generation register
+  std::uint32_t volatile egr;
+  /// Offset: 0x18 Capture/compare mode register 1
+  std::uint32_t volatile ccmr1;
+  /// Offset: 0x1C Capture/compare mode register 2
+  std::uint32_t volatile ccmr2;
+  /// Offset: 0x20 Capture/compare enable register
+  std::uint32_t volatile ccer;
+  /// Offset: 0x24 Counter
+  std::uint32_t volatile cnt;
+  /// Offset: 0x28 Prescaler, the counter runs at input clock / (psc + 1)
+  std::uint32_t volatile psc;
+  /// Offset: 0x2C Auto-reload register, the counter wraps after this value
+  std::uint32_t volatile arr;
+  /// Offset: 0x30 Repetition counter register, advanced timers only
+  std::uint32_t volatile rcr;
+  /// Offset: 0x34 Capture/compare registers 1-4
+  std::array<std::uint32_t volatile, 4> ccr;
+  /// Offset: 0x44 Break and dead-time register, advanced timers only
+  std::uint32_t volatile bdtr;
+  /// Offset: 0x48 DMA control register
+  std::uint32_t volatile dcr;
+  /// Offset: 0x4C DMA address for full transfer
+  std::uint32_t volatile dmar;
+  /// Offset: 0x50 Option register
+  std::uint32_t volatile option;
+};
+
+/// Number of general purpose timers, TIM2 to TIM5
+inline constexpr std::size_t general_timer_count = 4;
+
+/// Timer control register 1
+struct timer_control1
+{
+  /// 1: the counter is running
+  static constexpr auto counter_enable = bit_mask::from<0>();
+  /// 1: software updates do not generate an update event
+  static constexpr auto update_disable = bit_mask::from<1>();
+  /// 1: only counter overflows raise the update flag
+  static constexpr auto update_request_source = bit_mask::from<2>();
+  /// 1: the counter stops at the next update event
+  static constexpr auto one_pulse_mode = bit_mask::from<3>();
+  /// 0: up counter, 1: down counter
+  static constexpr auto direction = bit_mask::from<4>();
+  /// 1: ARR is buffered until the next update event
+  static constexpr auto auto_reload_preload = bit_mask::from<7>();
+};
+
+/// Bits shared by the DMA/interrupt enable and status registers
+struct timer_events
+{
+  /// Counter overflow (or update generated by software)
+  static constexpr auto update = bit_mask::from<0>();
+  /// Counter matched capture/compare register 1
+  static constexpr auto compare1 = bit_mask::from<1>();
+  static constexpr auto compare2 = bit_mask::from<2>();
+  static constexpr auto compare3 = bit_mask::from<3>();
+  static constexpr auto compare4 = bit_mask::from<4>();
+  /// Every interrupt flag
+  static constexpr auto all = bit_mask::from<4, 0>();
+};
+
+/// DMA request enables of the DMA/interrupt enable register
+struct timer_dma_requests
+{
+  /// Request a transfer on every update event
+  static constexpr auto update = bit_mask::from<8>();
+  /// Request a transfer on every capture/compare 1 event
+  static constexpr auto compare1 = bit_mask::from<9>();
+};
+
+/// Timer event generation register
+struct timer_event_generation
+{
+  /// Reinitialize the counter and load the prescaler and ARR
+  static constexpr auto update = bit_mask::from<0>();
+};
+
+inline timer_reg_t* timer_reg1 = reinterpret_cast<timer_reg_t*>(0x4001'0000);
+inline timer_reg_t* timer_reg2 = reinterpret_cast<timer_reg_t*>(0x4000'0000);
+inline timer_reg_t* timer_reg3 = reinterpret_cast<timer_reg_t*>(0x4000'0400);
+inline timer_reg_t* timer_reg4 = reinterpret_cast<timer_reg_t*>(0x4000'0800);
+inline timer_reg_t* timer_reg5 = reinterpret_cast<timer_reg_t*>(0x4000'0C00);
+}  // namespace hal::stm32f4
@@ -0,0 +1,138 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+#include <libhal-stm32f4/output_pin.hpp>
+#include <libhal-stm32f4/pin.hpp>
+#include <libhal-stm32f4/port_configuration.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+#include <libhal-stm32f4/register_trace.hpp>
+#include <libhal-stm32f4/spi.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/gpio_reg.hpp"
+
+namespace hal::stm32f4 {
+// Host counterpart of demos/applications/benchmarks.cpp. Cycle counts can only
+// be measured on the board, but register traffic and functional behavior of
+// each benchmarked operation are checked here against the register simulation.
+void benchmark_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "benchmark gpio_toggle.output_pin"_test = []() {
+    // Setup
+    constexpr std::uint32_t iterations = 100;
+    register_simulation simulation;
+    output_pin pin(peripheral::gpio_a, 5);
+    register_trace trace;
+
+    // Exercise
+    for (std::uint32_t i = 0; i < iterations; i++) {
+      pin.level(true);
+      pin.level(false);
+    }
+
+    // Verify
+    expect(that % (2U * iterations) ==
+           trace.access_counts().bus_accesses());
+    expect(that % 0U == simulation.gpio_output(peripheral::gpio_a));
+  };
+
+  "benchmark rcc_power_on.gpio"_test = []() {
+    // Setup
+    register_simulation simulation;
+    register_trace trace;
+
+    // Exercise
+    pin test_subject(peripheral::gpio_c, 0);
+
+    // Verify
+    // The enable bit is set with a single bit-band store
+    expect(register_trace::counts{ .writes = 1 } == trace.access_counts());
+  };
+
+  "benchmark pin_configure"_test = []() {
+    // Setup
+    constexpr std::uint8_t pin_count = 4;
+    register_simulation simulation;
+    auto* reg = get_reg(peripheral::gpio_c);
+
+    // Exercise
+    std::uint32_t separate = 0;
+    {
+      register_trace trace;
+      for (std::uint8_t i = 0; i < pin_count; i++) {
+        pin(peripheral::gpio_c, i)
+          .function(pin::pin_function::output)
+          .resistor(pin_resistor::pull_down)
+          .speed(pin_speed::fast);
+      }
+      separate = trace.access_counts().bus_accesses();
+    }
+    auto const separate_mode = reg->pin_mode;
+    reg->pin_mode = 0;
+    reg->pull_up_pull_down = 0;
+    reg->output_speed = 0;
+
+    register_trace trace;
+    port_configuration port(peripheral::gpio_c);
+    for (std::uint8_t i = 0; i < pin_count; i++) {
+      port.function(i, pin::pin_function::output)
+        .resistor(i, pin_resistor::pull_down)
+        .speed(i, pin_speed::fast);
+    }
+    port.commit();
+    auto const batched = trace.access_counts().bus_accesses();
+
+    // Verify
+    expect(that % 0x55U == separate_mode);
+    expect(that % 0x55U == reg->pin_mode);
+    expect(that % 0xAAU == reg->pull_up_pull_down);
+    expect(that % 0xAAU == reg->output_speed);
+    expect(that % batched < separate);
+  };
+
+  "benchmark spi_transfer"_test = []() {
+    constexpr std::array<std::uint32_t, 5> transfer_sizes{ 1, 4, 16, 64, 256 };
+    for (auto const size : transfer_sizes) {
+      // Setup
+      register_simulation simulation;
+      spi bus(hal::runtime{}, 2);
+      std::array<hal::byte, 256> out{};
+      std::array<hal::byte, 256> in{};
+      for (std::size_t i = 0; i < out.size(); i++) {
+        out[i] = static_cast<hal::byte>(i);
+      }
+      register_trace trace;
+
+      // Exercise
+      bus.transfer(std::span(out).first(size), std::span(in).first(size));
+
+      // Verify
+      auto const accesses = trace.access_counts().bus_accesses();
+      // Fixed cost of waiting for the bus and toggling slave select
+      constexpr std::uint32_t overhead = 5;
+      expect(that % accesses <= overhead + (4 * size));
+      expect(that % size == simulation.spi_transmitted(2).size());
+      expect(std::equal(in.begin(), in.begin() + size, out.begin()));
+    }
+  };
+};
+}  // namespace hal::stm32f4
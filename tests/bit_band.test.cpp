@@ -0,0 +1,93 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+
+#include <libhal-stm32f4/bit_band.hpp>
+#include <libhal-stm32f4/pin.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+#include <libhal-stm32f4/register_trace.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/gpio_reg.hpp"
+#include "../src/rcc_reg.hpp"
+
+namespace hal::stm32f4 {
+// RCC AHB1ENR bit 0 (gpio_a) and a word in SRAM
+static_assert(bit_band_alias(0x4002'3830, 0) == 0x4247'0600);
+static_assert(bit_band_alias(0x4002'3830, 31) == 0x4247'067C);
+static_assert(bit_band_alias(0x2000'0300, 2) == 0x2200'6008);
+// CCM RAM, AHB2 and the core peripherals are not bit-addressable
+static_assert(bit_band_alias(0x1000'0000, 0) == 0);
+static_assert(bit_band_alias(0x5000'0000, 0) == 0);
+static_assert(bit_band_alias(0xE000'ED10, 0) == 0);
+
+void bit_band_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "bit_band_write() on a variable"_test = []() {
+    // Setup
+    std::uint32_t volatile flags = 0x8000'0001;
+
+    // Exercise
+    bit_band_set(flags, 4);
+    auto const set = bit_band_test(flags, 4);
+    bit_band_clear(flags, 0);
+    auto const cleared = bit_band_test(flags, 0);
+
+    // Verify
+    expect(set);
+    expect(not cleared);
+    expect(that % 0x8000'0010U == flags);
+  };
+
+  "power on is a single register store"_test = []() {
+    // Setup
+    register_simulation simulation;
+    rcc->ahb1enr = 0x0000'0004;
+    register_trace trace;
+
+    // Exercise
+    pin test_subject(peripheral::gpio_b, 3);
+
+    // Verify
+    auto const entries = trace.entries();
+    expect(that % 1U == entries.size());
+    expect(register_access::write == entries[0].kind);
+    expect(reinterpret_cast<std::uintptr_t>(&rcc->ahb1enr) ==
+           entries[0].address);
+    expect(that % 0x0000'0006U == rcc->ahb1enr);
+  };
+
+  "pin::open_drain() keeps the other pins"_test = []() {
+    // Setup
+    register_simulation simulation;
+    pin test_subject(peripheral::gpio_c, 9);
+    get_reg(peripheral::gpio_c)->output_type = 0x0000'0101;
+
+    // Exercise
+    test_subject.open_drain(true);
+    auto const enabled = get_reg(peripheral::gpio_c)->output_type;
+    test_subject.open_drain(false);
+    auto const disabled = get_reg(peripheral::gpio_c)->output_type;
+
+    // Verify
+    expect(that % 0x0000'0301U == enabled);
+    expect(that % 0x0000'0101U == disabled);
+  };
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,116 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-stm32f4/boot.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+#include <libhal-stm32f4/register_trace.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/dwt_reg.hpp"
+#include "../src/gpio_reg.hpp"
+#include "../src/rcc_reg.hpp"
+
+namespace hal::stm32f4 {
+void boot_test()
+{
+  using namespace boost::ut;
+
+  "mark_boot_phase()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    reset_boot_phases();
+
+    // Exercise
+    dwt->cyccnt = 1'200;
+    mark_boot_phase(boot_phase::constructors_done);
+    dwt->cyccnt = 5'000;
+    mark_boot_phase(boot_phase::drivers_initialized);
+    auto const constructors = boot_phase_cycles(boot_phase::constructors_done);
+    auto const clocks = boot_phase_cycles(boot_phase::clocks_configured);
+    reset_boot_phases();
+
+    // Verify
+    expect(constructors.has_value() && *constructors == 1'200U);
+    expect(not clocks.has_value());
+    expect(not boot_phase_cycles(boot_phase::drivers_initialized));
+  };
+
+  "board_configuration::commit()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    board_configuration board;
+    board.clocks(hsi_2mhz_profile).power(peripheral::spi1);
+    board.port(peripheral::gpio_a)
+      .function(5, pin::pin_function::alternate5)
+      .function(8, pin::pin_function::output)
+      .level(8, true);
+    board.port(peripheral::gpio_c).function(13, pin::pin_function::output);
+
+    // Exercise
+    board.commit();
+
+    // Verify
+    auto const* port_a = get_reg(peripheral::gpio_a);
+    auto const* port_c = get_reg(peripheral::gpio_c);
+    expect(that % 0b101U == (rcc->ahb1enr & 0b111U));
+    expect(that % (1U << 12) == rcc->apb2enr);
+    expect(that % 2e6f == current_clock_rates().ahb);
+    expect(that % 5U == bit_extract<bit_mask::from<23, 20>()>(
+                          port_a->alt_function_low));
+    expect(that % 0b10U == bit_extract<bit_mask::from<11, 10>()>(
+                             port_a->pin_mode));
+    expect(that % 0b01U == bit_extract<bit_mask::from<17, 16>()>(
+                             port_a->pin_mode));
+    expect(that % 0b01U == bit_extract<bit_mask::from<27, 26>()>(
+                             port_c->pin_mode));
+    expect(that % (1U << 8) == simulation.gpio_output(peripheral::gpio_a));
+    expect(that % 0U == simulation.unclocked_writes());
+  };
+
+  "board_configuration::commit() register cost"_test = []() {
+    // Setup
+    register_simulation simulation;
+    board_configuration board;
+    board.power(peripheral::spi1).power(peripheral::dma2);
+    board.port(peripheral::gpio_a)
+      .function(5, pin::pin_function::alternate5)
+      .function(8, pin::pin_function::output)
+      .level(8, true);
+    board.port(peripheral::gpio_c)
+      .function(13, pin::pin_function::output)
+      .level(13, false);
+    register_trace trace;
+
+    // Exercise
+    board.commit();
+
+    // Verify
+    // AHB1 and APB2 enables, the read back, set and reset levels, alternate
+    // function low and mode of port A and mode of port C
+    expect(register_trace::counts{ .reads = 1, .writes = 2, .modifies = 5 } ==
+           trace.access_counts());
+  };
+
+  "board_configuration invalid peripherals"_test = []() {
+    // Setup
+    board_configuration board;
+
+    // Exercise + Verify
+    expect(throws([&board]() { board.power(peripheral::cpu); }));
+    expect(throws([&board]() { board.port(peripheral::spi1); }));
+    expect(throws([&board]() { board.clocks({ .ahb_divider = 3 }); }));
+  };
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,162 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstddef>
+
+#include <libhal-stm32f4/clock.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+#include <libhal-stm32f4/spi.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/flash_reg.hpp"
+#include "../src/pwr_reg.hpp"
+#include "../src/rcc_reg.hpp"
+#include "../src/spi_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+static_assert(calculate_clock_rates(hsi_16mhz_profile).ahb == 16e6f);
+static_assert(calculate_clock_rates(hsi_2mhz_profile).ahb == 2e6f);
+static_assert(calculate_clock_rates(hsi_2mhz_profile).apb1_timer == 2e6f);
+static_assert(calculate_clock_rates(hsi_pll_100mhz_profile).system == 100e6f);
+static_assert(calculate_clock_rates(hsi_pll_100mhz_profile).apb1 == 50e6f);
+static_assert(calculate_clock_rates(hsi_pll_100mhz_profile).apb1_timer ==
+              100e6f);
+static_assert(
+  calculate_clock_rates(hse_pll_100mhz_profile(25e6f)).apb2 == 100e6f);
+}  // namespace
+
+void clock_test()
+{
+  using namespace boost::ut;
+
+  "set_clock_profile() to the pll"_test = []() {
+    // Setup
+    register_simulation simulation;
+
+    // Exercise
+    set_clock_profile(hsi_pll_100mhz_profile);
+
+    // Verify
+    auto const rates = current_clock_rates();
+    expect(that % 100e6f == rates.system);
+    expect(that % 50e6f == rates.apb1);
+    expect(that % 100e6f == rates.apb2);
+    expect(that % 50e6f == clock_rate(peripheral::spi2));
+    expect(that % 100e6f == clock_rate(peripheral::timer5));
+    expect(that % 100e6f == clock_rate(peripheral::gpio_a));
+    expect(that % 3U ==
+           bit_extract<flash_access_control::latency>(flash->acr));
+    expect(that % 0b11U ==
+           bit_extract<power_control::voltage_scaling>(pwr->cr));
+    expect(that % 8U == bit_extract<pll_config::input_divider>(rcc->pllcfgr));
+    expect(that % 100U ==
+           bit_extract<pll_config::vco_multiplier>(rcc->pllcfgr));
+    expect(that % 0b100U == bit_extract<rcc_cnfg::apb1_prescalar>(rcc->cfgr));
+  };
+
+  "set_clock_profile() back down"_test = []() {
+    // Setup
+    register_simulation simulation;
+    set_clock_profile(hsi_pll_100mhz_profile);
+
+    // Exercise
+    set_clock_profile(hsi_2mhz_profile);
+
+    // Verify
+    auto const rates = current_clock_rates();
+    expect(that % 16e6f == rates.system);
+    expect(that % 2e6f == rates.ahb);
+    expect(that % 2e6f == clock_rate(peripheral::spi1));
+    expect(that % 0U ==
+           bit_extract<flash_access_control::latency>(flash->acr));
+    expect(that % 0U == bit_extract<clock_control::pll_enable>(rcc->cr));
+    expect(that % 0b1010U == bit_extract<rcc_cnfg::ahb_prescalar>(rcc->cfgr));
+  };
+
+  "set_clock_profile() from a crystal"_test = []() {
+    // Setup
+    register_simulation simulation;
+
+    // Exercise
+    set_clock_profile(hse_pll_100mhz_profile(25e6f));
+    auto const pll_rates = current_clock_rates();
+    set_clock_profile(hsi_16mhz_profile);
+
+    // Verify
+    expect(that % 100e6f == pll_rates.system);
+    expect(that % 16e6f == current_clock_rates().system);
+    expect(that % 0U == bit_extract<clock_control::hse_enable>(rcc->cr));
+  };
+
+  "set_clock_profile() invalid profiles"_test = []() {
+    // Setup
+    register_simulation simulation;
+    auto overclocked = hsi_pll_100mhz_profile;
+    overclocked.pll.n = 200;
+    auto fast_apb1 = hsi_pll_100mhz_profile;
+    fast_apb1.apb1_divider = 1;
+    clock_profile const missing_hse{ .source = system_clock_source::hse };
+
+    // Exercise + Verify
+    expect(throws([&]() { set_clock_profile(overclocked); }));
+    expect(throws([&]() { set_clock_profile(fast_apb1); }));
+    expect(throws([&]() { set_clock_profile(missing_hse); }));
+    expect(throws([]() { set_clock_profile({ .ahb_divider = 32 }); }));
+    expect(that % 16e6f == current_clock_rates().system);
+  };
+
+  "clock_change_listener"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::size_t first_calls = 0;
+    std::size_t second_calls = 0;
+    clock_change_listener first([&first_calls]() { first_calls++; });
+
+    // Exercise
+    {
+      clock_change_listener second([&second_calls]() { second_calls++; });
+      set_clock_profile(hsi_2mhz_profile);
+    }
+    set_clock_profile(hsi_16mhz_profile);
+
+    // Verify
+    expect(that % 2U == first_calls);
+    expect(that % 1U == second_calls);
+  };
+
+  "spi keeps its clock rate across profiles"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi test_subject(hal::runtime{}, 1, { .clock_rate = 1'000'000.0f });
+    auto const initial =
+      bit_extract<control_register1::baud_rate_control>(spi_reg1->cr1);
+
+    // Exercise
+    set_clock_profile(hsi_pll_100mhz_profile);
+    auto const fast =
+      bit_extract<control_register1::baud_rate_control>(spi_reg1->cr1);
+    set_clock_profile(hsi_2mhz_profile);
+    auto const slow =
+      bit_extract<control_register1::baud_rate_control>(spi_reg1->cr1);
+
+    // Verify
+    // 16MHz / 16, 100MHz / 128 and 2MHz / 2
+    expect(that % 3U == initial);
+    expect(that % 6U == fast);
+    expect(that % 0U == slow);
+  };
+};
+}  // namespace hal::stm32f4
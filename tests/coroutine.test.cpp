@@ -0,0 +1,314 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+#include <libhal-stm32f4/coroutine.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+#include <libhal-stm32f4/scheduler.hpp>
+#include <libhal-stm32f4/spi_engine.hpp>
+#include <libhal/error.hpp>
+#include <libhal/steady_clock.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/exti_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+class fake_clock : public hal::steady_clock
+{
+public:
+  std::uint64_t ticks = 0;
+
+private:
+  hal::hertz driver_frequency() override
+  {
+    return 1'000'000.0f;
+  }
+  std::uint64_t driver_uptime() override
+  {
+    return ticks;
+  }
+};
+
+task wait_for(completion& p_event, int& p_step)
+{
+  p_step = 1;
+  co_await p_event;
+  p_step = 2;
+}
+
+task fail()
+{
+  hal::safe_throw(hal::argument_out_of_domain(nullptr));
+  co_return;
+}
+
+task catch_failure(bool& p_caught)
+{
+  try {
+    co_await fail();
+  } catch (hal::argument_out_of_domain const&) {
+    p_caught = true;
+  }
+}
+
+task sleep_then_record(executor& p_executor,
+                       hal::time_duration p_duration,
+                       int p_id,
+                       std::array<int, 3>& p_order,
+                       std::size_t& p_count)
+{
+  co_await p_executor.delay(p_duration);
+  p_order[p_count++] = p_id;
+}
+
+task exchange(executor& p_executor,
+              spi_engine& p_engine,
+              std::uint8_t p_bus,
+              std::span<hal::byte const> p_data_out,
+              std::span<hal::byte> p_data_in)
+{
+  co_await spi_transfer_awaiter(
+    p_executor, p_engine, p_bus, p_data_out, p_data_in);
+}
+
+task wait_for_edge(executor& p_executor, int& p_edges)
+{
+  co_await pin_edge_awaiter(
+    p_executor, peripheral::gpio_b, 3, wake_edge::rising);
+  p_edges++;
+}
+}  // namespace
+
+void coroutine_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "executor resumes task on completion"_test = []() {
+    // Setup
+    fake_clock clock;
+    executor test_subject(clock);
+    completion event(test_subject);
+    int step = 0;
+
+    // Exercise
+    test_subject.spawn(wait_for(event, step));
+    auto const running = test_subject.run_ready();
+    auto const step_before = step;
+    event.complete();
+    auto const still_running = test_subject.run_ready();
+
+    // Verify
+    expect(running);
+    expect(that % 1 == step_before);
+    expect(!still_running);
+    expect(that % 2 == step);
+    expect(that % frame_pool::frame_count == frame_pool::available());
+  };
+
+  "completion before await does not suspend"_test = []() {
+    // Setup
+    fake_clock clock;
+    executor test_subject(clock);
+    completion event(test_subject);
+    int step = 0;
+
+    // Exercise
+    event.complete();
+    test_subject.spawn(wait_for(event, step));
+    auto const still_running = test_subject.run_ready();
+
+    // Verify
+    expect(!still_running);
+    expect(that % 2 == step);
+  };
+
+  "awaited task passes on its exception"_test = []() {
+    // Setup
+    fake_clock clock;
+    executor test_subject(clock);
+    bool caught = false;
+
+    // Exercise
+    test_subject.spawn(catch_failure(caught));
+    test_subject.run();
+
+    // Verify
+    expect(caught);
+    expect(that % frame_pool::frame_count == frame_pool::available());
+  };
+
+  "frame pool runs out"_test = []() {
+    // Setup
+    fake_clock clock;
+    executor test_subject(clock);
+    completion event_0(test_subject);
+    completion event_1(test_subject);
+    completion event_2(test_subject);
+    completion event_3(test_subject);
+    completion event_4(test_subject);
+    completion event_5(test_subject);
+    completion event_6(test_subject);
+    completion event_7(test_subject);
+    std::array<completion*, frame_pool::frame_count> events{
+      &event_0, &event_1, &event_2, &event_3,
+      &event_4, &event_5, &event_6, &event_7,
+    };
+    std::array<int, frame_pool::frame_count> steps{};
+    for (std::size_t i = 0; i < steps.size(); i++) {
+      test_subject.spawn(wait_for(*events[i], steps[i]));
+    }
+
+    // Exercise
+    int extra_step = 0;
+    auto const exhausted =
+      throws([&]() { auto extra = wait_for(event_0, extra_step); });
+    test_subject.run_ready();
+    for (auto* event : events) {
+      event->complete();
+    }
+    test_subject.run_ready();
+
+    // Verify
+    expect(exhausted);
+    expect(that % 0 == extra_step);
+    expect(that % 0U == test_subject.running());
+    expect(std::ranges::all_of(steps, [](int p_step) { return p_step == 2; }));
+    expect(that % frame_pool::frame_count == frame_pool::available());
+  };
+
+  "delays resume in deadline order"_test = []() {
+    // Setup
+    fake_clock clock;
+    executor test_subject(clock);
+    std::array<int, 3> order{};
+    std::size_t count = 0;
+    test_subject.spawn(sleep_then_record(test_subject, 30us, 1, order, count));
+    test_subject.spawn(sleep_then_record(test_subject, 10us, 2, order, count));
+    test_subject.spawn(sleep_then_record(test_subject, 20us, 3, order, count));
+
+    // Exercise
+    test_subject.run_ready();
+    clock.ticks = 10;
+    test_subject.run_ready();
+    auto const count_at_10us = count;
+    clock.ticks = 25;
+    test_subject.run_ready();
+    clock.ticks = 100;
+    auto const still_running = test_subject.run_ready();
+
+    // Verify
+    expect(that % 0U == count_at_10us);
+    expect(!still_running);
+    expect(that % 3U == count);
+    expect(that % 2 == order[0]);
+    expect(that % 3 == order[1]);
+    expect(that % 1 == order[2]);
+  };
+
+  "run() sleeps through delays with a scheduler"_test = []() {
+    // Setup
+    register_simulation simulation;
+    scheduler clock(hal::runtime{});
+    executor test_subject(clock);
+    std::array<int, 3> order{};
+    std::size_t count = 0;
+    test_subject.spawn(sleep_then_record(test_subject, 2ms, 1, order, count));
+    test_subject.spawn(sleep_then_record(test_subject, 1ms, 2, order, count));
+
+    // Exercise
+    test_subject.run();
+
+    // Verify
+    expect(that % 2U == count);
+    expect(that % 2 == order[0]);
+    expect(that % 1 == order[1]);
+    expect(simulation.elapsed() >= 2ms);
+    expect(simulation.elapsed() < 3ms);
+    expect(that % 2U == simulation.power_mode_entries(power_mode::sleep));
+  };
+
+  "spi transfers overlap across tasks"_test = []() {
+    // Setup
+    register_simulation simulation;
+    fake_clock clock;
+    executor test_subject(clock);
+    std::array<spi_engine::bus_settings, 2> const buses{ {
+      { .bus = 1 },
+      { .bus = 2 },
+    } };
+    spi_engine engine(hal::runtime{}, buses);
+    std::array<hal::byte, 2> const command_1{ 0x11, 0x12 };
+    std::array<hal::byte, 3> const command_2{ 0x21, 0x22, 0x23 };
+    std::array<hal::byte, 2> const response_1{ 0xA1, 0xA2 };
+    std::array<hal::byte, 3> const response_2{ 0xB1, 0xB2, 0xB3 };
+    std::array<hal::byte, 2> received_1{};
+    std::array<hal::byte, 3> received_2{};
+    simulation.spi_respond_with(1, response_1);
+    simulation.spi_respond_with(2, response_2);
+
+    // Exercise
+    test_subject.spawn(
+      exchange(test_subject, engine, 1, command_1, received_1));
+    test_subject.spawn(
+      exchange(test_subject, engine, 2, command_2, received_2));
+    test_subject.run_ready();
+    auto const both_started = engine.busy(1) && engine.busy(2);
+    test_subject.run();
+
+    // Verify
+    expect(both_started);
+    expect(that % 0U == test_subject.running());
+    expect(std::ranges::equal(command_1, simulation.spi_transmitted(1)));
+    expect(std::ranges::equal(command_2, simulation.spi_transmitted(2)));
+    expect(std::ranges::equal(response_1, received_1));
+    expect(std::ranges::equal(response_2, received_2));
+  };
+
+  "pin edge resumes task from exti interrupt"_test = []() {
+    // Setup
+    register_simulation simulation;
+    fake_clock clock;
+    executor test_subject(clock);
+    int edges = 0;
+    test_subject.spawn(wait_for_edge(test_subject, edges));
+
+    // Exercise
+    test_subject.run_ready();
+    auto const armed = exti->imr;
+    simulation.gpio_input(peripheral::gpio_b, 0);
+    simulation.gpio_input(peripheral::gpio_a, 1U << 3);
+    test_subject.run_ready();
+    auto const edges_on_other_port = edges;
+    simulation.gpio_input(peripheral::gpio_b, 1U << 3);
+    auto const still_running = test_subject.run_ready();
+
+    // Verify
+    expect(that % (1U << 3) == armed);
+    expect(that % 0 == edges_on_other_port);
+    expect(!still_running);
+    expect(that % 1 == edges);
+    expect(that % 0U == exti->imr);
+    expect(that % 0U == exti->pr);
+    expect(throws([&]() {
+      pin_edge_awaiter invalid(test_subject, peripheral::gpio_a, 16, {});
+    }));
+  };
+};
+}  // namespace hal::stm32f4
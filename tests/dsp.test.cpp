@@ -0,0 +1,243 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+
+#include <libhal-stm32f4/dsp.hpp>
+
+#include <boost/ut.hpp>
+
+namespace hal::stm32f4 {
+namespace {
+/// Deterministic full range samples
+template<typename T, std::size_t Size>
+std::array<T, Size> noise(std::uint32_t p_seed)
+{
+  std::array<T, Size> samples{};
+  for (auto& sample : samples) {
+    p_seed = (p_seed * 1'664'525U) + 1'013'904'223U;
+    sample = static_cast<T>(p_seed >> (32 - (8 * sizeof(T))));
+  }
+  return samples;
+}
+}  // namespace
+
+void dsp_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "dot_product() q15 matches reference"_test = []() {
+    // Setup
+    auto const a = noise<q15, 101>(1);
+    auto const b = noise<q15, 101>(2);
+    std::array<q15, 64> full_scale{};
+    full_scale.fill(std::numeric_limits<q15>::min());
+
+    // Exercise + Verify
+    // Every length exercises the paired loop and the leftover samples
+    for (std::size_t size = 0; size <= a.size(); size++) {
+      auto const lhs = std::span(a).first(size);
+      auto const rhs = std::span(b).first(size);
+      expect(reference::dot_product(lhs, rhs) == dot_product(lhs, rhs));
+    }
+    expect(that % (std::int64_t{ 64 } << 30) ==
+           dot_product(std::span<q15 const>(full_scale), full_scale));
+  };
+
+  "dot_product() q31"_test = []() {
+    // Setup
+    constexpr q31 half = 1 << 30;
+    std::array<q31, 3> const a{ half, half, -half };
+    std::array<q31, 3> const b{ half, -half / 2, half };
+
+    // Exercise
+    auto const sum = dot_product(std::span<q31 const>(a), b);
+
+    // Verify
+    // 0.25 - 0.125 - 0.25 with 48 fractional bits
+    expect(that % -(std::int64_t{ 1 } << 45) == sum);
+  };
+
+  "dot_product() with different lengths"_test = []() {
+    // Setup
+    std::array<q15, 4> a{};
+    std::array<q15, 3> b{};
+
+    // Exercise + Verify
+    expect(throws([&]() {
+      static_cast<void>(dot_product(std::span<q15 const>(a), b));
+    }));
+  };
+
+  "statistics() q15 matches reference"_test = []() {
+    // Setup
+    auto const samples = noise<q15, 37>(3);
+
+    // Exercise + Verify
+    for (std::size_t size = 1; size <= samples.size(); size++) {
+      auto const block = std::span(samples).first(size);
+      expect(reference::statistics(block) == statistics(block));
+    }
+    std::array<q15, 3> const known{ -4, 9, 1 };
+    expect(sample_statistics<q15>{ .min = -4, .max = 9, .mean = 2 } ==
+           statistics(known));
+    expect(throws([]() { static_cast<void>(statistics(std::span<q15>{})); }));
+  };
+
+  "statistics() q31"_test = []() {
+    // Setup
+    std::array<q31, 4> const samples{ -7, 2'000'000'000, -2'000'000'000, 1 };
+
+    // Exercise
+    auto const result = statistics(samples);
+
+    // Verify
+    expect(sample_statistics<q31>{
+             .min = -2'000'000'000, .max = 2'000'000'000, .mean = -1 } ==
+           result);
+  };
+
+  "fir_q15 impulse response"_test = []() {
+    // Setup
+    std::array<q15, 3> const coefficients{ 16384, -8192, 4096 };
+    std::array<q15, 8> buffer{};
+    fir_q15 test_subject(coefficients, buffer);
+    std::array<q15, 6> const impulse{ std::numeric_limits<q15>::max() };
+    std::array<q15, 6> output{};
+
+    // Exercise
+    auto const written = test_subject.process(impulse, output);
+
+    // Verify
+    expect(that % 6U == written.size());
+    expect(that % 16383 == output[0]);
+    expect(that % -8192 == output[1]);
+    expect(that % 4095 == output[2]);
+    expect(that % 0 == output[3]);
+  };
+
+  "fir_q15 matches reference across blocks"_test = []() {
+    // Setup
+    auto const signal = noise<q15, 240>(4);
+    auto const odd_taps = noise<q15, 7>(5);
+    auto const even_taps = noise<q15, 16>(6);
+
+    for (std::span<q15 const> coefficients :
+         { std::span<q15 const>(odd_taps), std::span<q15 const>(even_taps) }) {
+      for (std::uint32_t decimation : { 1U, 2U, 3U, 4U }) {
+        std::array<q15, 240> expected{};
+        reference::fir(coefficients, signal, expected, decimation);
+
+        // Exercise
+        // Blocks of varying sizes carry the history between them
+        std::array<q15, 64> buffer{};
+        fir_q15 test_subject(coefficients, buffer, decimation);
+        std::array<q15, 240> output{};
+        std::size_t consumed = 0;
+        std::size_t produced = 0;
+        std::size_t block = decimation;
+        while (consumed < signal.size()) {
+          auto const size = std::min({ block,
+                                       signal.size() - consumed,
+                                       test_subject.max_block() /
+                                         decimation * decimation });
+          auto const written = test_subject.process(
+            std::span(signal).subspan(consumed, size),
+            std::span(output).subspan(produced));
+          consumed += size;
+          produced += written.size();
+          block += decimation * 5;
+        }
+
+        // Verify
+        expect(that % (signal.size() / decimation) == produced);
+        expect(std::ranges::equal(std::span(expected).first(produced),
+                                  std::span(output).first(produced)));
+      }
+    }
+  };
+
+  "fir_q15 block size limits"_test = []() {
+    // Setup
+    std::array<q15, 4> const coefficients{};
+    std::array<q15, 10> buffer{};
+    fir_q15 test_subject(coefficients, buffer, 2);
+    std::array<q15, 8> input{};
+    std::array<q15, 4> output{};
+
+    // Exercise + Verify
+    expect(that % 7U == test_subject.max_block());
+    expect(throws([&]() {
+      test_subject.process(std::span(input).first(3), output);
+    }));
+    expect(throws([&]() { test_subject.process(input, output); }));
+    expect(not throws([&]() {
+      test_subject.process(std::span(input).first(6), output);
+    }));
+    expect(throws([&]() {
+      std::array<q15, 4> small_buffer{};
+      fir_q15 invalid(coefficients, small_buffer, 2);
+    }));
+  };
+
+  "biquad_cascade matches reference across blocks"_test = []() {
+    // Setup
+    // Second order low pass followed by a high pass, both at fs / 8
+    std::array<biquad_coefficients, 2> const sections{
+      biquad_coefficients{ .b0 = 0.0976f,
+                           .b1 = 0.1953f,
+                           .b2 = 0.0976f,
+                           .a1 = -0.9428f,
+                           .a2 = 0.3333f },
+      biquad_coefficients{ .b0 = 0.5690f,
+                           .b1 = -1.1381f,
+                           .b2 = 0.5690f,
+                           .a1 = -0.9428f,
+                           .a2 = 0.3333f },
+    };
+    std::array<float, 100> signal{};
+    auto const raw = noise<q15, 100>(7);
+    std::ranges::transform(
+      raw, signal.begin(), [](q15 p_sample) { return p_sample / 32768.0f; });
+    std::array<float, 100> expected{};
+    reference::biquad(sections, signal, expected);
+
+    std::array<biquad_state, 2> state{};
+    biquad_cascade test_subject(sections, state);
+    std::array<float, 100> output = signal;
+
+    // Exercise
+    // In place, in blocks of 1, 2, 3... samples
+    std::size_t offset = 0;
+    for (std::size_t block = 1; offset < output.size(); block++) {
+      auto const size = std::min(block, output.size() - offset);
+      auto const chunk = std::span(output).subspan(offset, size);
+      test_subject.process(chunk, chunk);
+      offset += size;
+    }
+
+    // Verify
+    expect(std::ranges::equal(expected, output));
+    expect(throws([]() {
+      std::array<biquad_state, 1> too_few{};
+      std::array<biquad_coefficients, 2> two{};
+      biquad_cascade invalid(two, too_few);
+    }));
+  };
+};
+}  // namespace hal::stm32f4
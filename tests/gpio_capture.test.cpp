@@ -0,0 +1,242 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <libhal-stm32f4/clock.hpp>
+#include <libhal-stm32f4/gpio_capture.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/dma_reg.hpp"
+#include "../src/timer_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+/// Collects delivered samples and counts the handler calls
+struct sample_log
+{
+  std::array<std::uint16_t, 32> samples{};
+  std::size_t count = 0;
+  std::size_t calls = 0;
+
+  gpio_capture::handler handler()
+  {
+    return [this](std::span<std::uint16_t const> p_samples) {
+      calls++;
+      for (auto const sample : p_samples) {
+        if (count < samples.size()) {
+          samples[count++] = sample;
+        }
+      }
+    };
+  }
+
+  [[nodiscard]] std::span<std::uint16_t const> received() const
+  {
+    return std::span(samples).first(count);
+  }
+};
+
+/// Drive each level on the port for one 1us sample period
+void drive(register_simulation& p_simulation,
+           std::span<std::uint16_t const> p_levels)
+{
+  using namespace std::literals;
+  for (auto const levels : p_levels) {
+    p_simulation.gpio_input(peripheral::gpio_b, levels);
+    p_simulation.elapse(1us);
+  }
+}
+}  // namespace
+
+void gpio_capture_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "gpio_capture::start()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<std::uint16_t, 8> buffer{};
+    gpio_capture test_subject(peripheral::gpio_b, buffer, [](auto) {});
+
+    // Exercise
+    test_subject.start(gpio_capture::mode::circular);
+
+    // Verify
+    // TIM1 update requests are served by DMA2 stream 5 channel 6
+    auto const& stream = dma_reg2->stream[5];
+    expect(test_subject.running());
+    expect(that % 1'000'000.0f == test_subject.sample_rate());
+    expect(that % 15U == timer_reg1->arr);
+    expect(bit_extract<timer_dma_requests::update>(timer_reg1->dier) == 1U);
+    expect(bit_extract<timer_control1::counter_enable>(timer_reg1->cr1) ==
+           1U);
+    expect(bit_extract<dma_stream_config::enable>(stream.cr) == 1U);
+    expect(bit_extract<dma_stream_config::channel>(stream.cr) == 6U);
+    expect(that % 8U == stream.ndtr);
+    expect(that % 0U == simulation.unclocked_writes());
+  };
+
+  "gpio_capture one shot"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<std::uint16_t, 6> buffer{};
+    sample_log log;
+    gpio_capture test_subject(peripheral::gpio_b, buffer, log.handler());
+    std::array<std::uint16_t, 8> const levels{
+      0x0001, 0x8002, 0x0004, 0x4008, 0x0010, 0x2020, 0xFFFF, 0xFFFF,
+    };
+    test_subject.start(gpio_capture::mode::one_shot);
+
+    // Exercise
+    drive(simulation, levels);
+
+    // Verify
+    expect(that % 1U == log.calls);
+    expect(std::ranges::equal(std::span(levels).first(6), log.received()));
+    expect(not test_subject.running());
+    expect(bit_extract<timer_control1::counter_enable>(timer_reg1->cr1) ==
+           0U);
+  };
+
+  "gpio_capture circular"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<std::uint16_t, 4> buffer{};
+    sample_log log;
+    gpio_capture test_subject(peripheral::gpio_b, buffer, log.handler());
+    std::array<std::uint16_t, 11> const levels{ 1, 2, 3, 4, 5, 6,
+                                                7, 8, 9, 10, 11 };
+    test_subject.start(gpio_capture::mode::circular);
+
+    // Exercise
+    drive(simulation, levels);
+    test_subject.stop();
+    drive(simulation, levels);
+
+    // Verify
+    // Each half is delivered once filled, the 11th sample is still waiting
+    expect(that % 5U == log.calls);
+    expect(std::ranges::equal(std::span(levels).first(10), log.received()));
+    expect(not test_subject.running());
+  };
+
+  "gpio_capture trigger on pattern"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<std::uint16_t, 4> buffer{};
+    sample_log log;
+    gpio_capture test_subject(peripheral::gpio_b, buffer, log.handler());
+    std::array<std::uint16_t, 12> const levels{
+      0x00, 0x01, 0x02, 0x03, 0x10, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+    };
+    test_subject.start(gpio_capture::mode::one_shot,
+                       { .mask = 0x0003, .levels = 0x0002 });
+
+    // Exercise
+    drive(simulation, levels);
+
+    // Verify
+    // 0x02 matches first, 4 samples from it on are delivered
+    expect(test_subject.triggered());
+    expect(not test_subject.running());
+    expect(std::ranges::equal(std::span(levels).subspan(2, 4),
+                              log.received()));
+  };
+
+  "gpio_capture circular trigger"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<std::uint16_t, 4> buffer{};
+    sample_log log;
+    gpio_capture test_subject(peripheral::gpio_b, buffer, log.handler());
+    std::array<std::uint16_t, 10> const levels{ 0, 0, 0, 0, 0, 1, 2, 3, 4, 5 };
+    test_subject.start(gpio_capture::mode::circular,
+                       { .mask = 0xFFFF, .levels = 1 });
+
+    // Exercise
+    drive(simulation, levels);
+
+    // Verify
+    expect(test_subject.running());
+    expect(std::ranges::equal(std::span(levels).subspan(5), log.received()));
+  };
+
+  "gpio_capture invalid settings"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<std::uint16_t, 4> buffer{};
+    std::array<std::uint16_t, 3> odd_buffer{};
+
+    // Exercise + Verify
+    expect(throws([&]() {
+      gpio_capture invalid(
+        peripheral::gpio_b, buffer, [](auto) {}, { .sample_rate = 64e6f });
+    }));
+    expect(throws([&]() {
+      gpio_capture invalid(
+        peripheral::gpio_b, buffer, [](auto) {}, { .sample_rate = 1e-3f });
+    }));
+    expect(throws([&]() {
+      gpio_capture invalid(peripheral::gpio_b, odd_buffer, [](auto) {});
+    }));
+    expect(throws([&]() {
+      gpio_capture invalid(peripheral::spi1, buffer, [](auto) {});
+    }));
+  };
+
+  "gpio_capture claims TIM1"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<std::uint16_t, 4> buffer{};
+    gpio_capture first(peripheral::gpio_a, buffer, [](auto) {});
+
+    // Exercise + Verify
+    expect(throws([&]() {
+      gpio_capture second(peripheral::gpio_b, buffer, [](auto) {});
+    }));
+    expect(is_resource_claimed(peripheral_resource(peripheral::timer1)));
+  };
+
+  "gpio_capture keeps its sample rate across profiles"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<std::uint16_t, 8> buffer{};
+    gpio_capture test_subject(peripheral::gpio_b,
+                              buffer,
+                              [](auto) {},
+                              { .sample_rate = 4'000'000.0f });
+
+    // Exercise
+    set_clock_profile(hsi_pll_100mhz_profile);
+    auto const fast_rate = test_subject.sample_rate();
+    auto const fast_reload = timer_reg1->arr;
+    set_clock_profile(hsi_2mhz_profile);
+
+    // Verify
+    // 100MHz / 25, then the 2MHz timer clock is the fastest rate left
+    expect(that % 4'000'000.0f == fast_rate);
+    expect(that % 24U == fast_reload);
+    expect(that % 2'000'000.0f == test_subject.sample_rate());
+    expect(that % 0U == timer_reg1->arr);
+    expect(that % 0U == timer_reg1->psc);
+  };
+};
+}  // namespace hal::stm32f4
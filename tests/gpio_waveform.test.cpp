@@ -0,0 +1,253 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <libhal-stm32f4/clock.hpp>
+#include <libhal-stm32f4/gpio_capture.hpp>
+#include <libhal-stm32f4/gpio_waveform.hpp>
+#include <libhal-stm32f4/output_pin.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/dma_reg.hpp"
+#include "../src/timer_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+static_assert(bsrr_word(0x0001, 0x0001) == 0x0000'0001);
+static_assert(bsrr_word(0x0001, 0x0000) == 0x0001'0000);
+static_assert(bsrr_word(0x00F0, 0xFF30) == 0x00C0'0030);
+
+constexpr auto encoded_byte = []() {
+  std::array<hal::byte, 1> const bytes{ 0b1010'0001 };
+  std::array<std::uint32_t, 8> words{};
+  encode_bitstream(3, bytes, words);
+  return words;
+}();
+static_assert(encoded_byte[0] == 0x0000'0008);
+static_assert(encoded_byte[1] == 0x0008'0000);
+static_assert(encoded_byte[7] == 0x0000'0008);
+
+/// Port output levels after each 1us word period
+template<std::size_t Count>
+std::array<std::uint16_t, Count> record(register_simulation& p_simulation)
+{
+  using namespace std::literals;
+  std::array<std::uint16_t, Count> levels{};
+  for (auto& level : levels) {
+    p_simulation.elapse(1us);
+    level = p_simulation.gpio_output(peripheral::gpio_c);
+  }
+  return levels;
+}
+}  // namespace
+
+void gpio_waveform_test()
+{
+  using namespace boost::ut;
+
+  "encode_levels()"_test = []() {
+    // Setup
+    std::array<std::uint16_t, 3> const levels{ 0x0003, 0x0001, 0x0100 };
+    std::array<std::uint32_t, 4> words{};
+
+    // Exercise
+    auto const encoded = encode_levels(0x0103, levels, words);
+
+    // Verify
+    expect(that % 3U == encoded.size());
+    expect(that % 0x0100'0003U == words[0]);
+    expect(that % 0x0102'0001U == words[1]);
+    expect(that % 0x0003'0100U == words[2]);
+    expect(throws([&]() {
+      encode_levels(0x0001, levels, std::span(words).first(2));
+    }));
+  };
+
+  "encode_bitstream()"_test = []() {
+    // Setup
+    std::array<hal::byte, 2> const bytes{ 0x01, 0x80 };
+    std::array<std::uint32_t, 16> words{};
+    constexpr std::uint32_t high = 0x0000'0001;
+    constexpr std::uint32_t low = 0x0001'0000;
+
+    // Exercise
+    auto const lsb_first =
+      encode_bitstream(0, bytes, words, bit_order::lsb_first);
+
+    // Verify
+    expect(that % 16U == lsb_first.size());
+    expect(that % high == words[0]);
+    expect(that % low == words[1]);
+    expect(that % low == words[14]);
+    expect(that % high == words[15]);
+    expect(throws([&]() { encode_bitstream(16, bytes, words); }));
+    expect(throws([&]() {
+      encode_bitstream(0, bytes, std::span(words).first(15));
+    }));
+  };
+
+  "encode_clocked_bitstream()"_test = []() {
+    // Setup
+    std::array<hal::byte, 1> const bytes{ 0b1000'0001 };
+    std::array<std::uint32_t, 16> words{};
+    // Data on pin 0, clock on pin 1
+    constexpr std::uint32_t high_clock_low = 0x0002'0001;
+    constexpr std::uint32_t high_clock_high = 0x0000'0003;
+    constexpr std::uint32_t low_clock_low = 0x0003'0000;
+    constexpr std::uint32_t low_clock_high = 0x0001'0002;
+
+    // Exercise
+    auto const encoded = encode_clocked_bitstream(0, 1, bytes, words);
+
+    // Verify
+    expect(that % 16U == encoded.size());
+    expect(that % high_clock_low == words[0]);
+    expect(that % high_clock_high == words[1]);
+    for (std::size_t i = 2; i < 14; i += 2) {
+      expect(that % low_clock_low == words[i]);
+      expect(that % low_clock_high == words[i + 1]);
+    }
+    expect(that % high_clock_low == words[14]);
+    expect(that % high_clock_high == words[15]);
+    expect(throws([&]() { encode_clocked_bitstream(1, 1, bytes, words); }));
+  };
+
+  "gpio_waveform::play() once"_test = []() {
+    // Setup
+    register_simulation simulation;
+    output_pin pin0(peripheral::gpio_c, 0);
+    output_pin pin4(peripheral::gpio_c, 4);
+    std::array<std::uint16_t, 4> const levels{ 0x0011, 0x0001, 0x0010, 0x0000 };
+    std::array<std::uint32_t, 4> words{};
+    encode_levels(0x0011, levels, words);
+    std::size_t finished = 0;
+    gpio_waveform test_subject(peripheral::gpio_c,
+                               [&finished]() { finished++; });
+
+    // Exercise
+    test_subject.play(words);
+    auto const played = record<6>(simulation);
+
+    // Verify
+    // TIM1 update requests are served by DMA2 stream 5 channel 6
+    auto const& stream = dma_reg2->stream[5];
+    expect(that % 1'000'000.0f == test_subject.word_rate());
+    expect(bit_extract<dma_stream_config::channel>(stream.cr) == 6U);
+    expect(that % 0x0011 == played[0]);
+    expect(that % 0x0001 == played[1]);
+    expect(that % 0x0010 == played[2]);
+    expect(that % 0x0000 == played[3]);
+    expect(that % 0x0000 == played[5]);
+    expect(that % 1U == finished);
+    expect(not test_subject.playing());
+    expect(bit_extract<timer_control1::counter_enable>(timer_reg1->cr1) ==
+           0U);
+    expect(that % 0U == simulation.unclocked_writes());
+  };
+
+  "gpio_waveform::play() repeat"_test = []() {
+    // Setup
+    register_simulation simulation;
+    output_pin pin(peripheral::gpio_c, 2);
+    std::array<std::uint32_t, 2> const words{ bsrr_word(0x0004, 0x0004),
+                                              bsrr_word(0x0004, 0x0000) };
+    std::size_t finished = 0;
+    gpio_waveform test_subject(peripheral::gpio_c,
+                               [&finished]() { finished++; });
+
+    // Exercise
+    test_subject.play(words, gpio_waveform::mode::repeat);
+    auto const played = record<5>(simulation);
+    test_subject.stop();
+    auto const stopped = record<2>(simulation);
+
+    // Verify
+    expect(that % 0x0004 == played[0]);
+    expect(that % 0x0000 == played[1]);
+    expect(that % 0x0004 == played[2]);
+    expect(that % 0x0000 == played[3]);
+    expect(that % 0x0004 == played[4]);
+    expect(that % 0x0004 == stopped[1]);
+    expect(that % 0U == finished);
+    expect(not test_subject.playing());
+  };
+
+  "gpio_waveform::play() leaves other pins alone"_test = []() {
+    // Setup
+    register_simulation simulation;
+    output_pin pin1(peripheral::gpio_c, 1);
+    output_pin pin5(peripheral::gpio_c, 5);
+    pin5.level(true);
+    std::array<std::uint32_t, 1> const words{ bsrr_word(0x0002, 0x0002) };
+    gpio_waveform test_subject(peripheral::gpio_c);
+
+    // Exercise
+    test_subject.play(words);
+    auto const played = record<1>(simulation);
+
+    // Verify
+    expect(that % 0x0022 == played[0]);
+  };
+
+  "gpio_waveform invalid settings"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<std::uint32_t, 1> const words{};
+
+    // Exercise + Verify
+    expect(throws([&]() {
+      gpio_waveform invalid(
+        peripheral::gpio_c, [] {}, { .word_rate = 64e6f });
+    }));
+    expect(throws([&]() { gpio_waveform invalid(peripheral::spi1); }));
+    expect(throws([&]() {
+      gpio_waveform test_subject(peripheral::gpio_c);
+      test_subject.play(std::span(words).first(0));
+    }));
+  };
+
+  "gpio_waveform shares TIM1 with gpio_capture"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<std::uint16_t, 4> buffer{};
+    gpio_waveform waveform(peripheral::gpio_c);
+
+    // Exercise + Verify
+    expect(throws([&]() {
+      gpio_capture capture(peripheral::gpio_b, buffer, [](auto) {});
+    }));
+    expect(is_resource_claimed(dma_stream_resource(2, 5)));
+  };
+
+  "gpio_waveform keeps its word rate across profiles"_test = []() {
+    // Setup
+    register_simulation simulation;
+    gpio_waveform test_subject(peripheral::gpio_a);
+
+    // Exercise
+    set_clock_profile(hsi_pll_100mhz_profile);
+
+    // Verify
+    // 100MHz / 100
+    expect(that % 1'000'000.0f == test_subject.word_rate());
+    expect(that % 0U == timer_reg1->psc);
+    expect(that % 99U == timer_reg1->arr);
+  };
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,59 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-stm32f4/input_pin.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/gpio_reg.hpp"
+
+namespace hal::stm32f4 {
+void input_pin_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "input_pin::input_pin()"_test = []() {
+    // Setup
+    register_simulation simulation;
+
+    // Exercise
+    input_pin test_subject(peripheral::gpio_a,
+                           3,
+                           { .resistor = pin_resistor::pull_down });
+
+    // Verify
+    auto* reg = get_reg(peripheral::gpio_a);
+    expect(that % 0U == (reg->pin_mode & (0b11U << 6)));
+    expect(that % (0b10U << 6) == (reg->pull_up_pull_down & (0b11U << 6)));
+  };
+
+  "input_pin::level()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    input_pin test_subject(peripheral::gpio_c, 13);
+
+    // Exercise
+    simulation.gpio_input(peripheral::gpio_c, 1U << 13);
+    auto const high = test_subject.level();
+    simulation.gpio_input(peripheral::gpio_c, 0xFFFF & ~(1U << 13));
+    auto const low = test_subject.level();
+
+    // Verify
+    expect(that % true == high);
+    expect(that % false == low);
+  };
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,137 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-stm32f4/interrupt.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+#include <libhal-util/enum.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/mmio.hpp"
+#include "../src/nvic_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+void dummy_handler()
+{
+}
+void other_handler()
+{
+}
+}  // namespace
+
+void interrupt_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "initialize_interrupts()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    auto const flash_table = scb->vtor;
+    expect(that % false == interrupts_initialized());
+    expect(that % nullptr == interrupt_vector(irq::spi1));
+
+    // Exercise
+    initialize_interrupts();
+
+    // Verify
+    expect(that % true == interrupts_initialized());
+    expect(that % flash_table != scb->vtor);
+    expect(that % nullptr == interrupt_vector(irq::spi1));
+  };
+
+  "initialize_interrupts() copies only the core vectors"_test = []() {
+    // Setup
+    register_simulation simulation;
+    auto* const flash_table =
+      static_cast<interrupt_handler*>(mmio_pointer(scb->vtor));
+    // Hard fault, then a slot past the end of a core-only startup table
+    flash_table[3] = dummy_handler;
+    flash_table[core_vector_count + hal::value(irq::spi1)] = other_handler;
+
+    // Exercise
+    initialize_interrupts();
+
+    // Verify
+    auto const* const ram_table =
+      static_cast<interrupt_handler const*>(mmio_pointer(scb->vtor));
+    expect(ram_table[3] == dummy_handler);
+    expect(that % nullptr == interrupt_vector(irq::spi1));
+  };
+
+  "enable_interrupt()"_test = []() {
+    // Setup
+    register_simulation simulation;
+
+    // Exercise
+    enable_interrupt(irq::spi1, dummy_handler);
+    enable_interrupt(irq::spi5, other_handler);
+
+    // Verify
+    expect(that % true == interrupts_initialized());
+    expect(dummy_handler == interrupt_vector(irq::spi1));
+    expect(other_handler == interrupt_vector(irq::spi5));
+    expect(that % true == is_interrupt_enabled(irq::spi1));
+    expect(that % true == is_interrupt_enabled(irq::spi5));
+    expect(that % false == is_interrupt_enabled(irq::spi2));
+    expect(that % (1U << 35 % 32) == nvic->iser[1]);
+    expect(that % (1U << 85 % 32) == nvic->iser[2]);
+  };
+
+  "disable_interrupt()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    enable_interrupt(irq::spi1, dummy_handler);
+    enable_interrupt(irq::spi2, dummy_handler);
+
+    // Exercise
+    disable_interrupt(irq::spi1);
+
+    // Verify
+    expect(that % false == is_interrupt_enabled(irq::spi1));
+    expect(that % true == is_interrupt_enabled(irq::spi2));
+    expect(dummy_handler == interrupt_vector(irq::spi1));
+  };
+
+  "set_interrupt_priority()"_test = []() {
+    // Setup
+    register_simulation simulation;
+
+    // Exercise
+    set_interrupt_priority(irq::dma2_channel0, 1);
+    set_interrupt_priority(irq::spi2, lowest_interrupt_priority);
+
+    // Verify
+    expect(that % 0x10 == nvic->ip[56]);
+    expect(that % 0xF0 == nvic->ip[36]);
+    expect(that % 1 == interrupt_priority(irq::dma2_channel0));
+    expect(that % lowest_interrupt_priority == interrupt_priority(irq::spi2));
+    expect(throws([]() { set_interrupt_priority(irq::spi2, 16); }));
+    expect(throws([]() { set_interrupt_priority(irq::max, 0); }));
+  };
+
+  "set_priority_grouping()"_test = []() {
+    // Setup
+    register_simulation simulation;
+
+    // Exercise
+    set_priority_grouping(2);
+
+    // Verify
+    expect(that % 0x05FA'0500U == scb->aircr);
+    expect(throws([]() { set_priority_grouping(5); }));
+  };
+};
+}  // namespace hal::stm32f4
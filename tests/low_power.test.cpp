@@ -0,0 +1,213 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+
+#include <libhal-stm32f4/low_power.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+#include <libhal-util/bit.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/exti_reg.hpp"
+#include "../src/nvic_reg.hpp"
+#include "../src/pwr_reg.hpp"
+#include "../src/rcc_reg.hpp"
+#include "../src/rtc_reg.hpp"
+
+namespace hal::stm32f4 {
+void low_power_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "sleep()"_test = []() {
+    // Setup
+    register_simulation simulation;
+
+    // Exercise
+    sleep();
+
+    // Verify
+    expect(that % 1U == simulation.power_mode_entries(power_mode::sleep));
+    expect(that % 0U == simulation.power_mode_entries(power_mode::stop));
+    expect(that % 0U == bit_extract<system_control::sleep_deep>(scb->scr));
+  };
+
+  "stop() restores the clock tree"_test = []() {
+    // Setup
+    register_simulation simulation;
+    bit_modify(rcc->cr)
+      .set<clock_control::hse_enable>()
+      .set<clock_control::hse_ready>()
+      .set<clock_control::pll_enable>()
+      .set<clock_control::pll_ready>();
+    bit_modify(rcc->cfgr)
+      .insert<rcc_cnfg::system_clock_switch>(0b10U)
+      .insert<rcc_cnfg::system_clock_status_switch>(0b10U);
+
+    // Exercise
+    stop();
+
+    // Verify
+    expect(that % 1U == simulation.power_mode_entries(power_mode::stop));
+    expect(that % 1U == bit_extract<clock_control::hse_ready>(rcc->cr));
+    expect(that % 1U == bit_extract<clock_control::pll_ready>(rcc->cr));
+    expect(that % 0b10U ==
+           bit_extract<rcc_cnfg::system_clock_status_switch>(rcc->cfgr));
+    expect(that % 1U ==
+           bit_extract<power_control::low_power_deep_sleep>(pwr->cr));
+    expect(that % 0U == bit_extract<power_control::flash_power_down>(pwr->cr));
+    expect(that % 0U ==
+           bit_extract<power_control::power_down_deep_sleep>(pwr->cr));
+    expect(that % 0U == bit_extract<system_control::sleep_deep>(scb->scr));
+  };
+
+  "stop() on HSI leaves clocks alone"_test = []() {
+    // Setup
+    register_simulation simulation;
+
+    // Exercise
+    stop({ .low_power_regulator = false, .flash_power_down = true });
+
+    // Verify
+    expect(that % 0U == bit_extract<clock_control::hse_enable>(rcc->cr));
+    expect(that % 0U == bit_extract<clock_control::pll_enable>(rcc->cr));
+    expect(that % 0U ==
+           bit_extract<power_control::low_power_deep_sleep>(pwr->cr));
+    expect(that % 1U == bit_extract<power_control::flash_power_down>(pwr->cr));
+  };
+
+  "stop() restores SEVONPEND"_test = []() {
+    // Setup
+    register_simulation simulation;
+
+    // Exercise
+    stop();
+    auto const cleared =
+      bit_extract<system_control::send_event_on_pending>(scb->scr);
+    bit_modify(scb->scr).set<system_control::send_event_on_pending>();
+    stop();
+    auto const set =
+      bit_extract<system_control::send_event_on_pending>(scb->scr);
+
+    // Verify
+    expect(that % 0U == cleared);
+    expect(that % 1U == set);
+    expect(that % 2U == simulation.power_mode_entries(power_mode::stop));
+  };
+
+  "enable_pin_wake()"_test = []() {
+    // Setup
+    register_simulation simulation;
+
+    // Exercise
+    enable_pin_wake(peripheral::gpio_c, 13, wake_edge::falling);
+    enable_pin_wake(peripheral::gpio_a, 0, wake_edge::both);
+
+    // Verify
+    expect(that % 0b0010U ==
+           bit_extract<bit_mask::from<7, 4>()>(syscfg->exticr[3]));
+    expect(that % 0b0000U ==
+           bit_extract<bit_mask::from<3, 0>()>(syscfg->exticr[0]));
+    expect(that % ((1U << 13) | (1U << 0)) == exti->emr);
+    expect(that % ((1U << 13) | (1U << 0)) == exti->ftsr);
+    expect(that % (1U << 0) == exti->rtsr);
+    expect(that % 0U == exti->imr);
+    expect(throws([]() { enable_pin_wake(peripheral::gpio_a, 16, {}); }));
+    expect(throws([]() { enable_pin_wake(peripheral::spi1, 0, {}); }));
+  };
+
+  "disable_pin_wake()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    enable_pin_wake(peripheral::gpio_b, 5, wake_edge::both);
+
+    // Exercise
+    disable_pin_wake(5);
+
+    // Verify
+    expect(that % 0U == exti->emr);
+    expect(that % 0U == exti->rtsr);
+    expect(that % 0U == exti->ftsr);
+  };
+
+  "enable_rtc_wake()"_test = []() {
+    // Setup
+    register_simulation simulation;
+
+    // Exercise
+    enable_rtc_wake(100ms);
+
+    // Verify
+    expect(that % 0b10U ==
+           bit_extract<backup_domain_control::rtc_clock_select>(rcc->bdcr));
+    expect(that % 1U ==
+           bit_extract<backup_domain_control::rtc_enable>(rcc->bdcr));
+    expect(that % 1U == bit_extract<clock_status::lsi_enable>(rcc->csr));
+    expect(that % 199U == rtc->wutr);
+    expect(that % 1U == bit_extract<rtc_control::wakeup_timer_enable>(rtc->cr));
+    expect(that % 1U ==
+           bit_extract<rtc_control::wakeup_timer_interrupt>(rtc->cr));
+    expect(that % rtc_lock_key == rtc->wpr);
+    expect(that % (1U << exti_rtc_wakeup_line) == exti->emr);
+    expect(that % (1U << exti_rtc_wakeup_line) == exti->rtsr);
+    expect(throws([]() { enable_rtc_wake(100us); }));
+    expect(throws([]() { enable_rtc_wake(33s); }));
+  };
+
+  "enable_rtc_wake() uses the LSE when selected"_test = []() {
+    // Setup
+    register_simulation simulation;
+    bit_modify(rcc->bdcr)
+      .insert<backup_domain_control::rtc_clock_select>(0b01U);
+
+    // Exercise
+    enable_rtc_wake(1s);
+
+    // Verify
+    expect(that % 2047U == rtc->wutr);
+    expect(that % 0U == bit_extract<clock_status::lsi_enable>(rcc->csr));
+  };
+
+  "disable_rtc_wake()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    enable_rtc_wake(1s);
+
+    // Exercise
+    disable_rtc_wake();
+
+    // Verify
+    expect(that % 0U == bit_extract<rtc_control::wakeup_timer_enable>(rtc->cr));
+    expect(that % 0U == exti->emr);
+  };
+
+  "woke_from_standby()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    bit_modify(pwr->csr).set<power_status::standby_flag>();
+
+    // Exercise
+    auto const woke = woke_from_standby();
+    clear_wake_flags();
+
+    // Verify
+    expect(that % true == woke);
+    expect(that % 1U ==
+           bit_extract<power_control::clear_standby_flag>(pwr->cr));
+    expect(that % 1U == bit_extract<power_control::clear_wakeup_flag>(pwr->cr));
+  };
+};
+}  // namespace hal::stm32f4
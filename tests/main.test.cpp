@@ -13,10 +13,52 @@
 // limitations under the License.
 
 namespace hal::stm32f4 {
+extern void benchmark_test();
+extern void coroutine_test();
+extern void input_pin_test();
+extern void interrupt_test();
+extern void low_power_test();
 extern void output_pin_test();
+extern void port_configuration_test();
+extern void profile_test();
+extern void register_trace_test();
+extern void resources_test();
+extern void scheduler_test();
+extern void spi_test();
+extern void spi_bus_test();
+extern void spi_capture_test();
+extern void spi_engine_test();
+extern void spsc_ring_test();
+extern void bit_band_test();
+extern void dsp_test();
+extern void gpio_capture_test();
+extern void gpio_waveform_test();
+extern void clock_test();
+extern void boot_test();
 }  // namespace hal::stm32f4
 
 int main()
 {
+  hal::stm32f4::benchmark_test();
+  hal::stm32f4::coroutine_test();
+  hal::stm32f4::input_pin_test();
+  hal::stm32f4::interrupt_test();
+  hal::stm32f4::low_power_test();
   hal::stm32f4::output_pin_test();
-}
\ No newline at end of file
+  hal::stm32f4::port_configuration_test();
+  hal::stm32f4::profile_test();
+  hal::stm32f4::register_trace_test();
+  hal::stm32f4::resources_test();
+  hal::stm32f4::scheduler_test();
+  hal::stm32f4::spi_test();
+  hal::stm32f4::spi_bus_test();
+  hal::stm32f4::spi_capture_test();
+  hal::stm32f4::spi_engine_test();
+  hal::stm32f4::spsc_ring_test();
+  hal::stm32f4::bit_band_test();
+  hal::stm32f4::dsp_test();
+  hal::stm32f4::gpio_capture_test();
+  hal::stm32f4::gpio_waveform_test();
+  hal::stm32f4::clock_test();
+  hal::stm32f4::boot_test();
+}
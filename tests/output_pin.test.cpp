@@ -13,19 +13,52 @@
 // limitations under the License.
 
 #include <libhal-stm32f4/output_pin.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
 
 #include <boost/ut.hpp>
 
+#include "../src/gpio_reg.hpp"
+#include "../src/rcc_reg.hpp"
+
 namespace hal::stm32f4 {
 void output_pin_test()
 {
   using namespace boost::ut;
   using namespace std::literals;
 
-  "output_pin::get()"_test = []() {
+  "output_pin::output_pin()"_test = []() {
+    // Setup
+    register_simulation simulation;
+
+    // Exercise
+    output_pin test_subject(peripheral::gpio_c, 5, { .open_drain = true });
+
+    // Verify
+    auto* reg = get_reg(peripheral::gpio_c);
+    expect(that % 0b0100U == (rcc->ahb1enr & 0b0100U));
+    expect(that % (0b01U << 10) == reg->pin_mode);
+    expect(that % (1U << 5) == reg->output_type);
+    expect(that % 0U == simulation.unclocked_writes());
+  };
+
+  "output_pin::level()"_test = []() {
     // Setup
+    register_simulation simulation;
+    output_pin test_subject(peripheral::gpio_b, 12);
+
     // Exercise
+    test_subject.level(true);
+    auto const high_output = simulation.gpio_output(peripheral::gpio_b);
+    auto const high_level = test_subject.level();
+    test_subject.level(false);
+    auto const low_output = simulation.gpio_output(peripheral::gpio_b);
+    auto const low_level = test_subject.level();
+
     // Verify
+    expect(that % (1U << 12) == high_output);
+    expect(that % true == high_level);
+    expect(that % 0U == low_output);
+    expect(that % false == low_level);
   };
 };
 }  // namespace hal::stm32f4
@@ -0,0 +1,114 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-stm32f4/port_configuration.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+#include <libhal-stm32f4/register_trace.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/gpio_reg.hpp"
+
+namespace hal::stm32f4 {
+void port_configuration_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  static_assert(pin_speed_for(1'000'000.0f) == pin_speed::low);
+  static_assert(pin_speed_for(2'000'000.0f) == pin_speed::low);
+  static_assert(pin_speed_for(8'000'000.0f) == pin_speed::medium);
+  static_assert(pin_speed_for(25'000'000.0f) == pin_speed::fast);
+  static_assert(pin_speed_for(50'000'000.0f) == pin_speed::high);
+
+  "port_configuration::commit()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    auto* reg = get_reg(peripheral::gpio_c);
+    reg->pull_up_pull_down = 0b11U << 30;
+
+    // Exercise
+    port_configuration(peripheral::gpio_c)
+      .function(1, pin::pin_function::output)
+      .function(3, pin::pin_function::alternate5)
+      .function(9, pin::pin_function::alternate12)
+      .open_drain(1)
+      .resistor(3, pin_resistor::pull_up)
+      .speed(3, pin_speed::high)
+      .speed(9, pin_speed::medium)
+      .commit();
+
+    // Verify
+    expect(that % ((0b01U << 2) | (0b10U << 6) | (0b10U << 18)) ==
+           reg->pin_mode);
+    expect(that % (5U << 12) == reg->alt_function_low);
+    expect(that % (12U << 4) == reg->alt_function_high);
+    expect(that % (1U << 1) == reg->output_type);
+    expect(that % ((0b11U << 6) | (0b01U << 18)) == reg->output_speed);
+    expect(that % ((0b11U << 30) | (0b01U << 6)) == reg->pull_up_pull_down);
+    expect(that % 0U == simulation.unclocked_writes());
+  };
+
+  "port_configuration::commit() register cost"_test = []() {
+    // Setup
+    register_simulation simulation;
+    port_configuration configuration(peripheral::gpio_a);
+    for (std::uint8_t pin_number = 0; pin_number < 8; pin_number++) {
+      configuration.function(pin_number, pin::pin_function::alternate5)
+        .speed(pin_number, pin_speed::fast);
+    }
+    register_trace trace;
+
+    // Exercise
+    configuration.commit();
+
+    // Verify
+    // alternate function low + speed + mode, mode is written last
+    auto const* reg = get_reg(peripheral::gpio_a);
+    expect(register_trace::counts{ .modifies = 3 } == trace.access_counts());
+    expect(that % reinterpret_cast<std::uintptr_t>(&reg->pin_mode) ==
+           trace.entries().back().address);
+  };
+
+  "port_configuration::route()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    auto* reg = get_reg(peripheral::gpio_b);
+    reg->output_type = 1U << 10;
+    reg->pull_up_pull_down = 0b01U << 20;
+
+    // Exercise
+    port_configuration(peripheral::gpio_b)
+      .route(10, pin::pin_function::alternate5, pin_speed::fast)
+      .commit();
+
+    // Verify
+    // Only pin 10's settings change, port B's reset values stay in place
+    expect(that % (0b10U << 20) == (reg->pin_mode & (0b11U << 20)));
+    expect(that % (5U << 8) == reg->alt_function_high);
+    expect(that % 0U == reg->output_type);
+    expect(that % 0U == reg->pull_up_pull_down);
+    expect(that % (0b10U << 20) == (reg->output_speed & (0b11U << 20)));
+  };
+
+  "port_configuration invalid pin"_test = []() {
+    // Setup
+    register_simulation simulation;
+    port_configuration configuration(peripheral::gpio_a);
+
+    // Exercise + Verify
+    expect(throws([&configuration]() { configuration.open_drain(16); }));
+  };
+};
+}  // namespace hal::stm32f4
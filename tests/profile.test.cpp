@@ -0,0 +1,99 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <libhal-stm32f4/profile.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/dwt_reg.hpp"
+
+namespace hal::stm32f4 {
+void profile_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "latency_histogram::record()"_test = []() {
+    // Setup
+    latency_histogram test_subject;
+
+    // Exercise
+    test_subject.record(0);
+    test_subject.record(1);
+    test_subject.record(5);
+    test_subject.record(7);
+    test_subject.record(1000);
+
+    // Verify
+    auto const buckets = test_subject.buckets();
+    expect(that % 1U == buckets[0]);
+    expect(that % 1U == buckets[1]);
+    expect(that % 2U == buckets[3]);
+    expect(that % 1U == buckets[10]);
+    expect(that % 5U == test_subject.count());
+    expect(that % 0U == test_subject.min());
+    expect(that % 1000U == test_subject.max());
+    expect(that % 202U == test_subject.mean());
+  };
+
+  "latency_histogram::percentile()"_test = []() {
+    // Setup
+    latency_histogram test_subject;
+    for (int i = 0; i < 99; i++) {
+      test_subject.record(100);
+    }
+    test_subject.record(5000);
+
+    // Exercise
+    auto const p50 = test_subject.percentile(0.50f);
+    auto const p99 = test_subject.percentile(0.99f);
+    auto const p100 = test_subject.percentile(1.0f);
+
+    // Verify
+    expect(that % 127U == p50);
+    expect(that % 127U == p99);
+    expect(that % 5000U == p100);
+  };
+
+  "latency_histogram::reset()"_test = []() {
+    // Setup
+    latency_histogram test_subject;
+    test_subject.record(42);
+
+    // Exercise
+    test_subject.reset();
+
+    // Verify
+    expect(that % 0U == test_subject.count());
+    expect(that % 0U == test_subject.min());
+    expect(that % 0U == test_subject.max());
+    expect(that % 0U == test_subject.percentile(0.99f));
+  };
+
+  "enable_cycle_counter()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    dwt->cyccnt = 1234;
+
+    // Exercise
+    enable_cycle_counter();
+
+    // Verify
+    expect(that % 1U == (dwt->ctrl & 1U));
+    expect(that % (1U << 24) == core_debug->demcr);
+    expect(that % 1234U == cycle_count());
+  };
+};
+}  // namespace hal::stm32f4
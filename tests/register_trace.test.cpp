@@ -0,0 +1,116 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+
+#include <libhal-stm32f4/output_pin.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+#include <libhal-stm32f4/register_trace.hpp>
+#include <libhal-stm32f4/spi.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/gpio_reg.hpp"
+#include "../src/spi_reg.hpp"
+
+namespace hal::stm32f4 {
+void register_trace_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "register_trace records accesses in order"_test = []() {
+    // Setup
+    register_simulation simulation;
+    output_pin test_subject(peripheral::gpio_b, 7);
+    register_trace trace;
+
+    // Exercise
+    test_subject.level(true);
+    (void)test_subject.level();
+
+    // Verify
+    auto const entries = trace.entries();
+    auto* reg = get_reg(peripheral::gpio_b);
+    expect(that % 2U == entries.size());
+    expect(register_access::write == entries[0].kind);
+    expect(reinterpret_cast<std::uintptr_t>(&reg->set) == entries[0].address);
+    expect(register_access::read == entries[1].kind);
+    expect(reinterpret_cast<std::uintptr_t>(&reg->output_data) ==
+           entries[1].address);
+    expect(that % 0U == trace.dropped());
+  };
+
+  "register_trace::reset()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    output_pin test_subject(peripheral::gpio_b, 7);
+    register_trace trace;
+    test_subject.level(true);
+
+    // Exercise
+    trace.reset();
+
+    // Verify
+    expect(register_trace::counts{} == trace.access_counts());
+    expect(that % 0U == trace.entries().size());
+  };
+
+  "output_pin::configure() register cost"_test = []() {
+    // Setup
+    register_simulation simulation;
+    output_pin test_subject(peripheral::gpio_a, 1);
+    register_trace trace;
+
+    // Exercise
+    test_subject.configure({});
+
+    // Verify
+    // power on is a bit-band store, then mode + output type + pull resistor
+    expect(register_trace::counts{ .writes = 1, .modifies = 3 } ==
+           trace.access_counts());
+  };
+
+  "output_pin::level() register cost"_test = []() {
+    // Setup
+    register_simulation simulation;
+    output_pin test_subject(peripheral::gpio_a, 1);
+    register_trace trace;
+
+    // Exercise
+    test_subject.level(false);
+
+    // Verify
+    expect(register_trace::counts{ .writes = 1 } == trace.access_counts());
+  };
+
+  "spi::transfer() register cost"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi test_subject(hal::runtime{}, 1);
+    std::array<hal::byte, 4> payload{};
+    register_trace trace;
+
+    // Exercise
+    test_subject.transfer(payload, {});
+
+    // Verify
+    // 1 busy check, then per byte: TXE check, data write, RXNE check, data
+    // read. The slave select bit is set and cleared around the transfer with
+    // bit-band stores.
+    expect(register_trace::counts{ .reads = 1 + (3 * 4), .writes = 4 + 2 } ==
+           trace.access_counts());
+  };
+};
+}  // namespace hal::stm32f4
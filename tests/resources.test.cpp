@@ -0,0 +1,126 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <optional>
+#include <utility>
+
+#include <libhal-stm32f4/register_simulation.hpp>
+#include <libhal-stm32f4/resources.hpp>
+#include <libhal-stm32f4/spi.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/dma.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+constexpr spi_pins bus1_on_port_b{ .clock = { peripheral::gpio_b, 3 },
+                                   .data_in = { peripheral::gpio_b, 4 },
+                                   .data_out = { peripheral::gpio_b, 5 } };
+
+constexpr std::array compatible_board{
+  spi_resources(1),
+  spi_resources(2),
+  spi_resources(3),
+  scheduler_resources(),
+};
+static_assert(!find_resource_conflict(compatible_board));
+
+// SPI1 routed to port B takes the default pins of SPI3
+constexpr std::array clashing_board{
+  spi_resources(3),
+  spi_resources(1, bus1_on_port_b),
+};
+static_assert(find_resource_conflict(clashing_board) ==
+              pin_resource(peripheral::gpio_b, 3));
+}  // namespace
+
+void resources_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "drivers cannot share pins"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::optional<spi> bus3(std::in_place, hal::runtime{}, 3);
+
+    // Exercise
+    auto const clash =
+      throws([]() { spi bus1(hal::runtime{}, 1, bus1_on_port_b); });
+    auto const pins_claimed =
+      is_resource_claimed(pin_resource(peripheral::gpio_b, 4));
+    bus3.reset();
+    auto const pins_released =
+      !is_resource_claimed(pin_resource(peripheral::gpio_b, 4));
+    spi bus1(hal::runtime{}, 1, bus1_on_port_b);
+
+    // Verify
+    expect(clash);
+    expect(pins_claimed);
+    expect(pins_released);
+    expect(is_resource_claimed(peripheral_resource(peripheral::spi1)));
+  };
+
+  "drivers cannot share a bus"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi first(hal::runtime{}, 2);
+
+    // Exercise & Verify
+    expect(throws([]() { spi second(hal::runtime{}, 2); }));
+  };
+
+  "resource_claim takes all resources or none"_test = []() {
+    // Setup
+    auto const held = pin_resource(peripheral::gpio_c, 1);
+    auto const free = pin_resource(peripheral::gpio_c, 2);
+    resource_claim holder(resource_list{}.add(held));
+
+    // Exercise
+    auto const clash = throws([&]() {
+      resource_claim both(resource_list{}.add(free).add(held));
+    });
+    auto const free_after_clash = !is_resource_claimed(free);
+    resource_claim moved(std::move(holder));
+    auto const held_after_move = is_resource_claimed(held);
+    moved = resource_claim{};
+
+    // Verify
+    expect(clash);
+    expect(free_after_clash);
+    expect(held_after_move);
+    expect(!is_resource_claimed(held));
+  };
+
+  "dma streams are tracked as resources"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<dma_request, 1> const options{ {
+      { .controller = 2, .stream = 6, .channel = 7 },
+    } };
+    auto const stream = dma_stream_resource(2, 6);
+
+    // Exercise
+    auto const request = claim_dma_stream(options);
+    auto const claimed = is_resource_claimed(stream);
+    release_dma_stream(request);
+
+    // Verify
+    expect(claimed);
+    expect(!is_resource_claimed(stream));
+  };
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,194 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <cstdint>
+
+#include <libhal-stm32f4/clock.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+#include <libhal-stm32f4/scheduler.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/timer_reg.hpp"
+
+namespace hal::stm32f4 {
+void scheduler_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "scheduler runs tasks in deadline order"_test = []() {
+    // Setup
+    register_simulation simulation;
+    scheduler test_subject(hal::runtime{});
+    std::array<int, 3> order{};
+    std::array<std::uint64_t, 3> run_at{};
+    std::size_t count = 0;
+    auto record = [&](int p_id) {
+      return [&, p_id]() {
+        run_at[count] = test_subject.uptime();
+        order[count++] = p_id;
+      };
+    };
+
+    // Exercise
+    test_subject.post_after(30ms, record(1));
+    test_subject.post_after(10ms, record(2));
+    test_subject.post(record(3));
+    test_subject.run();
+
+    // Verify
+    expect(that % 3 == order[0]);
+    expect(that % 2 == order[1]);
+    expect(that % 1 == order[2]);
+    expect(that % 0U == run_at[0]);
+    expect(that % 10'000U == run_at[1]);
+    expect(that % 30'000U == run_at[2]);
+    expect(that % 0U == test_subject.pending());
+    // The core slept once before each delayed task, without a periodic tick
+    expect(that % 2U == simulation.power_mode_entries(power_mode::sleep));
+    expect(30ms == simulation.elapsed());
+  };
+
+  "scheduler runs periodic tasks without drift"_test = []() {
+    // Setup
+    register_simulation simulation;
+    scheduler test_subject(hal::runtime{});
+    std::array<std::uint64_t, 3> run_at{};
+    std::size_t count = 0;
+    scheduler::task_id periodic = 0;
+    periodic = test_subject.post_every(5ms, [&]() {
+      run_at[count++] = test_subject.uptime();
+      // Time spent in the task does not shift the following deadlines
+      simulation.elapse(1ms);
+      if (count == run_at.size()) {
+        test_subject.cancel(periodic);
+      }
+    });
+
+    // Exercise
+    test_subject.run();
+
+    // Verify
+    expect(that % 5'000U == run_at[0]);
+    expect(that % 10'000U == run_at[1]);
+    expect(that % 15'000U == run_at[2]);
+    expect(that % 0U == test_subject.pending());
+  };
+
+  "scheduler cancels queued tasks"_test = []() {
+    // Setup
+    register_simulation simulation;
+    scheduler test_subject(hal::runtime{});
+    bool ran = false;
+    auto const id = test_subject.post_after(1ms, [&ran]() { ran = true; });
+
+    // Exercise
+    auto const cancelled = test_subject.cancel(id);
+    auto const cancelled_twice = test_subject.cancel(id);
+    test_subject.run();
+
+    // Verify
+    expect(cancelled);
+    expect(!cancelled_twice);
+    expect(!ran);
+    expect(that % 0U == test_subject.pending());
+  };
+
+  "scheduler run_due only runs due tasks"_test = []() {
+    // Setup
+    register_simulation simulation;
+    scheduler test_subject(hal::runtime{});
+    int runs = 0;
+    test_subject.post_after(2ms, [&runs]() { runs++; });
+
+    // Exercise
+    auto const queued_early = test_subject.run_due();
+    auto const runs_early = runs;
+    simulation.elapse(2ms);
+    auto const queued_late = test_subject.run_due();
+
+    // Verify
+    expect(queued_early);
+    expect(that % 0 == runs_early);
+    expect(!queued_late);
+    expect(that % 1 == runs);
+  };
+
+  "scheduler extends the counter past 32 bits"_test = []() {
+    // Setup
+    register_simulation simulation;
+    scheduler test_subject(hal::runtime{});
+    timer_reg5->cnt = 0xFFFF'FF00;
+    std::uint64_t run_at = 0;
+
+    // Exercise
+    test_subject.post_after(1ms, [&]() { run_at = test_subject.uptime(); });
+    test_subject.run();
+
+    // Verify
+    expect(that % (0xFFFF'FF00ULL + 1'000U) == run_at);
+    expect(that % 1.0e6f == test_subject.frequency());
+  };
+
+  "scheduler rejects invalid use"_test = []() {
+    // Setup
+    register_simulation simulation;
+    scheduler test_subject(hal::runtime{});
+    for (std::size_t i = 0; i < scheduler::capacity; i++) {
+      test_subject.post([]() {});
+    }
+
+    // Exercise & Verify
+    expect(throws([&]() { test_subject.post([]() {}); }));
+    expect(throws([]() { scheduler second(hal::runtime{}); }));
+    expect(throws([&]() { test_subject.post_every(0ms, []() {}); }));
+  };
+
+  "scheduler rejects unreachable tick rates"_test = []() {
+    // Setup
+    register_simulation simulation;
+
+    // Exercise & Verify
+    expect(throws([]() {
+      scheduler too_fast(hal::runtime{}, { .tick_rate = 64'000'000.0f });
+    }));
+    expect(throws([]() {
+      scheduler too_slow(hal::runtime{}, { .tick_rate = 100.0f });
+    }));
+  };
+
+  "scheduler keeps its tick rate across profiles"_test = []() {
+    // Setup
+    register_simulation simulation;
+    scheduler test_subject(hal::runtime{});
+    simulation.elapse(1ms);
+
+    // Exercise
+    set_clock_profile(hsi_pll_100mhz_profile);
+    auto const fast_prescaler = timer_reg5->psc;
+    auto const fast_uptime = test_subject.uptime();
+    set_clock_profile(hsi_2mhz_profile);
+
+    // Verify
+    // 16MHz / 16, 100MHz / 100 and 2MHz / 2, counting on from 1ms
+    expect(that % 99U == fast_prescaler);
+    expect(that % 1'000U == fast_uptime);
+    expect(that % 1U == timer_reg5->psc);
+    expect(that % 1'000U == test_subject.uptime());
+    expect(that % 1'000'000.0f == test_subject.frequency());
+  };
+};
+}  // namespace hal::stm32f4
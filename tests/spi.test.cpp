@@ -0,0 +1,429 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <vector>
+#include <system_error>
+
+#include <libhal-stm32f4/output_pin.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+#include <libhal-stm32f4/register_trace.hpp>
+#include <libhal-stm32f4/spi.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/dma.hpp"
+#include "../src/gpio_reg.hpp"
+#include "../src/power.hpp"
+#include "../src/spi_reg.hpp"
+
+namespace hal::stm32f4 {
+void spi_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "spi::spi()"_test = []() {
+    // Setup
+    register_simulation simulation;
+
+    // Exercise
+    spi test_subject(hal::runtime{}, 2, { .clock_idles_high = true });
+
+    // Verify
+    expect(bit_extract<control_register1::enable>(spi_reg2->cr1) == 1U);
+    expect(bit_extract<control_register1::master_selection>(spi_reg2->cr1) ==
+           1U);
+    expect(bit_extract<control_register1::clock_polarity>(spi_reg2->cr1) ==
+           1U);
+    expect(that % 0U == simulation.unclocked_writes());
+  };
+
+  "spi::configure() selects pin speed"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi test_subject(hal::runtime{}, 1, { .clock_rate = 1'000'000.0f });
+    auto* port = get_reg(peripheral::gpio_a);
+    // PA5 (SCK), PA6 and PA7 each have a 2-bit speed field
+    constexpr auto pins_mask = bit_mask::from<15, 10>();
+    auto const slow_speed = bit_extract<pins_mask>(port->output_speed);
+
+    // Exercise
+    test_subject.configure({ .clock_rate = 8'000'000.0f });
+    auto const fast_speed = bit_extract<pins_mask>(port->output_speed);
+
+    // Verify
+    expect(that % 0b00'00'00U == slow_speed);
+    expect(that % 0b01'01'01U == fast_speed);
+    expect(that % (0b10'10'10U << 10) == (port->pin_mode & (0x3FU << 10)));
+  };
+
+  "spi::spi() alternate pins"_test = []() {
+    // Setup
+    register_simulation simulation;
+    constexpr auto pins =
+      checked_spi_pins(1,
+                       { .clock = { peripheral::gpio_b, 3 },
+                         .data_in = { peripheral::gpio_b, 4 },
+                         .data_out = { peripheral::gpio_b, 5 } });
+    auto* port = get_reg(peripheral::gpio_b);
+
+    // Exercise
+    spi test_subject(hal::runtime{}, 1, pins);
+
+    // Verify
+    expect(that % 0x0055'5000U == (port->alt_function_low & 0x00FF'F000U));
+    expect(that % (0b10'10'10U << 6) == (port->pin_mode & (0x3FU << 6)));
+  };
+
+  "spi::spi() bus 3 default pins use AF6"_test = []() {
+    // Setup
+    register_simulation simulation;
+    auto* port = get_reg(peripheral::gpio_b);
+
+    // Exercise
+    spi test_subject(hal::runtime{}, 3);
+
+    // Verify
+    expect(that % 0x0066'6000U == (port->alt_function_low & 0x00FF'F000U));
+  };
+
+  "spi::spi() invalid pins"_test = []() {
+    // Setup
+    register_simulation simulation;
+    static_assert(!is_valid_spi_pins(2, default_spi_pins[0]));
+
+    // Exercise + Verify
+    expect(throws([]() {
+      spi test_subject(hal::runtime{}, 2, default_spi_pins[0]);
+    }));
+  };
+
+  "spi::spi() invalid bus"_test = []() {
+    // Setup
+    register_simulation simulation;
+
+    // Exercise + Verify
+    expect(throws([]() { spi test_subject(hal::runtime{}, 6); }));
+  };
+
+  "spi::spi() without exceptions"_test = []() {
+    // Setup
+    register_simulation simulation;
+    constexpr auto settings = checked_spi_settings(
+      1, { .clock_rate = 1'000'000.0f }, hsi_pll_100mhz_profile);
+    std::array<hal::byte, 2> const payload{ 0x12, 0x34 };
+    auto error = std::errc::io_error;
+
+    // Exercise
+    spi test_subject(
+      hal::runtime{}, 1, default_spi_pins[0], settings, error);
+    test_subject.transfer(payload, {});
+
+    // Verify
+    static_assert(noexcept(spi(
+      hal::runtime{}, 1, default_spi_pins[0], settings, error)));
+    expect(error == std::errc{});
+    expect(bit_extract<control_register1::enable>(spi_reg1->cr1) == 1U);
+    expect(std::ranges::equal(payload, simulation.spi_transmitted(1)));
+  };
+
+  "spi::spi() without exceptions reports errors"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi owner(hal::runtime{}, 1);
+    auto invalid_bus = std::errc{};
+    auto invalid_pins = std::errc{};
+    auto too_slow = std::errc{};
+    auto busy = std::errc{};
+
+    // Exercise
+    {
+      spi bus6(hal::runtime{}, 6, default_spi_pins[0], {}, invalid_bus);
+      spi wrong_pins(
+        hal::runtime{}, 2, default_spi_pins[0], {}, invalid_pins);
+      spi slow(hal::runtime{},
+               2,
+               default_spi_pins[1],
+               { .clock_rate = 1'000.0f },
+               too_slow);
+      spi taken(hal::runtime{}, 1, default_spi_pins[0], {}, busy);
+    }
+
+    // Verify
+    expect(invalid_bus == std::errc::operation_not_supported);
+    expect(invalid_pins == std::errc::argument_out_of_domain);
+    expect(too_slow == std::errc::operation_not_supported);
+    expect(busy == std::errc::device_or_resource_busy);
+    // Failed objects neither claimed bus 2 nor powered off bus 1
+    expect(not power(peripheral::spi2).is_on());
+    expect(power(peripheral::spi1).is_on());
+    spi bus2(hal::runtime{}, 2);
+  };
+
+  "spi::configure() without exceptions"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi test_subject(hal::runtime{}, 1, { .clock_rate = 1'000'000.0f });
+    auto const cr1 = spi_reg1->cr1;
+    auto error = std::errc{};
+
+    // Exercise
+    test_subject.configure({ .clock_rate = 1'000.0f }, error);
+    auto const rejected_cr1 = spi_reg1->cr1;
+    test_subject.configure({ .clock_idles_high = true }, error);
+
+    // Verify
+    expect(that % cr1 == rejected_cr1);
+    expect(error == std::errc{});
+    expect(bit_extract<control_register1::clock_polarity>(spi_reg1->cr1) ==
+           1U);
+  };
+
+  "spi::transfer()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi test_subject(hal::runtime{}, 1);
+    std::array<hal::byte, 3> const response{ 0xAA, 0xBB };
+    std::array<hal::byte, 2> const payload{ 0x01, 0x02 };
+    std::array<hal::byte, 4> buffer{};
+    simulation.spi_respond_with(1, response);
+
+    // Exercise
+    test_subject.transfer(payload, buffer, 0xFF);
+
+    // Verify
+    auto const transmitted = simulation.spi_transmitted(1);
+    expect(that % 4U == transmitted.size());
+    expect(that % 0x01 == transmitted[0]);
+    expect(that % 0x02 == transmitted[1]);
+    expect(that % 0xFF == transmitted[2]);
+    expect(that % 0xFF == transmitted[3]);
+    expect(that % 0xAA == buffer[0]);
+    expect(that % 0xBB == buffer[1]);
+    expect(that % 0x00 == buffer[2]);
+    // Response queue exhausted, remaining bytes are looped back
+    expect(that % 0xFF == buffer[3]);
+  };
+  "spi::transaction() runs segments back to back"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi test_subject(hal::runtime{}, 1);
+    std::array<hal::byte, 1> const command{ 0x0B };
+    std::array<hal::byte, 3> const address{ 0x01, 0x02, 0x03 };
+    std::array<hal::byte, 2> data{};
+    std::array<hal::byte, 6> const response{ 0, 0, 0, 0, 0xC0, 0xDE };
+    std::array const segments{
+      spi_segment{ .data_out = command },
+      spi_segment{ .data_out = address },
+      spi_segment{},
+      spi_segment{ .data_in = data, .filler = 0x00 },
+    };
+    simulation.spi_respond_with(1, response);
+
+    // Exercise
+    test_subject.transaction(segments);
+
+    // Verify
+    std::array<hal::byte, 6> const expected{ 0x0B, 0x01, 0x02,
+                                             0x03, 0x00, 0x00 };
+    expect(std::ranges::equal(expected, simulation.spi_transmitted(1)));
+    expect(that % 0xC0 == data[0]);
+    expect(that % 0xDE == data[1]);
+  };
+
+  "spi::transaction() register cost"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi test_subject(hal::runtime{}, 1);
+    std::array<hal::byte, 1> const payload{ 0x5A };
+    std::array const segments{
+      spi_segment{ .data_out = payload },
+      spi_segment{ .data_out = payload },
+      spi_segment{ .data_out = payload },
+    };
+    register_trace trace;
+
+    // Exercise
+    test_subject.transaction(segments);
+
+    // Verify
+    // One idle wait and one select for the whole transaction:
+    // BSY + 3 * (TXE + RXNE + data), select and deselect are bit-band stores
+    auto const counts = trace.access_counts();
+    expect(that % 10U == counts.reads);
+    expect(that % 5U == counts.writes);
+    expect(that % 0U == counts.modifies);
+  };
+
+  "spi::transaction() recovers from an overrun"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi test_subject(hal::runtime{}, 1);
+    std::array<hal::byte, 4> const payload{ 0x01, 0x02, 0x03, 0x04 };
+    std::array<hal::byte, 4> const response{ 0x10, 0x11, 0x12, 0x13 };
+    std::array<hal::byte, 4> data{ 0xFF, 0xFF, 0xFF, 0xFF };
+    std::array const segments{
+      spi_segment{ .data_out = payload, .data_in = data },
+    };
+    simulation.spi_respond_with(1, response);
+    simulation.spi_overrun_next(1);
+
+    // Exercise
+    auto const intact = test_subject.transaction(segments);
+
+    // Verify
+    // The second response was lost, the bytes after it were still received
+    std::array<hal::byte, 4> const expected{ 0x10, 0xFF, 0x12, 0x13 };
+    expect(not intact);
+    expect(std::ranges::equal(payload, simulation.spi_transmitted(1)));
+    expect(std::ranges::equal(expected, data));
+  };
+
+  "spi::transaction() recovers from an overrun before a data read"_test =
+    []() {
+      // Setup
+      register_simulation simulation;
+      spi test_subject(hal::runtime{}, 1);
+      std::array<hal::byte, 4> const payload{ 0x01, 0x02, 0x03, 0x04 };
+      std::array<hal::byte, 4> const response{ 0x10, 0x11, 0x12, 0x13 };
+      std::array<hal::byte, 4> data{ 0xFF, 0xFF, 0xFF, 0xFF };
+      std::array const segments{
+        spi_segment{ .data_out = payload, .data_in = data },
+      };
+      simulation.spi_respond_with(1, response);
+      simulation.spi_overrun_on_read(1);
+
+      // Exercise
+      auto const intact = test_subject.transaction(segments);
+
+      // Verify
+      // The overrun is only visible on the status read that clears it, the
+      // bytes after the lost one still land in their own slots
+      std::array<hal::byte, 4> const expected{ 0x10, 0xFF, 0x12, 0x13 };
+      expect(not intact);
+      expect(std::ranges::equal(payload, simulation.spi_transmitted(1)));
+      expect(std::ranges::equal(expected, data));
+    };
+
+  "spi::transfer() cannot overrun"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi test_subject(hal::runtime{}, 1);
+    std::array<hal::byte, 4> const payload{ 0x01, 0x02, 0x03, 0x04 };
+    std::array<hal::byte, 4> const response{ 0x10, 0x11, 0x12, 0x13 };
+    std::array<hal::byte, 4> data{};
+    simulation.spi_respond_with(1, response);
+    simulation.spi_overrun_next(1);
+
+    // Exercise
+    test_subject.transfer(payload, data);
+
+    // Verify
+    expect(std::ranges::equal(response, data));
+  };
+
+  "spi::transaction() with chip select"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi test_subject(hal::runtime{}, 1);
+    output_pin chip_select(peripheral::gpio_b, 6);
+    chip_select.level(true);
+    std::array<hal::byte, 2> const payload{ 0x01, 0x02 };
+    std::array const segments{ spi_segment{ .data_out = payload } };
+
+    // Exercise
+    test_subject.transaction(chip_select, segments);
+
+    // Verify
+    expect(std::ranges::equal(payload, simulation.spi_transmitted(1)));
+    expect(that % (1U << 6) ==
+           (simulation.gpio_output(peripheral::gpio_b) & (1U << 6)));
+  };
+
+  "spi::start_stream() refills halves without gaps"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi test_subject(hal::runtime{}, 1);
+    std::array<hal::byte, 8> buffer{};
+    std::iota(buffer.begin(), buffer.end(), hal::byte{ 0 });
+    int halves = 0;
+    std::array<hal::byte, 16> expected{};
+    std::iota(expected.begin(), expected.end(), hal::byte{ 0 });
+    std::array<hal::byte, 2> const payload{ 0xAB, 0xCD };
+
+    // Exercise
+    test_subject.start_stream(buffer, [&halves](std::span<hal::byte> p_half) {
+      halves++;
+      for (auto& byte : p_half) {
+        byte = static_cast<hal::byte>(byte + 8);
+      }
+    });
+    auto const was_streaming = test_subject.streaming();
+    simulation.spi_clock_out(1, 16);
+    auto const sent = std::vector(simulation.spi_transmitted(1).begin(),
+                                  simulation.spi_transmitted(1).end());
+    test_subject.stop_stream();
+    simulation.spi_clear(1);
+    test_subject.transfer(payload, {});
+
+    // Verify
+    expect(was_streaming);
+    expect(not test_subject.streaming());
+    expect(that % 4 == halves);
+    expect(std::ranges::equal(expected, sent));
+    expect(not is_dma_stream_claimed(2, 3));
+    expect(bit_extract<control_register2::tx_dma_enable>(spi_reg1->cr2) ==
+           0U);
+    expect(std::ranges::equal(payload, simulation.spi_transmitted(1)));
+  };
+
+  "spi::start_stream() re-times once stopped"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi test_subject(hal::runtime{}, 1, { .clock_rate = 1'000'000.0f });
+    std::array<hal::byte, 4> buffer{ 1, 2, 3, 4 };
+    test_subject.start_stream(buffer, [](std::span<hal::byte>) {});
+    simulation.spi_clock_out(1, 2);
+
+    // Exercise
+    set_clock_profile(hsi_pll_100mhz_profile);
+    auto const streaming =
+      bit_extract<control_register1::baud_rate_control>(spi_reg1->cr1);
+    simulation.spi_clock_out(1, 2);
+    test_subject.stop_stream();
+    auto const stopped =
+      bit_extract<control_register1::baud_rate_control>(spi_reg1->cr1);
+
+    // Verify
+    // 16MHz / 16, then 100MHz / 128
+    expect(that % 3U == streaming);
+    expect(that % 6U == stopped);
+    expect(std::ranges::equal(buffer, simulation.spi_transmitted(1)));
+  };
+
+  "spi::start_stream() invalid buffer"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi test_subject(hal::runtime{}, 1);
+    std::array<hal::byte, 7> buffer{};
+
+    // Exercise + Verify
+    expect(throws([&]() { test_subject.start_stream(buffer, {}); }));
+    expect(not test_subject.streaming());
+  };
+};
+}  // namespace hal::stm32f4
@@ -0,0 +1,277 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+#include <libhal-stm32f4/clock.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+#include <libhal-stm32f4/register_trace.hpp>
+#include <libhal-stm32f4/spi_bus.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/spi_reg.hpp"
+
+namespace hal::stm32f4 {
+namespace {
+/// Chip select that records its levels without touching any registers
+class recording_chip_select : public hal::output_pin
+{
+public:
+  std::array<bool, 8> levels{};
+  std::size_t count = 0;
+
+private:
+  void driver_configure(settings const&) override
+  {
+  }
+  void driver_level(bool p_high) override
+  {
+    if (count < levels.size()) {
+      levels[count++] = p_high;
+    }
+  }
+  bool driver_level() override
+  {
+    return count != 0 && levels[count - 1];
+  }
+};
+}  // namespace
+
+void spi_bus_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "spi_bus::device::transfer() toggles chip select"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi_bus bus(hal::runtime{}, 1);
+    recording_chip_select chip_select;
+    spi_bus::device test_subject(bus, chip_select);
+    std::array<hal::byte, 2> const payload{ 0x01, 0x02 };
+
+    // Exercise
+    test_subject.transfer(payload, std::span<hal::byte>{});
+
+    // Verify
+    expect(that % 3U == chip_select.count);
+    expect(chip_select.levels[0]);
+    expect(not chip_select.levels[1]);
+    expect(chip_select.levels[2]);
+    expect(std::ranges::equal(payload, simulation.spi_transmitted(1)));
+    expect(that % 0U == simulation.unclocked_writes());
+  };
+
+  "spi_bus::device::transfer() device switch only writes"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi_bus bus(hal::runtime{}, 1);
+    recording_chip_select chip_select_a;
+    recording_chip_select chip_select_b;
+    spi_bus::device device_a(bus, chip_select_a, { .clock_rate = 1'000'000 });
+    spi_bus::device device_b(bus,
+                             chip_select_b,
+                             { .clock_rate = 4'000'000,
+                               .clock_idles_high = true });
+    std::array<hal::byte, 1> const payload{ 0x5A };
+    device_a.transfer(payload, std::span<hal::byte>{});
+    register_trace trace;
+
+    // Exercise
+    device_b.transfer(payload, std::span<hal::byte>{});
+
+    // Verify
+    // control register 1 + enable + data
+    // status (TXE, RXNE, BSY) + data
+    auto const counts = trace.access_counts();
+    expect(that % 3U == counts.writes);
+    expect(that % 4U == counts.reads);
+    expect(that % 0U == counts.modifies);
+    expect(bit_extract<control_register1::clock_polarity>(spi_reg1->cr1) ==
+           1U);
+    expect(bit_extract<control_register1::enable>(spi_reg1->cr1) == 1U);
+  };
+
+  "spi_bus::device::transfer() same device skips configuration"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi_bus bus(hal::runtime{}, 1);
+    recording_chip_select chip_select;
+    spi_bus::device test_subject(bus, chip_select);
+    std::array<hal::byte, 1> const payload{ 0x5A };
+    test_subject.transfer(payload, std::span<hal::byte>{});
+    register_trace trace;
+
+    // Exercise
+    test_subject.transfer(payload, std::span<hal::byte>{});
+
+    // Verify
+    auto const counts = trace.access_counts();
+    expect(that % 1U == counts.writes);
+    expect(that % 4U == counts.reads);
+    expect(that % 0U == counts.modifies);
+  };
+
+  "spi_bus::device::configure() reloads control registers"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi_bus bus(hal::runtime{}, 1);
+    recording_chip_select chip_select;
+    spi_bus::device test_subject(bus, chip_select);
+    std::array<hal::byte, 1> const payload{ 0x5A };
+    test_subject.transfer(payload, std::span<hal::byte>{});
+
+    // Exercise
+    test_subject.configure({ .data_valid_on_trailing_edge = true });
+    test_subject.transfer(payload, std::span<hal::byte>{});
+
+    // Verify
+    expect(bit_extract<control_register1::clock_phase>(spi_reg1->cr1) == 1U);
+  };
+
+  "spi_bus hardware chip select"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi_bus bus(hal::runtime{},
+                1,
+                default_spi_pins[0],
+                spi_pin{ peripheral::gpio_a, 4 });
+    spi_bus::device test_subject(bus);
+    std::array<hal::byte, 1> const payload{ 0x5A };
+
+    // Exercise
+    test_subject.transfer(payload, std::span<hal::byte>{});
+
+    // Verify
+    // NSS is released by disabling the peripheral
+    expect(bit_extract<control_register1::enable>(spi_reg1->cr1) == 0U);
+    expect(bit_extract<control_register1::software_slave_management>(
+             spi_reg1->cr1) == 0U);
+    expect(bit_extract<control_register2::slave_select_output_enable>(
+             spi_reg1->cr2) == 1U);
+    expect(std::ranges::equal(payload, simulation.spi_transmitted(1)));
+  };
+
+  "spi_bus hardware chip select requires NSS pin"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi_bus bus(hal::runtime{}, 1);
+
+    // Exercise + Verify
+    expect(throws([&bus]() { spi_bus::device test_subject(bus); }));
+  };
+
+  "spi_bus invalid NSS pin"_test = []() {
+    // Setup
+    register_simulation simulation;
+
+    // Exercise + Verify
+    expect(throws([]() {
+      spi_bus bus(hal::runtime{},
+                  1,
+                  default_spi_pins[0],
+                  spi_pin{ peripheral::gpio_b, 12 });
+    }));
+  };
+
+  "spi_bus::process() runs transactions in order"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi_bus bus(hal::runtime{}, 1);
+    recording_chip_select chip_select_a;
+    recording_chip_select chip_select_b;
+    spi_bus::device device_a(bus, chip_select_a);
+    spi_bus::device device_b(bus, chip_select_b);
+    std::array<hal::byte, 1> const first{ 0x01 };
+    std::array<hal::byte, 1> const second{ 0x02 };
+    std::array<hal::byte, 1> const third{ 0x03 };
+    int completed = 0;
+    bus.enqueue({ .target = &device_a,
+                  .data_out = first,
+                  .on_complete = [&completed]() { completed++; } });
+    bus.enqueue({ .target = &device_b, .data_out = second });
+
+    // Exercise
+    device_a.transfer(third, std::span<hal::byte>{});
+
+    // Verify
+    std::array<hal::byte, 3> const expected{ 0x01, 0x02, 0x03 };
+    expect(std::ranges::equal(expected, simulation.spi_transmitted(1)));
+    expect(that % 1 == completed);
+    expect(that % 0U == bus.pending());
+    expect(that % 5U == chip_select_a.count);
+    expect(that % 3U == chip_select_b.count);
+  };
+
+  "spi_bus::enqueue() rejects when full"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi_bus bus(hal::runtime{}, 1);
+    recording_chip_select chip_select;
+    spi_bus::device test_subject(bus, chip_select);
+    for (std::size_t i = 0; i < spi_bus::queue_capacity; i++) {
+      bus.enqueue({ .target = &test_subject });
+    }
+
+    // Exercise + Verify
+    expect(that % spi_bus::queue_capacity == bus.pending());
+    expect(throws([&]() { bus.enqueue({ .target = &test_subject }); }));
+    expect(throws([&]() { bus.enqueue({}); }));
+  };
+  "spi_bus::device::transaction() one chip select window"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi_bus bus(hal::runtime{}, 1);
+    recording_chip_select chip_select;
+    spi_bus::device test_subject(bus, chip_select);
+    std::array<hal::byte, 1> const command{ 0x9F };
+    std::array<hal::byte, 3> id{};
+    std::array const segments{
+      spi_segment{ .data_out = command },
+      spi_segment{ .data_in = id },
+    };
+
+    // Exercise
+    test_subject.transaction(segments);
+
+    // Verify
+    expect(that % 3U == chip_select.count);
+    expect(that % 4U == simulation.spi_transmitted(1).size());
+    expect(that % 0xFF == id[2]);
+  };
+
+  "spi_bus::device keeps its clock rate across profiles"_test = []() {
+    // Setup
+    register_simulation simulation;
+    spi_bus bus(hal::runtime{}, 1);
+    recording_chip_select chip_select;
+    spi_bus::device test_subject(
+      bus, chip_select, { .clock_rate = 1'000'000.0f });
+    std::array<hal::byte, 1> const payload{ 0x01 };
+    test_subject.transfer(payload, std::span<hal::byte>{});
+
+    // Exercise
+    set_clock_profile(hsi_pll_100mhz_profile);
+    test_subject.transfer(payload, std::span<hal::byte>{});
+
+    // Verify
+    // 100MHz / 128, the closest rate not above 1MHz
+    expect(that % 6U ==
+           bit_extract<control_register1::baud_rate_control>(spi_reg1->cr1));
+  };
+}
+}  // namespace hal::stm32f4
@@ -0,0 +1,203 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+#include <libhal-stm32f4/clock.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+#include <libhal-stm32f4/spi_capture.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/dma_reg.hpp"
+#include "../src/dwt_reg.hpp"
+#include "../src/spi_reg.hpp"
+
+namespace hal::stm32f4 {
+void spi_capture_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "spi_capture::start()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<hal::byte, 8> buffer{};
+    spi_capture test_subject(hal::runtime{}, 2, buffer, [](auto) {});
+
+    // Exercise
+    test_subject.start();
+
+    // Verify
+    // SPI2 receive requests are served by DMA1 stream 3 channel 0
+    auto const& stream = dma_reg1->stream[3];
+    expect(test_subject.running());
+    expect(bit_extract<control_register1::rx_only>(spi_reg2->cr1) == 1U);
+    expect(bit_extract<control_register1::enable>(spi_reg2->cr1) == 1U);
+    expect(bit_extract<control_register2::rx_dma_enable>(spi_reg2->cr2) ==
+           1U);
+    expect(bit_extract<dma_stream_config::enable>(stream.cr) == 1U);
+    expect(bit_extract<dma_stream_config::circular_mode>(stream.cr) == 1U);
+    expect(bit_extract<dma_stream_config::channel>(stream.cr) == 0U);
+    expect(that % 8U == stream.ndtr);
+    expect(that % 0U == simulation.unclocked_writes());
+  };
+
+  "spi_capture delivers each half"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<hal::byte, 4> buffer{};
+    std::array<hal::byte, 6> received{};
+    std::size_t received_count = 0;
+    spi_capture test_subject(
+      hal::runtime{}, 1, buffer, [&](std::span<hal::byte const> p_half) {
+        for (auto const byte : p_half) {
+          if (received_count < received.size()) {
+            received[received_count++] = byte;
+          }
+        }
+      });
+    std::array<hal::byte, 6> const samples{ 1, 2, 3, 4, 5, 6 };
+    simulation.spi_respond_with(1, samples);
+    test_subject.start();
+
+    // Exercise
+    simulation.spi_clock_in(1, samples.size());
+
+    // Verify
+    expect(that % 6U == received_count);
+    expect(std::ranges::equal(samples, received));
+    // Nothing is transmitted in receive-only mode
+    expect(that % 0U == simulation.spi_transmitted(1).size());
+  };
+
+  "spi_capture::stop()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<hal::byte, 8> buffer{};
+    std::size_t calls = 0;
+    spi_capture test_subject(
+      hal::runtime{}, 2, buffer, [&calls](auto) { calls++; });
+    test_subject.start();
+    simulation.spi_clock_in(2, 2);
+
+    // Exercise
+    test_subject.stop();
+    simulation.spi_clock_in(2, 8);
+
+    // Verify
+    // The stop sequence completes bytes 3 through 5 without callbacks
+    auto const& stream = dma_reg1->stream[3];
+    expect(not test_subject.running());
+    expect(that % 0U == calls);
+    expect(bit_extract<control_register1::enable>(spi_reg2->cr1) == 0U);
+    expect(bit_extract<dma_stream_config::enable>(stream.cr) == 0U);
+    expect(that % 3U == stream.ndtr);
+    expect(that % 0U == dma_reg1->lisr);
+  };
+
+  "spi_capture::stop() waits one spi clock in cpu cycles"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<hal::byte, 8> buffer{};
+    spi_capture test_subject(
+      hal::runtime{}, 2, buffer, [](auto) {}, { .clock_rate = 1'000'000.0f });
+    test_subject.start();
+    auto const start = dwt->cyccnt;
+
+    // Exercise
+    test_subject.stop();
+
+    // Verify
+    // 16MHz / 1MHz, measured by the cycle counter rather than loop passes
+    expect(that % 1U ==
+           bit_extract<dwt_control::cycle_count_enable>(dwt->ctrl));
+    expect(dwt->cyccnt - start >= 16U);
+  };
+
+  "spi_capture::start() after stop() restarts at the beginning"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<hal::byte, 2> buffer{};
+    // The stop sequence completes three bytes
+    std::array<hal::byte, 5> const samples{ 0, 0, 0, 0xAB, 0xCD };
+    std::size_t calls = 0;
+    spi_capture test_subject(
+      hal::runtime{}, 2, buffer, [&calls](auto) { calls++; });
+    simulation.spi_respond_with(2, samples);
+    test_subject.start();
+    test_subject.stop();
+
+    // Exercise
+    test_subject.start();
+    simulation.spi_clock_in(2, 2);
+
+    // Verify
+    expect(that % 2U == calls);
+    expect(that % 0xAB == buffer[0]);
+    expect(that % 0xCD == buffer[1]);
+  };
+
+  "spi_capture invalid buffer"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<hal::byte, 3> odd{};
+
+    // Exercise + Verify
+    expect(throws([&odd]() {
+      spi_capture test_subject(hal::runtime{}, 2, odd, [](auto) {});
+    }));
+    expect(throws([]() {
+      spi_capture test_subject(
+        hal::runtime{}, 2, std::span<hal::byte>{}, [](auto) {});
+    }));
+  };
+
+  "spi_capture dma stream allocation"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<hal::byte, 2> buffer{};
+
+    // Exercise + Verify
+    {
+      spi_capture first(hal::runtime{}, 2, buffer, [](auto) {});
+      // SPI2 has a single receive stream
+      expect(throws([&buffer]() {
+        spi_capture second(hal::runtime{}, 2, buffer, [](auto) {});
+      }));
+    }
+    // Released on destruction
+    spi_capture again(hal::runtime{}, 2, buffer, [](auto) {});
+  };
+
+  "spi_capture keeps its clock rate across profiles"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<hal::byte, 8> buffer{};
+    spi_capture test_subject(
+      hal::runtime{}, 2, buffer, [](auto) {}, { .clock_rate = 1'000'000.0f });
+
+    // Exercise
+    set_clock_profile(hsi_pll_100mhz_profile);
+    test_subject.start();
+
+    // Verify
+    // SPI2 runs from the 50MHz APB1 clock: 50MHz / 64
+    expect(that % 5U ==
+           bit_extract<control_register1::baud_rate_control>(spi_reg2->cr1));
+  };
+}
+}  // namespace hal::stm32f4
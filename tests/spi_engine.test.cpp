@@ -0,0 +1,197 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+
+#include <libhal-stm32f4/clock.hpp>
+#include <libhal-stm32f4/register_simulation.hpp>
+#include <libhal-stm32f4/spi_capture.hpp>
+#include <libhal-stm32f4/spi_engine.hpp>
+
+#include <boost/ut.hpp>
+
+#include "../src/dma_reg.hpp"
+#include "../src/spi_reg.hpp"
+
+namespace hal::stm32f4 {
+void spi_engine_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "spi_engine assigns streams to competing buses"_test = []() {
+    // Setup
+    register_simulation simulation;
+    // The first choices of SPI1 take the streams SPI4 and SPI5 depend on
+    std::array<spi_engine::bus_settings, 3> const buses{ {
+      { .bus = 1 },
+      { .bus = 4 },
+      { .bus = 5 },
+    } };
+    std::array<hal::byte, 2> const payload{ 0xC0, 0xDE };
+
+    // Exercise
+    spi_engine test_subject(hal::runtime{}, buses);
+    for (std::uint8_t bus : { 1, 4, 5 }) {
+      test_subject.start(bus, payload, std::span<hal::byte>{});
+    }
+    test_subject.wait_all();
+
+    // Verify
+    for (std::uint8_t bus : { 1, 4, 5 }) {
+      expect(std::ranges::equal(payload, simulation.spi_transmitted(bus)));
+    }
+    expect(that % 0U == simulation.unclocked_writes());
+  };
+
+  "spi_engine runs transfers in parallel"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<spi_engine::bus_settings, 2> const buses{ {
+      { .bus = 1 },
+      { .bus = 2 },
+    } };
+    spi_engine test_subject(hal::runtime{}, buses);
+    std::array<hal::byte, 3> const command_1{ 0x11, 0x12, 0x13 };
+    std::array<hal::byte, 2> const command_2{ 0x21, 0x22 };
+    std::array<hal::byte, 3> const response_1{ 0xA1, 0xA2, 0xA3 };
+    std::array<hal::byte, 2> const response_2{ 0xB1, 0xB2 };
+    std::array<hal::byte, 3> received_1{};
+    std::array<hal::byte, 2> received_2{};
+    simulation.spi_respond_with(1, response_1);
+    simulation.spi_respond_with(2, response_2);
+
+    // Exercise
+    test_subject.start(1, command_1, received_1);
+    test_subject.start(2, command_2, received_2);
+    auto const both_running = test_subject.busy(1) && test_subject.busy(2);
+    test_subject.wait_all();
+
+    // Verify
+    expect(both_running);
+    expect(not test_subject.busy(1));
+    expect(not test_subject.busy(2));
+    expect(std::ranges::equal(command_1, simulation.spi_transmitted(1)));
+    expect(std::ranges::equal(command_2, simulation.spi_transmitted(2)));
+    expect(std::ranges::equal(response_1, received_1));
+    expect(std::ranges::equal(response_2, received_2));
+    // Both buses completed during a single wait
+    expect(that % 1U == simulation.power_mode_entries(power_mode::sleep));
+  };
+
+  "spi_engine::wait_any()"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<spi_engine::bus_settings, 2> const buses{ {
+      { .bus = 2 },
+      { .bus = 3 },
+    } };
+    spi_engine test_subject(hal::runtime{}, buses);
+    std::array<hal::byte, 1> const payload{ 0x55 };
+    test_subject.start(3, payload, std::span<hal::byte>{});
+
+    // Exercise
+    auto const first = test_subject.wait_any();
+    auto const second = test_subject.wait_any();
+
+    // Verify
+    expect(that % 3 == first);
+    expect(that % 0 == second);
+  };
+
+  "spi_engine::start() pads with filler and discards extra bytes"_test =
+    []() {
+      // Setup
+      register_simulation simulation;
+      std::array<spi_engine::bus_settings, 1> const buses{ { { .bus = 1 } } };
+      spi_engine test_subject(hal::runtime{}, buses);
+      std::array<hal::byte, 1> const command{ 0x9F };
+      std::array<hal::byte, 3> id{};
+      std::array<hal::byte, 3> const response{ 0x00, 0xEF, 0x40 };
+      simulation.spi_respond_with(1, response);
+
+      // Exercise
+      test_subject.start(1, command, id, 0x00);
+      test_subject.wait_all();
+
+      // Verify
+      std::array<hal::byte, 3> const expected{ 0x9F, 0x00, 0x00 };
+      expect(std::ranges::equal(expected, simulation.spi_transmitted(1)));
+      expect(std::ranges::equal(response, id));
+    };
+
+  "spi_engine::start() while busy"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<spi_engine::bus_settings, 1> const buses{ { { .bus = 1 } } };
+    spi_engine test_subject(hal::runtime{}, buses);
+    std::array<hal::byte, 1> const payload{ 0x55 };
+    test_subject.start(1, payload, std::span<hal::byte>{});
+
+    // Exercise + Verify
+    expect(throws([&]() {
+      test_subject.start(1, payload, std::span<hal::byte>{});
+    }));
+    expect(throws([&]() {
+      test_subject.start(2, payload, std::span<hal::byte>{});
+    }));
+  };
+
+  "spi_engine rejects duplicate buses"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<spi_engine::bus_settings, 2> const buses{ {
+      { .bus = 1 },
+      { .bus = 1 },
+    } };
+
+    // Exercise + Verify
+    expect(throws(
+      [&buses]() { spi_engine test_subject(hal::runtime{}, buses); }));
+  };
+
+  "spi_engine streams taken by another driver"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<hal::byte, 2> buffer{};
+    spi_capture capture(hal::runtime{}, 2, buffer, [](auto) {});
+    std::array<spi_engine::bus_settings, 1> const buses{ { { .bus = 2 } } };
+
+    // Exercise + Verify
+    expect(throws(
+      [&buses]() { spi_engine test_subject(hal::runtime{}, buses); }));
+  };
+
+  "spi_engine keeps its clock rates across profiles"_test = []() {
+    // Setup
+    register_simulation simulation;
+    std::array<spi_engine::bus_settings, 2> const buses{ {
+      { .bus = 1, .settings = { .clock_rate = 1'000'000.0f } },
+      { .bus = 2, .settings = { .clock_rate = 1'000'000.0f } },
+    } };
+    spi_engine test_subject(hal::runtime{}, buses);
+
+    // Exercise
+    set_clock_profile(hsi_pll_100mhz_profile);
+
+    // Verify
+    // SPI1 runs from the 100MHz APB2 clock and SPI2 from the 50MHz APB1 clock
+    expect(that % 6U ==
+           bit_extract<control_register1::baud_rate_control>(spi_reg1->cr1));
+    expect(that % 5U ==
+           bit_extract<control_register1::baud_rate_control>(spi_reg2->cr1));
+  };
+}
+}  // namespace hal::stm32f4
@@ -0,0 +1,151 @@
+// Copyright 2024 Khalil Estell
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <thread>
+
+#include <libhal-stm32f4/spsc_ring.hpp>
+
+#include <boost/ut.hpp>
+
+namespace hal::stm32f4 {
+void spsc_ring_test()
+{
+  using namespace boost::ut;
+  using namespace std::literals;
+
+  "spsc_ring push and pop"_test = []() {
+    // Setup
+    spsc_ring<std::uint8_t, 4> test_subject;
+
+    // Exercise
+    std::array<bool, 5> pushed{};
+    for (std::uint8_t i = 0; i < pushed.size(); i++) {
+      pushed[i] = test_subject.push(i);
+    }
+    auto const full = test_subject.full();
+    auto const first = test_subject.pop();
+    auto const pushed_after_pop = test_subject.push(9);
+    std::array<std::uint8_t, 8> rest{};
+    auto const rest_count = test_subject.read(rest);
+    auto const empty_pop = test_subject.pop();
+
+    // Verify
+    expect(pushed[0] && pushed[1] && pushed[2] && pushed[3]);
+    expect(!pushed[4]);
+    expect(full);
+    expect(first.has_value() && *first == 0);
+    expect(pushed_after_pop);
+    expect(that % 4U == rest_count);
+    expect(std::ranges::equal(std::array<std::uint8_t, 4>{ 1, 2, 3, 9 },
+                              std::span(rest).first(rest_count)));
+    expect(!empty_pop.has_value());
+    expect(test_subject.empty());
+  };
+
+  "spsc_ring spans stop at the end of the storage"_test = []() {
+    // Setup
+    spsc_ring<std::uint16_t, 8> test_subject;
+    std::array<std::uint16_t, 6> const first{ 1, 2, 3, 4, 5, 6 };
+    test_subject.write(first);
+    std::array<std::uint16_t, 5> drained{};
+    test_subject.read(drained);
+
+    // Exercise
+    auto const free_span = test_subject.write_span();
+    auto const free_size = free_span.size();
+    free_span[0] = 7;
+    free_span[1] = 8;
+    test_subject.commit_write(2);
+    auto const wrapped_span = test_subject.write_span();
+    auto const wrapped_offset_size = wrapped_span.size();
+    wrapped_span[0] = 9;
+    test_subject.commit_write(1);
+    auto const readable = test_subject.read_span();
+    auto const readable_size = readable.size();
+    test_subject.commit_read(readable_size);
+    auto const rest = test_subject.read_span();
+
+    // Verify
+    // Elements 6 to 8 wrap around the 8 element storage
+    expect(that % 2U == free_size);
+    expect(that % 5U == wrapped_offset_size);
+    expect(that % 3U == readable_size);
+    expect(that % 1U == rest.size());
+    expect(that % 9 == rest[0]);
+  };
+
+  "spsc_ring keeps order across threads"_test = []() {
+    // Setup
+    constexpr std::uint32_t count = 1 << 20;
+    static spsc_ring<std::uint32_t, 256> test_subject;
+    std::uint32_t mismatches = 0;
+
+    // Exercise
+    std::thread producer([]() {
+      std::uint32_t next = 0;
+      std::array<std::uint32_t, 37> batch{};
+      while (next < count) {
+        // Alternate between single elements, copies and direct span writes
+        if (next % 3 == 0) {
+          if (test_subject.push(next)) {
+            next++;
+          }
+        } else if (next % 3 == 1) {
+          auto const length =
+            std::min<std::size_t>(batch.size(), count - next);
+          for (std::size_t i = 0; i < length; i++) {
+            batch[i] = next + static_cast<std::uint32_t>(i);
+          }
+          next += static_cast<std::uint32_t>(
+            test_subject.write(std::span(batch).first(length)));
+        } else {
+          auto destination = test_subject.write_span();
+          auto const length =
+            std::min<std::size_t>(destination.size(), count - next);
+          for (std::size_t i = 0; i < length; i++) {
+            destination[i] = next + static_cast<std::uint32_t>(i);
+          }
+          test_subject.commit_write(length);
+          next += static_cast<std::uint32_t>(length);
+        }
+      }
+    });
+
+    std::uint32_t expected = 0;
+    std::array<std::uint32_t, 29> batch{};
+    while (expected < count) {
+      if (expected % 2 == 0) {
+        auto const received = test_subject.read(batch);
+        for (std::size_t i = 0; i < received; i++) {
+          mismatches += batch[i] != expected++ ? 1 : 0;
+        }
+      } else {
+        auto const source = test_subject.read_span();
+        for (auto const value : source) {
+          mismatches += value != expected++ ? 1 : 0;
+        }
+        test_subject.commit_read(source.size());
+      }
+    }
+    producer.join();
+
+    // Verify
+    expect(that % 0U == mismatches);
+    expect(test_subject.empty());
+  };
+};
+}  // namespace hal::stm32f4